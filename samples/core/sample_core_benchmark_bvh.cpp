@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/geometry/AccelerationStructure.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+
+using namespace Saiga;
+using namespace Saiga::AccelerationStructure;
+
+/**
+ * Build time and rays per second of the BVH variants.
+ *
+ * The scene is a procedural height field. Primary rays of a pinhole camera are coherent, the random rays are not.
+ */
+
+std::vector<Triangle> HeightField(int n)
+{
+    auto height = [n](int x, int y) {
+        float fx = float(x) / n * 12;
+        float fy = float(y) / n * 12;
+        return 0.3f * sin(fx) * cos(fy * 1.3f) + 0.1f * sin(fx * 5.1f + fy * 3.7f);
+    };
+    auto vertex = [&](int x, int y) { return vec3(float(x) / n * 2 - 1, height(x, y), float(y) / n * 2 - 1); };
+
+    std::vector<Triangle> result;
+    for (int y = 0; y < n; ++y)
+    {
+        for (int x = 0; x < n; ++x)
+        {
+            result.emplace_back(vertex(x, y), vertex(x + 1, y), vertex(x + 1, y + 1));
+            result.emplace_back(vertex(x, y), vertex(x + 1, y + 1), vertex(x, y + 1));
+        }
+    }
+    return result;
+}
+
+std::vector<Ray> CameraRays(int w, int h)
+{
+    vec3 origin(0, 1.2, 2.2);
+    vec3 forward = (vec3(0, 0, 0) - origin).normalized();
+    vec3 right   = forward.cross(vec3(0, 1, 0)).normalized();
+    vec3 up      = right.cross(forward);
+
+    std::vector<Ray> result;
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            float u = (x + 0.5f) / w * 2 - 1;
+            float v = (y + 0.5f) / h * 2 - 1;
+            result.emplace_back((forward + 0.6f * u * right - 0.45f * v * up).normalized(), origin);
+        }
+    }
+    return result;
+}
+
+std::vector<Ray> RandomRays(int n)
+{
+    std::vector<Ray> result;
+    for (int i = 0; i < n; ++i)
+    {
+        result.emplace_back(Random::MatrixUniform<vec3>(-1, 1).normalized(), Random::MatrixUniform<vec3>(-1, 1));
+    }
+    return result;
+}
+
+double SingleRays(const BVH& bvh, const std::vector<Ray>& rays, std::vector<RayTriangleIntersection>& result)
+{
+    int n   = rays.size();
+    auto st = measureObject(5, [&]() {
+#pragma omp parallel for schedule(dynamic, 64)
+        for (int i = 0; i < n; ++i)
+        {
+            result[i] = bvh.getClosest(rays[i]);
+        }
+    });
+    return n / (st.median / 1000.0);
+}
+
+double BatchedRays(const BVH& bvh, const std::vector<Ray>& rays, std::vector<RayTriangleIntersection>& result)
+{
+    auto st = measureObject(5, [&]() { bvh.getClosest(rays, result); });
+    return rays.size() / (st.median / 1000.0);
+}
+
+int main(int, char**)
+{
+    catchSegFaults();
+    Random::setSeed(3467);
+
+    auto triangles   = HeightField(300);
+    auto camera_rays = CameraRays(1024, 768);
+    auto random_rays = RandomRays(200000);
+
+    std::cout << "Triangles: " << triangles.size() << ", Threads: " << OMP::getMaxThreads() << std::endl;
+
+    Table table({22, 12, 14, 14, 14, 14});
+    table.setFloatPrecision(3);
+    table << "BVH"
+          << "Build ms"
+          << "Camera Mr/s"
+          << "Cam. batch"
+          << "Random Mr/s"
+          << "Rand. batch";
+
+    auto run = [&](const std::string& name, const BVH& bvh, float build_ms) {
+        std::vector<RayTriangleIntersection> cam(camera_rays.size()), rnd(random_rays.size());
+        table << name << build_ms << SingleRays(bvh, camera_rays, cam) / 1e6 << BatchedRays(bvh, camera_rays, cam) / 1e6
+              << SingleRays(bvh, random_rays, rnd) / 1e6 << BatchedRays(bvh, random_rays, rnd) / 1e6;
+    };
+
+    {
+        std::unique_ptr<ObjectMedianBVH> bvh;
+        auto build = measureObject(3, [&]() { bvh = std::make_unique<ObjectMedianBVH>(triangles); });
+        run("ObjectMedianBVH", *bvh, build.median);
+    }
+    {
+        std::unique_ptr<SAHBVH> bvh;
+        auto build = measureObject(3, [&]() { bvh = std::make_unique<SAHBVH>(triangles); });
+        run("SAHBVH", *bvh, build.median);
+    }
+
+    std::cout << "Done." << std::endl;
+    return 0;
+}
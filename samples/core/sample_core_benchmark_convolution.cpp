@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/image/ImageConvolution.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+
+using namespace Saiga;
+
+/**
+ * Run time of the box filter on a 1280x720 float image for increasing radii.
+ *
+ *   Direct:     (2r+1)^2 clampedRead per pixel (how most filters in the tree are written)
+ *   Separable:  ImageConvolution::Separable with two constant kernels, O(r)
+ *   Integral:   ImageConvolution::Box, O(1)
+ *   Valid:      ImageConvolution::BoxValid on a depth map with 10% holes, O(1)
+ */
+int main(int, char**)
+{
+    initSaigaSampleNoWindow();
+
+    int h = 720, w = 1280;
+    int samples = 10;
+
+    TemplatedImage<float> img(h, w), out(h, w);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            img(y, x) = Random::sampleBool(0.1) ? 0 : Random::sampleDouble(0.5, 5);
+        }
+    }
+
+    std::cout << "Image " << w << "x" << h << " Threads: " << OMP::getMaxThreads() << std::endl;
+
+    Table table({8, 12, 12, 12, 12});
+    table.setFloatPrecision(4);
+    table << "Radius"
+          << "Direct"
+          << "Separable"
+          << "Integral"
+          << "Valid";
+
+    ImageConvolution<float> conv;
+    for (int radius : {1, 2, 4, 8, 16, 32})
+    {
+        table << radius;
+        if (radius <= 8)
+        {
+            auto st = measureObject(samples, [&]() {
+                auto src = img.getImageView();
+                for (int y = 0; y < h; ++y)
+                {
+                    for (int x = 0; x < w; ++x)
+                    {
+                        float sum = 0;
+                        for (int i = -radius; i <= radius; ++i)
+                        {
+                            for (int j = -radius; j <= radius; ++j) sum += src.clampedRead(y + i, x + j);
+                        }
+                        out(y, x) = sum / ((2 * radius + 1) * (2 * radius + 1));
+                    }
+                }
+            });
+            table << st.median;
+        }
+        else
+        {
+            table << "-";
+        }
+
+        std::vector<float> kernel(2 * radius + 1, 1.0f / (2 * radius + 1));
+        table << measureObject(samples, [&]() { conv.Separable(img, out, kernel, kernel); }).median;
+        table << measureObject(samples, [&]() { conv.Box(img, out, radius); }).median;
+        table << measureObject(samples, [&]() { conv.BoxValid(img, out, radius); }).median;
+    }
+    return 0;
+}
@@ -0,0 +1,190 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/image/ImageKernels.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+
+#include <functional>
+
+using namespace Saiga;
+
+/**
+ * Throughput (input megapixels / second) of the ImageKernel functions on a 1920x1080 image compared to the
+ * per pixel implementations in ImageView and the previous per pixel implementations of ImageTransformation (which
+ * now forward to ImageKernel).
+ *
+ * Columns:
+ *   Old:       the previous implementation (if there is one)
+ *   Generic:   ImageKernel with the generic backend, 1 thread
+ *   AVX2:      ImageKernel with the AVX2 backend, 1 thread
+ *   Threads:   ImageKernel with the best backend and all threads
+ */
+int main(int, char**)
+{
+    initSaigaSampleNoWindow();
+
+    namespace IK = ImageKernel;
+
+    int h = 1080, w = 1920;
+    int samples       = 20;
+    int max_threads   = OMP::getMaxThreads();
+    double megapixels = h * w / 1e6;
+
+    TemplatedImage<ucvec4> rgba(h, w), rgba2(h, w), rgba_small(h / 2, w / 2);
+    TemplatedImage<ucvec3> rgb(h, w), rgb2(h, w);
+    TemplatedImage<unsigned char> gray(h, w), gray2(h, w), gray_small(h / 2, w / 2);
+    TemplatedImage<float> grayf(h, w), outf(h, w), outf2(h, w), grayf_small(h / 2, w / 2);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            rgba(y, x)  = ucvec4(x * 7 + y, x ^ y, Random::uniformInt(0, 255), 255);
+            rgb(y, x)   = rgba(y, x).head<3>();
+            rgb2(y, x)  = ucvec3(Random::uniformInt(0, 255), y, x);
+            gray(y, x)  = (x + y * 3) % 256;
+            gray2(y, x) = Random::uniformInt(0, 255);
+            grayf(y, x) = gray(y, x) + Random::sampleDouble(0, 1);
+        }
+    }
+
+    std::cout << "Image " << w << "x" << h << " Threads: " << max_threads
+              << " Best backend: " << ImageKernelBackendName(BestImageKernelBackend()) << std::endl;
+
+    Table table({22, 12, 12, 12, 12});
+    table.setFloatPrecision(4);
+    table << "MPixel/s"
+          << "Old"
+          << "Generic"
+          << "AVX2"
+          << "Threads";
+
+    auto mps = [&](std::function<void()> f) { return megapixels / (measureObject(samples, f).median / 1000); };
+
+    // old: the previous implementation (may be empty)
+    // kernel: the ImageKernel function with the given backend
+    auto run = [&](const std::string& name, std::function<void()> old,
+                   std::function<void(ImageKernelBackend)> kernel) {
+        table << name;
+        if (old)
+            table << mps(old);
+        else
+            table << "-";
+
+        OMP::setNumThreads(1);
+        for (auto backend : {ImageKernelBackend::Generic, ImageKernelBackend::AVX2})
+        {
+            if (ImageKernelBackendSupported(backend))
+                table << mps([&]() { kernel(backend); });
+            else
+                table << "-";
+        }
+        OMP::setNumThreads(max_threads);
+        table << mps([&]() { kernel(BestImageKernelBackend()); });
+    };
+
+    // The previous per pixel implementations of ImageTransformation
+    const vec3 gray_weights(0.299f, 0.587f, 0.114f);
+    auto to_gray = [&](const ucvec4& v) { return dot(gray_weights, vec3(v[0], v[1], v[2])); };
+
+    auto scale_down2_old = [&]() {
+        for (int i : rgba_small.rowRange())
+        {
+            for (int j : rgba_small.colRange())
+            {
+                ivec4 sum = rgba(2 * i, 2 * j).cast<int>() + rgba(2 * i + 1, 2 * j).cast<int>() +
+                            rgba(2 * i, 2 * j + 1).cast<int>() + rgba(2 * i + 1, 2 * j + 1).cast<int>();
+                rgba_small(i, j) = (sum / 4).cast<unsigned char>();
+            }
+        }
+    };
+
+    // Color conversion
+    run(
+        "RGBAToGray8",
+        [&]() {
+            rgba.getImageView().copyToTransform(gray2.getImageView(),
+                                                [&](const ucvec4& v) -> unsigned char { return to_gray(v); });
+        },
+        [&](auto b) { IK::RGBAToGray8(rgba, gray2, b); });
+    run("RGBToGray8", nullptr, [&](auto b) { IK::RGBToGray8(rgb, gray2, b); });
+    run(
+        "RGBAToGrayF",
+        [&]() {
+            rgba.getImageView().copyToTransform(outf.getImageView(), [&](const ucvec4& v) { return to_gray(v); });
+        },
+        [&](auto b) { IK::RGBAToGrayF(rgba, outf, 1, b); });
+    run(
+        "Gray8ToRGBA",
+        [&]() {
+            gray.getImageView().copyToTransform(rgba2.getImageView(),
+                                                [](unsigned char v) { return ucvec4(v, v, v, 255); });
+        },
+        [&](auto b) { IK::Gray8ToRGBA(gray, rgba2, 255, b); });
+
+    // Resize and pyramids
+    run("ScaleDown2 RGBA", scale_down2_old, [&](auto b) { IK::ScaleDown2(rgba, rgba_small, b); });
+    run("ScaleDown2 8-bit", nullptr, [&](auto b) { IK::ScaleDown2(gray, gray_small, b); });
+    run(
+        "ScaleDown2 float", [&]() { grayf.getImageView().copyScaleDownPow2(grayf_small.getImageView(), 2); },
+        [&](auto b) { IK::ScaleDown2(grayf, grayf_small, b); });
+    run(
+        "ScaleDown2Median", [&]() { grayf.getImageView().copyToScaleDownMedian(grayf_small.getImageView()); },
+        [&](auto b) { IK::ScaleDown2Median(grayf, grayf_small, true, b); });
+    run("PyramidDown 8-bit", nullptr, [&](auto b) { IK::PyramidDown(gray, gray_small, b); });
+    run("PyramidDown float", nullptr, [&](auto b) { IK::PyramidDown(grayf, grayf_small, b); });
+
+    // Gradients
+    run(
+        "GradientX", [&]() { grayf.getImageView().gx(outf); }, [&](auto b) { IK::GradientX(grayf, outf, b); });
+    run(
+        "GradientY", [&]() { grayf.getImageView().gy(outf); }, [&](auto b) { IK::GradientY(grayf, outf, b); });
+    run("Sobel", nullptr, [&](auto b) { IK::Sobel(gray, outf, outf2, b); });
+
+    // Filters
+    auto clamp = ImageBorder::Clamp;
+    run("BoxFilter 8-bit r=2", nullptr, [&](auto b) { IK::BoxFilter(gray, gray2, 2, clamp, b); });
+    run("BoxFilter float r=2", nullptr, [&](auto b) { IK::BoxFilter(grayf, outf, 2, clamp, b); });
+    run("BoxFilter float r=10", nullptr, [&](auto b) { IK::BoxFilter(grayf, outf, 10, clamp, b); });
+    run("Gaussian 8-bit r=3", nullptr, [&](auto b) { IK::GaussianBlur(gray, gray2, 3, 1.5f, clamp, b); });
+    run("Gaussian float r=3", nullptr, [&](auto b) { IK::GaussianBlur(grayf, outf, 3, 1.5f, clamp, b); });
+
+    // Reductions
+    run(
+        "L1Difference 8-bit",
+        [&]() {
+            long result = 0;
+            for (int i : gray.rowRange())
+            {
+                for (int j : gray.colRange()) result += std::abs(gray(i, j) - gray2(i, j));
+            }
+            return result;
+        },
+        [&](auto b) { IK::L1Difference(gray, gray2, b); });
+    run(
+        "L1Difference RGB",
+        [&]() {
+            long result = 0;
+            for (int i : rgb.rowRange())
+            {
+                for (int j : rgb.colRange())
+                {
+                    result += (rgb(i, j).cast<int>() - rgb2(i, j).cast<int>()).array().abs().sum();
+                }
+            }
+            return result;
+        },
+        [&](auto b) { IK::L1Difference(rgb, rgb2, b); });
+    run("Sum 8-bit", nullptr, [&](auto b) { IK::Sum(gray, b); });
+    run("Sum float", nullptr, [&](auto b) { IK::Sum(grayf, b); });
+    float mn, mx;
+    run(
+        "MinMax float", [&]() { grayf.getImageView().findMinMax(mn, mx); },
+        [&](auto b) { IK::MinMax(grayf, mn, mx, b); });
+
+    return 0;
+}
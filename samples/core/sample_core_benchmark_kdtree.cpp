@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/geometry/kdtree.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+
+using namespace Saiga;
+
+/**
+ * Compares the bucket kd-tree with the previous implementation (one point per node, recursive queries).
+ *
+ * Build time and query throughput for nearest neighbor, k-nearest neighbor and radius queries.
+ */
+
+// The previous implementation. Only used as a baseline in this benchmark.
+class LegacyKDTree
+{
+   public:
+    LegacyKDTree(const std::vector<vec3>& points)
+    {
+        nodes.resize(points.size());
+        for (int i = 0; i < (int)points.size(); ++i)
+        {
+            nodes[i].p             = points[i];
+            nodes[i].initial_index = i;
+        }
+        root = MakeTree(0, nodes.size(), 0);
+    }
+
+    int NearestNeighborSearch(const vec3& q)
+    {
+        int best        = -1;
+        float best_dist = std::numeric_limits<float>::infinity();
+        NearestNeighborSearch(root, q, 0, best, best_dist);
+        return nodes[best].initial_index;
+    }
+
+    std::vector<int> KNearestNeighborSearch(const vec3& q, int k)
+    {
+        std::vector<std::pair<float, int>> queue(k, {1e10, -1});
+        KNearestNeighborSearch(root, q, 0, queue);
+        std::vector<int> result;
+        for (auto& p : queue)
+        {
+            if (p.second != -1) result.push_back(nodes[p.second].initial_index);
+        }
+        return result;
+    }
+
+    std::vector<int> RadiusSearch(const vec3& q, float r)
+    {
+        std::vector<int> result;
+        RadiusSearch(root, q, r * r, 0, result);
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+   private:
+    struct Node
+    {
+        vec3 p;
+        int initial_index;
+        int left = -1, right = -1;
+    };
+    std::vector<Node> nodes;
+    int root;
+
+    int MakeTree(int begin, int end, int axis)
+    {
+        if (begin == end) return -1;
+        if (begin + 1 == end) return begin;
+        std::sort(nodes.begin() + begin, nodes.begin() + end,
+                  [axis](const Node& a, const Node& b) { return a.p[axis] < b.p[axis]; });
+        int median          = (begin + end) / 2;
+        nodes[median].left  = MakeTree(begin, median, (axis + 1) % 3);
+        nodes[median].right = MakeTree(median + 1, end, (axis + 1) % 3);
+        return median;
+    }
+
+    void NearestNeighborSearch(int node, const vec3& q, int axis, int& best, float& best_dist)
+    {
+        if (node == -1) return;
+        float d = (nodes[node].p - q).squaredNorm();
+        if (d < best_dist)
+        {
+            best_dist = d;
+            best      = node;
+        }
+        if (d == 0) return;
+        float d_axis = nodes[node].p[axis] - q[axis];
+        NearestNeighborSearch(d_axis > 0 ? nodes[node].left : nodes[node].right, q, (axis + 1) % 3, best, best_dist);
+        if (d_axis * d_axis >= best_dist) return;
+        NearestNeighborSearch(d_axis > 0 ? nodes[node].right : nodes[node].left, q, (axis + 1) % 3, best, best_dist);
+    }
+
+    void KNearestNeighborSearch(int node, const vec3& q, int axis, std::vector<std::pair<float, int>>& queue)
+    {
+        if (node == -1) return;
+        float d = (nodes[node].p - q).squaredNorm();
+        if (d < queue.back().first)
+        {
+            queue.back() = {d, node};
+            std::sort(queue.begin(), queue.end());
+        }
+        float last   = queue.back().first;
+        float d_axis = nodes[node].p[axis] - q[axis];
+        KNearestNeighborSearch(d_axis > 0 ? nodes[node].left : nodes[node].right, q, (axis + 1) % 3, queue);
+        if (d_axis * d_axis >= last) return;
+        KNearestNeighborSearch(d_axis > 0 ? nodes[node].right : nodes[node].left, q, (axis + 1) % 3, queue);
+    }
+
+    void RadiusSearch(int node, const vec3& q, float r2, int axis, std::vector<int>& result)
+    {
+        if (node == -1) return;
+        float d = (nodes[node].p - q).squaredNorm();
+        if (d < r2) result.push_back(nodes[node].initial_index);
+        float d_axis = nodes[node].p[axis] - q[axis];
+        RadiusSearch(d_axis > 0 ? nodes[node].left : nodes[node].right, q, r2, (axis + 1) % 3, result);
+        if (d_axis * d_axis >= r2) return;
+        RadiusSearch(d_axis > 0 ? nodes[node].right : nodes[node].left, q, r2, (axis + 1) % 3, result);
+    }
+};
+
+std::vector<vec3> RandomPoints(int n)
+{
+    std::vector<vec3> result(n);
+    for (auto& p : result) p = Random::MatrixUniform<vec3>(-1, 1);
+    return result;
+}
+
+int main(int, char**)
+{
+    catchSegFaults();
+    Random::setSeed(93467);
+
+    int num_points  = 1000000;
+    int num_queries = 100000;
+    int k           = 10;
+    // ~30 points per query
+    float radius = 0.025;
+
+    auto points  = RandomPoints(num_points);
+    auto queries = RandomPoints(num_queries);
+
+    std::cout << "Points: " << num_points << ", Queries: " << num_queries << ", Threads: " << OMP::getMaxThreads()
+              << std::endl;
+
+    Table table({28, 12, 12, 12, 12});
+    table.setFloatPrecision(3);
+    table << "Tree"
+          << "Build ms"
+          << "NN Mq/s"
+          << "KNN Mq/s"
+          << "Radius Mq/s";
+
+    auto qps = [&](float ms) { return num_queries / (ms / 1000.0) / 1e6; };
+
+    long sink = 0;
+    {
+        std::unique_ptr<LegacyKDTree> tree;
+        auto build = measureObject(1, [&]() { tree = std::make_unique<LegacyKDTree>(points); });
+        auto nn    = measureObject(3, [&]() {
+            for (auto& q : queries) sink += tree->NearestNeighborSearch(q);
+        });
+        auto knn = measureObject(3, [&]() {
+            for (auto& q : queries) sink += tree->KNearestNeighborSearch(q, k).size();
+        });
+        auto rad = measureObject(3, [&]() {
+            for (auto& q : queries) sink += tree->RadiusSearch(q, radius).size();
+        });
+        table << "Legacy" << build.median << qps(nn.median) << qps(knn.median) << qps(rad.median);
+    }
+
+    {
+        std::unique_ptr<KDTree<3, vec3>> tree;
+        auto build = measureObject(3, [&]() { tree = std::make_unique<KDTree<3, vec3>>(points); });
+
+        auto nn = measureObject(3, [&]() {
+            for (auto& q : queries) sink += tree->NearestNeighborSearch(q);
+        });
+        std::vector<int> indices(k);
+        auto knn = measureObject(3, [&]() {
+            for (auto& q : queries) sink += tree->KNearestNeighborSearch(q, k, indices.data(), nullptr);
+        });
+        std::vector<int> result;
+        auto rad = measureObject(3, [&]() {
+            for (auto& q : queries)
+            {
+                result.clear();
+                tree->RadiusSearch(q, radius, result);
+                sink += result.size();
+            }
+        });
+        table << "Bucket" << build.median << qps(nn.median) << qps(knn.median) << qps(rad.median);
+
+        std::vector<int> nn_out(num_queries);
+        std::vector<int> knn_out(num_queries * k);
+        auto nn_batched  = measureObject(3, [&]() { tree->NearestNeighborSearch(queries, nn_out); });
+        auto knn_batched = measureObject(3, [&]() { tree->KNearestNeighborSearch(queries, k, knn_out); });
+        auto rad_batched = measureObject(3, [&]() { sink += tree->RadiusSearch(queries, radius).size(); });
+        table << "Bucket (batched, parallel)"
+              << "-" << qps(nn_batched.median) << qps(knn_batched.median) << qps(rad_batched.median);
+    }
+
+    std::cout << sink << std::endl;
+    std::cout << "Done." << std::endl;
+    return 0;
+}
@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/LockFreeBuffer.h"
+#include "saiga/core/util/Thread/SynchronizedBuffer.h"
+
+#include <chrono>
+
+using namespace Saiga;
+
+/**
+ * Compares the mutex based SynchronizedBuffer with the lock-free SPSC/MPMC buffers.
+ *
+ * Throughput: P producers push N integers, C consumers pop them.
+ * Latency:    Two threads play ping-pong over two buffers. Half of the round trip time is the hand-off latency.
+ */
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Buffer>
+double throughput(Buffer& buffer, int producers, int consumers, int n)
+{
+    auto st = measureObject(3, [&]() {
+        std::vector<std::thread> threads;
+        std::atomic<long> sum = 0;
+        for (int p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&]() {
+                for (int i = 0; i < n / producers; ++i) buffer.add(i);
+            });
+        }
+        for (int c = 0; c < consumers; ++c)
+        {
+            threads.emplace_back([&]() {
+                long local = 0;
+                for (int i = 0; i < n / consumers; ++i) local += buffer.get();
+                sum += local;
+            });
+        }
+        for (auto& t : threads) t.join();
+    });
+    return n / (st.median / 1000.0);
+}
+
+template <typename Buffer>
+double pingPongLatency(Buffer& ping, Buffer& pong, int n)
+{
+    std::thread other([&]() {
+        for (int i = 0; i < n; ++i) pong.add(ping.get());
+    });
+
+    auto start = Clock::now();
+    for (int i = 0; i < n; ++i)
+    {
+        ping.add(i);
+        pong.get();
+    }
+    auto end = Clock::now();
+    other.join();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (2.0 * n);
+}
+
+template <typename Buffer, typename... Args>
+void benchmark(Table& table, const std::string& name, int n, Args... args)
+{
+    double spsc, mpmc;
+    {
+        Buffer buffer(256, args...);
+        spsc = throughput(buffer, 1, 1, n);
+    }
+    {
+        Buffer buffer(256, args...);
+        mpmc = throughput(buffer, 2, 2, n);
+    }
+    Buffer ping(16, args...), pong(16, args...);
+    double latency = pingPongLatency(ping, pong, n / 10);
+    table << name << spsc / 1e6 << mpmc / 1e6 << latency;
+}
+
+int main(int, char**)
+{
+    catchSegFaults();
+
+    int n = 1000000;
+
+    Table table({24, 14, 14, 14});
+    table.setFloatPrecision(3);
+    table << "Buffer"
+          << "1P/1C Mops/s"
+          << "2P/2C Mops/s"
+          << "Latency ns";
+
+    benchmark<SynchronizedBuffer<int>>(table, "SynchronizedBuffer", n);
+    // The SPSC buffer only supports a single producer, so the 2P/2C column uses the MPMC buffer instead.
+    {
+        double spsc;
+        {
+            SPSCBuffer<int> buffer(256);
+            spsc = throughput(buffer, 1, 1, n);
+        }
+        SPSCBuffer<int> ping(16), pong(16);
+        double latency = pingPongLatency(ping, pong, n / 10);
+        table << "SPSCBuffer" << spsc / 1e6 << "-" << latency;
+    }
+    benchmark<MPMCBuffer<int>>(table, "MPMCBuffer", n);
+    if (std::thread::hardware_concurrency() >= 4)
+    {
+        // Busy waiting only makes sense if every thread has its own core.
+        benchmark<MPMCBuffer<int>>(table, "MPMCBuffer (spin)", n, false);
+    }
+
+    std::cout << "Done." << std::endl;
+    return 0;
+}
@@ -30,7 +30,7 @@ int main(int argc, char* args[])
     auto triangles = mesh.TriangleSoup();
 
 
-    AccelerationStructure::ObjectMedianBVH bf(triangles);
+    AccelerationStructure::SAHBVH bf(triangles);
 
     std::cout << "Num triangles = " << triangles.size() << std::endl;
 
@@ -39,22 +39,25 @@ int main(int argc, char* args[])
 
     {
         SAIGA_BLOCK_TIMER();
-#pragma omp parallel for
+
+        std::vector<Ray> rays(w * h);
         for (int i = 0; i < h; ++i)
         {
             for (int j = 0; j < w; ++j)
             {
-                img(i, j) = ucvec3(255, 0, 0);
+                rays[i * w + j] = camera.PixelRay(vec2(j, i), w, h, false);
+            }
+        }
 
-                //                vec3 dir = camera.inverseprojectToWorldSpace(vec2(j, i), 1, w, h);
-                //                Ray ray(normalize(dir), camera.getPosition());
-                Ray ray = camera.PixelRay(vec2(j, i), w, h, false);
+        // Neighboring pixels are traced together as one ray packet.
+        auto inters = bf.getClosest(rays);
 
-                auto inter = bf.getClosest(ray);
-                if (inter && !inter.backFace)
-                {
-                    img(i, j) = ucvec3(0, 255, 0);
-                }
+        for (int i = 0; i < h; ++i)
+        {
+            for (int j = 0; j < w; ++j)
+            {
+                auto& inter = inters[i * w + j];
+                img(i, j)   = (inter && !inter.backFace) ? ucvec3(0, 255, 0) : ucvec3(255, 0, 0);
             }
         }
     }
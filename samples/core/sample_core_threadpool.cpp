@@ -5,9 +5,12 @@
  */
 
 #include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
 #include "saiga/core/util/Thread/SpinLock.h"
+#include "saiga/core/util/Thread/threadPool.h"
 
 #include <chrono>
+#include <queue>
 
 using namespace Saiga;
 
@@ -50,51 +53,252 @@ void testRingBuffer()
     pipeline.stop();
 }
 
-int main(int argc, char* argv[])
+/**
+ * The previous single-queue thread pool. Only used as a baseline in the benchmark below.
+ */
+class LegacyThreadPool
 {
-    SynchronizedBuffer<int> buffer(5);
-    //    std::vector<char> asdf(100);
-
-    //    testRingBuffer();
+   public:
+    LegacyThreadPool(size_t threads) : stop(false)
+    {
+        for (size_t i = 0; i < threads; ++i)
+        {
+            workers.emplace_back([this] {
+                for (;;)
+                {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(this->queue_mutex);
+                        this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
+                        if (this->stop && this->tasks.empty()) return;
+                        task = std::move(this->tasks.front());
+                        this->tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
 
-    SpinLock sl;
+    ~LegacyThreadPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            stop = true;
+        }
+        condition.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
 
+    template <class F, class... Args>
+    auto enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result_t<F, Args...>>
     {
-        std::unique_lock l(sl);
-        // Critical Section
+        using return_type = typename std::invoke_result_t<F, Args...>;
+        auto task         = std::make_shared<std::packaged_task<return_type()> >(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<return_type> res = task->get_future();
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            tasks.emplace([task]() { (*task)(); });
+        }
+        condition.notify_one();
+        return res;
     }
 
-    createGlobalThreadPool(5);
+   private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()> > tasks;
+    std::mutex queue_mutex;
+    std::condition_variable condition;
+    bool stop;
+};
 
+using Clock = std::chrono::steady_clock;
 
+// A tiny task of a few hundred nanoseconds.
+inline double tinyWork(int i)
+{
+    double x = i;
+    for (int j = 0; j < 50; ++j) x = x * 0.999 + 1.0;
+    return x;
+}
 
-    std::cout << "start" << std::endl;
+std::atomic<double> sink = 0;
 
-    auto f = globalThreadPool->enqueue([]() {
-        std::cout << "hello from other thread." << std::endl;
-        std::this_thread::sleep_for(std::chrono::seconds(3));
+template <typename Pool>
+double throughputFutures(Pool& pool, int num_tasks)
+{
+    std::vector<std::future<double> > futures;
+    futures.reserve(num_tasks);
+    auto st = measureObject(5, [&]() {
+        futures.clear();
+        for (int i = 0; i < num_tasks; ++i) futures.push_back(pool.enqueue(tinyWork, i));
+        double s = 0;
+        for (auto& f : futures) s += f.get();
+        sink = sink + s;
     });
+    return num_tasks / (st.median / 1000.0);
+}
 
-
-    globalThreadPool->enqueue([]() {
-        std::cout << "hello from other thread." << std::endl;
-        std::this_thread::sleep_for(std::chrono::seconds(3));
+double throughputTaskGroup(ThreadPool& pool, int num_tasks)
+{
+    auto st = measureObject(5, [&]() {
+        std::atomic<int> counter = 0;
+        TaskGroup group(pool);
+        for (int i = 0; i < num_tasks; ++i)
+        {
+            group.run([i, &counter]() {
+                if (tinyWork(i) > 0) counter.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+        group.wait();
+        SAIGA_ASSERT(counter == num_tasks);
     });
+    return num_tasks / (st.median / 1000.0);
+}
 
-    globalThreadPool->enqueue([]() {
-        std::cout << "hello from other thread." << std::endl;
-        std::this_thread::sleep_for(std::chrono::seconds(3));
-    });
+double throughputParallelFor(ThreadPool& pool, int num_tasks)
+{
+    std::vector<double> result(num_tasks);
+    auto st = measureObject(5, [&]() { pool.parallel_for(0, num_tasks, [&](int i) { result[i] = tinyWork(i); }, 1); });
+    return num_tasks / (st.median / 1000.0);
+}
 
-    globalThreadPool->enqueue([]() {
-        std::cout << "hello from other thread." << std::endl;
-        std::this_thread::sleep_for(std::chrono::seconds(3));
+// Nested parallelism: every outer task spawns its own group of inner tasks.
+double throughputNested(ThreadPool& pool, int num_tasks)
+{
+    int outer = 64;
+    int inner = num_tasks / outer;
+    std::vector<double> result(outer * inner);
+    auto st = measureObject(5, [&]() {
+        pool.parallel_for(
+            0, outer,
+            [&](int o) { pool.parallel_for(0, inner, [&](int i) { result[o * inner + i] = tinyWork(i); }, 1); }, 1);
     });
+    return outer * inner / (st.median / 1000.0);
+}
+
+/**
+ * Submits bursts of tasks from the main thread and records the time from submission until a worker starts the
+ * task.
+ */
+template <typename Pool>
+std::vector<double> latencyFutures(Pool& pool, int bursts, int burst_size)
+{
+    std::vector<double> latencies(bursts * burst_size);
+    std::vector<std::future<void> > futures(burst_size);
+    for (int b = 0; b < bursts; ++b)
+    {
+        for (int i = 0; i < burst_size; ++i)
+        {
+            auto submit = Clock::now();
+            double* out = &latencies[b * burst_size + i];
+            futures[i]  = pool.enqueue([submit, out, i]() {
+                *out = std::chrono::duration<double, std::micro>(Clock::now() - submit).count();
+                sink = sink + tinyWork(i);
+            });
+        }
+        for (auto& f : futures) f.wait();
+    }
+    return latencies;
+}
+
+std::vector<double> latencyTaskGroup(ThreadPool& pool, int bursts, int burst_size)
+{
+    std::vector<double> latencies(bursts * burst_size);
+    for (int b = 0; b < bursts; ++b)
+    {
+        TaskGroup group(pool);
+        for (int i = 0; i < burst_size; ++i)
+        {
+            auto submit = Clock::now();
+            double* out = &latencies[b * burst_size + i];
+            group.run([submit, out, i]() {
+                *out = std::chrono::duration<double, std::micro>(Clock::now() - submit).count();
+                sink = sink + tinyWork(i);
+            });
+        }
+        group.wait();
+    }
+    return latencies;
+}
+
+double percentile(std::vector<double> data, double p)
+{
+    std::sort(data.begin(), data.end());
+    size_t i = std::min(data.size() - 1, size_t(p * data.size()));
+    return data[i];
+}
+
+void benchmark(int threads)
+{
+    int num_tasks  = 200000;
+    int bursts     = 200;
+    int burst_size = 256;
+
+    std::cout << "Threads: " << threads << ", Tasks: " << num_tasks << std::endl;
+
+    Table table({26, 16});
+    table.setFloatPrecision(2);
+    table << "Throughput"
+          << "MTasks/s";
+    {
+        LegacyThreadPool legacy(threads);
+        table << "Legacy enqueue" << throughputFutures(legacy, num_tasks) / 1e6;
+    }
+
+    ThreadPool pool(threads);
+    table << "WorkStealing enqueue" << throughputFutures(pool, num_tasks) / 1e6;
+    table << "WorkStealing TaskGroup" << throughputTaskGroup(pool, num_tasks) / 1e6;
+    table << "WorkStealing parallel_for" << throughputParallelFor(pool, num_tasks) / 1e6;
+    table << "WorkStealing nested" << throughputNested(pool, num_tasks) / 1e6;
+    std::cout << std::endl;
 
-    std::cout << "before wait " << std::endl;
+    Table latency_table({26, 10, 10, 10, 10});
+    latency_table.setFloatPrecision(2);
+    latency_table << "Latency (us)"
+                  << "p50"
+                  << "p99"
+                  << "p99.9"
+                  << "max";
+    auto print = [&](const std::string& name, const std::vector<double>& l) {
+        latency_table << name << percentile(l, 0.5) << percentile(l, 0.99) << percentile(l, 0.999)
+                      << percentile(l, 1.0);
+    };
+    {
+        LegacyThreadPool legacy(threads);
+        print("Legacy enqueue", latencyFutures(legacy, bursts, burst_size));
+    }
+    print("WorkStealing enqueue", latencyFutures(pool, bursts, burst_size));
+    print("WorkStealing TaskGroup", latencyTaskGroup(pool, bursts, burst_size));
+    std::cout << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    catchSegFaults();
+
+    //    testRingBuffer();
+
+    SpinLock sl;
 
+    {
+        std::unique_lock l(sl);
+        // Critical Section
+    }
+
+    createGlobalThreadPool(5);
+
+    auto f = globalThreadPool->enqueue([]() { std::cout << "hello from other thread." << std::endl; });
     f.wait();
 
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int threads = 1; threads < max_threads; threads *= 2)
+    {
+        benchmark(threads);
+    }
+    benchmark(max_threads);
+
     std::cout << "Done." << std::endl;
     return 0;
 }
@@ -8,6 +8,7 @@
 #include "saiga/core/math/random.h"
 #include "saiga/core/time/all.h"
 #include "saiga/core/util/fileChecker.h"
+#include "saiga/core/util/Thread/omp.h"
 #include "saiga/core/util/table.h"
 #include "saiga/core/util/tostring.h"
 #include "saiga/vision/ceres/CeresBA.h"
@@ -15,6 +16,7 @@
 #include "saiga/vision/recursive/BAPointOnly.h"
 #include "saiga/vision/recursive/BARecursive.h"
 #include "saiga/vision/scene/BALDataset.h"
+#include "saiga/vision/scene/BinarySceneFile.h"
 #include "saiga/vision/scene/SynteticScene.h"
 
 #include <fstream>
@@ -121,6 +123,7 @@ void test_to_file(const OptimizationOptions& baoptions, const std::string& file,
 
         std::vector<std::shared_ptr<BABase>> solvers;
         solvers.push_back(std::make_shared<BARec>());
+        solvers.push_back(std::make_shared<BARecFloat>());
         solvers.push_back(std::make_shared<g2oBA2>());
         solvers.push_back(std::make_shared<CeresBA>());
 
@@ -165,13 +168,138 @@ void test_to_file(const OptimizationOptions& baoptions, const std::string& file,
 }
 
 
-int main(int, char**)
+// Strong scaling of the multi threaded recursive BA (LMOptimizer::solveOMP) from 1 to max_threads threads.
+// The problem size is fixed, so the speedup is time(1 thread) / time(k threads).
+void test_scaling(const OptimizationOptions& baoptions, int max_threads, int its)
+{
+    std::cout << baoptions << std::endl;
+    std::cout << "Running strong scaling test of BARec with up to " << max_threads << " threads..." << std::endl;
+
+    std::vector<int> thread_counts;
+    for (int t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(max_threads);
+
+    for (auto file : getBALFiles())
+    {
+        if (hasEnding(file, ".scene")) continue;
+        Scene scene;
+        buildSceneBAL(scene, SearchPathes::data(balPrefix + file));
+
+        std::cout << "> " << file << " Images: " << scene.images.size() << " Points: " << scene.worldPoints.size()
+                  << std::endl;
+
+        Saiga::Table table({10, 15, 15, 15, 15});
+        table << "Threads"
+              << "Final Error"
+              << "Time_LS"
+              << "Time_Total"
+              << "Speedup";
+
+        double time_single_thread = 0;
+        for (auto threads : thread_counts)
+        {
+            std::vector<double> times;
+            std::vector<double> timesl;
+            double chi2 = 0;
+            for (int i = 0; i < its; ++i)
+            {
+                Scene cpy = scene;
+                BARec ba;
+                ba.create(cpy);
+                ba.optimizationOptions            = baoptions;
+                ba.optimizationOptions.numThreads = threads;
+
+                OptimizationResults result;
+                double init_time;
+                {
+                    ScopedTimer<double> timer(init_time);
+                    ba.initOMP();
+                }
+                result = ba.solveOMP();
+                chi2   = result.cost_final;
+                times.push_back(result.total_time + init_time);
+                timesl.push_back(result.linear_solver_time);
+            }
+
+            auto t  = Statistics(times).median;
+            auto tl = Statistics(timesl).median;
+            if (threads == 1) time_single_thread = t;
+            table << threads << chi2 << tl << t << time_single_thread / t;
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Load times of the BAL text files, the saiga text scene format and the binary scene format.
+// "Open (mmap)" only maps the binary file and checks the header.
+void test_loading(int its)
+{
+    std::cout << "Running load time test..." << std::endl;
+
+    const std::string text_file   = "ba_benchmark_tmp.scene";
+    const std::string binary_file = "ba_benchmark_tmp.sceneb";
+
+    Saiga::Table table({30, 12, 15, 15, 15, 15});
+    table << "File"
+          << "Obs."
+          << "BAL Text"
+          << "Scene Text"
+          << "Scene Binary"
+          << "Open (mmap)";
+
+    for (auto file : getBALFiles())
+    {
+        if (hasEnding(file, ".scene")) continue;
+        auto path = SearchPathes::data(balPrefix + file);
+
+        Scene scene;
+        auto st_bal = measureObject(its, [&]() { scene = Saiga::BALDataset(path).makeScene(); });
+
+        scene.save(text_file);
+        scene.saveBinary(binary_file);
+
+        Scene cpy;
+        auto st_text   = measureObject(its, [&]() { cpy.load(text_file); });
+        auto st_binary = measureObject(its, [&]() { cpy.loadBinary(binary_file); });
+        SAIGA_ASSERT(cpy.worldPoints.size() == scene.worldPoints.size());
+
+        BinarySceneFileView view;
+        auto st_open = measureObject(its, [&]() { view.open(binary_file); });
+        SAIGA_ASSERT(view.header().num_images == scene.images.size());
+
+        table << file << view.header().num_observations << st_bal.median << st_text.median << st_binary.median
+              << st_open.median;
+    }
+    std::remove(text_file.c_str());
+    std::remove(binary_file.c_str());
+}
+
+int main(int argc, char** argv)
 {
     initSaigaSampleNoWindow();
 
     Saiga::EigenHelper::checkEigenCompabitilty<2765>();
     Saiga::Random::setSeed(93865023985);
 
+    if (argc > 1 && std::string(argv[1]) == "scaling")
+    {
+        OptimizationOptions baoptions;
+        baoptions.maxIterations          = 3;
+        baoptions.initialLambda          = 1000;
+        baoptions.maxIterativeIterations = 25;
+        baoptions.iterativeTolerance     = 1e-50;
+        baoptions.solverType             = OptimizationOptions::SolverType::Iterative;
+        int max_threads                  = argc > 2 ? std::stoi(argv[2]) : OMP::getMaxThreads();
+        test_scaling(baoptions, max_threads, 3);
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "loading")
+    {
+        test_loading(3);
+        return 0;
+    }
+
 
 #if 0
 
@@ -261,6 +389,7 @@ int main(int, char**)
     std::vector<std::shared_ptr<BABase>> solvers;
 
     solvers.push_back(std::make_shared<BARec>());
+    solvers.push_back(std::make_shared<BARecFloat>());
     solvers.push_back(std::make_shared<CeresBA>());
     //    solvers.push_back(std::make_shared<BAPoseOnly>());
     solvers.push_back(std::make_shared<g2oBA2>());
@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/vision/slam/MiniBow2Database.h"
+
+using namespace Saiga;
+using namespace MiniBow2;
+
+/**
+ * Query performance of the inverted file BowDatabase compared to linear scoring against every entry.
+ *
+ * The bow vectors are generated randomly with the size of the ORB-SLAM vocabulary (10^6 words). Low word ids are more
+ * likely, which results in a few very long inverted lists similar to real data.
+ */
+
+const int num_words       = 1000000;
+const int words_per_image = 300;
+
+BowVector RandomBowVector()
+{
+    std::vector<std::pair<WordId, WordValue>> words;
+    for (int i = 0; i < words_per_image; ++i)
+    {
+        double u = Random::sampleDouble(0, 1);
+        words.emplace_back(int(num_words * u * u), Random::sampleDouble(0.1, 1));
+    }
+    BowVector v;
+    v.set(words);
+    return v;
+}
+
+int main(int, char**)
+{
+    catchSegFaults();
+    Random::setSeed(3467);
+
+    const int num_entries = 100000;
+    const int num_queries = 200;
+    const int k           = 10;
+
+    std::cout << "Threads: " << OMP::getMaxThreads() << std::endl;
+
+    std::vector<BowVector> bows(num_entries);
+    for (auto& b : bows) b = RandomBowVector();
+    std::vector<BowVector> queries(num_queries);
+    for (auto& q : queries) q = RandomBowVector();
+
+    BowDatabase db;
+    auto st_add = measureObject(1, [&]() {
+        for (auto& b : bows) db.add(b);
+    });
+    std::cout << "Add " << num_entries << " entries: " << st_add.median << " ms" << std::endl;
+
+    // Linear scoring against all entries. Only a few queries, because it is very slow.
+    const int num_linear_queries = 5;
+    auto st_linear               = measureObject(1, [&]() {
+        for (int j = 0; j < num_linear_queries; ++j)
+        {
+            auto& q = queries[j];
+            std::vector<QueryResult> scores;
+            for (int i = 0; i < num_entries; ++i) scores.push_back({i, FeatureVector::score(q, bows[i])});
+            std::partial_sort(scores.begin(), scores.begin() + k, scores.end(),
+                              [](auto& a, auto& b) { return a.score > b.score; });
+        }
+    });
+
+    auto st_db = measureObject(3, [&]() {
+        for (auto& q : queries) db.query(q, k);
+    });
+
+    auto st_db_omp = measureObject(3, [&]() {
+#pragma omp parallel for
+        for (int i = 0; i < num_queries; ++i) db.query(queries[i], k);
+    });
+
+    std::cout << std::endl;
+    Table table({26, 14, 14, 14});
+    table.setFloatPrecision(4);
+    table << "Method"
+          << "ms/Query"
+          << "Queries/s"
+          << "Speedup";
+    double t_linear = st_linear.median / num_linear_queries;
+    double t_db     = st_db.median / num_queries;
+    double t_db_omp = st_db_omp.median / num_queries;
+    table << "Linear" << t_linear << 1000 / t_linear << 1;
+    table << "BowDatabase" << t_db << 1000 / t_db << t_linear / t_db;
+    table << "BowDatabase (OMP)" << t_db_omp << 1000 / t_db_omp << t_linear / t_db_omp;
+
+    std::cout << std::endl;
+    auto st_remove = measureObject(1, [&]() {
+        for (int i = 0; i < num_entries; i += 10) db.remove(i);
+    });
+    std::cout << "Remove " << num_entries / 10 << " entries: " << st_remove.median << " ms" << std::endl;
+
+    auto st_save = measureObject(1, [&]() { db.saveRaw("bow_database.bin"); });
+    BowDatabase db2;
+    auto st_load = measureObject(1, [&]() { db2.loadRaw("bow_database.bin"); });
+    SAIGA_ASSERT(db2.size() == db.size());
+    std::cout << "Save: " << st_save.median << " ms, Load: " << st_load.median << " ms" << std::endl;
+
+    std::cout << "Done." << std::endl;
+    return 0;
+}
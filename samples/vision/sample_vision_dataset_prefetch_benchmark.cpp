@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/vision/camera/CameraBase.h"
+
+#include <filesystem>
+
+using namespace Saiga;
+
+/**
+ * Playback of an image dataset with the different loading modes of DatasetCameraBase.
+ *
+ * A synthetic sequence of png images is written to a temporary directory. The consumer simulates a tracking system
+ * that needs 'work_ms' per frame. Measured are the startup time (Load), the time the consumer is blocked in
+ * getImageSync and the maximum number of frames that are in memory at the same time.
+ *   - Preload: all images are loaded in Load()
+ *   - Sync: each image is loaded in getImageSync
+ *   - Prefetch: the next 'window' images are loaded in the background
+ */
+
+class SyntheticDataset : public DatasetCameraBase
+{
+   public:
+    SyntheticDataset(const DatasetParameters& params, int num_frames) : DatasetCameraBase(params), num_frames(num_frames)
+    {
+        camera_type = CameraInputType::Mono;
+        Load();
+    }
+    ~SyntheticDataset() { close(); }
+
+    int LoadMetaData() override
+    {
+        frames.resize(num_frames);
+        for (int i = 0; i < num_frames; ++i)
+        {
+            frames[i].id         = i;
+            frames[i].timeStamp  = i / 30.0;
+            frames[i].image_file = params.dir + "/" + std::to_string(i) + ".png";
+        }
+        return num_frames;
+    }
+
+    void LoadImageData(FrameData& data) override
+    {
+        data.image.load(data.image_file);
+        loaded_frames++;
+        int current = loaded_frames - consumed_frames;
+        int max     = max_in_memory.load();
+        while (current > max && !max_in_memory.compare_exchange_weak(max, current))
+        {
+        }
+    }
+
+    int num_frames;
+    std::atomic<int> loaded_frames   = 0;
+    std::atomic<int> consumed_frames = 0;
+    std::atomic<int> max_in_memory   = 0;
+};
+
+int main(int argc, char** argv)
+{
+    catchSegFaults();
+
+    int num_frames = argc > 1 ? atoi(argv[1]) : 300;
+    double work_ms = argc > 2 ? atof(argv[2]) : 5;
+    int w          = 752;
+    int h          = 480;
+
+    std::string dir = "dataset_prefetch_benchmark";
+    std::filesystem::create_directories(dir);
+    {
+        GrayImageType img(h, w);
+        for (int i = 0; i < num_frames; ++i)
+        {
+            for (int y = 0; y < h; ++y)
+            {
+                for (int x = 0; x < w; ++x)
+                {
+                    img(y, x) = (x * 7 + y * 3 + i * 11 + ((x * y) >> 5)) & 0xFF;
+                }
+            }
+            img.save(dir + "/" + std::to_string(i) + ".png");
+        }
+    }
+
+    Table table({18, 12, 14, 14, 14});
+    table.setFloatPrecision(4);
+    table << "Mode"
+          << "Load (ms)"
+          << "Wait avg (ms)"
+          << "Wait max (ms)"
+          << "Max frames";
+
+    auto run = [&](const std::string& name, bool preload, int window) {
+        DatasetParameters params;
+        params.dir             = dir;
+        params.playback_fps    = 1000000;
+        params.preload         = preload;
+        params.prefetch_window = window;
+
+        Timer load_timer;
+        load_timer.start();
+        SyntheticDataset dataset(params, num_frames);
+        double load_ms = load_timer.stop().count() / 1000000.0;
+
+        std::vector<double> waits;
+        FrameData frame;
+        while (true)
+        {
+            Timer t;
+            t.start();
+            bool valid = dataset.getImageSync(frame);
+            waits.push_back(t.stop().count() / 1000000.0);
+            if (!valid) break;
+
+            SAIGA_ASSERT(frame.image.valid());
+            frame.FreeImageData();
+            dataset.consumed_frames++;
+
+            std::this_thread::sleep_for(std::chrono::microseconds(int(work_ms * 1000)));
+        }
+        waits.pop_back();
+
+        Statistics st(waits);
+        table << name << load_ms << st.mean << st.max << dataset.max_in_memory.load();
+    };
+
+    run("Preload", true, 0);
+    run("Sync", false, 0);
+    for (int window : {2, 8, 32})
+    {
+        run("Prefetch (" + std::to_string(window) + ")", false, window);
+    }
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/vision/util/DepthmapPreprocessor.h"
+
+using namespace Saiga;
+
+// The previous implementation of DepthProcessor2::filter_gaussian (one temporary image per call, branchy inner
+// loops, single threaded). Only used as a baseline.
+static void LegacyGaussian(ImageView<const float> input, ImageView<float> output, int radius, float sigma)
+{
+    std::vector<float> filter(radius * 2 + 1);
+    for (int i = -radius; i <= radius; ++i)
+    {
+        filter[i + radius] = std::exp(-(i * i / (2.0f * sigma * sigma)));
+    }
+
+    TemplatedImage<float> temp_image(input.height, input.width);
+    temp_image.makeZero();
+
+    auto filter_dir = [&](ImageView<const float> src, ImageView<float> dst, int dx, int dy) {
+        for (int h = 0; h < src.height; ++h)
+        {
+            for (int w = 0; w < src.width; ++w)
+            {
+                if (src(h, w) == 0) continue;
+
+                float weights = filter[radius];
+                float value   = filter[radius] * src(h, w);
+                for (int side : {-1, 1})
+                {
+                    for (int j = 1; j <= radius; ++j)
+                    {
+                        int x = w + side * j * dx, y = h + side * j * dy;
+                        if (!src.inImage(y, x) || src(y, x) == 0) break;
+                        weights += filter[radius + j];
+                        value += filter[radius + j] * src(y, x);
+                    }
+                }
+                dst(h, w) = value / weights;
+            }
+        }
+    };
+    filter_dir(input, temp_image, 1, 0);
+    filter_dir(temp_image, output, 0, 1);
+}
+
+/**
+ * Run time of the depth map filters on a synthetic 1280x720 depth map (slanted planes with depth discontinuities,
+ * noise and 5% holes).
+ *
+ *   - Legacy:   the previous gaussian filter of DepthProcessor2
+ *   - Gaussian, Bilateral, JointBilateral: DepthFilter with radius 4
+ *   - Process:  DepthProcessor2::Process (occlusion edge removal + filter)
+ */
+int main(int argc, char** argv)
+{
+    initSaigaSampleNoWindow();
+
+    int h = 720, w = 1280;
+    int samples = 20;
+
+    TemplatedImage<float> depth(h, w), guide(h, w), output(h, w);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            float d     = 1.5f + 0.001f * x + 0.0005f * y + ((x / 160 + y / 120) % 2 ? 0.8f : 0.0f);
+            depth(y, x) = Random::sampleBool(0.05) ? 0 : d + Random::sampleDouble(-0.005, 0.005);
+            guide(y, x) = d * 100;
+        }
+    }
+
+    std::cout << "Depth map " << w << "x" << h << " Threads: " << OMP::getMaxThreads() << std::endl;
+
+    Table table({20, 14});
+    table.setFloatPrecision(4);
+    table << "Filter"
+          << "Time (ms)";
+
+    {
+        auto st = measureObject(samples, [&]() { LegacyGaussian(depth, output, 4, 1.2f); });
+        table << "Legacy" << st.median;
+    }
+
+    DepthFilter filter;
+    for (auto mode : {DepthFilterMode::Gaussian, DepthFilterMode::Bilateral, DepthFilterMode::JointBilateral})
+    {
+        const char* names[] = {"Gaussian", "Bilateral", "JointBilateral"};
+        filter.params.mode  = mode;
+        auto st             = measureObject(samples, [&]() { filter.Filter(depth, output, guide); });
+        table << names[int(mode)] << st.median;
+    }
+
+    {
+        DepthProcessor2::Settings settings;
+        IntrinsicsPinholed K(900, 900, w / 2, h / 2, 0);
+        settings.cameraParameters = StereoCamera4(K, 0.1 * K.fx).cast<float>();
+        DepthProcessor2 processor(settings);
+
+        TemplatedImage<float> copy(h, w);
+        auto st = measureObject(samples, [&]() {
+            depth.getImageView().copyTo(copy.getImageView());
+            processor.Process(copy);
+        });
+        table << "Process" << st.median;
+    }
+    return 0;
+}
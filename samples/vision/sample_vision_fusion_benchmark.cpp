@@ -0,0 +1,177 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/vision/reconstruction/VoxelFusion.h"
+
+using namespace Saiga;
+
+/**
+ * Block visibility of VoxelFusion on a long synthetic sequence.
+ *
+ * The camera moves through a corridor of 'length' meters. The depth maps are ray traced against the 4 walls. Only the
+ * visibility step is measured:
+ *   - Legacy: the previous implementation (every allocated block is copied and tested for every image)
+ *   - All blocks: every block is tested (visibility_cell_size = 0)
+ *   - Frustum culled: cells of blocks outside the view frustum are skipped
+ */
+
+// Distance along the ray to the first corridor wall
+float TraceCorridor(const Vec3& origin, const Vec3& dir)
+{
+    // x in [-1.5, 1.5], y in [-1.5, 1.2], z unbounded
+    float t = std::numeric_limits<float>::infinity();
+    if (dir.x() > 0) t = std::min<float>(t, (1.5 - origin.x()) / dir.x());
+    if (dir.x() < 0) t = std::min<float>(t, (-1.5 - origin.x()) / dir.x());
+    if (dir.y() > 0) t = std::min<float>(t, (1.2 - origin.y()) / dir.y());
+    if (dir.y() < 0) t = std::min<float>(t, (-1.5 - origin.y()) / dir.y());
+    return t;
+}
+
+void LegacyVisibility(FusionScene& scene, int num_images)
+{
+    auto& tsdf = scene.tsdf;
+    auto K2    = scene.K;
+    if (scene.params.increase_visibility_frustum)
+    {
+        K2.fx *= 0.95;
+        K2.fy *= 0.95;
+    }
+#pragma omp parallel for
+    for (int i = 0; i < num_images; ++i)
+    {
+        auto& dm = scene.images[i];
+        dm.visible_blocks.clear();
+        for (int i = 0; i < tsdf->current_blocks; ++i)
+        {
+            auto block = tsdf->blocks[i];
+            Vec3 c     = tsdf->BlockCenter(block.index).cast<double>();
+            Vec3 pos   = dm.V * c;
+
+            Vec2 np           = pos.head<2>() / pos.z();
+            double voxelDepth = pos.z();
+            if (voxelDepth < 0 || voxelDepth > scene.params.maxIntegrationDistance + 0.4) continue;
+
+            np      = distortNormalizedPoint(np, scene.dis);
+            Vec2 ip = K2.normalizedToImage(np);
+            ip      = ip.array().round();
+            int ipx = ip(0);
+            int ipy = ip(1);
+            if (!dm.depthMap.inImage(ipy, ipx)) continue;
+            dm.visible_blocks.push_back(block.index);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    catchSegFaults();
+
+    int num_frames = argc > 1 ? atoi(argv[1]) : 3000;
+    float length   = argc > 2 ? atof(argv[2]) : 150;
+    int w          = 80;
+    int h          = 60;
+
+    FusionScene scene;
+    scene.K                              = IntrinsicsPinholed(60, 60, w / 2.0, h / 2.0, 0);
+    scene.dis                            = Distortion();
+    scene.params.voxelSize               = 0.05;
+    scene.params.truncationDistance      = 0.1;
+    scene.params.truncationDistanceScale = 0;
+    scene.params.maxIntegrationDistance  = 3;
+    scene.params.use_confidence          = false;
+    scene.params.verbose                 = false;
+    scene.params.out_file                = "";
+
+    // Camera moves along +z and slowly turns left and right
+    std::vector<TemplatedImage<float>> depth_maps(num_frames);
+    for (int f = 0; f < num_frames; ++f)
+    {
+        double alpha = f / double(num_frames);
+        Vec3 position(0.5 * sin(alpha * 40), 0, alpha * length);
+        Quat q(Eigen::AngleAxisd(0.4 * sin(alpha * 25), Vec3(0, 1, 0)));
+        SE3 camera_to_world(q, position);
+
+        auto& dm = depth_maps[f];
+        dm.create(h, w);
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                Vec2 np = scene.K.unproject2(Vec2(x, y));
+                Vec3 dir_cam(np(0), np(1), 1);
+                Vec3 dir = camera_to_world.so3() * dir_cam;
+                float t  = TraceCorridor(position, dir);
+                dm(y, x) = t;  // t is the depth, because dir_cam.z() == 1
+            }
+        }
+
+        FusionImage fi;
+        fi.depthMap = dm.getImageView();
+        fi.V        = camera_to_world.inverse();
+        scene.images.push_back(fi);
+    }
+
+    scene.Preprocess();
+    scene.AnalyseSparseStructure();
+
+    std::cout << "Frames: " << num_frames << " Blocks: " << scene.tsdf->current_blocks
+              << " Threads: " << OMP::getMaxThreads() << std::endl;
+
+    // The legacy implementation is only measured on a subset, because it is very slow
+    int legacy_frames = std::min(num_frames, 200);
+
+    auto st_legacy = measureObject(1, [&]() { LegacyVisibility(scene, legacy_frames); });
+    std::vector<std::vector<ivec3>> legacy_result;
+    for (int i = 0; i < legacy_frames; ++i) legacy_result.push_back(scene.images[i].visible_blocks);
+
+    scene.params.visibility_cell_size = 0;
+    auto st_all                       = measureObject(1, [&]() { scene.Visibility(); });
+
+    Table table({20, 14, 14, 14});
+    table.setFloatPrecision(4);
+    table << "Method"
+          << "ms/frame"
+          << "Speedup"
+          << "Visible";
+
+    auto count_visible = [&]() {
+        size_t n = 0;
+        for (auto& i : scene.images) n += i.visible_blocks.size();
+        return n / scene.images.size();
+    };
+
+    double legacy_per_frame = st_legacy.median / legacy_frames;
+    table << "Legacy" << legacy_per_frame << 1 << "";
+    table << "All blocks" << st_all.median / num_frames << legacy_per_frame / (st_all.median / num_frames)
+          << count_visible();
+
+    for (int cell_size : {4, 8, 16})
+    {
+        scene.params.visibility_cell_size = cell_size;
+        auto st                           = measureObject(1, [&]() { scene.Visibility(); });
+        table << ("Culled (" + std::to_string(cell_size) + ")") << st.median / num_frames
+              << legacy_per_frame / (st.median / num_frames) << count_visible();
+
+        // Same blocks as the brute force test
+        for (int i = 0; i < legacy_frames; ++i)
+        {
+            auto a   = legacy_result[i];
+            auto b   = scene.images[i].visible_blocks;
+            auto cmp = [](const ivec3& x, const ivec3& y) {
+                return std::tie(x.x(), x.y(), x.z()) < std::tie(y.x(), y.y(), y.z());
+            };
+            std::sort(a.begin(), a.end(), cmp);
+            std::sort(b.begin(), b.end(), cmp);
+            if (a != b) SAIGA_EXIT_ERROR("Culled visibility differs from the brute force result");
+        }
+    }
+
+    std::cout << "Done." << std::endl;
+    return 0;
+}
@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/vision/features/OrbMatcher.h"
+
+using namespace Saiga;
+
+/**
+ * Throughput of the hamming distance backends and the brute force ORB matcher.
+ *
+ * LegacyMatchKnn2 is the previous BruteForceMatcher::matchKnn2_omp implementation (one scalar distance per pair).
+ */
+
+int LegacyMatchKnn2(ArrayView<DescriptorORB> desc1, ArrayView<DescriptorORB> desc2, int threshold, float ratio)
+{
+    int matches = 0;
+#pragma omp parallel for reduction(+ : matches)
+    for (int i = 0; i < (int)desc1.size(); ++i)
+    {
+        std::pair<int, int> best = {1000, -1}, second = {1000, -1};
+        for (int j = 0; j < (int)desc2.size(); ++j)
+        {
+            auto dis = distance(desc1[i], desc2[j]);
+            if (dis < best.first)
+            {
+                second = best;
+                best   = {dis, j};
+            }
+            else if (dis < second.first)
+            {
+                second = {dis, j};
+            }
+        }
+        if (best.first <= threshold && best.first <= second.first * ratio) matches++;
+    }
+    return matches;
+}
+
+std::vector<DescriptorORB> RandomDescriptors(int n)
+{
+    std::vector<DescriptorORB> result(n);
+    for (auto& d : result)
+    {
+        for (auto& v : d) v = Random::urand64();
+    }
+    return result;
+}
+
+int main(int, char**)
+{
+    catchSegFaults();
+    Random::setSeed(3467);
+
+    std::cout << "Threads: " << OMP::getMaxThreads() << std::endl;
+
+    for (int n : {2000, 10000})
+    {
+        auto query = RandomDescriptors(n);
+        auto train = RandomDescriptors(n);
+        std::vector<int> dis(size_t(n) * n);
+
+        std::cout << std::endl << n << " x " << n << " descriptors" << std::endl;
+        Table table({12, 14, 14, 14});
+        table.setFloatPrecision(4);
+        table << "Backend"
+              << "Time ms"
+              << "MDist/s"
+              << "Speedup";
+
+        double reference = 0;
+        for (auto b : {HammingBackend::Scalar, HammingBackend::AVX2, HammingBackend::AVX512})
+        {
+            if (!HammingBackendSupported(b)) continue;
+            auto st = measureObject(5, [&]() { DistanceManyToMany(query, train, dis.data(), b); });
+            if (b == HammingBackend::Scalar) reference = st.median;
+            table << HammingBackendName(b) << st.median << double(n) * n / (st.median * 1000)
+                  << reference / st.median;
+        }
+
+        // Complete matching with knn=2 + ratio test
+        {
+            int old_matches = 0;
+            auto st_old     = measureObject(3, [&]() { old_matches = LegacyMatchKnn2(query, train, 100, 0.8f); });
+
+            std::vector<DescriptorMatch> matches;
+            auto st_new = measureObject(3, [&]() { matches = MatchORB(query, train); });
+
+            std::cout << std::endl;
+            Table table2({26, 14, 14, 14});
+            table2.setFloatPrecision(4);
+            table2 << "Matcher"
+                   << "Time ms"
+                   << "Queries/s"
+                   << "Speedup";
+            SAIGA_ASSERT(old_matches == (int)matches.size());
+            table2 << "Legacy matchKnn2_omp" << st_old.median << n / (st_old.median / 1000) << 1;
+            table2 << "MatchORB (" + std::string(HammingBackendName(BestHammingBackend())) + ")" << st_new.median
+                   << n / (st_new.median / 1000) << st_old.median / st_new.median;
+        }
+    }
+
+    std::cout << "Done." << std::endl;
+    return 0;
+}
@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/image/imageTransformations.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/vision/features/FastDetector.h"
+#include "saiga/vision/features/ORBExtractor.h"
+
+#ifdef SAIGA_USE_OPENCV
+#    include "saiga/vision/opencv/opencv.h"
+
+#    include <opencv2/features2d/features2d.hpp>
+#    include <opencv2/imgproc/imgproc.hpp>
+#endif
+
+using namespace Saiga;
+
+/**
+ * Run time of the ORBExtractor building blocks on a VGA image.
+ *
+ *   - FAST:     DetectFAST on the complete image (all backends) and cv::FAST
+ *   - Pyramid:  ResizeLinear + FillBorderReflect101 and cv::resize + cv::copyMakeBorder for all 8 levels
+ *   - Gaussian: GaussianBlur and cv::GaussianBlur (7x7, sigma 2)
+ *   - Extract:  ORBExtractor::Detect with 1000 and 2000 features
+ *
+ * The OpenCV rows are only available if saiga was built with OpenCV.
+ *
+ * Afterwards the orientation + descriptor throughput (descriptors/second) of all FAST corners of the image is
+ * measured for the per keypoint functions ORB::ComputeAngle/ComputeDescriptor and the batch functions
+ * ORB::ComputeAngles/ComputeDescriptors.
+ */
+int main(int argc, char** argv)
+{
+    initSaigaSampleNoWindow();
+
+    std::string file = argc > 1 ? argv[1] : "textures/redie.png";
+    int samples      = 50;
+
+    TemplatedImage<ucvec3> input(file);
+    TemplatedImage<unsigned char> input_gray(input.dimensions());
+    for (int y = 0; y < input.h; ++y)
+    {
+        for (int x = 0; x < input.w; ++x)
+        {
+            vec3 c           = input(y, x).cast<float>();
+            input_gray(y, x) = iRound(c.dot(vec3(0.299f, 0.587f, 0.114f)));
+        }
+    }
+
+    TemplatedImage<unsigned char> image(480, 640);
+    ImageTransformation::ResizeLinear(input_gray, image);
+    std::cout << "Image: " << file << " " << image.w << "x" << image.h << " Threads: " << OMP::getMaxThreads()
+              << std::endl;
+
+    Table table({28, 14, 14});
+    table.setFloatPrecision(4);
+    table << "Kernel"
+          << "Time (ms)"
+          << "Result";
+
+    // FAST
+    std::vector<KeyPoint<float>> reference;
+    DetectFAST(image, reference, 20, true, FastBackend::Scalar);
+    for (auto backend : {FastBackend::Scalar, FastBackend::AVX2})
+    {
+        if (!FastBackendSupported(backend)) continue;
+        std::vector<KeyPoint<float>> kps;
+        auto st = measureObject(samples, [&]() { DetectFAST(image, kps, 20, true, backend); });
+        table << std::string("FAST ") + FastBackendName(backend) << st.median << kps.size();
+        if (kps != reference) SAIGA_EXIT_ERROR("FAST backends computed different keypoints");
+    }
+
+    // Pyramid
+    ScalePyramid pyramid(8, 1.2, 1000);
+    const int border = 19;
+    std::vector<TemplatedImage<unsigned char>> levels;
+    for (int l = 0; l < 8; ++l)
+    {
+        float scale = pyramid.InverseScale(l);
+        levels.emplace_back(iRound(image.h * scale) + 2 * border, iRound(image.w * scale) + 2 * border);
+    }
+    auto inner = [&](int l) { return levels[l].getImageView().subImageView(border, border, levels[l].h - 2 * border,
+                                                                           levels[l].w - 2 * border); };
+    auto st_pyramid = measureObject(samples, [&]() {
+        image.getImageView().copyTo(inner(0));
+        ImageTransformation::FillBorderReflect101(levels[0], border);
+        for (int l = 1; l < 8; ++l)
+        {
+            ImageTransformation::ResizeLinear(inner(l - 1), inner(l));
+            ImageTransformation::FillBorderReflect101(levels[l], border);
+        }
+    });
+    table << "Pyramid" << st_pyramid.median << "";
+
+    // Gaussian
+    TemplatedImage<unsigned char> blurred(image.dimensions());
+    auto st_gauss = measureObject(samples, [&]() { ImageTransformation::GaussianBlur(image, blurred, 3, 2); });
+    table << "Gaussian" << st_gauss.median << "";
+
+#ifdef SAIGA_USE_OPENCV
+    {
+        cv::Mat cv_image = ImageViewToMat(image.getImageView());
+        std::vector<cv::KeyPoint> cv_kps;
+        auto st = measureObject(samples, [&]() { cv::FAST(cv_image, cv_kps, 20, true); });
+        table << "FAST OpenCV" << st.median << cv_kps.size();
+
+        std::vector<cv::Mat> cv_levels(8);
+        auto st_cv_pyramid = measureObject(samples, [&]() {
+            cv::copyMakeBorder(cv_image, cv_levels[0], border, border, border, border, cv::BORDER_REFLECT_101);
+            for (int l = 1; l < 8; ++l)
+            {
+                cv::Mat prev = cv_levels[l - 1](cv::Rect(border, border, cv_levels[l - 1].cols - 2 * border,
+                                                         cv_levels[l - 1].rows - 2 * border));
+                cv::Mat resized;
+                cv::resize(prev, resized, cv::Size(levels[l].w - 2 * border, levels[l].h - 2 * border), 0, 0,
+                           cv::INTER_LINEAR);
+                cv::copyMakeBorder(resized, cv_levels[l], border, border, border, border, cv::BORDER_REFLECT_101);
+            }
+        });
+        table << "Pyramid OpenCV" << st_cv_pyramid.median << "";
+
+        cv::Mat cv_blurred;
+        auto st_cv_gauss = measureObject(
+            samples, [&]() { cv::GaussianBlur(cv_image, cv_blurred, cv::Size(7, 7), 2, 2, cv::BORDER_REFLECT_101); });
+        table << "Gaussian OpenCV" << st_cv_gauss.median << "";
+    }
+#endif
+
+    // Complete extraction
+    for (int features : {1000, 2000})
+    {
+        for (int threads : {1, OMP::getMaxThreads()})
+        {
+            ORBExtractor extractor(features, 1.2, 8, 20, 7, threads);
+            std::vector<KeyPoint<float>> kps;
+            std::vector<DescriptorORB> descriptors;
+            auto st = measureObject(samples, [&]() { extractor.Detect(image, kps, descriptors); });
+            table << "Extract " + std::to_string(features) + " (" + std::to_string(threads) + " threads)" << st.median
+                  << kps.size();
+            if (threads == OMP::getMaxThreads()) break;
+        }
+    }
+
+    // Orientation + descriptor
+    {
+        TemplatedImage<unsigned char> gauss(image.dimensions());
+        ImageTransformation::GaussianBlur(image, gauss, 3, 2);
+
+        std::vector<KeyPoint<float>> kps;
+        DetectFAST(image.getImageView().subImageView(16, 16, image.h - 32, image.w - 32), kps, 20, true);
+        for (auto& kp : kps) kp.point += vec2(16, 16);
+
+        ORB orb;
+        std::vector<DescriptorORB> descriptors(kps.size());
+        auto st_single = measureObject(samples, [&]() {
+            for (size_t i = 0; i < kps.size(); ++i)
+            {
+                kps[i].angle   = orb.ComputeAngle(image, kps[i].point);
+                descriptors[i] = orb.ComputeDescriptor(gauss, kps[i].point, kps[i].angle);
+            }
+        });
+
+        Table table2({28, 14, 14, 14});
+        table2.setFloatPrecision(4);
+        table2 << "Descriptors (" + std::to_string(kps.size()) + ")"
+               << "Time (ms)"
+               << "Desc/s (M)"
+               << "Speedup";
+        table2 << "Per keypoint" << st_single.median << kps.size() / st_single.median / 1000 << 1;
+
+        for (int threads : {1, OMP::getMaxThreads()})
+        {
+            auto st = measureObject(samples, [&]() {
+                orb.ComputeAngles(image, kps, threads);
+                orb.ComputeDescriptors(gauss, kps, descriptors, threads);
+            });
+            table2 << "Batch (" + std::to_string(threads) + " threads)" << st.median
+                   << kps.size() / st.median / 1000 << st_single.median / st.median;
+            if (threads == OMP::getMaxThreads()) break;
+        }
+    }
+
+    return 0;
+}
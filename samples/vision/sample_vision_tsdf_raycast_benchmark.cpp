@@ -0,0 +1,155 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/vision/reconstruction/SparseTSDFRaycast.h"
+#include "saiga/vision/reconstruction/VoxelFusion.h"
+
+using namespace Saiga;
+
+/**
+ * Depth map rendering of a fused TSDF, as used for model-to-frame tracking.
+ *
+ * A corridor is fused (see sample_vision_fusion_benchmark) and rendered from the fused poses with:
+ *   - Legacy: SparseTSDF::RaySurfaceIntersection for every pixel (fixed step, 8 hash lookups per sample)
+ *   - Raycast: SparseTSDFRaycast (tiles, empty space skipping, cached blocks, sdf step size)
+ */
+
+float TraceCorridor(const Vec3& origin, const Vec3& dir)
+{
+    float t = std::numeric_limits<float>::infinity();
+    if (dir.x() > 0) t = std::min<float>(t, (1.5 - origin.x()) / dir.x());
+    if (dir.x() < 0) t = std::min<float>(t, (-1.5 - origin.x()) / dir.x());
+    if (dir.y() > 0) t = std::min<float>(t, (1.2 - origin.y()) / dir.y());
+    if (dir.y() < 0) t = std::min<float>(t, (-1.5 - origin.y()) / dir.y());
+    return t;
+}
+
+int main(int argc, char** argv)
+{
+    catchSegFaults();
+
+    int num_frames = argc > 1 ? atoi(argv[1]) : 100;
+    float length   = argc > 2 ? atof(argv[2]) : 10;
+    int w          = 320;
+    int h          = 240;
+
+    FusionScene scene;
+    scene.K                              = IntrinsicsPinholed(240, 240, w / 2.0, h / 2.0, 0);
+    scene.dis                            = Distortion();
+    scene.params.voxelSize               = 0.02;
+    scene.params.truncationDistance      = 0.08;
+    scene.params.truncationDistanceScale = 0;
+    scene.params.maxIntegrationDistance  = 4;
+    scene.params.use_confidence          = false;
+    scene.params.verbose                 = false;
+    scene.params.out_file                = "";
+    scene.params.block_count             = 200000;
+    scene.params.hash_size               = 200000;
+
+    std::vector<SE3> poses;
+    TemplatedImage<float> depth_map(h, w);
+    for (int f = 0; f < num_frames; ++f)
+    {
+        double alpha = f / double(num_frames);
+        Vec3 position(0.5 * sin(alpha * 20), 0, alpha * length);
+        Quat q(Eigen::AngleAxisd(0.4 * sin(alpha * 12), Vec3(0, 1, 0)));
+        SE3 camera_to_world(q, position);
+
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                Vec2 np = scene.K.unproject2(Vec2(x, y));
+                Vec3 dir_cam(np(0), np(1), 1);
+                Vec3 dir        = camera_to_world.so3() * dir_cam;
+                depth_map(y, x) = TraceCorridor(position, dir);
+            }
+        }
+
+        FusionImage fi;
+        fi.depthMap = depth_map.getImageView();
+        fi.V        = camera_to_world.inverse();
+        scene.FuseIncrement(fi, f == 0);
+        poses.push_back(fi.V);
+    }
+
+    auto& tsdf = *scene.tsdf;
+    std::cout << "Frames: " << num_frames << " Blocks: " << tsdf.current_blocks << " Image: " << w << "x" << h
+              << " Threads: " << OMP::getMaxThreads() << std::endl;
+
+    float max_depth = scene.params.maxIntegrationDistance;
+
+    // Only a few frames for the legacy method, because it is slow.
+    int legacy_frames = std::min(num_frames, 5);
+    std::vector<TemplatedImage<float>> legacy_depth(legacy_frames);
+    auto st_legacy = measureObject(1, [&]() {
+        for (int f = 0; f < legacy_frames; ++f)
+        {
+            SE3 V_inv   = poses[f].inverse();
+            vec3 origin = V_inv.translation().cast<float>();
+            auto& dm    = legacy_depth[f];
+            dm.create(h, w);
+#pragma omp parallel for
+            for (int y = 0; y < h; ++y)
+            {
+                for (int x = 0; x < w; ++x)
+                {
+                    Vec2 np = scene.K.unproject2(Vec2(x, y));
+                    Vec3 dir_cam(np(0), np(1), 1);
+                    float l  = dir_cam.norm();
+                    vec3 dir = (V_inv.so3() * dir_cam / l).cast<float>();
+                    float t  = tsdf.RaySurfaceIntersection<2>(origin, dir, 0.1 * l, max_depth * l, tsdf.voxel_size);
+                    dm(y, x) = t < max_depth * l ? t / l : 0;
+                }
+            }
+        }
+    });
+
+    SparseTSDFRaycast raycast(tsdf);
+    raycast.params.max_depth = max_depth;
+    TSDFRaycastImages model;
+    TSDFRaycastStatistics stats;
+
+    int agree = 0, compared = 0;
+    for (int f = 0; f < legacy_frames; ++f)
+    {
+        raycast.Raycast(scene.K, poses[f], h, w, model);
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                float a = legacy_depth[f](y, x);
+                float b = model.depth(y, x);
+                compared++;
+                agree += (a == 0 && b == 0) || std::abs(a - b) < tsdf.voxel_size;
+            }
+        }
+    }
+
+    auto st_raycast = measureObject(1, [&]() {
+        for (auto& V : poses) stats = raycast.Raycast(scene.K, V, h, w, model);
+    });
+
+    double legacy_ms  = st_legacy.median / legacy_frames;
+    double raycast_ms = st_raycast.median / num_frames;
+
+    Table table({12, 14, 14});
+    table.setFloatPrecision(4);
+    table << "Method"
+          << "ms/frame"
+          << "Speedup";
+    table << "Legacy" << legacy_ms << 1;
+    table << "Raycast" << raycast_ms << legacy_ms / raycast_ms;
+
+    std::cout << "Last frame: " << stats.hits << " hits, " << double(stats.samples) / (w * h) << " samples/ray, "
+              << double(stats.block_lookups) / (w * h) << " hash lookups/ray, " << stats.skipped_blocks
+              << " skipped blocks" << std::endl;
+    std::cout << "Same result as legacy: " << 100.0 * agree / compared << "% of the pixels" << std::endl;
+    return 0;
+}
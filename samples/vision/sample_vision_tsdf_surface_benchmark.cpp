@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/Core.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/vision/reconstruction/VoxelFusion.h"
+
+using namespace Saiga;
+
+/**
+ * Surface extraction of a SparseTSDF during incremental fusion.
+ *
+ * A corridor is fused frame by frame (see sample_vision_fusion_benchmark). Afterwards the following is measured:
+ *   - Soup: SparseTSDF::ExtractSurface + CreateMesh (the complete TSDF is re-meshed)
+ *   - Full: SparseTSDFSurface on an empty cache (every block is meshed, shared vertices)
+ *   - Incremental: SparseTSDFSurface after one more frame was fused (only the modified blocks are meshed)
+ */
+
+float TraceCorridor(const Vec3& origin, const Vec3& dir)
+{
+    float t = std::numeric_limits<float>::infinity();
+    if (dir.x() > 0) t = std::min<float>(t, (1.5 - origin.x()) / dir.x());
+    if (dir.x() < 0) t = std::min<float>(t, (-1.5 - origin.x()) / dir.x());
+    if (dir.y() > 0) t = std::min<float>(t, (1.2 - origin.y()) / dir.y());
+    if (dir.y() < 0) t = std::min<float>(t, (-1.5 - origin.y()) / dir.y());
+    return t;
+}
+
+int main(int argc, char** argv)
+{
+    catchSegFaults();
+
+    int num_frames = argc > 1 ? atoi(argv[1]) : 300;
+    float length   = argc > 2 ? atof(argv[2]) : 30;
+    int w          = 160;
+    int h          = 120;
+
+    FusionScene scene;
+    scene.K                              = IntrinsicsPinholed(120, 120, w / 2.0, h / 2.0, 0);
+    scene.dis                            = Distortion();
+    scene.params.voxelSize               = 0.03;
+    scene.params.truncationDistance      = 0.1;
+    scene.params.truncationDistanceScale = 0;
+    scene.params.maxIntegrationDistance  = 3;
+    scene.params.use_confidence          = false;
+    scene.params.verbose                 = false;
+    scene.params.post_process_mesh       = false;
+    scene.params.out_file                = "";
+    scene.params.block_count             = 200000;
+    scene.params.hash_size               = 200000;
+
+    TemplatedImage<float> depth_map(h, w);
+    auto fuse_frame = [&](int f) {
+        double alpha = f / double(num_frames);
+        Vec3 position(0.5 * sin(alpha * 40), 0, alpha * length);
+        Quat q(Eigen::AngleAxisd(0.4 * sin(alpha * 25), Vec3(0, 1, 0)));
+        SE3 camera_to_world(q, position);
+
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                Vec2 np = scene.K.unproject2(Vec2(x, y));
+                Vec3 dir_cam(np(0), np(1), 1);
+                Vec3 dir        = camera_to_world.so3() * dir_cam;
+                depth_map(y, x) = TraceCorridor(position, dir);
+            }
+        }
+
+        FusionImage fi;
+        fi.depthMap = depth_map.getImageView();
+        fi.V        = camera_to_world.inverse();
+        scene.FuseIncrement(fi, f == 0);
+    };
+
+    for (int f = 0; f < num_frames; ++f)
+    {
+        fuse_frame(f);
+    }
+
+    std::cout << "Frames: " << num_frames << " Blocks: " << scene.tsdf->current_blocks
+              << " Threads: " << OMP::getMaxThreads() << std::endl;
+
+    auto& p = scene.params;
+
+    UnifiedMesh soup_mesh;
+    auto st_soup = measureObject(5, [&]() {
+        auto triangles = scene.tsdf->ExtractSurface(p.extract_iso, p.extract_outlier_factor, 0, OMP::getMaxThreads(),
+                                                    false);
+        soup_mesh      = scene.tsdf->CreateMesh(triangles, false);
+    });
+
+    UnifiedMesh full_mesh;
+    auto st_full = measureObject(5, [&]() {
+        SparseTSDFSurface surface;
+        surface.Update(*scene.tsdf, p.extract_iso, p.extract_outlier_factor, 0);
+        full_mesh = surface.CreateMesh();
+    });
+
+    // Incremental: one more frame is fused between two updates. Only the update is measured.
+    SparseTSDFSurface surface;
+    surface.Update(*scene.tsdf, p.extract_iso, p.extract_outlier_factor, 0);
+
+    UnifiedMesh incremental_mesh;
+    std::vector<double> update_times, mesh_times;
+    int updated_blocks = 0;
+    for (int f = 0; f < 5; ++f)
+    {
+        fuse_frame(num_frames - 1 - f);
+        update_times.push_back(measureObject(1, [&]() {
+                                   updated_blocks = surface.Update(*scene.tsdf, p.extract_iso,
+                                                                   p.extract_outlier_factor, 0);
+                               }).median);
+        mesh_times.push_back(measureObject(1, [&]() { incremental_mesh = surface.CreateMesh(); }).median);
+    }
+    std::sort(update_times.begin(), update_times.end());
+    std::sort(mesh_times.begin(), mesh_times.end());
+
+    Table table({16, 14, 14, 14, 14});
+    table.setFloatPrecision(4);
+    table << "Method"
+          << "Time (ms)"
+          << "Speedup"
+          << "Triangles"
+          << "Vertices";
+    table << "Soup" << st_soup.median << 1 << soup_mesh.NumFaces() << soup_mesh.NumVertices();
+    table << "Full" << st_full.median << st_soup.median / st_full.median << full_mesh.NumFaces()
+          << full_mesh.NumVertices();
+    double incremental = update_times[2] + mesh_times[2];
+    table << "Incremental" << incremental << st_soup.median / incremental << incremental_mesh.NumFaces()
+          << incremental_mesh.NumVertices();
+
+    std::cout << "Incremental update: " << updated_blocks << " blocks meshed, update " << update_times[2]
+              << " ms, mesh assembly " << mesh_times[2] << " ms" << std::endl;
+
+    if (soup_mesh.NumFaces() != full_mesh.NumFaces())
+    {
+        SAIGA_EXIT_ERROR("The indexed surface has a different number of triangles");
+    }
+
+    std::cout << "Done." << std::endl;
+    return 0;
+}
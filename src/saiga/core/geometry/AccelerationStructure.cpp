@@ -5,7 +5,11 @@
  */
 #include "AccelerationStructure.h"
 
-#include "algorithm"
+#include "saiga/core/math/imath.h"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
 
 namespace Saiga
 {
@@ -46,27 +50,136 @@ std::vector<RayTriangleIntersection> BruteForce::getAll(const Ray& ray) const
 }
 
 
-BVH::BVH(const std::vector<Saiga::Triangle>& triangles)
+BVH::BVH(const std::vector<Saiga::Triangle>& triangles) : triangles(triangles)
 {
     static_assert(sizeof(BVHNode) == 8 * sizeof(float), "Node size broken.");
-    for (size_t i = 0; i < triangles.size(); ++i)
-    {
-        this->triangles.push_back({triangles[i], i});
-    }
+    triangle_ids.resize(triangles.size());
+    std::iota(triangle_ids.begin(), triangle_ids.end(), 0);
 }
 
+// Same as Intersection::RayAABB, but with a precomputed inverse direction.
+static inline bool RayAABBInv(const vec3& origin, const vec3& inv_dir, const AABB& box, float& t)
+{
+    vec3 t_min = (box.min - origin).array() * inv_dir.array();
+    vec3 t_max = (box.max - origin).array() * inv_dir.array();
+
+    float tmin = t_min.array().min(t_max.array()).maxCoeff();
+    float tmax = t_min.array().max(t_max.array()).minCoeff();
+
+    t = tmin;
+    return tmax >= 0 && tmin <= tmax;
+}
 
 RayTriangleIntersection BVH::getClosest(const Ray& ray) const
 {
     Intersection::RayTriangleIntersection result;
-    if (!nodes.empty()) getClosest(0, ray, result);
+    if (nodes.empty()) return result;
+
+    vec3 inv_dir = 1.0 / ray.direction.array();
+
+    struct StackEntry
+    {
+        uint32_t node;
+        float t;
+    };
+    StackEntry stack[128];
+    int sp = 0;
+
+    float root_t;
+    if (!RayAABBInv(ray.origin, inv_dir, nodes[0].box, root_t)) return result;
+    stack[sp++] = {0, root_t};
+
+    while (sp > 0)
+    {
+        auto e = stack[--sp];
+
+        // The node is further than the closest hit
+        if (e.t > result.t) continue;
+
+        const BVHNode& n = nodes[e.node];
+        if (n._inner)
+        {
+            float tl, tr;
+            bool hit_l = RayAABBInv(ray.origin, inv_dir, nodes[n._left].box, tl) && tl <= result.t;
+            bool hit_r = RayAABBInv(ray.origin, inv_dir, nodes[n._right].box, tr) && tr <= result.t;
+
+            // Push the far child first, so that the near child is traversed first.
+            if (hit_l && hit_r)
+            {
+                if (tl <= tr)
+                {
+                    stack[sp++] = {n._right, tr};
+                    stack[sp++] = {n._left, tl};
+                }
+                else
+                {
+                    stack[sp++] = {n._left, tl};
+                    stack[sp++] = {n._right, tr};
+                }
+            }
+            else if (hit_l)
+            {
+                stack[sp++] = {n._left, tl};
+            }
+            else if (hit_r)
+            {
+                stack[sp++] = {n._right, tr};
+            }
+        }
+        else
+        {
+            // Leaf node -> intersect with triangles
+            for (uint32_t i = n._left; i < n._right; ++i)
+            {
+                auto inter = Intersection::RayTriangle(ray, triangles[i], triangle_epsilon);
+                if (inter && inter < result)
+                {
+                    inter.triangleIndex = triangle_ids[i];
+                    result              = inter;
+                }
+            }
+        }
+    }
     return result;
 }
 
 std::vector<Intersection::RayTriangleIntersection> BVH::getAll(const Ray& ray) const
 {
     std::vector<RayTriangleIntersection> result;
-    if (!nodes.empty()) getAll(0, ray, result);
+    if (nodes.empty()) return result;
+
+    vec3 inv_dir = 1.0 / ray.direction.array();
+
+    uint32_t stack[128];
+    int sp      = 0;
+    stack[sp++] = 0;
+    while (sp > 0)
+    {
+        const BVHNode& n = nodes[stack[--sp]];
+
+        float aabbT;
+        // The ray missed the box
+        if (!RayAABBInv(ray.origin, inv_dir, n.box, aabbT)) continue;
+
+        if (n._inner)
+        {
+            stack[sp++] = n._right;
+            stack[sp++] = n._left;
+        }
+        else
+        {
+            // Leaf node -> intersect with triangles
+            for (uint32_t i = n._left; i < n._right; ++i)
+            {
+                auto inter = Intersection::RayTriangle(ray, triangles[i], triangle_epsilon);
+                if (inter)
+                {
+                    inter.triangleIndex = triangle_ids[i];
+                    result.push_back(inter);
+                }
+            }
+        }
+    }
     return result;
 }
 
@@ -87,7 +200,7 @@ AABB BVH::computeBox(int start, int end) const
     box.makeNegative();
     for (int i = start; i < end; ++i)
     {
-        auto& t = triangles[i].first;
+        auto& t = triangles[i];
         box.growBox(t.a);
         box.growBox(t.b);
         box.growBox(t.c);
@@ -98,75 +211,6 @@ AABB BVH::computeBox(int start, int end) const
     return box;
 }
 
-void BVH::sortByAxis(int start, int end, int axis)
-{
-    std::sort(triangles.begin() + start, triangles.begin() + end, SortTriangleByAxis(axis));
-}
-
-void BVH::getClosest(int node, const Ray& ray, Intersection::RayTriangleIntersection& result) const
-{
-    const BVHNode& n = nodes[node];
-
-    float aabbT;
-
-    // The ray missed the box
-    if (!Intersection::RayAABB(ray, n.box, aabbT)) return;
-
-    // The node is further than the closest hit
-    if (aabbT > result.t) return;
-
-    if (n._inner)
-    {
-        getClosest(n._left, ray, result);
-        getClosest(n._right, ray, result);
-    }
-    else
-    {
-        // Leaf node -> intersect with triangles
-        for (uint32_t i = n._left; i < n._right; ++i)
-        {
-            auto inter = Intersection::RayTriangle(ray, triangles[i].first, triangle_epsilon);
-            if (inter && inter < result)
-            {
-                inter.triangleIndex = triangles[i].second;
-                result              = inter;
-            }
-        }
-    }
-}
-
-void BVH::getAll(int node, const Ray& ray, std::vector<Intersection::RayTriangleIntersection>& result) const
-{
-    const BVHNode& n = nodes[node];
-
-    float aabbT;
-
-    if (!Intersection::RayAABB(ray, n.box, aabbT))
-    {
-        // The ray missed the box
-        return;
-    }
-
-    if (n._inner)
-    {
-        getAll(n._left, ray, result);
-        getAll(n._right, ray, result);
-    }
-    else
-    {
-        // Leaf node -> intersect with triangles
-        for (uint32_t i = n._left; i < n._right; ++i)
-        {
-            auto inter = Intersection::RayTriangle(ray, triangles[i].first, triangle_epsilon);
-            if (inter)
-            {
-                inter.triangleIndex = triangles[i].second;
-                result.push_back(inter);
-            }
-        }
-    }
-}
-
 void BVH::ClosestPoint(int node, const vec3& p, std::pair<float, int>& result) const
 {
     const BVHNode& n = nodes[node];
@@ -209,22 +253,241 @@ void BVH::ClosestPoint(int node, const vec3& p, std::pair<float, int>& result) c
         // Leaf node -> compute triangle distance
         for (uint32_t i = n._left; i < n._right; ++i)
         {
-            auto& tri = triangles[i].first;
+            auto& tri = triangles[i];
             auto d    = tri.Distance(p);
             d         = d * d;
             if (d < result.first)
             {
                 result.first  = d;
-                result.second = triangles[i].second;
+                result.second = triangle_ids[i];
+            }
+        }
+    }
+}
+
+// ================== Packet traversal ==================
+// All per-ray data is stored in SoA layout with one lane per ray. The loops over the lanes have no dependencies and
+// are vectorized by the compiler.
+
+namespace
+{
+constexpr int P = BVH::packet_size;
+
+struct alignas(32) RayPacket
+{
+    float ox[P], oy[P], oz[P];
+    float dx[P], dy[P], dz[P];
+    float ix[P], iy[P], iz[P];
+
+    // Closest hit so far. -inf for unused lanes, so they never intersect anything.
+    float t[P];
+    int tri[P];
+    int back_face[P];
+};
+
+// Slab test of all rays against the box. Returns true if at least one ray hits the box in front of its current
+// closest hit. 'tnear' is the minimum entry distance over all these rays.
+inline bool PacketAABB(const RayPacket& p, const AABB& box, float& tnear)
+{
+    float tn = std::numeric_limits<float>::infinity();
+    int any  = 0;
+#pragma omp simd reduction(min : tn) reduction(| : any)
+    for (int l = 0; l < P; ++l)
+    {
+        float t0x = (box.min.x() - p.ox[l]) * p.ix[l];
+        float t1x = (box.max.x() - p.ox[l]) * p.ix[l];
+        float t0y = (box.min.y() - p.oy[l]) * p.iy[l];
+        float t1y = (box.max.y() - p.oy[l]) * p.iy[l];
+        float t0z = (box.min.z() - p.oz[l]) * p.iz[l];
+        float t1z = (box.max.z() - p.oz[l]) * p.iz[l];
+
+        float tmin = std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)), std::min(t0z, t1z));
+        float tmax = std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)), std::max(t0z, t1z));
+
+        int hit = tmax >= 0 && tmin <= tmax && tmin <= p.t[l];
+        any |= hit;
+        tn = hit ? std::min(tn, tmin) : tn;
+    }
+    tnear = tn;
+    return any;
+}
+
+// Möller–Trumbore of all rays against one triangle. Same math as Intersection::RayTriangle.
+inline void PacketTriangle(RayPacket& p, const Triangle& tri, int tri_id, float epsilon)
+{
+    vec3 e1 = tri.b - tri.a;
+    vec3 e2 = tri.c - tri.a;
+    vec3 n  = cross(e1, e2);
+
+#pragma omp simd
+    for (int l = 0; l < P; ++l)
+    {
+        // P = cross(direction, e2)
+        float px  = p.dy[l] * e2.z() - p.dz[l] * e2.y();
+        float py  = p.dz[l] * e2.x() - p.dx[l] * e2.z();
+        float pz  = p.dx[l] * e2.y() - p.dy[l] * e2.x();
+        float det = e1.x() * px + e1.y() * py + e1.z() * pz;
+
+        float inv_det = 1.f / det;
+
+        // T = origin - A
+        float tx = p.ox[l] - tri.a.x();
+        float ty = p.oy[l] - tri.a.y();
+        float tz = p.oz[l] - tri.a.z();
+        float u  = (tx * px + ty * py + tz * pz) * inv_det;
+
+        // Q = cross(T, e1)
+        float qx = ty * e1.z() - tz * e1.y();
+        float qy = tz * e1.x() - tx * e1.z();
+        float qz = tx * e1.y() - ty * e1.x();
+        float v  = (p.dx[l] * qx + p.dy[l] * qy + p.dz[l] * qz) * inv_det;
+        float t  = (e2.x() * qx + e2.y() * qy + e2.z() * qz) * inv_det;
+
+        // Bitwise and, so that the compiler doesn't generate branches
+        int hit = (std::abs(det) >= epsilon) & (u >= 0.f) & (u <= 1.f) & (v >= 0.f) & (u + v <= 1.f) & (t > epsilon) &
+                  (t < p.t[l]);
+
+        int back_face = (p.dx[l] * n.x() + p.dy[l] * n.y() + p.dz[l] * n.z()) > 0;
+
+        p.t[l]         = hit ? t : p.t[l];
+        p.tri[l]       = hit ? tri_id : p.tri[l];
+        p.back_face[l] = hit ? back_face : p.back_face[l];
+    }
+}
+
+}  // namespace
+
+void BVH::getClosestPacket(const Ray* rays, int n, RayTriangleIntersection* result) const
+{
+    RayPacket p;
+    for (int l = 0; l < P; ++l)
+    {
+        const Ray& r = rays[std::min(l, n - 1)];
+        p.ox[l]      = r.origin.x();
+        p.oy[l]      = r.origin.y();
+        p.oz[l]      = r.origin.z();
+        p.dx[l]      = r.direction.x();
+        p.dy[l]      = r.direction.y();
+        p.dz[l]      = r.direction.z();
+        p.ix[l]      = 1.0 / r.direction.x();
+        p.iy[l]      = 1.0 / r.direction.y();
+        p.iz[l]      = 1.0 / r.direction.z();
+        p.t[l]       = l < n ? std::numeric_limits<float>::infinity() : -std::numeric_limits<float>::infinity();
+        p.tri[l]     = -1;
+        p.back_face[l] = 0;
+    }
+
+    struct StackEntry
+    {
+        uint32_t node;
+        float t;
+    };
+    StackEntry stack[128];
+    int sp = 0;
+
+    float root_t;
+    if (PacketAABB(p, nodes[0].box, root_t)) stack[sp++] = {0, root_t};
+
+    while (sp > 0)
+    {
+        auto e = stack[--sp];
+
+        // Skip the node if it is behind the closest hit of all rays.
+        float max_t = p.t[0];
+        for (int l = 1; l < P; ++l) max_t = std::max(max_t, p.t[l]);
+        if (e.t > max_t) continue;
+
+        const BVHNode& node = nodes[e.node];
+        if (node._inner)
+        {
+            float tl, tr;
+            bool hit_l = PacketAABB(p, nodes[node._left].box, tl);
+            bool hit_r = PacketAABB(p, nodes[node._right].box, tr);
+
+            if (hit_l && hit_r)
+            {
+                if (tl <= tr)
+                {
+                    stack[sp++] = {node._right, tr};
+                    stack[sp++] = {node._left, tl};
+                }
+                else
+                {
+                    stack[sp++] = {node._left, tl};
+                    stack[sp++] = {node._right, tr};
+                }
+            }
+            else if (hit_l)
+            {
+                stack[sp++] = {node._left, tl};
+            }
+            else if (hit_r)
+            {
+                stack[sp++] = {node._right, tr};
             }
         }
+        else
+        {
+            for (uint32_t i = node._left; i < node._right; ++i)
+            {
+                PacketTriangle(p, triangles[i], i, triangle_epsilon);
+            }
+        }
+    }
+
+    for (int l = 0; l < n; ++l)
+    {
+        RayTriangleIntersection inter;
+        if (p.tri[l] >= 0)
+        {
+            inter.valid         = true;
+            inter.t             = p.t[l];
+            inter.backFace      = p.back_face[l];
+            inter.triangleIndex = triangle_ids[p.tri[l]];
+        }
+        result[l] = inter;
+    }
+}
+
+void BVH::getClosest(ArrayView<const Ray> rays, ArrayView<RayTriangleIntersection> result) const
+{
+    SAIGA_ASSERT(rays.size() == result.size());
+    if (nodes.empty())
+    {
+        for (auto& r : result) r = RayTriangleIntersection();
+        return;
     }
+
+    int num_rays    = rays.size();
+    int num_packets = iDivUp(num_rays, P);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < num_packets; ++i)
+    {
+        int begin = i * P;
+        getClosestPacket(rays.data() + begin, std::min(P, num_rays - begin), result.data() + begin);
+    }
+}
+
+std::vector<RayTriangleIntersection> BVH::getClosest(ArrayView<const Ray> rays) const
+{
+    std::vector<RayTriangleIntersection> result(rays.size());
+    getClosest(rays, result);
+    return result;
 }
 
+// ================== Object Median ==================
+
 void ObjectMedianBVH::construct()
 {
     nodes.reserve(triangles.size());
     construct(0, triangles.size());
+
+    std::vector<Triangle> sorted(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        sorted[i] = triangles[triangle_ids[i]];
+    }
+    triangles = std::move(sorted);
 }
 
 int ObjectMedianBVH::construct(int start, int end)
@@ -233,7 +496,17 @@ int ObjectMedianBVH::construct(int start, int end)
     nodes.push_back({});
     auto& node = nodes.back();
 
-    node.box = computeBox(start, end);
+    // The triangles are only reordered after construction. Until then they are accessed through triangle_ids.
+    node.box.makeNegative();
+    for (int i = start; i < end; ++i)
+    {
+        auto& t = triangles[triangle_ids[i]];
+        node.box.growBox(t.a);
+        node.box.growBox(t.b);
+        node.box.growBox(t.c);
+    }
+    node.box.min -= vec3(bvh_epsilon, bvh_epsilon, bvh_epsilon);
+    node.box.max += vec3(bvh_epsilon, bvh_epsilon, bvh_epsilon);
 
     if (end - start <= leafTriangles)
     {
@@ -246,9 +519,11 @@ int ObjectMedianBVH::construct(int start, int end)
     {
         node._inner = 1;
         int axis    = node.box.maxDimension();
-        sortByAxis(start, end, axis);
+        int mid     = (start + end) / 2;
 
-        int mid = (start + end) / 2;
+        // Only the median has to be found, a full sort is not required.
+        std::nth_element(triangle_ids.begin() + start, triangle_ids.begin() + mid, triangle_ids.begin() + end,
+                         [&](int a, int b) { return triangles[a].center()[axis] < triangles[b].center()[axis]; });
 
         int l = construct(start, mid);
         int r = construct(mid, end);
@@ -262,6 +537,242 @@ int ObjectMedianBVH::construct(int start, int end)
     return nodeid;
 }
 
+// ================== SAH ==================
+
+namespace
+{
+// Half of the surface area. The factor doesn't matter for the SAH.
+inline float HalfArea(const AABB& box)
+{
+    vec3 e = box.max - box.min;
+    return e.x() * e.y() + e.y() * e.z() + e.z() * e.x();
+}
+
+struct SAHBuilder
+{
+    // Relative cost of one node traversal compared to one triangle intersection.
+    static constexpr float traversal_cost = 1.0f;
+    // Subtrees larger than this are built in a separate OpenMP task.
+    static constexpr int parallel_threshold = 4096;
+    // Deeper nodes are split at the median, so the traversal stacks can't overflow.
+    static constexpr int max_sah_depth = 48;
+    static constexpr int bins          = SAHBVH::bins;
+
+    const std::vector<Triangle>& triangles;
+    int max_leaf;
+    float epsilon;
+
+    std::vector<AABB> boxes;
+    std::vector<vec3> centers;
+    std::vector<int> ids;
+    AlignedVector<BVHNode, SAIGA_CACHE_LINE_SIZE> nodes;
+    std::atomic<int> next_node;
+
+    SAHBuilder(const std::vector<Triangle>& triangles, int max_leaf, float epsilon)
+        : triangles(triangles), max_leaf(max_leaf), epsilon(epsilon)
+    {
+        int n = triangles.size();
+        boxes.resize(n);
+        centers.resize(n);
+        ids.resize(n);
+        for (int i = 0; i < n; ++i)
+        {
+            auto& t = triangles[i];
+            boxes[i].makeNegative();
+            boxes[i].growBox(t.a);
+            boxes[i].growBox(t.b);
+            boxes[i].growBox(t.c);
+            centers[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+            ids[i]     = i;
+        }
+
+        // The root is at 0. Child pairs start at 2 so that every pair of siblings is cache line aligned.
+        nodes.resize(std::max(2 * n, 2));
+        next_node = 2;
+
+#pragma omp parallel if (n > parallel_threshold)
+        {
+#pragma omp single
+            {
+                build(0, 0, n, 0);
+            }
+        }
+        nodes.resize(next_node.load());
+    }
+
+    void build(int node_id, int start, int end, int depth)
+    {
+        int n = end - start;
+
+        AABB box, center_box;
+        box.makeNegative();
+        center_box.makeNegative();
+        for (int i = start; i < end; ++i)
+        {
+            box.growBox(boxes[ids[i]]);
+            center_box.growBox(centers[ids[i]]);
+        }
+
+        BVHNode& node = nodes[node_id];
+        node.box      = box;
+        node.box.min -= vec3(epsilon, epsilon, epsilon);
+        node.box.max += vec3(epsilon, epsilon, epsilon);
+
+        if (n <= 1)
+        {
+            makeLeaf(node, start, end);
+            return;
+        }
+
+        int mid = -1;
+        if (depth < max_sah_depth)
+        {
+            int best_axis;
+            int best_bin;
+            float best_cost = findSplit(start, end, center_box, best_axis, best_bin);
+
+            float leaf_cost  = n;
+            float split_cost = traversal_cost + best_cost / HalfArea(box);
+
+            if (n <= max_leaf && leaf_cost <= split_cost)
+            {
+                makeLeaf(node, start, end);
+                return;
+            }
+
+            if (best_axis >= 0)
+            {
+                float cmin  = center_box.min[best_axis];
+                float scale = bins / (center_box.max[best_axis] - cmin);
+                mid         = std::partition(ids.begin() + start, ids.begin() + end,
+                                     [&](int id) { return binIndex(centers[id][best_axis], cmin, scale) <= best_bin; }) -
+                      ids.begin();
+                if (mid == start || mid == end) mid = -1;
+            }
+        }
+
+        if (mid == -1)
+        {
+            // All centers are identical or the tree is too deep -> object median split
+            if (n <= max_leaf)
+            {
+                makeLeaf(node, start, end);
+                return;
+            }
+            int axis = center_box.maxDimension();
+            mid      = (start + end) / 2;
+            std::nth_element(ids.begin() + start, ids.begin() + mid, ids.begin() + end,
+                             [&](int a, int b) { return centers[a][axis] < centers[b][axis]; });
+        }
+
+        int left    = next_node.fetch_add(2);
+        node._inner = 1;
+        node._left  = left;
+        node._right = left + 1;
+
+        if (n > parallel_threshold)
+        {
+#pragma omp task
+            build(left, start, mid, depth + 1);
+            build(left + 1, mid, end, depth + 1);
+#pragma omp taskwait
+        }
+        else
+        {
+            build(left, start, mid, depth + 1);
+            build(left + 1, mid, end, depth + 1);
+        }
+    }
+
+    static int binIndex(float c, float cmin, float scale) { return std::min(int((c - cmin) * scale), bins - 1); }
+
+    // Returns the best SAH cost (without normalization) and the split after bin 'best_bin' on 'best_axis'.
+    // best_axis is -1 if no split was found.
+    float findSplit(int start, int end, const AABB& center_box, int& best_axis, int& best_bin)
+    {
+        float best_cost = std::numeric_limits<float>::infinity();
+        best_axis       = -1;
+        best_bin        = -1;
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float cmin   = center_box.min[axis];
+            float extent = center_box.max[axis] - cmin;
+            if (!(extent > 0)) continue;
+            float scale = bins / extent;
+
+            AABB bin_box[bins];
+            int bin_count[bins] = {};
+            for (auto& b : bin_box) b.makeNegative();
+
+            for (int i = start; i < end; ++i)
+            {
+                int id = ids[i];
+                int b  = binIndex(centers[id][axis], cmin, scale);
+                bin_box[b].growBox(boxes[id]);
+                bin_count[b]++;
+            }
+
+            // Sweep from the right to get the cost of all right sides
+            float right_area[bins];
+            int right_count[bins];
+            AABB acc;
+            acc.makeNegative();
+            int count = 0;
+            for (int b = bins - 1; b > 0; --b)
+            {
+                acc.growBox(bin_box[b]);
+                count += bin_count[b];
+                right_area[b]  = count > 0 ? HalfArea(acc) : 0;
+                right_count[b] = count;
+            }
+
+            acc.makeNegative();
+            count = 0;
+            for (int b = 0; b < bins - 1; ++b)
+            {
+                acc.growBox(bin_box[b]);
+                count += bin_count[b];
+                if (count == 0 || right_count[b + 1] == 0) continue;
+                float cost = HalfArea(acc) * count + right_area[b + 1] * right_count[b + 1];
+                if (cost < best_cost)
+                {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin  = b;
+                }
+            }
+        }
+        return best_cost;
+    }
+
+    void makeLeaf(BVHNode& node, int start, int end)
+    {
+        node._inner = 0;
+        node._left  = start;
+        node._right = end;
+    }
+};
+
+}  // namespace
+
+void SAHBVH::construct()
+{
+    nodes.clear();
+    if (triangles.empty()) return;
+
+    SAHBuilder builder(triangles, maxLeafTriangles, bvh_epsilon);
+    nodes = std::move(builder.nodes);
+
+    std::vector<Triangle> sorted(triangles.size());
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        sorted[i]       = triangles[builder.ids[i]];
+        triangle_ids[i] = builder.ids[i];
+    }
+    triangles = std::move(sorted);
+}
+
 
 }  // namespace AccelerationStructure
 }  // namespace Saiga
@@ -8,6 +8,8 @@
 
 #include "saiga/config.h"
 #include "saiga/core/math/math.h"
+#include "saiga/core/util/Align.h"
+#include "saiga/core/util/DataStructures/ArrayView.h"
 
 #include "aabb.h"
 #include "intersection.h"
@@ -66,17 +68,8 @@ struct BVHNode
 class SAIGA_CORE_API BVH : public Base
 {
    public:
-    struct SortTriangleByAxis
-    {
-        SortTriangleByAxis(int a) : axis(a) {}
-        bool operator()(const std::pair<Triangle, int>& A, const std::pair<Triangle, int>& B)
-        {
-            auto a = A.first.center();
-            auto b = B.first.center();
-            return a[axis] < b[axis];
-        }
-        int axis;
-    };
+    // Number of rays that are traced together in the batched getClosest.
+    static constexpr int packet_size = 8;
 
     BVH() {}
     BVH(const std::vector<Triangle>& triangles);
@@ -89,17 +82,30 @@ class SAIGA_CORE_API BVH : public Base
     virtual std::vector<RayTriangleIntersection> getAll(const Ray& ray) const override;
     virtual std::pair<float, int> ClosestPoint(const vec3& p) const;
 
+    /**
+     * Batched closest hit query.
+     * The rays are traced in packets of 'packet_size' using SIMD box and triangle tests. The packets are distributed
+     * over all OpenMP threads. This is only faster than single rays if neighboring rays are coherent, for example rays
+     * of neighboring pixels.
+     */
+    void getClosest(ArrayView<const Ray> rays, ArrayView<RayTriangleIntersection> result) const;
+    std::vector<RayTriangleIntersection> getClosest(ArrayView<const Ray> rays) const;
+
    protected:
-    std::vector<std::pair<Triangle, int>> triangles;
-    std::vector<BVHNode> nodes;
+    // The leaf triangles in tree order and their index in the input array.
+    std::vector<Triangle> triangles;
+    std::vector<int> triangle_ids;
+
+    // Sibling nodes are stored next to each other. With the aligned allocator a pair of siblings is in one cache line.
+    AlignedVector<BVHNode, SAIGA_CACHE_LINE_SIZE> nodes;
 
     AABB computeBox(int start, int end) const;
-    void sortByAxis(int start, int end, int axis);
 
     // Recursive traversal
-    void getClosest(int node, const Ray& ray, RayTriangleIntersection& result) const;
-    void getAll(int node, const Ray& ray, std::vector<RayTriangleIntersection>& result) const;
     void ClosestPoint(int node, const vec3& p, std::pair<float, int>& result) const;
+
+    // The packet traversal of the batched getClosest
+    void getClosestPacket(const Ray* rays, int n, RayTriangleIntersection* result) const;
 };
 
 class SAIGA_CORE_API ObjectMedianBVH : public BVH
@@ -119,5 +125,32 @@ class SAIGA_CORE_API ObjectMedianBVH : public BVH
     int construct(int start, int end);
 };
 
+/**
+ * BVH built with the binned surface area heuristic (SAH).
+ *
+ * For each node the triangle centroids are sorted into 'bins' buckets along every axis and the split with the lowest
+ * expected traversal cost is chosen. A node becomes a leaf if it has at most 'maxLeafTriangles' triangles and
+ * splitting is not cheaper. Large subtrees are built in parallel with OpenMP tasks.
+ *
+ * Construction is slower than ObjectMedianBVH, but rays traverse considerably fewer nodes on real meshes.
+ */
+class SAIGA_CORE_API SAHBVH : public BVH
+{
+   public:
+    static constexpr int bins = 16;
+
+    SAHBVH() {}
+    SAHBVH(const std::vector<Triangle>& triangles, int maxLeafTriangles = 8)
+        : BVH(triangles), maxLeafTriangles(maxLeafTriangles)
+    {
+        construct();
+    }
+    virtual ~SAHBVH() {}
+
+   protected:
+    int maxLeafTriangles = 8;
+    void construct() override;
+};
+
 }  // namespace AccelerationStructure
 }  // namespace Saiga
@@ -8,276 +8,535 @@
 
 #include "saiga/config.h"
 #include "saiga/core/math/math.h"
+#include "saiga/core/util/DataStructures/ArrayView.h"
+#include "saiga/core/util/assert.h"
 
 #include <algorithm>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
 #include <vector>
 
 namespace Saiga
 {
-// D : Dimension. for example D=3 for 3 dimensional points
-// point_t : should be a vector type. for example vec2 or vec3
+/**
+ * A static kd-tree for nearest neighbor, k-nearest neighbor and radius queries.
+ *
+ * Construction
+ *   - Split at the median (std::nth_element) of the axis with the largest extent -> O(n log n).
+ *   - Subtrees with more than 'leaf_size' points are split. Leafs store their points in SoA layout (all x, then all
+ *     y, ...) so the distance computation of a bucket is vectorized.
+ *   - The nodes are stored depth first in a flat array. The left child directly follows its parent.
+ *   - Large subtrees are built in parallel with OpenMP tasks.
+ *
+ * Queries
+ *   - All queries are iterative with a small fixed-size stack. They do not allocate memory, except the convenience
+ *     functions returning a std::vector and k-nn queries without distance output and k > max_leaf_size.
+ *   - k-nn queries keep a bounded max-heap in the caller supplied output buffer.
+ *   - The batched queries process the query points in parallel with OpenMP.
+ *
+ * All returned indices refer to the original point array. Distances are squared.
+ *
+ * D : Dimension. for example D=3 for 3 dimensional points
+ * point_t : should be a vector type. for example vec2 or vec3
+ */
 template <int D, typename point_t>
 class SAIGA_TEMPLATE KDTree
 {
    public:
+    static constexpr int max_leaf_size = 64;
+
     // create an empty tree
     KDTree() {}
-    KDTree(const std::vector<point_t>& points);
+    KDTree(ArrayView<const point_t> points, int leaf_size = 8);
+    KDTree(const std::vector<point_t>& points, int leaf_size = 8)
+        : KDTree(ArrayView<const point_t>(points.data(), points.size()), leaf_size)
+    {
+    }
+
+    int size() const { return indices.size(); }
+
+    // ========== Single queries ==========
 
     // returns the nearest point in this tree to the searchpoint
-    int NearestNeighborSearch(const point_t& searchPoint);
+    // -1 if the tree is empty
+    int NearestNeighborSearch(const point_t& searchPoint, float* out_dist2 = nullptr) const;
 
     // returns the k nearest points in this tree to the searchpoint
-    std::vector<int> KNearestNeighborSearch(const point_t& searchPoint, int k);
+    // The result is sorted by distance.
+    std::vector<int> KNearestNeighborSearch(const point_t& searchPoint, int k) const;
+
+    // Version of the function above with caller supplied output buffers.
+    // The output buffers must have space for k elements. out_dist2 can be nullptr.
+    // Returns the number of found points, which is min(k, size()).
+    // Allocation free if out_dist2 != nullptr or k <= max_leaf_size. Otherwise a temporary distance buffer is
+    // allocated.
+    int KNearestNeighborSearch(const point_t& searchPoint, int k, int* out_indices, float* out_dist2) const;
 
+    // Returns all points with distance < radius. The result is sorted by index.
+    std::vector<int> RadiusSearch(const point_t& searchPoint, float radius) const;
 
-    std::vector<int> RadiusSearch(const point_t& searchPoint, float radius);
+    // Appends all points with distance < radius to 'result' (unsorted).
+    // No allocation if 'result' has enough capacity.
+    void RadiusSearch(const point_t& searchPoint, float radius, std::vector<int>& result) const;
 
+    // ========== Batched queries (multi-threaded) ==========
 
+    // out_indices.size() == queries.size()
+    // out_dist2 is optional.
+    void NearestNeighborSearch(ArrayView<const point_t> queries, ArrayView<int> out_indices,
+                               ArrayView<float> out_dist2 = {}) const;
+
+    // The k results of query i are stored at [i*k, i*k+k). Missing neighbors are padded with index -1.
+    // out_indices.size() == queries.size() * k
+    // out_dist2 is optional. Without it, one distance buffer per thread is allocated if k > max_leaf_size.
+    void KNearestNeighborSearch(ArrayView<const point_t> queries, int k, ArrayView<int> out_indices,
+                                ArrayView<float> out_dist2 = {}) const;
+
+    std::vector<std::vector<int>> RadiusSearch(ArrayView<const point_t> queries, float radius) const;
 
    private:
-    typedef int index_t;
-    typedef unsigned int axis_t;
-    typedef std::vector<std::pair<float, index_t>> queue_t;
+    // Inner node: axis >= 0, the left child is at node+1, the right child at 'right'.
+    // Leaf: axis == -1, the points are in [begin, end) of the SoA arrays.
+    struct Node
+    {
+        float split;
+        int axis;
+        int right_or_begin;
+        int end;
+    };
 
-    struct kd_node_t
+    struct StackEntry
     {
-        point_t p;
-        int initial_index;
-        index_t left = -1, right = -1;
+        int node;
+        float dist2;
     };
 
-    std::vector<kd_node_t> nodes;
-    index_t rootNode = -1;
+    // Enough for more than 2^32 points
+    static constexpr int max_stack = 64;
 
-    index_t sortByAxis(index_t startIndex, index_t endIndex, axis_t axis);
-    index_t make_tree(index_t startIndex, index_t endIndex, axis_t currentAxis);
+    // Subtrees larger than this are built in a separate OpenMP task.
+    static constexpr int parallel_build_threshold = 1 << 14;
 
-    // rekursive helper functions for nearest neighbour lookup
-    void NearestNeighborSearch(index_t currentNode, const point_t& searchPoint, axis_t currentAxis, index_t& bestNode,
-                               float& bestDist);
+    std::vector<Node> nodes;
+    // coords[d * n + i] is the coordinate d of the i-th point in tree order
+    std::vector<float> coords;
+    // the original index of the i-th point in tree order
+    std::vector<int> indices;
+    int leaf_size = 8;
 
-    void KNearestNeighborSearch(index_t currentNode, const point_t& searchPoint, int k, axis_t currentAxis,
-                                queue_t& queue);
+    int NumNodes(int n, std::unordered_map<int, int>& cache) const;
+    void Build(int node, int begin, int end, ArrayView<const point_t> points,
+               const std::unordered_map<int, int>& node_count);
 
-    void RadiusSearch(index_t currentNode, const point_t& searchPoint, float r, axis_t currentAxis,
-                      std::vector<int>& result);
+    // Computes the squared distances from q to all points in the leaf.
+    inline void LeafDistances(const Node& leaf, const float* q, float* dist2) const;
 
-    float addToQueue(queue_t& queue, index_t currentNode, float distance);
-    float distance(point_t a, point_t b);
-    void printPoints(index_t startIndex, index_t endIndex);
+    // The k-nn max-heap on (dist2, index) pairs
+    static inline bool HeapLess(float da, int ia, float db, int ib) { return da < db || (da == db && ia < ib); }
+    static inline void HeapPush(int* idx, float* dist, int& count, int i, float d);
+    static inline void HeapReplaceTop(int* idx, float* dist, int count, int i, float d);
 };
 
 template <int D, typename point_t>
-KDTree<D, point_t>::KDTree(const std::vector<point_t>& points)
+KDTree<D, point_t>::KDTree(ArrayView<const point_t> points, int leaf_size) : leaf_size(leaf_size)
 {
-    nodes.resize(points.size());
-    for (int i = 0; i < points.size(); ++i)
+    SAIGA_ASSERT(leaf_size >= 1 && leaf_size <= max_leaf_size);
+    int n = points.size();
+    if (n == 0) return;
+
+    indices.resize(n);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    // The tree shape only depends on the number of points. Precompute the subtree sizes so that the depth first
+    // layout can be built in parallel.
+    std::unordered_map<int, int> node_count;
+    nodes.resize(NumNodes(n, node_count));
+
+#pragma omp parallel if (n > parallel_build_threshold)
     {
-        nodes[i].p             = points[i];
-        nodes[i].initial_index = i;
+#pragma omp single
+        {
+            Build(0, 0, n, points, node_count);
+        }
+    }
+
+    coords.resize(size_t(D) * n);
+    for (int i = 0; i < n; ++i)
+    {
+        const point_t& p = points[indices[i]];
+        for (int d = 0; d < D; ++d)
+        {
+            coords[size_t(d) * n + i] = p[d];
+        }
     }
-    rootNode = make_tree(0, nodes.size(), 0);
 }
 
 template <int D, typename point_t>
-typename KDTree<D, point_t>::index_t KDTree<D, point_t>::sortByAxis(index_t startIndex, index_t endIndex, axis_t axis)
+int KDTree<D, point_t>::NumNodes(int n, std::unordered_map<int, int>& cache) const
 {
-    auto cmp = [axis](const kd_node_t& a, const kd_node_t& b) -> bool { return a.p[axis] < b.p[axis]; };
-    std::sort(nodes.begin() + startIndex, nodes.begin() + endIndex, cmp);
-    // return the median point
-    return (startIndex + endIndex) / 2;
+    if (n <= leaf_size) return 1;
+    auto it = cache.find(n);
+    if (it != cache.end()) return it->second;
+    int result = 1 + NumNodes(n / 2, cache) + NumNodes(n - n / 2, cache);
+    cache[n]   = result;
+    return result;
 }
 
 template <int D, typename point_t>
-typename KDTree<D, point_t>::index_t KDTree<D, point_t>::make_tree(index_t startIndex, index_t endIndex,
-                                                                   axis_t currentAxis)
+void KDTree<D, point_t>::Build(int node, int begin, int end, ArrayView<const point_t> points,
+                               const std::unordered_map<int, int>& node_count)
 {
-    if (startIndex == endIndex) return -1;
-    if (startIndex + 1 == endIndex) return startIndex;
-
-    index_t median = sortByAxis(startIndex, endIndex, currentAxis);
-    currentAxis    = (currentAxis + 1) % D;
+    int n = end - begin;
+    if (n <= leaf_size)
+    {
+        nodes[node] = {0, -1, begin, end};
+        return;
+    }
 
+    // Split along the axis with the largest extent
+    float bmin[D], bmax[D];
+    for (int d = 0; d < D; ++d)
+    {
+        bmin[d] = std::numeric_limits<float>::infinity();
+        bmax[d] = -std::numeric_limits<float>::infinity();
+    }
+    for (int i = begin; i < end; ++i)
+    {
+        const point_t& p = points[indices[i]];
+        for (int d = 0; d < D; ++d)
+        {
+            bmin[d] = std::min<float>(bmin[d], p[d]);
+            bmax[d] = std::max<float>(bmax[d], p[d]);
+        }
+    }
+    int axis = 0;
+    for (int d = 1; d < D; ++d)
+    {
+        if (bmax[d] - bmin[d] > bmax[axis] - bmin[axis]) axis = d;
+    }
 
-    nodes[median].left  = make_tree(startIndex, median, currentAxis);
-    nodes[median].right = make_tree(median + 1, endIndex, currentAxis);
+    int mid = begin + n / 2;
+    std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end,
+                     [&](int a, int b) { return points[a][axis] < points[b][axis]; });
 
-    return median;
-}
+    int left_count = (mid - begin) <= leaf_size ? 1 : node_count.at(mid - begin);
+    int right      = node + 1 + left_count;
+    nodes[node]    = {float(points[indices[mid]][axis]), axis, right, 0};
 
-template <int D, typename point_t>
-int KDTree<D, point_t>::NearestNeighborSearch(const point_t& searchPoint)
-{
-    KDTree::index_t bestNode;
-    float bestDist = std::numeric_limits<float>::infinity();
-    NearestNeighborSearch(rootNode, searchPoint, 0, bestNode, bestDist);
-    return nodes[bestNode].initial_index;
+    if (n > parallel_build_threshold)
+    {
+#pragma omp task
+        Build(node + 1, begin, mid, points, node_count);
+        Build(right, mid, end, points, node_count);
+#pragma omp taskwait
+    }
+    else
+    {
+        Build(node + 1, begin, mid, points, node_count);
+        Build(right, mid, end, points, node_count);
+    }
 }
 
-
 template <int D, typename point_t>
-void KDTree<D, point_t>::NearestNeighborSearch(index_t currentNode, const point_t& searchPoint, axis_t currentAxis,
-                                               index_t& bestNode, float& bestDist)
+inline void KDTree<D, point_t>::LeafDistances(const Node& leaf, const float* q, float* dist2) const
 {
-    if (currentNode == -1) return;
+    int begin = leaf.right_or_begin;
+    int count = leaf.end - begin;
+    size_t n  = indices.size();
 
-    // calculate distance to current point and update the current best
-    float d = distance(nodes[currentNode].p, searchPoint);
-    if (d < bestDist)
+    for (int i = 0; i < count; ++i) dist2[i] = 0;
+    for (int d = 0; d < D; ++d)
     {
-        bestDist = d;
-        bestNode = currentNode;
+        const float* c = coords.data() + d * n + begin;
+        float qd       = q[d];
+        for (int i = 0; i < count; ++i)
+        {
+            float diff = c[i] - qd;
+            dist2[i] += diff * diff;
+        }
     }
-
-    // exact match (can't get any better)
-    if (d == 0) return;
-
-    // the (signed) distance of the searchpoint to the current split axis
-    float dAxis = nodes[currentNode].p[currentAxis] - searchPoint[currentAxis];
-    // the actual distance to the point is squared so we also need to square the distance to the axis
-    float dAxisSquared = dAxis * dAxis;
-
-    currentAxis = (currentAxis + 1) % D;
-
-    // first traverse the subtree in which the point lays
-    NearestNeighborSearch(dAxis > 0 ? nodes[currentNode].left : nodes[currentNode].right, searchPoint, currentAxis,
-                          bestNode, bestDist);
-
-    // when the distance to the axis is greater than the current distance
-    // we don't need to traverse the other sub tree
-    if (dAxisSquared >= bestDist) return;
-
-    // there may be a better point in this subtree
-    NearestNeighborSearch(dAxis > 0 ? nodes[currentNode].right : nodes[currentNode].left, searchPoint, currentAxis,
-                          bestNode, bestDist);
 }
 
-
 template <int D, typename point_t>
-std::vector<int> KDTree<D, point_t>::KNearestNeighborSearch(const point_t& searchPoint, int k)
+inline void KDTree<D, point_t>::HeapPush(int* idx, float* dist, int& count, int i, float d)
 {
-    queue_t queue(k);
-    for (auto& p : queue)
+    int c = count++;
+    while (c > 0)
     {
-        p.second = -1;
-        p.first  = 1e10;
+        int parent = (c - 1) / 2;
+        if (!HeapLess(dist[parent], idx[parent], d, i)) break;
+        idx[c]  = idx[parent];
+        dist[c] = dist[parent];
+        c       = parent;
     }
-    KNearestNeighborSearch(rootNode, searchPoint, k, 0, queue);
+    idx[c]  = i;
+    dist[c] = d;
+}
 
-    std::vector<int> points;
-    for (auto& p : queue)
+template <int D, typename point_t>
+inline void KDTree<D, point_t>::HeapReplaceTop(int* idx, float* dist, int count, int i, float d)
+{
+    int c = 0;
+    for (;;)
     {
-        if (p.second != -1)
+        int l       = 2 * c + 1;
+        int largest = c;
+        float ld    = d;
+        int li      = i;
+        if (l < count && HeapLess(ld, li, dist[l], idx[l]))
         {
-            points.push_back(nodes[p.second].initial_index);
+            largest = l;
+            ld      = dist[l];
+            li      = idx[l];
         }
+        if (l + 1 < count && HeapLess(ld, li, dist[l + 1], idx[l + 1]))
+        {
+            largest = l + 1;
+        }
+        if (largest == c) break;
+        idx[c]  = idx[largest];
+        dist[c] = dist[largest];
+        c       = largest;
     }
-    return points;
+    idx[c]  = i;
+    dist[c] = d;
 }
 
-
 template <int D, typename point_t>
-void KDTree<D, point_t>::KNearestNeighborSearch(index_t currentNode, const point_t& searchPoint, int k,
-                                                axis_t currentAxis, queue_t& queue)
+int KDTree<D, point_t>::NearestNeighborSearch(const point_t& searchPoint, float* out_dist2) const
 {
-    if (currentNode == -1) return;
-
-    // calculate distance to current point and update the current best
-    float d     = distance(nodes[currentNode].p, searchPoint);
-    float lastD = addToQueue(queue, currentNode, d);
-
-
-    // the (signed) distance of the searchpoint to the current split axis
-    float dAxis = nodes[currentNode].p[currentAxis] - searchPoint[currentAxis];
-    // the actual distance to the point is squared so we also need to square the distance to the axis
-    float dAxisSquared = dAxis * dAxis;
-
-    currentAxis = (currentAxis + 1) % D;
+    int best_index   = -1;
+    float best_dist2 = std::numeric_limits<float>::infinity();
+    if (nodes.empty())
+    {
+        if (out_dist2) *out_dist2 = best_dist2;
+        return -1;
+    }
 
-    // first traverse the subtree in which the point lays
-    KNearestNeighborSearch(dAxis > 0 ? nodes[currentNode].left : nodes[currentNode].right, searchPoint, k, currentAxis,
-                           queue);
+    float q[D];
+    for (int d = 0; d < D; ++d) q[d] = searchPoint[d];
+    float dist2[max_leaf_size];
 
-    // when the distance to the axis is greater than the current distance
-    // we don't need to traverse the other sub tree
-    if (dAxisSquared >= lastD) return;
+    StackEntry stack[max_stack];
+    int sp      = 0;
+    stack[sp++] = {0, 0};
+    while (sp > 0)
+    {
+        auto e = stack[--sp];
+        if (e.dist2 > best_dist2) continue;
 
-    // there may be a better point in this subtree
-    KNearestNeighborSearch(dAxis > 0 ? nodes[currentNode].right : nodes[currentNode].left, searchPoint, k, currentAxis,
-                           queue);
+        int node = e.node;
+        while (nodes[node].axis >= 0)
+        {
+            const Node& n = nodes[node];
+            float diff    = q[n.axis] - n.split;
+            int near      = diff < 0 ? node + 1 : n.right_or_begin;
+            int far       = diff < 0 ? n.right_or_begin : node + 1;
+            if (diff * diff <= best_dist2) stack[sp++] = {far, diff * diff};
+            node = near;
+        }
 
-    //    nearestNeighbour(dAxis > 0 ? nodes[currentNode].right : nodes[currentNode].left, searchPoint, currentAxis
-    //    ,bestNode,  bestDist);
+        const Node& leaf = nodes[node];
+        LeafDistances(leaf, q, dist2);
+        for (int i = 0; i < leaf.end - leaf.right_or_begin; ++i)
+        {
+            int index = indices[leaf.right_or_begin + i];
+            if (HeapLess(dist2[i], index, best_dist2, best_index))
+            {
+                best_dist2 = dist2[i];
+                best_index = index;
+            }
+        }
+    }
+    if (out_dist2) *out_dist2 = best_dist2;
+    return best_index;
 }
 
 template <int D, typename point_t>
-float KDTree<D, point_t>::addToQueue(queue_t& queue, index_t currentNode, float distance)
+int KDTree<D, point_t>::KNearestNeighborSearch(const point_t& searchPoint, int k, int* out_indices,
+                                               float* out_dist2) const
 {
-    float lastD = queue[queue.size() - 1].first;
-    if (distance >= lastD) return lastD;
+    if (nodes.empty() || k <= 0) return 0;
 
-    queue[queue.size() - 1].first  = distance;
-    queue[queue.size() - 1].second = currentNode;
-
-    std::sort(queue.begin(), queue.end());
+    float q[D];
+    for (int d = 0; d < D; ++d) q[d] = searchPoint[d];
+    float dist2[max_leaf_size];
 
+    // Use the caller's buffers for the heap if possible.
+    float local_dist[max_leaf_size];
+    float* heap_dist = out_dist2;
+    std::vector<float> tmp_dist;
+    if (!heap_dist)
+    {
+        if (k <= max_leaf_size)
+        {
+            heap_dist = local_dist;
+        }
+        else
+        {
+            tmp_dist.resize(k);
+            heap_dist = tmp_dist.data();
+        }
+    }
+    int* heap_idx = out_indices;
+    int count     = 0;
 
-    return queue[queue.size() - 1].first;
-}
+    StackEntry stack[max_stack];
+    int sp      = 0;
+    stack[sp++] = {0, 0};
+    while (sp > 0)
+    {
+        auto e       = stack[--sp];
+        float worst2 = count < k ? std::numeric_limits<float>::infinity() : heap_dist[0];
+        if (e.dist2 > worst2) continue;
 
+        int node = e.node;
+        while (nodes[node].axis >= 0)
+        {
+            const Node& n = nodes[node];
+            float diff    = q[n.axis] - n.split;
+            int near      = diff < 0 ? node + 1 : n.right_or_begin;
+            int far       = diff < 0 ? n.right_or_begin : node + 1;
+            if (diff * diff <= worst2) stack[sp++] = {far, diff * diff};
+            node = near;
+        }
 
-template <int D, typename point_t>
-void KDTree<D, point_t>::RadiusSearch(index_t currentNode, const point_t& searchPoint, float r, axis_t currentAxis,
-                                      std::vector<int>& result)
-{
-    if (currentNode == -1) return;
+        const Node& leaf = nodes[node];
+        LeafDistances(leaf, q, dist2);
+        for (int i = 0; i < leaf.end - leaf.right_or_begin; ++i)
+        {
+            int index = indices[leaf.right_or_begin + i];
+            if (count < k)
+            {
+                HeapPush(heap_idx, heap_dist, count, index, dist2[i]);
+            }
+            else if (HeapLess(dist2[i], index, heap_dist[0], heap_idx[0]))
+            {
+                HeapReplaceTop(heap_idx, heap_dist, count, index, dist2[i]);
+            }
+        }
+    }
 
-    // calculate distance to current point and update the current best
-    float d = distance(nodes[currentNode].p, searchPoint);
-    if (d < r)
+    // Heap sort -> ascending order
+    for (int end = count - 1; end > 0; --end)
     {
-        result.push_back(nodes[currentNode].initial_index);
+        int i   = heap_idx[end];
+        float d = heap_dist[end];
+        std::swap(heap_idx[0], heap_idx[end]);
+        std::swap(heap_dist[0], heap_dist[end]);
+        HeapReplaceTop(heap_idx, heap_dist, end, i, d);
     }
+    return count;
+}
 
+template <int D, typename point_t>
+std::vector<int> KDTree<D, point_t>::KNearestNeighborSearch(const point_t& searchPoint, int k) const
+{
+    std::vector<int> points(std::max(k, 0));
+    int count = KNearestNeighborSearch(searchPoint, k, points.data(), nullptr);
+    points.resize(count);
+    return points;
+}
 
-    // the (signed) distance of the searchpoint to the current split axis
-    float dAxis = nodes[currentNode].p[currentAxis] - searchPoint[currentAxis];
-    // the actual distance to the point is squared so we also need to square the distance to the axis
-    float dAxisSquared = dAxis * dAxis;
-
-    currentAxis = (currentAxis + 1) % D;
+template <int D, typename point_t>
+void KDTree<D, point_t>::RadiusSearch(const point_t& searchPoint, float radius, std::vector<int>& result) const
+{
+    if (nodes.empty()) return;
 
-    // first traverse the subtree in which the point lies
-    RadiusSearch(dAxis > 0 ? nodes[currentNode].left : nodes[currentNode].right, searchPoint, r, currentAxis, result);
+    float r2 = radius * radius;
+    float q[D];
+    for (int d = 0; d < D; ++d) q[d] = searchPoint[d];
+    float dist2[max_leaf_size];
 
-    // when the distance to the axis is greater than the current distance
-    // we don't need to traverse the other sub tree
-    if (dAxisSquared >= r) return;
+    StackEntry stack[max_stack];
+    int sp      = 0;
+    stack[sp++] = {0, 0};
+    while (sp > 0)
+    {
+        int node = stack[--sp].node;
+        while (nodes[node].axis >= 0)
+        {
+            const Node& n = nodes[node];
+            float diff    = q[n.axis] - n.split;
+            int near      = diff < 0 ? node + 1 : n.right_or_begin;
+            int far       = diff < 0 ? n.right_or_begin : node + 1;
+            if (diff * diff < r2) stack[sp++] = {far, diff * diff};
+            node = near;
+        }
 
-    // there may be a better point in this subtree
-    RadiusSearch(dAxis > 0 ? nodes[currentNode].right : nodes[currentNode].left, searchPoint, r, currentAxis, result);
+        const Node& leaf = nodes[node];
+        LeafDistances(leaf, q, dist2);
+        for (int i = 0; i < leaf.end - leaf.right_or_begin; ++i)
+        {
+            if (dist2[i] < r2) result.push_back(indices[leaf.right_or_begin + i]);
+        }
+    }
 }
 
-
 template <int D, typename point_t>
-std::vector<int> KDTree<D, point_t>::RadiusSearch(const point_t& searchPoint, float r)
+std::vector<int> KDTree<D, point_t>::RadiusSearch(const point_t& searchPoint, float radius) const
 {
     std::vector<int> points;
-    RadiusSearch(rootNode, searchPoint, r * r, 0, points);
+    RadiusSearch(searchPoint, radius, points);
     std::sort(points.begin(), points.end());
     return points;
 }
 
+template <int D, typename point_t>
+void KDTree<D, point_t>::NearestNeighborSearch(ArrayView<const point_t> queries, ArrayView<int> out_indices,
+                                               ArrayView<float> out_dist2) const
+{
+    SAIGA_ASSERT(out_indices.size() == queries.size());
+    SAIGA_ASSERT(out_dist2.empty() || out_dist2.size() == queries.size());
+    int n = queries.size();
+#pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < n; ++i)
+    {
+        out_indices[i] = NearestNeighborSearch(queries[i], out_dist2.empty() ? nullptr : &out_dist2[i]);
+    }
+}
 
+template <int D, typename point_t>
+void KDTree<D, point_t>::KNearestNeighborSearch(ArrayView<const point_t> queries, int k, ArrayView<int> out_indices,
+                                                ArrayView<float> out_dist2) const
+{
+    SAIGA_ASSERT(k > 0);
+    SAIGA_ASSERT(out_indices.size() == queries.size() * k);
+    SAIGA_ASSERT(out_dist2.empty() || out_dist2.size() == queries.size() * k);
+    int n = queries.size();
+#pragma omp parallel
+    {
+        // Scratch distances for large k, so the single queries do not allocate.
+        std::vector<float> scratch(out_dist2.empty() && k > max_leaf_size ? k : 0);
+#pragma omp for schedule(dynamic, 64)
+        for (int i = 0; i < n; ++i)
+        {
+            int* idx    = out_indices.data() + size_t(i) * k;
+            float* dist = out_dist2.empty() ? nullptr : out_dist2.data() + size_t(i) * k;
+            int count   = KNearestNeighborSearch(queries[i], k, idx, dist ? dist : scratch.data());
+            for (int j = count; j < k; ++j)
+            {
+                idx[j] = -1;
+                if (dist) dist[j] = std::numeric_limits<float>::infinity();
+            }
+        }
+    }
+}
 
 template <int D, typename point_t>
-float KDTree<D, point_t>::distance(point_t a, point_t b)
+std::vector<std::vector<int>> KDTree<D, point_t>::RadiusSearch(ArrayView<const point_t> queries, float radius) const
 {
-    // use the squared distance so we don't have to calculate the sqrt
-    point_t tmp = a - b;
-    return dot(tmp, tmp);
+    int n = queries.size();
+    std::vector<std::vector<int>> result(n);
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < n; ++i)
+    {
+        RadiusSearch(queries[i], radius, result[i]);
+        std::sort(result[i].begin(), result[i].end());
+    }
+    return result;
 }
 
 }  // namespace Saiga
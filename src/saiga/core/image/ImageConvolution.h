@@ -0,0 +1,317 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/core/util/DataStructures/ArrayView.h"
+#include "saiga/core/util/assert.h"
+
+#include "ImageKernels.h"
+#include "templatedImage.h"
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+
+namespace Saiga
+{
+/**
+ * Summed area table of an image, which is padded by 'padding' pixels on each side with the given border mode.
+ * The sum over any rectangle of the (padded) image is then computed with 4 lookups.
+ *
+ * The sums are accumulated in S. The default double avoids cancellation errors with large float images.
+ * ComputeValidCount with S = int counts the non-zero pixels instead, for example the valid pixels of a depth map.
+ *
+ * The row sums are computed in parallel over the rows, the column sums in parallel over blocks of columns.
+ */
+template <typename T, typename S = double>
+class IntegralImage
+{
+   public:
+    void Compute(ImageView<const T> img, int padding = 0, ImageBorder border = ImageBorder::Clamp)
+    {
+        Build(img, padding, border, [](T v) { return S(v); });
+    }
+
+    void ComputeValidCount(ImageView<const T> img, int padding = 0, ImageBorder border = ImageBorder::Clamp)
+    {
+        Build(img, padding, border, [](T v) { return S(v != T(0)); });
+    }
+
+    // Sum over [y0, y1) x [x0, x1) in image coordinates.
+    // The rectangle may extend up to 'padding' pixels outside of the image.
+    S Sum(int y0, int x0, int y1, int x1)
+    {
+        SAIGA_ASSERT(y0 >= -padding && x0 >= -padding && y1 <= h + padding && x1 <= w + padding);
+        SAIGA_ASSERT(y0 <= y1 && x0 <= x1);
+        y0 += padding;
+        x0 += padding;
+        y1 += padding;
+        x1 += padding;
+        return table(y1, x1) - table(y0, x1) - table(y1, x0) + table(y0, x0);
+    }
+
+    int h = 0, w = 0, padding = 0;
+
+    // Size (h + 2 * padding + 1) x (w + 2 * padding + 1).
+    // table(y, x) is the sum of all padded pixels in [0, y) x [0, x).
+    TemplatedImage<S> table;
+
+   private:
+    template <typename F>
+    void Build(ImageView<const T> img, int pad, ImageBorder border, F f)
+    {
+        SAIGA_ASSERT(pad >= 0);
+        h       = img.h;
+        w       = img.w;
+        padding = pad;
+
+        int ph = h + 2 * pad;
+        int pw = w + 2 * pad;
+        table.create(ph + 1, pw + 1);
+        std::fill(table.rowPtr(0), table.rowPtr(0) + pw + 1, S(0));
+
+        auto read = [&](const T* row, int x) {
+            int sx = BorderIndex(x, w, border);
+            return sx < 0 ? S(0) : f(row[sx]);
+        };
+
+        // Prefix sum of each padded row
+#pragma omp parallel for if (ph * pw >= 65536)
+        for (int py = 0; py < ph; ++py)
+        {
+            S* dst = table.rowPtr(py + 1);
+            int sy = BorderIndex(py - pad, h, border);
+            if (sy < 0)
+            {
+                std::fill(dst, dst + pw + 1, S(0));
+                continue;
+            }
+
+            const T* src = img.rowPtr(sy);
+            S sum        = 0;
+            dst[0]       = 0;
+            for (int x = -pad; x < 0; ++x)
+            {
+                sum += read(src, x);
+                dst[x + pad + 1] = sum;
+            }
+            for (int x = 0; x < w; ++x)
+            {
+                sum += f(src[x]);
+                dst[x + pad + 1] = sum;
+            }
+            for (int x = w; x < w + pad; ++x)
+            {
+                sum += read(src, x);
+                dst[x + pad + 1] = sum;
+            }
+        }
+
+        // Prefix sum of the columns. Each block of columns is processed top to bottom.
+        const int block_size = 512;
+        int num_blocks       = (pw + block_size) / block_size;
+#pragma omp parallel for if (ph * pw >= 65536)
+        for (int b = 0; b < num_blocks; ++b)
+        {
+            int x0 = b * block_size;
+            int n  = std::min(block_size, pw + 1 - x0);
+            for (int py = 2; py <= ph; ++py)
+            {
+                AddRow(table.rowPtr(py - 1) + x0, table.rowPtr(py) + x0, n);
+            }
+        }
+    }
+
+    static void AddRow(const S* __restrict src, S* __restrict dst, int n)
+    {
+        for (int x = 0; x < n; ++x)
+        {
+            dst[x] += src[x];
+        }
+    }
+};
+
+
+/**
+ * Neighbourhood filters for floating point images with O(1) (box) or O(kernel size) (separable) cost per pixel.
+ *
+ *   Separable:  Correlation with an arbitrary separable kernel (kernel_y * kernel_x^T).
+ *   Gaussian:   Normalized gaussian kernel. Forwards to ImageKernel::GaussianBlur.
+ *   Box:        Mean of the (2 * radius + 1)^2 window. Uses an integral image, so the cost does not depend on the
+ *               radius.
+ *   BoxValid:   Mean of the valid (non-zero) pixels in the window, for depth maps with holes. Uses integral images.
+ *
+ * The temporary images are kept, so repeated calls with the same image size do not allocate.
+ * src and dst can be the same image. All filters are parallelized over the rows with OpenMP.
+ *
+ * Usage:
+ *   ImageConvolution<float> conv(ImageBorder::Mirror);
+ *   conv.Box(depth, smoothed, 10);
+ */
+template <typename T>
+class ImageConvolution
+{
+    static_assert(std::is_floating_point<T>::value, "ImageConvolution is only implemented for float and double.");
+
+   public:
+    ImageBorder border;
+
+    explicit ImageConvolution(ImageBorder border = ImageBorder::Clamp) : border(border) {}
+
+    // dst(y, x) = sum_ij kernel_y[i] * kernel_x[j] * src(y + i - ry, x + j - rx)
+    // with rx = kernel_x.size() / 2 and ry = kernel_y.size() / 2. Both kernels must have an odd size.
+    void Separable(ImageView<const T> src, ImageView<T> dst, ArrayView<const T> kernel_x, ArrayView<const T> kernel_y)
+    {
+        SAIGA_ASSERT(src.dimensions() == dst.dimensions());
+        SAIGA_ASSERT(kernel_x.size() % 2 == 1 && kernel_y.size() % 2 == 1);
+        int h  = src.h;
+        int w  = src.w;
+        int rx = kernel_x.size() / 2;
+        int ry = kernel_y.size() / 2;
+        temp.create(h, w);
+
+        // Horizontal pass into temp. The row is copied into a padded buffer so the inner loop has no border checks.
+#pragma omp parallel if (h * w >= 65536)
+        {
+            std::vector<T> padded(w + 2 * rx);
+#pragma omp for
+            for (int y = 0; y < h; ++y)
+            {
+                const T* s = src.rowPtr(y);
+                std::copy(s, s + w, padded.data() + rx);
+                for (int x = 0; x < rx; ++x)
+                {
+                    int left           = BorderIndex(x - rx, w, border);
+                    int right          = BorderIndex(w + x, w, border);
+                    padded[x]          = left < 0 ? T(0) : s[left];
+                    padded[w + rx + x] = right < 0 ? T(0) : s[right];
+                }
+
+                T* t = temp.rowPtr(y);
+                std::fill(t, t + w, T(0));
+                for (int j = 0; j < int(kernel_x.size()); ++j)
+                {
+                    MultiplyAdd(padded.data() + j, kernel_x[j], t, w);
+                }
+            }
+        }
+
+        // Vertical pass into dst
+#pragma omp parallel for if (h * w >= 65536)
+        for (int y = 0; y < h; ++y)
+        {
+            T* d = dst.rowPtr(y);
+            std::fill(d, d + w, T(0));
+            for (int i = 0; i < int(kernel_y.size()); ++i)
+            {
+                int sy = BorderIndex(y + i - ry, h, border);
+                if (sy < 0) continue;
+                MultiplyAdd(temp.rowPtr(sy), kernel_y[i], d, w);
+            }
+        }
+    }
+
+    void Gaussian(ImageView<const T> src, ImageView<T> dst, int radius, T sigma)
+    {
+        ImageKernel::GaussianBlur(NonOverlapping(src, dst), dst, radius, sigma, border);
+    }
+
+    void Box(ImageView<const T> src, ImageView<T> dst, int radius)
+    {
+        SAIGA_ASSERT(src.dimensions() == dst.dimensions());
+        SAIGA_ASSERT(radius >= 0);
+        sums.Compute(src, radius, border);
+
+        int d           = 2 * radius + 1;
+        double inv_area = 1.0 / (double(d) * d);
+#pragma omp parallel for if (src.h * src.w >= 65536)
+        for (int y = 0; y < src.h; ++y)
+        {
+            BoxRow(sums.table.rowPtr(y), sums.table.rowPtr(y + d), d, inv_area, dst.rowPtr(y), src.w);
+        }
+    }
+
+    // Pixels without a valid pixel in their window are set to zero.
+    // keep_holes: invalid input pixels stay zero (only the valid pixels are smoothed).
+    // Otherwise the holes are filled with the mean of their valid neighbours.
+    void BoxValid(ImageView<const T> src, ImageView<T> dst, int radius, bool keep_holes = false)
+    {
+        BoxValidImpl(src, dst, radius, keep_holes, nullptr);
+    }
+
+    // Additionally writes the number of valid pixels in each window to count.
+    void BoxValid(ImageView<const T> src, ImageView<T> dst, int radius, bool keep_holes, ImageView<int> count)
+    {
+        SAIGA_ASSERT(count.dimensions() == src.dimensions());
+        BoxValidImpl(src, dst, radius, keep_holes, &count);
+    }
+
+    IntegralImage<T, double> sums;
+    IntegralImage<T, int> counts;
+
+   private:
+    TemplatedImage<T> temp;
+
+    // The ImageKernel filter requires distinct images. For in-place filtering the source is copied to temp.
+    ImageView<const T> NonOverlapping(ImageView<const T> src, ImageView<T> dst)
+    {
+        if (src.data != dst.data) return src;
+        temp.create(src.h, src.w);
+        src.copyTo(temp.getImageView());
+        return temp;
+    }
+
+    void BoxValidImpl(ImageView<const T> src, ImageView<T> dst, int radius, bool keep_holes, ImageView<int>* count)
+    {
+        SAIGA_ASSERT(src.dimensions() == dst.dimensions());
+        SAIGA_ASSERT(radius >= 0);
+        sums.Compute(src, radius, border);
+        counts.ComputeValidCount(src, radius, border);
+
+        int d = 2 * radius + 1;
+#pragma omp parallel for if (src.h * src.w >= 65536)
+        for (int y = 0; y < src.h; ++y)
+        {
+            const double* sum_top    = sums.table.rowPtr(y);
+            const double* sum_bottom = sums.table.rowPtr(y + d);
+            const int* count_top     = counts.table.rowPtr(y);
+            const int* count_bottom  = counts.table.rowPtr(y + d);
+            const T* s               = src.rowPtr(y);
+            T* out                   = dst.rowPtr(y);
+            int* c                   = count ? count->rowPtr(y) : nullptr;
+            for (int x = 0; x < src.w; ++x)
+            {
+                double sum = sum_bottom[x + d] - sum_bottom[x] - sum_top[x + d] + sum_top[x];
+                int n      = count_bottom[x + d] - count_bottom[x] - count_top[x + d] + count_top[x];
+                T value    = n > 0 ? T(sum / n) : T(0);
+                if (keep_holes && s[x] == T(0)) value = 0;
+                if (c) c[x] = n;
+                out[x] = value;
+            }
+        }
+    }
+
+    static void MultiplyAdd(const T* __restrict src, T k, T* __restrict dst, int w)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            dst[x] += k * src[x];
+        }
+    }
+
+    static void BoxRow(const double* __restrict top, const double* __restrict bottom, int d, double inv_area,
+                       T* __restrict dst, int w)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            dst[x] = T((bottom[x + d] - bottom[x] - top[x + d] + top[x]) * inv_area);
+        }
+    }
+};
+
+}  // namespace Saiga
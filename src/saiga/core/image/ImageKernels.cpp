@@ -0,0 +1,997 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "ImageKernels.h"
+
+#include "saiga/core/util/Thread/omp.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define SAIGA_IMAGE_KERNELS_X86
+#    define SAIGA_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#    define SAIGA_TARGET_AVX2
+#endif
+
+#if defined(__GNUC__)
+#    define SAIGA_KERNEL_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#    define SAIGA_KERNEL_INLINE __forceinline
+#else
+#    define SAIGA_KERNEL_INLINE inline
+#endif
+
+// Instantiates the row kernel NAME for both backends: NAME_Generic and NAME_AVX2.
+// The kernel is force inlined, so the loops are compiled (and vectorized) for the target of the wrapper.
+#define SAIGA_ROW_KERNEL(NAME, PARAMS, ARGS)      \
+    static void NAME##_Generic PARAMS { NAME ARGS; } \
+    SAIGA_TARGET_AVX2 static void NAME##_AVX2 PARAMS { NAME ARGS; }
+
+#define SAIGA_SELECT_ROW_KERNEL(NAME, BACKEND) ((BACKEND) == ImageKernelBackend::AVX2 ? NAME##_AVX2 : NAME##_Generic)
+
+namespace Saiga
+{
+bool ImageKernelBackendSupported(ImageKernelBackend backend)
+{
+    switch (backend)
+    {
+        case ImageKernelBackend::Generic:
+            return true;
+#ifdef SAIGA_IMAGE_KERNELS_X86
+        case ImageKernelBackend::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+ImageKernelBackend BestImageKernelBackend()
+{
+    static const ImageKernelBackend best = ImageKernelBackendSupported(ImageKernelBackend::AVX2)
+                                               ? ImageKernelBackend::AVX2
+                                               : ImageKernelBackend::Generic;
+    return best;
+}
+
+const char* ImageKernelBackendName(ImageKernelBackend backend)
+{
+    switch (backend)
+    {
+        case ImageKernelBackend::AVX2:
+            return "AVX2";
+        default:
+            return "Generic";
+    }
+}
+
+namespace ImageKernel
+{
+static constexpr int tile_rows           = 16;
+static constexpr int min_parallel_pixels = 1 << 16;
+
+// Calls f(y_begin, y_end) for all tiles of rows. Large images are processed in parallel.
+template <typename F>
+static void ParallelRows(int h, int w, F f)
+{
+    int tiles     = iDivUp(h, tile_rows);
+    bool parallel = size_t(h) * w >= min_parallel_pixels && tiles > 1;
+#pragma omp parallel for schedule(static) if (parallel)
+    for (int t = 0; t < tiles; ++t)
+    {
+        f(t * tile_rows, std::min(h, (t + 1) * tile_rows));
+    }
+}
+
+static inline int Clamp(int i, int n)
+{
+    return std::min(std::max(i, 0), n - 1);
+}
+
+// ===== Row kernels =====
+
+// Same formula and summation order as the Eigen version dot(vec3(0.299, 0.587, 0.114), rgb), which is computed as
+// x + (y + z). Otherwise the truncation to 8-bit differs for a few colors.
+static const float gray_r = 0.299f, gray_g = 0.587f, gray_b = 0.114f;
+
+template <int C>
+static SAIGA_KERNEL_INLINE void ToGray8Row(const unsigned char* __restrict src, unsigned char* __restrict dst, int w)
+{
+    for (int x = 0; x < w; ++x)
+    {
+        float gray = gray_r * src[C * x] + (gray_g * src[C * x + 1] + gray_b * src[C * x + 2]);
+        dst[x]     = (unsigned char)gray;
+    }
+}
+static SAIGA_KERNEL_INLINE void RGBAToGray8Row(const unsigned char* src, unsigned char* dst, int w)
+{
+    ToGray8Row<4>(src, dst, w);
+}
+static SAIGA_KERNEL_INLINE void RGBToGray8Row(const unsigned char* src, unsigned char* dst, int w)
+{
+    ToGray8Row<3>(src, dst, w);
+}
+SAIGA_ROW_KERNEL(RGBAToGray8Row, (const unsigned char* src, unsigned char* dst, int w), (src, dst, w))
+SAIGA_ROW_KERNEL(RGBToGray8Row, (const unsigned char* src, unsigned char* dst, int w), (src, dst, w))
+
+static SAIGA_KERNEL_INLINE void RGBAToGrayFRow(const unsigned char* __restrict src, float* __restrict dst, int w,
+                                               float scale)
+{
+    for (int x = 0; x < w; ++x)
+    {
+        float gray = gray_r * src[4 * x] + (gray_g * src[4 * x + 1] + gray_b * src[4 * x + 2]);
+        dst[x]     = gray * scale;
+    }
+}
+SAIGA_ROW_KERNEL(RGBAToGrayFRow, (const unsigned char* src, float* dst, int w, float scale), (src, dst, w, scale))
+
+static SAIGA_KERNEL_INLINE void Gray8ToRGBARow(const unsigned char* __restrict src, unsigned char* __restrict dst,
+                                               int w, unsigned char alpha)
+{
+    for (int x = 0; x < w; ++x)
+    {
+        dst[4 * x + 0] = src[x];
+        dst[4 * x + 1] = src[x];
+        dst[4 * x + 2] = src[x];
+        dst[4 * x + 3] = alpha;
+    }
+}
+SAIGA_ROW_KERNEL(Gray8ToRGBARow, (const unsigned char* src, unsigned char* dst, int w, unsigned char alpha),
+                 (src, dst, w, alpha))
+
+// 2x2 average of interleaved 8-bit pixels with C channels. w is the output width.
+template <int C>
+static SAIGA_KERNEL_INLINE void ScaleDown2BytesRow(const unsigned char* __restrict a, const unsigned char* __restrict b,
+                                                   unsigned char* __restrict dst, int w)
+{
+    for (int x = 0; x < w; ++x)
+    {
+        for (int c = 0; c < C; ++c)
+        {
+            int sum = a[2 * C * x + c] + a[2 * C * x + C + c] + b[2 * C * x + c] + b[2 * C * x + C + c];
+            dst[C * x + c] = sum >> 2;
+        }
+    }
+}
+static SAIGA_KERNEL_INLINE void ScaleDown2Row1(const unsigned char* a, const unsigned char* b, unsigned char* dst,
+                                               int w)
+{
+    ScaleDown2BytesRow<1>(a, b, dst, w);
+}
+static SAIGA_KERNEL_INLINE void ScaleDown2Row4(const unsigned char* a, const unsigned char* b, unsigned char* dst,
+                                               int w)
+{
+    ScaleDown2BytesRow<4>(a, b, dst, w);
+}
+SAIGA_ROW_KERNEL(ScaleDown2Row1, (const unsigned char* a, const unsigned char* b, unsigned char* dst, int w),
+                 (a, b, dst, w))
+SAIGA_ROW_KERNEL(ScaleDown2Row4, (const unsigned char* a, const unsigned char* b, unsigned char* dst, int w),
+                 (a, b, dst, w))
+
+static SAIGA_KERNEL_INLINE void ScaleDown2FloatRow(const float* __restrict a, const float* __restrict b,
+                                                   float* __restrict dst, int w)
+{
+    for (int x = 0; x < w; ++x)
+    {
+        // Same summation order as ImageView::copyScaleDownPow2
+        dst[x] = (((a[2 * x] + a[2 * x + 1]) + b[2 * x]) + b[2 * x + 1]) * 0.25f;
+    }
+}
+SAIGA_ROW_KERNEL(ScaleDown2FloatRow, (const float* a, const float* b, float* dst, int w), (a, b, dst, w))
+
+static SAIGA_KERNEL_INLINE void ScaleDown2MedianRow(const float* __restrict a, const float* __restrict b,
+                                                    float* __restrict dst, int w, bool low)
+{
+    // Sorting network: the second smallest of 4 values is min(max(lo1, lo2), min(hi1, hi2)) and the third smallest
+    // max(max(lo1, lo2), min(hi1, hi2)).
+    for (int x = 0; x < w; ++x)
+    {
+        float lo1   = std::min(a[2 * x], a[2 * x + 1]);
+        float hi1   = std::max(a[2 * x], a[2 * x + 1]);
+        float lo2   = std::min(b[2 * x], b[2 * x + 1]);
+        float hi2   = std::max(b[2 * x], b[2 * x + 1]);
+        float lo_hi = std::max(lo1, lo2);
+        float hi_lo = std::min(hi1, hi2);
+        dst[x]      = low ? std::min(lo_hi, hi_lo) : std::max(lo_hi, hi_lo);
+    }
+}
+SAIGA_ROW_KERNEL(ScaleDown2MedianRow, (const float* a, const float* b, float* dst, int w, bool low),
+                 (a, b, dst, w, low))
+
+// Vertical [1 4 6 4 1] pass of PyramidDown for w pixels.
+template <typename T, typename S>
+static SAIGA_KERNEL_INLINE void PyramidVerticalRow(const T* __restrict r0, const T* __restrict r1,
+                                                   const T* __restrict r2, const T* __restrict r3,
+                                                   const T* __restrict r4, S* __restrict dst, int w)
+{
+    for (int x = 0; x < w; ++x)
+    {
+        dst[x] = S(r0[x]) + S(r4[x]) + S(4) * (S(r1[x]) + S(r3[x])) + S(6) * S(r2[x]);
+    }
+}
+
+// Horizontal [1 4 6 4 1] pass of PyramidDown + subsampling. p is the vertical result with 2 padding pixels on each
+// side and w the output width.
+static SAIGA_KERNEL_INLINE void PyramidHorizontalRow(const int* __restrict p, unsigned char* __restrict dst, int w)
+{
+    for (int x = 0; x < w; ++x)
+    {
+        const int* q = p + 2 * x;
+        int sum      = q[0] + q[4] + 4 * (q[1] + q[3]) + 6 * q[2];
+        dst[x]       = (sum + 128) >> 8;
+    }
+}
+static SAIGA_KERNEL_INLINE void PyramidHorizontalRowF(const float* __restrict p, float* __restrict dst, int w)
+{
+    for (int x = 0; x < w; ++x)
+    {
+        const float* q = p + 2 * x;
+        float sum      = q[0] + q[4] + 4.0f * (q[1] + q[3]) + 6.0f * q[2];
+        dst[x]         = sum * (1.0f / 256.0f);
+    }
+}
+
+static SAIGA_KERNEL_INLINE void PyramidDownRow(const unsigned char* const* rows, int* tmp, unsigned char* dst,
+                                               int src_w, int dst_w)
+{
+    PyramidVerticalRow(rows[0], rows[1], rows[2], rows[3], rows[4], tmp + 2, src_w);
+    for (int i = 0; i < 2; ++i)
+    {
+        tmp[1 - i]         = tmp[2 + BorderIndex(i + 1, src_w, ImageBorder::Mirror)];
+        tmp[src_w + 2 + i] = tmp[2 + BorderIndex(src_w + i, src_w, ImageBorder::Mirror)];
+    }
+    PyramidHorizontalRow(tmp, dst, dst_w);
+}
+static SAIGA_KERNEL_INLINE void PyramidDownRowF(const float* const* rows, float* tmp, float* dst, int src_w, int dst_w)
+{
+    PyramidVerticalRow(rows[0], rows[1], rows[2], rows[3], rows[4], tmp + 2, src_w);
+    for (int i = 0; i < 2; ++i)
+    {
+        tmp[1 - i]         = tmp[2 + BorderIndex(i + 1, src_w, ImageBorder::Mirror)];
+        tmp[src_w + 2 + i] = tmp[2 + BorderIndex(src_w + i, src_w, ImageBorder::Mirror)];
+    }
+    PyramidHorizontalRowF(tmp, dst, dst_w);
+}
+SAIGA_ROW_KERNEL(PyramidDownRow,
+                 (const unsigned char* const* rows, int* tmp, unsigned char* dst, int src_w, int dst_w),
+                 (rows, tmp, dst, src_w, dst_w))
+SAIGA_ROW_KERNEL(PyramidDownRowF, (const float* const* rows, float* tmp, float* dst, int src_w, int dst_w),
+                 (rows, tmp, dst, src_w, dst_w))
+
+static SAIGA_KERNEL_INLINE void GradientXRow(const float* __restrict src, float* __restrict dst, int w)
+{
+    for (int x = 1; x < w - 1; ++x)
+    {
+        dst[x] = (src[x + 1] - src[x - 1]) / 2.0f;
+    }
+    dst[0]     = src[1] - src[0];
+    dst[w - 1] = src[w - 1] - src[w - 2];
+}
+SAIGA_ROW_KERNEL(GradientXRow, (const float* src, float* dst, int w), (src, dst, w))
+
+// dst = (b - a) / div
+static SAIGA_KERNEL_INLINE void DifferenceRow(const float* __restrict a, const float* __restrict b,
+                                              float* __restrict dst, int w, float div)
+{
+    for (int x = 0; x < w; ++x)
+    {
+        dst[x] = (b[x] - a[x]) / div;
+    }
+}
+SAIGA_ROW_KERNEL(DifferenceRow, (const float* a, const float* b, float* dst, int w, float div),
+                 (a, b, dst, w, div))
+
+// a, b, c are the rows y-1, y, y+1. tmp must have space for 2 * (w + 2) floats.
+static SAIGA_KERNEL_INLINE void SobelRow(const unsigned char* __restrict a, const unsigned char* __restrict b,
+                                         const unsigned char* __restrict c, float* __restrict tmp,
+                                         float* __restrict dx, float* __restrict dy, int w)
+{
+    // Vertical smoothing and vertical difference with one padding pixel on each side
+    float* smooth = tmp;
+    float* diff   = tmp + w + 2;
+    for (int x = 0; x < w; ++x)
+    {
+        smooth[x + 1] = float(a[x] + 2 * b[x] + c[x]);
+        diff[x + 1]   = float(c[x] - a[x]);
+    }
+    smooth[0]     = smooth[1];
+    smooth[w + 1] = smooth[w];
+    diff[0]       = diff[1];
+    diff[w + 1]   = diff[w];
+
+    for (int x = 0; x < w; ++x)
+    {
+        dx[x] = smooth[x + 2] - smooth[x];
+        dy[x] = diff[x] + 2.0f * diff[x + 1] + diff[x + 2];
+    }
+}
+SAIGA_ROW_KERNEL(SobelRow,
+                 (const unsigned char* a, const unsigned char* b, const unsigned char* c, float* tmp, float* dx,
+                  float* dy, int w),
+                 (a, b, c, tmp, dx, dy, w))
+
+// acc += add - sub
+template <typename T, typename S>
+static SAIGA_KERNEL_INLINE void SlideRow(const T* __restrict add, const T* __restrict sub, S* __restrict acc, int w)
+{
+    for (int x = 0; x < w; ++x)
+    {
+        acc[x] += S(add[x]) - S(sub[x]);
+    }
+}
+template <typename T, typename S>
+static SAIGA_KERNEL_INLINE void AddRow(const T* __restrict add, S* __restrict acc, int w)
+{
+    for (int x = 0; x < w; ++x)
+    {
+        acc[x] += S(add[x]);
+    }
+}
+
+// Horizontal box sum of the column sums 'col' (w values). The border is handled outside of the main loop.
+// prefix needs space for w + 2 * radius + 1 values.
+template <typename S, typename P>
+static SAIGA_KERNEL_INLINE void BoxPrefix(const S* col, P* prefix, int w, int radius, ImageBorder border)
+{
+    P sum     = 0;
+    prefix[0] = 0;
+    for (int i = 0; i < radius; ++i)
+    {
+        int j = BorderIndex(i - radius, w, border);
+        sum += j < 0 ? P(0) : P(col[j]);
+        prefix[i + 1] = sum;
+    }
+    for (int x = 0; x < w; ++x)
+    {
+        sum += P(col[x]);
+        prefix[radius + x + 1] = sum;
+    }
+    for (int i = 0; i < radius; ++i)
+    {
+        int j = BorderIndex(w + i, w, border);
+        sum += j < 0 ? P(0) : P(col[j]);
+        prefix[radius + w + i + 1] = sum;
+    }
+}
+
+static SAIGA_KERNEL_INLINE void BoxFilterRow8(const unsigned char* add, const unsigned char* sub, uint32_t* col,
+                                              uint32_t* prefix, unsigned char* __restrict dst, int w, int radius,
+                                              float inv_area, ImageBorder border)
+{
+    if (add) SlideRow(add, sub, col, w);
+    BoxPrefix(col, prefix, w, radius, border);
+    // Unsigned arithmetic, so the difference is correct even if the prefix sum overflows.
+    const uint32_t* __restrict lo = prefix;
+    const uint32_t* __restrict hi = prefix + 2 * radius + 1;
+    for (int x = 0; x < w; ++x)
+    {
+        dst[x] = (unsigned char)(float(hi[x] - lo[x]) * inv_area + 0.5f);
+    }
+}
+template <typename T>
+static SAIGA_KERNEL_INLINE void BoxFilterRowT(const T* add, const T* sub, double* col, double* prefix,
+                                              T* __restrict dst, int w, int radius, T inv_area, ImageBorder border)
+{
+    if (add) SlideRow(add, sub, col, w);
+    BoxPrefix(col, prefix, w, radius, border);
+    const double* __restrict lo = prefix;
+    const double* __restrict hi = prefix + 2 * radius + 1;
+    for (int x = 0; x < w; ++x)
+    {
+        dst[x] = T(hi[x] - lo[x]) * inv_area;
+    }
+}
+static SAIGA_KERNEL_INLINE void BoxFilterRowF(const float* add, const float* sub, double* col, double* prefix,
+                                              float* dst, int w, int radius, float inv_area, ImageBorder border)
+{
+    BoxFilterRowT(add, sub, col, prefix, dst, w, radius, inv_area, border);
+}
+static SAIGA_KERNEL_INLINE void BoxFilterRowD(const double* add, const double* sub, double* col, double* prefix,
+                                              double* dst, int w, int radius, double inv_area, ImageBorder border)
+{
+    BoxFilterRowT(add, sub, col, prefix, dst, w, radius, inv_area, border);
+}
+static SAIGA_KERNEL_INLINE void AddRow8(const unsigned char* add, uint32_t* col, int w)
+{
+    AddRow(add, col, w);
+}
+static SAIGA_KERNEL_INLINE void AddRowF(const float* add, double* col, int w)
+{
+    AddRow(add, col, w);
+}
+static SAIGA_KERNEL_INLINE void AddRowD(const double* add, double* col, int w)
+{
+    AddRow(add, col, w);
+}
+SAIGA_ROW_KERNEL(BoxFilterRow8,
+                 (const unsigned char* add, const unsigned char* sub, uint32_t* col, uint32_t* prefix,
+                  unsigned char* dst, int w, int radius, float inv_area, ImageBorder border),
+                 (add, sub, col, prefix, dst, w, radius, inv_area, border))
+SAIGA_ROW_KERNEL(BoxFilterRowF,
+                 (const float* add, const float* sub, double* col, double* prefix, float* dst, int w, int radius,
+                  float inv_area, ImageBorder border),
+                 (add, sub, col, prefix, dst, w, radius, inv_area, border))
+SAIGA_ROW_KERNEL(BoxFilterRowD,
+                 (const double* add, const double* sub, double* col, double* prefix, double* dst, int w, int radius,
+                  double inv_area, ImageBorder border),
+                 (add, sub, col, prefix, dst, w, radius, inv_area, border))
+SAIGA_ROW_KERNEL(AddRow8, (const unsigned char* add, uint32_t* col, int w), (add, col, w))
+SAIGA_ROW_KERNEL(AddRowF, (const float* add, double* col, int w), (add, col, w))
+SAIGA_ROW_KERNEL(AddRowD, (const double* add, double* col, int w), (add, col, w))
+
+// rows[j] is the source row y + j - radius. kernel[j] is the weight at distance j.
+// tmp must have space for w + 2 * radius values.
+template <typename T>
+static SAIGA_KERNEL_INLINE void GaussianRowT(const T* const* rows, const T* kernel, int radius, T* tmp,
+                                             T* __restrict dst, int w, ImageBorder border)
+{
+    T* __restrict col = tmp + radius;
+    {
+        const T* __restrict center = rows[radius];
+        for (int x = 0; x < w; ++x) col[x] = kernel[0] * center[x];
+    }
+    for (int j = 1; j <= radius; ++j)
+    {
+        const T* __restrict up   = rows[radius - j];
+        const T* __restrict down = rows[radius + j];
+        T k                      = kernel[j];
+        for (int x = 0; x < w; ++x) col[x] += k * (up[x] + down[x]);
+    }
+
+    for (int i = 0; i < radius; ++i)
+    {
+        int left            = BorderIndex(i - radius, w, border);
+        int right           = BorderIndex(w + i, w, border);
+        tmp[i]              = left < 0 ? T(0) : col[left];
+        tmp[w + radius + i] = right < 0 ? T(0) : col[right];
+    }
+
+    for (int x = 0; x < w; ++x) dst[x] = kernel[0] * col[x];
+    for (int j = 1; j <= radius; ++j)
+    {
+        const T* __restrict left  = col - j;
+        const T* __restrict right = col + j;
+        T k                       = kernel[j];
+        for (int x = 0; x < w; ++x) dst[x] += k * (left[x] + right[x]);
+    }
+}
+static SAIGA_KERNEL_INLINE void GaussianRowF(const float* const* rows, const float* kernel, int radius, float* tmp,
+                                             float* dst, int w, ImageBorder border)
+{
+    GaussianRowT(rows, kernel, radius, tmp, dst, w, border);
+}
+static SAIGA_KERNEL_INLINE void GaussianRowD(const double* const* rows, const double* kernel, int radius,
+                                             double* tmp, double* dst, int w, ImageBorder border)
+{
+    GaussianRowT(rows, kernel, radius, tmp, dst, w, border);
+}
+SAIGA_ROW_KERNEL(GaussianRowF,
+                 (const float* const* rows, const float* kernel, int radius, float* tmp, float* dst, int w,
+                  ImageBorder border),
+                 (rows, kernel, radius, tmp, dst, w, border))
+SAIGA_ROW_KERNEL(GaussianRowD,
+                 (const double* const* rows, const double* kernel, int radius, double* tmp, double* dst, int w,
+                  ImageBorder border),
+                 (rows, kernel, radius, tmp, dst, w, border))
+
+// 8-bit gaussian in 8.8 fixed point. The weights sum up to 256.
+// Horizontal pass: 'padded' is the source row with 'radius' border pixels on each side.
+static SAIGA_KERNEL_INLINE void Gaussian8HorizontalRow(const unsigned char* padded, const uint16_t* weights, int n,
+                                                       uint16_t* __restrict dst, int w)
+{
+    for (int x = 0; x < w; ++x) dst[x] = 0;
+    for (int k = 0; k < n; ++k)
+    {
+        const unsigned char* __restrict p = padded + k;
+        uint16_t wk                       = weights[k];
+        for (int x = 0; x < w; ++x) dst[x] += wk * p[x];
+    }
+}
+// Vertical pass: rows[k] is the horizontally filtered row y + k - radius. The result is rounded.
+static SAIGA_KERNEL_INLINE void Gaussian8VerticalRow(const uint16_t* const* rows, const uint16_t* weights, int n,
+                                                     uint32_t* __restrict acc, unsigned char* __restrict dst, int w)
+{
+    for (int x = 0; x < w; ++x) acc[x] = 1 << 15;
+    for (int k = 0; k < n; ++k)
+    {
+        const uint16_t* __restrict p = rows[k];
+        uint32_t wk                  = weights[k];
+        for (int x = 0; x < w; ++x) acc[x] += wk * p[x];
+    }
+    for (int x = 0; x < w; ++x) dst[x] = acc[x] >> 16;
+}
+SAIGA_ROW_KERNEL(Gaussian8HorizontalRow,
+                 (const unsigned char* padded, const uint16_t* weights, int n, uint16_t* dst, int w),
+                 (padded, weights, n, dst, w))
+SAIGA_ROW_KERNEL(Gaussian8VerticalRow,
+                 (const uint16_t* const* rows, const uint16_t* weights, int n, uint32_t* acc, unsigned char* dst,
+                  int w),
+                 (rows, weights, n, acc, dst, w))
+
+static SAIGA_KERNEL_INLINE int L1DifferenceRow(const unsigned char* __restrict a, const unsigned char* __restrict b,
+                                               int n)
+{
+    int sum = 0;
+    for (int x = 0; x < n; ++x)
+    {
+        sum += std::abs(int(a[x]) - int(b[x]));
+    }
+    return sum;
+}
+static SAIGA_KERNEL_INLINE int SumRow8(const unsigned char* __restrict a, int n)
+{
+    int sum = 0;
+    for (int x = 0; x < n; ++x) sum += a[x];
+    return sum;
+}
+
+// Float reductions with 8 independent partial results. The summation order doesn't depend on the vector width,
+// therefore the result is identical for all backends.
+static constexpr int lanes = 8;
+
+static SAIGA_KERNEL_INLINE double SumRowF(const float* __restrict a, int n)
+{
+    float partial[lanes] = {};
+    int x                = 0;
+    for (; x + lanes <= n; x += lanes)
+    {
+        for (int l = 0; l < lanes; ++l) partial[l] += a[x + l];
+    }
+    double sum = 0;
+    for (int l = 0; l < lanes; ++l) sum += partial[l];
+    for (; x < n; ++x) sum += a[x];
+    return sum;
+}
+
+static SAIGA_KERNEL_INLINE void MinMaxRow(const float* __restrict a, int n, float& min_value, float& max_value)
+{
+    float mn[lanes], mx[lanes];
+    for (int l = 0; l < lanes; ++l)
+    {
+        mn[l] = min_value;
+        mx[l] = max_value;
+    }
+    int x = 0;
+    for (; x + lanes <= n; x += lanes)
+    {
+        for (int l = 0; l < lanes; ++l)
+        {
+            mn[l] = std::min(mn[l], a[x + l]);
+            mx[l] = std::max(mx[l], a[x + l]);
+        }
+    }
+    for (; x < n; ++x)
+    {
+        mn[0] = std::min(mn[0], a[x]);
+        mx[0] = std::max(mx[0], a[x]);
+    }
+    for (int l = 0; l < lanes; ++l)
+    {
+        min_value = std::min(min_value, mn[l]);
+        max_value = std::max(max_value, mx[l]);
+    }
+}
+
+// Reductions over the rows [y_begin, y_end)
+static SAIGA_KERNEL_INLINE void L1DifferenceRows(ImageView<const unsigned char> a, ImageView<const unsigned char> b,
+                                                 int y_begin, int y_end, long& result)
+{
+    for (int y = y_begin; y < y_end; ++y) result += L1DifferenceRow(a.rowPtr(y), b.rowPtr(y), a.w);
+}
+static SAIGA_KERNEL_INLINE void SumRows8(ImageView<const unsigned char> a, int y_begin, int y_end, long& result)
+{
+    for (int y = y_begin; y < y_end; ++y) result += SumRow8(a.rowPtr(y), a.w);
+}
+static SAIGA_KERNEL_INLINE void SumRowsF(ImageView<const float> a, int y_begin, int y_end, double& result)
+{
+    for (int y = y_begin; y < y_end; ++y) result += SumRowF(a.rowPtr(y), a.w);
+}
+static SAIGA_KERNEL_INLINE void MinMaxRows(ImageView<const float> a, int y_begin, int y_end, float& min_value,
+                                           float& max_value)
+{
+    for (int y = y_begin; y < y_end; ++y) MinMaxRow(a.rowPtr(y), a.w, min_value, max_value);
+}
+SAIGA_ROW_KERNEL(L1DifferenceRows,
+                 (ImageView<const unsigned char> a, ImageView<const unsigned char> b, int y_begin, int y_end,
+                  long& result),
+                 (a, b, y_begin, y_end, result))
+SAIGA_ROW_KERNEL(SumRows8, (ImageView<const unsigned char> a, int y_begin, int y_end, long& result),
+                 (a, y_begin, y_end, result))
+SAIGA_ROW_KERNEL(SumRowsF, (ImageView<const float> a, int y_begin, int y_end, double& result),
+                 (a, y_begin, y_end, result))
+SAIGA_ROW_KERNEL(MinMaxRows, (ImageView<const float> a, int y_begin, int y_end, float& min_value, float& max_value),
+                 (a, y_begin, y_end, min_value, max_value))
+
+// ===== Public functions =====
+
+// Applies a row kernel to all rows of src and dst.
+template <typename F>
+static void ForAllRows(int h, int w, F f)
+{
+    ParallelRows(h, w, [&](int y_begin, int y_end) {
+        for (int y = y_begin; y < y_end; ++y) f(y);
+    });
+}
+
+void RGBAToGray8(ImageView<const ucvec4> src, ImageView<unsigned char> dst, ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(src.dimensions() == dst.dimensions());
+    auto row = SAIGA_SELECT_ROW_KERNEL(RGBAToGray8Row, backend);
+    ForAllRows(dst.h, dst.w, [&](int y) { row(src.rowPtr(y)->data(), dst.rowPtr(y), dst.w); });
+}
+
+void RGBToGray8(ImageView<const ucvec3> src, ImageView<unsigned char> dst, ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(src.dimensions() == dst.dimensions());
+    auto row = SAIGA_SELECT_ROW_KERNEL(RGBToGray8Row, backend);
+    ForAllRows(dst.h, dst.w, [&](int y) { row(src.rowPtr(y)->data(), dst.rowPtr(y), dst.w); });
+}
+
+void RGBAToGrayF(ImageView<const ucvec4> src, ImageView<float> dst, float scale, ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(src.dimensions() == dst.dimensions());
+    auto row = SAIGA_SELECT_ROW_KERNEL(RGBAToGrayFRow, backend);
+    ForAllRows(dst.h, dst.w, [&](int y) { row(src.rowPtr(y)->data(), dst.rowPtr(y), dst.w, scale); });
+}
+
+void Gray8ToRGBA(ImageView<const unsigned char> src, ImageView<ucvec4> dst, unsigned char alpha,
+                 ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(src.dimensions() == dst.dimensions());
+    auto row = SAIGA_SELECT_ROW_KERNEL(Gray8ToRGBARow, backend);
+    ForAllRows(dst.h, dst.w, [&](int y) { row(src.rowPtr(y), dst.rowPtr(y)->data(), dst.w, alpha); });
+}
+
+void ScaleDown2(ImageView<const unsigned char> src, ImageView<unsigned char> dst, ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(src.h / 2 == dst.h && src.w / 2 == dst.w);
+    auto row = SAIGA_SELECT_ROW_KERNEL(ScaleDown2Row1, backend);
+    ForAllRows(dst.h, dst.w, [&](int y) { row(src.rowPtr(2 * y), src.rowPtr(2 * y + 1), dst.rowPtr(y), dst.w); });
+}
+
+void ScaleDown2(ImageView<const ucvec4> src, ImageView<ucvec4> dst, ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(src.h / 2 == dst.h && src.w / 2 == dst.w);
+    auto row = SAIGA_SELECT_ROW_KERNEL(ScaleDown2Row4, backend);
+    ForAllRows(dst.h, dst.w, [&](int y) {
+        row(src.rowPtr(2 * y)->data(), src.rowPtr(2 * y + 1)->data(), dst.rowPtr(y)->data(), dst.w);
+    });
+}
+
+void ScaleDown2(ImageView<const float> src, ImageView<float> dst, ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(src.h / 2 == dst.h && src.w / 2 == dst.w);
+    auto row = SAIGA_SELECT_ROW_KERNEL(ScaleDown2FloatRow, backend);
+    ForAllRows(dst.h, dst.w, [&](int y) { row(src.rowPtr(2 * y), src.rowPtr(2 * y + 1), dst.rowPtr(y), dst.w); });
+}
+
+void ScaleDown2Median(ImageView<const float> src, ImageView<float> dst, bool low, ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(src.h / 2 == dst.h && src.w / 2 == dst.w);
+    auto row = SAIGA_SELECT_ROW_KERNEL(ScaleDown2MedianRow, backend);
+    ForAllRows(dst.h, dst.w,
+               [&](int y) { row(src.rowPtr(2 * y), src.rowPtr(2 * y + 1), dst.rowPtr(y), dst.w, low); });
+}
+
+template <typename T, typename S, typename Row>
+static void PyramidDownImpl(ImageView<const T> src, ImageView<T> dst, Row row)
+{
+    SAIGA_ASSERT((src.h + 1) / 2 == dst.h && (src.w + 1) / 2 == dst.w);
+    SAIGA_ASSERT(src.h >= 2 && src.w >= 2);
+    ParallelRows(dst.h, dst.w, [&](int y_begin, int y_end) {
+        std::vector<S> tmp(src.w + 4);
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            const T* rows[5];
+            for (int k = 0; k < 5; ++k) rows[k] = src.rowPtr(BorderIndex(2 * y + k - 2, src.h, ImageBorder::Mirror));
+            row(rows, tmp.data(), dst.rowPtr(y), src.w, dst.w);
+        }
+    });
+}
+
+void PyramidDown(ImageView<const unsigned char> src, ImageView<unsigned char> dst, ImageKernelBackend backend)
+{
+    PyramidDownImpl<unsigned char, int>(src, dst, SAIGA_SELECT_ROW_KERNEL(PyramidDownRow, backend));
+}
+
+void PyramidDown(ImageView<const float> src, ImageView<float> dst, ImageKernelBackend backend)
+{
+    PyramidDownImpl<float, float>(src, dst, SAIGA_SELECT_ROW_KERNEL(PyramidDownRowF, backend));
+}
+
+void GradientX(ImageView<const float> src, ImageView<float> dst, ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(src.dimensions() == dst.dimensions());
+    SAIGA_ASSERT(src.w >= 2);
+    auto row = SAIGA_SELECT_ROW_KERNEL(GradientXRow, backend);
+    ForAllRows(dst.h, dst.w, [&](int y) { row(src.rowPtr(y), dst.rowPtr(y), dst.w); });
+}
+
+void GradientY(ImageView<const float> src, ImageView<float> dst, ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(src.dimensions() == dst.dimensions());
+    SAIGA_ASSERT(src.h >= 2);
+    auto row = SAIGA_SELECT_ROW_KERNEL(DifferenceRow, backend);
+    int h    = src.h;
+    ForAllRows(dst.h, dst.w, [&](int y) {
+        if (y == 0)
+            row(src.rowPtr(0), src.rowPtr(1), dst.rowPtr(y), dst.w, 1.0f);
+        else if (y == h - 1)
+            row(src.rowPtr(h - 2), src.rowPtr(h - 1), dst.rowPtr(y), dst.w, 1.0f);
+        else
+            row(src.rowPtr(y - 1), src.rowPtr(y + 1), dst.rowPtr(y), dst.w, 2.0f);
+    });
+}
+
+void Sobel(ImageView<const unsigned char> src, ImageView<float> dx, ImageView<float> dy, ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(src.dimensions() == dx.dimensions() && src.dimensions() == dy.dimensions());
+    auto row = SAIGA_SELECT_ROW_KERNEL(SobelRow, backend);
+    ParallelRows(src.h, src.w, [&](int y_begin, int y_end) {
+        std::vector<float> tmp(2 * (src.w + 2));
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            row(src.rowPtr(Clamp(y - 1, src.h)), src.rowPtr(y), src.rowPtr(Clamp(y + 1, src.h)), tmp.data(),
+                dx.rowPtr(y), dy.rowPtr(y), src.w);
+        }
+    });
+}
+
+// Running box filter over a contiguous block of rows. The column sums are initialized at the first row of the block
+// with 2 * radius + 1 rows and then updated with one added and one removed row.
+//
+// Each thread processes one block. The blocks are at least 2 * radius + 1 rows high, so the initialization never
+// costs more than the block itself and the time per pixel does not grow with the radius.
+template <typename T, typename S, typename P, typename F, typename Add, typename Row>
+static void BoxFilterImpl(ImageView<const T> src, ImageView<T> dst, int radius, ImageBorder border, Add add_row,
+                          Row row)
+{
+    SAIGA_ASSERT(src.dimensions() == dst.dimensions());
+    SAIGA_ASSERT(radius >= 0);
+    int h      = src.h;
+    int w      = src.w;
+    F inv_area = F(1) / F((2 * radius + 1) * (2 * radius + 1));
+
+    bool parallel = size_t(h) * w >= min_parallel_pixels;
+    int blocks    = parallel ? std::min(OMP::getMaxThreads(), h / std::max(tile_rows, 2 * radius + 1)) : 1;
+    blocks        = std::max(blocks, 1);
+
+#pragma omp parallel for schedule(static) if (blocks > 1)
+    for (int b = 0; b < blocks; ++b)
+    {
+        int y_begin = int(int64_t(h) * b / blocks);
+        int y_end   = int(int64_t(h) * (b + 1) / blocks);
+        if (y_begin == y_end) continue;
+
+        std::vector<S> col(w, S(0));
+        std::vector<P> prefix(w + 2 * radius + 1);
+        std::vector<T> zero(border == ImageBorder::Zero ? w : 0, T(0));
+        auto src_row = [&](int y) {
+            int sy = BorderIndex(y, h, border);
+            return sy < 0 ? zero.data() : src.rowPtr(sy);
+        };
+
+        for (int k = -radius; k <= radius; ++k)
+        {
+            add_row(src_row(y_begin + k), col.data(), w);
+        }
+        row(nullptr, nullptr, col.data(), prefix.data(), dst.rowPtr(y_begin), w, radius, inv_area, border);
+        for (int y = y_begin + 1; y < y_end; ++y)
+        {
+            row(src_row(y + radius), src_row(y - radius - 1), col.data(), prefix.data(), dst.rowPtr(y), w, radius,
+                inv_area, border);
+        }
+    }
+}
+
+void BoxFilter(ImageView<const unsigned char> src, ImageView<unsigned char> dst, int radius, ImageBorder border,
+               ImageKernelBackend backend)
+{
+    BoxFilterImpl<unsigned char, uint32_t, uint32_t, float>(src, dst, radius, border,
+                                                            SAIGA_SELECT_ROW_KERNEL(AddRow8, backend),
+                                                            SAIGA_SELECT_ROW_KERNEL(BoxFilterRow8, backend));
+}
+
+void BoxFilter(ImageView<const float> src, ImageView<float> dst, int radius, ImageBorder border,
+               ImageKernelBackend backend)
+{
+    BoxFilterImpl<float, double, double, float>(src, dst, radius, border, SAIGA_SELECT_ROW_KERNEL(AddRowF, backend),
+                                                SAIGA_SELECT_ROW_KERNEL(BoxFilterRowF, backend));
+}
+
+void BoxFilter(ImageView<const double> src, ImageView<double> dst, int radius, ImageBorder border,
+               ImageKernelBackend backend)
+{
+    BoxFilterImpl<double, double, double, double>(src, dst, radius, border,
+                                                  SAIGA_SELECT_ROW_KERNEL(AddRowD, backend),
+                                                  SAIGA_SELECT_ROW_KERNEL(BoxFilterRowD, backend));
+}
+
+template <typename T, typename Row>
+static void GaussianBlurImpl(ImageView<const T> src, ImageView<T> dst, int radius, T sigma, ImageBorder border,
+                             Row row)
+{
+    SAIGA_ASSERT(src.dimensions() == dst.dimensions());
+    SAIGA_ASSERT(radius >= 0);
+    int h = src.h;
+    int w = src.w;
+
+    // Normalized half kernel
+    std::vector<T> kernel(radius + 1);
+    T sum = 0;
+    for (int j = 0; j <= radius; ++j)
+    {
+        kernel[j] = std::exp(-T(j * j) / (T(2) * sigma * sigma));
+        sum += j == 0 ? kernel[j] : 2 * kernel[j];
+    }
+    for (auto& k : kernel) k /= sum;
+
+    ParallelRows(h, w, [&](int y_begin, int y_end) {
+        std::vector<T> tmp(w + 2 * radius);
+        std::vector<T> zero(border == ImageBorder::Zero ? w : 0, T(0));
+        std::vector<const T*> rows(2 * radius + 1);
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            for (int k = 0; k <= 2 * radius; ++k)
+            {
+                int sy  = BorderIndex(y + k - radius, h, border);
+                rows[k] = sy < 0 ? zero.data() : src.rowPtr(sy);
+            }
+            row(rows.data(), kernel.data(), radius, tmp.data(), dst.rowPtr(y), w, border);
+        }
+    });
+}
+
+void GaussianBlur(ImageView<const float> src, ImageView<float> dst, int radius, float sigma, ImageBorder border,
+                  ImageKernelBackend backend)
+{
+    GaussianBlurImpl(src, dst, radius, sigma, border, SAIGA_SELECT_ROW_KERNEL(GaussianRowF, backend));
+}
+
+void GaussianBlur(ImageView<const double> src, ImageView<double> dst, int radius, double sigma, ImageBorder border,
+                  ImageKernelBackend backend)
+{
+    GaussianBlurImpl(src, dst, radius, sigma, border, SAIGA_SELECT_ROW_KERNEL(GaussianRowD, backend));
+}
+
+void GaussianBlur(ImageView<const unsigned char> src, ImageView<unsigned char> dst, int radius, float sigma,
+                  ImageBorder border, ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(src.dimensions() == dst.dimensions());
+    SAIGA_ASSERT(radius >= 0);
+    int h = src.h;
+    int w = src.w;
+    int n = 2 * radius + 1;
+
+    // 8 bit fixed point weights with an exact sum of 256
+    std::vector<uint16_t> weights(n);
+    {
+        std::vector<double> g(n);
+        double sum = 0;
+        for (int k = 0; k < n; ++k)
+        {
+            double d = k - radius;
+            g[k]     = std::exp(-d * d / (2.0 * sigma * sigma));
+            sum += g[k];
+        }
+        int isum = 0;
+        for (int k = 0; k < n; ++k)
+        {
+            weights[k] = iRound(g[k] / sum * 256.0);
+            isum += weights[k];
+        }
+        weights[radius] += 256 - isum;
+    }
+
+    auto horizontal = SAIGA_SELECT_ROW_KERNEL(Gaussian8HorizontalRow, backend);
+    auto vertical   = SAIGA_SELECT_ROW_KERNEL(Gaussian8VerticalRow, backend);
+    ParallelRows(h, w, [&](int y_begin, int y_end) {
+        // The horizontally filtered rows are cached in a ring buffer of n rows. Row r is stored in slot r % n.
+        // The different rows required for one output row are always distinct modulo n, also at the border.
+        std::vector<uint16_t> rows(n * w);
+        std::vector<int> row_ids(n, -1);
+        std::vector<unsigned char> padded(w + 2 * radius);
+        std::vector<uint16_t> zero(border == ImageBorder::Zero ? w : 0, 0);
+        std::vector<uint32_t> acc(w);
+        std::vector<const uint16_t*> window(n);
+
+        auto filter_row = [&](int r) -> const uint16_t* {
+            uint16_t* out = rows.data() + (r % n) * w;
+            if (row_ids[r % n] == r) return out;
+            row_ids[r % n] = r;
+
+            const unsigned char* in = src.rowPtr(r);
+            std::copy(in, in + w, padded.data() + radius);
+            for (int x = 0; x < radius; ++x)
+            {
+                int left               = BorderIndex(x - radius, w, border);
+                int right              = BorderIndex(w + x, w, border);
+                padded[x]              = left < 0 ? 0 : in[left];
+                padded[radius + w + x] = right < 0 ? 0 : in[right];
+            }
+            horizontal(padded.data(), weights.data(), n, out, w);
+            return out;
+        };
+
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            for (int k = 0; k < n; ++k)
+            {
+                int r     = BorderIndex(y + k - radius, h, border);
+                window[k] = r < 0 ? zero.data() : filter_row(r);
+            }
+            vertical(window.data(), weights.data(), n, acc.data(), dst.rowPtr(y), w);
+        }
+    });
+}
+
+// Sums up the partial results of all tiles in a fixed order.
+template <typename T, typename F>
+static T ReduceRows(int h, int w, F f)
+{
+    std::vector<T> partial(iDivUp(h, tile_rows), T(0));
+    ParallelRows(h, w, [&](int y_begin, int y_end) { f(y_begin, y_end, partial[y_begin / tile_rows]); });
+    T sum = 0;
+    for (auto p : partial) sum += p;
+    return sum;
+}
+
+long L1Difference(ImageView<const unsigned char> img1, ImageView<const unsigned char> img2,
+                  ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(img1.dimensions() == img2.dimensions());
+    auto rows = SAIGA_SELECT_ROW_KERNEL(L1DifferenceRows, backend);
+    return ReduceRows<long>(img1.h, img1.w,
+                            [&](int y_begin, int y_end, long& result) { rows(img1, img2, y_begin, y_end, result); });
+}
+
+long L1Difference(ImageView<const ucvec3> img1, ImageView<const ucvec3> img2, ImageKernelBackend backend)
+{
+    SAIGA_ASSERT(img1.dimensions() == img2.dimensions());
+    // The channels are treated as individual pixels of a 3 times wider image.
+    ImageView<const unsigned char> a(img1.h, img1.w * 3, img1.pitchBytes, img1.data);
+    ImageView<const unsigned char> b(img2.h, img2.w * 3, img2.pitchBytes, img2.data);
+    return L1Difference(a, b, backend);
+}
+
+long Sum(ImageView<const unsigned char> img, ImageKernelBackend backend)
+{
+    auto rows = SAIGA_SELECT_ROW_KERNEL(SumRows8, backend);
+    return ReduceRows<long>(img.h, img.w,
+                            [&](int y_begin, int y_end, long& result) { rows(img, y_begin, y_end, result); });
+}
+
+double Sum(ImageView<const float> img, ImageKernelBackend backend)
+{
+    auto rows = SAIGA_SELECT_ROW_KERNEL(SumRowsF, backend);
+    return ReduceRows<double>(img.h, img.w,
+                              [&](int y_begin, int y_end, double& result) { rows(img, y_begin, y_end, result); });
+}
+
+void MinMax(ImageView<const float> img, float& min_value, float& max_value, ImageKernelBackend backend)
+{
+    auto rows  = SAIGA_SELECT_ROW_KERNEL(MinMaxRows, backend);
+    int tiles  = iDivUp(img.h, tile_rows);
+    std::vector<float> mins(tiles, std::numeric_limits<float>::max());
+    std::vector<float> maxs(tiles, std::numeric_limits<float>::lowest());
+    ParallelRows(img.h, img.w, [&](int y_begin, int y_end) {
+        int t = y_begin / tile_rows;
+        rows(img, y_begin, y_end, mins[t], maxs[t]);
+    });
+    min_value = std::numeric_limits<float>::max();
+    max_value = std::numeric_limits<float>::lowest();
+    for (int t = 0; t < tiles; ++t)
+    {
+        min_value = std::min(min_value, mins[t]);
+        max_value = std::max(max_value, maxs[t]);
+    }
+}
+
+}  // namespace ImageKernel
+}  // namespace Saiga
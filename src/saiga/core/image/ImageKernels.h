@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/core/math/math.h"
+
+#include "imageView.h"
+
+
+namespace Saiga
+{
+/**
+ * Vectorized and multi-threaded image kernels.
+ *
+ * All kernels are implemented as loops over single rows, which are written so that the compiler can vectorize
+ * them. The rows are processed in tiles of 16 rows in parallel with OpenMP (only for images with more than 64k
+ * pixels).
+ *
+ * Generic:  Compiled for the target of the library (SSE2 on x86-64, NEON on ARM64).
+ * AVX2:     The same row kernels compiled with the AVX2 target attribute. Selected at runtime.
+ *
+ * All backends compute identical results.
+ * If not noted otherwise, the kernels read outside of the image with clampedRead (replicate the border pixel). The
+ * box and gaussian filters take the border mode as a parameter.
+ * src and dst must not overlap.
+ */
+enum class ImageKernelBackend
+{
+    Generic,
+    AVX2
+};
+
+SAIGA_CORE_API bool ImageKernelBackendSupported(ImageKernelBackend backend);
+
+// The fastest backend of this CPU
+SAIGA_CORE_API ImageKernelBackend BestImageKernelBackend();
+
+SAIGA_CORE_API const char* ImageKernelBackendName(ImageKernelBackend backend);
+
+/**
+ * How the filters read pixels outside of the image.
+ */
+enum class ImageBorder
+{
+    // Replicate the edge pixel (ImageView::clampedRead)
+    Clamp,
+    // Reflect at the edge pixel without repeating it (ImageView::mirrorToEdge, cv::BORDER_REFLECT_101)
+    Mirror,
+    // Outside pixels are zero. The valid-count filters treat them as invalid.
+    Zero
+};
+
+// The pixel index that is read for index i in an image of size n. Returns -1 for outside pixels with
+// ImageBorder::Zero.
+inline int BorderIndex(int i, int n, ImageBorder border)
+{
+    if (i >= 0 && i < n) return i;
+    switch (border)
+    {
+        case ImageBorder::Clamp:
+            return i < 0 ? 0 : n - 1;
+        case ImageBorder::Mirror:
+            if (n == 1) return 0;
+            // mirrorToEdge reflects only once. Repeat it for windows that are larger than the image.
+            while (i < 0 || i >= n) i = i < 0 ? -i : 2 * (n - 1) - i;
+            return i;
+        default:
+            return -1;
+    }
+}
+
+
+namespace ImageKernel
+{
+// ===== Color conversion =====
+
+// Same results as ImageTransformation::RGBAToGray8
+SAIGA_CORE_API void RGBAToGray8(ImageView<const ucvec4> src, ImageView<unsigned char> dst,
+                                ImageKernelBackend backend = BestImageKernelBackend());
+SAIGA_CORE_API void RGBToGray8(ImageView<const ucvec3> src, ImageView<unsigned char> dst,
+                               ImageKernelBackend backend = BestImageKernelBackend());
+// Same results as ImageTransformation::RGBAToGrayF
+SAIGA_CORE_API void RGBAToGrayF(ImageView<const ucvec4> src, ImageView<float> dst, float scale = 1.0f,
+                                ImageKernelBackend backend = BestImageKernelBackend());
+SAIGA_CORE_API void Gray8ToRGBA(ImageView<const unsigned char> src, ImageView<ucvec4> dst, unsigned char alpha = 255,
+                                ImageKernelBackend backend = BestImageKernelBackend());
+
+
+// ===== Resize and pyramids =====
+
+// 2x2 average. dst must have the size (h/2, w/2). The 8-bit versions truncate like ImageTransformation::ScaleDown2.
+SAIGA_CORE_API void ScaleDown2(ImageView<const unsigned char> src, ImageView<unsigned char> dst,
+                               ImageKernelBackend backend = BestImageKernelBackend());
+SAIGA_CORE_API void ScaleDown2(ImageView<const ucvec4> src, ImageView<ucvec4> dst,
+                               ImageKernelBackend backend = BestImageKernelBackend());
+SAIGA_CORE_API void ScaleDown2(ImageView<const float> src, ImageView<float> dst,
+                               ImageKernelBackend backend = BestImageKernelBackend());
+
+// Median of each 2x2 block. Same results as ImageView::copyToScaleDownMedian.
+// low = true selects the second smallest and low = false the third smallest value.
+SAIGA_CORE_API void ScaleDown2Median(ImageView<const float> src, ImageView<float> dst, bool low = true,
+                                     ImageKernelBackend backend = BestImageKernelBackend());
+
+// Gaussian [1 4 6 4 1] x [1 4 6 4 1] / 256 smoothing followed by removing every second row and column
+// (cv::pyrDown). dst must have the size ((h+1)/2, (w+1)/2). Uses BORDER_REFLECT_101, src must be at least 2x2.
+SAIGA_CORE_API void PyramidDown(ImageView<const unsigned char> src, ImageView<unsigned char> dst,
+                                ImageKernelBackend backend = BestImageKernelBackend());
+SAIGA_CORE_API void PyramidDown(ImageView<const float> src, ImageView<float> dst,
+                                ImageKernelBackend backend = BestImageKernelBackend());
+
+
+// ===== Gradients =====
+
+// Same results as ImageView::gx and ImageView::gy (central differences, one sided at the border).
+SAIGA_CORE_API void GradientX(ImageView<const float> src, ImageView<float> dst,
+                              ImageKernelBackend backend = BestImageKernelBackend());
+SAIGA_CORE_API void GradientY(ImageView<const float> src, ImageView<float> dst,
+                              ImageKernelBackend backend = BestImageKernelBackend());
+
+// 3x3 Sobel filter (not normalized).
+SAIGA_CORE_API void Sobel(ImageView<const unsigned char> src, ImageView<float> dx, ImageView<float> dy,
+                          ImageKernelBackend backend = BestImageKernelBackend());
+
+
+// ===== Filters =====
+// ImageConvolution::Gaussian and ImageTransformation::GaussianBlur forward to these functions.
+
+// Mean of the (2 * radius + 1)^2 window, computed with running sums. The cost is O(w * h + radius * (w + h)), so it
+// only grows with the radius through the border rows and columns.
+// The 8-bit version is rounded to the nearest integer.
+SAIGA_CORE_API void BoxFilter(ImageView<const unsigned char> src, ImageView<unsigned char> dst, int radius,
+                              ImageBorder border         = ImageBorder::Clamp,
+                              ImageKernelBackend backend = BestImageKernelBackend());
+SAIGA_CORE_API void BoxFilter(ImageView<const float> src, ImageView<float> dst, int radius,
+                              ImageBorder border         = ImageBorder::Clamp,
+                              ImageKernelBackend backend = BestImageKernelBackend());
+SAIGA_CORE_API void BoxFilter(ImageView<const double> src, ImageView<double> dst, int radius,
+                              ImageBorder border         = ImageBorder::Clamp,
+                              ImageKernelBackend backend = BestImageKernelBackend());
+
+// Separable normalized gaussian filter with a (2 * radius + 1)^2 kernel.
+// The 8-bit version is computed in 8.8 fixed point and matches cv::GaussianBlur up to +-1.
+SAIGA_CORE_API void GaussianBlur(ImageView<const unsigned char> src, ImageView<unsigned char> dst, int radius,
+                                 float sigma, ImageBorder border = ImageBorder::Clamp,
+                                 ImageKernelBackend backend = BestImageKernelBackend());
+SAIGA_CORE_API void GaussianBlur(ImageView<const float> src, ImageView<float> dst, int radius, float sigma,
+                                 ImageBorder border         = ImageBorder::Clamp,
+                                 ImageKernelBackend backend = BestImageKernelBackend());
+SAIGA_CORE_API void GaussianBlur(ImageView<const double> src, ImageView<double> dst, int radius, double sigma,
+                                 ImageBorder border         = ImageBorder::Clamp,
+                                 ImageKernelBackend backend = BestImageKernelBackend());
+
+
+// ===== Reductions =====
+
+// Same results as ImageTransformation::L1Difference
+SAIGA_CORE_API long L1Difference(ImageView<const unsigned char> img1, ImageView<const unsigned char> img2,
+                                 ImageKernelBackend backend = BestImageKernelBackend());
+SAIGA_CORE_API long L1Difference(ImageView<const ucvec3> img1, ImageView<const ucvec3> img2,
+                                 ImageKernelBackend backend = BestImageKernelBackend());
+
+SAIGA_CORE_API long Sum(ImageView<const unsigned char> img, ImageKernelBackend backend = BestImageKernelBackend());
+// The rows are summed up in float, the row sums in double.
+SAIGA_CORE_API double Sum(ImageView<const float> img, ImageKernelBackend backend = BestImageKernelBackend());
+SAIGA_CORE_API void MinMax(ImageView<const float> img, float& min_value, float& max_value,
+                           ImageKernelBackend backend = BestImageKernelBackend());
+
+}  // namespace ImageKernel
+}  // namespace Saiga
@@ -11,8 +11,11 @@
 
 #include "internal/noGraphicsAPI.h"
 
+#include "ImageKernels.h"
 #include "templatedImage.h"
 
+#include <cstring>
+
 namespace Saiga
 {
 namespace ImageTransformation
@@ -97,53 +100,19 @@ void depthToRGBA_HSV(ImageView<const float> src, ImageView<ucvec4> dst, float mi
 }
 
 
-
-// const vec3 rgbToGray(0.2126f, 0.7152f, 0.0722f);
-const vec3 rgbToGray(0.299f, 0.587f, 0.114f);  // opencv values
-
-struct RGBATOGRAY8Trans
-{
-    unsigned char operator()(const ucvec4& v)
-    {
-        vec3 vf(v[0], v[1], v[2]);
-        float gray = dot(rgbToGray, vf);
-        return gray;
-    }
-};
-
 void RGBAToGray8(ImageView<const ucvec4> src, ImageView<unsigned char> dst)
 {
-    src.copyToTransform(dst, RGBATOGRAY8Trans());
+    ImageKernel::RGBAToGray8(src, dst);
 }
 
-
-
-struct RGBATOGRAYFTrans
-{
-    float scale;
-    RGBATOGRAYFTrans(float scale) : scale(scale) {}
-    float operator()(const ucvec4& v)
-    {
-        vec3 vf(v[0], v[1], v[2]);
-        float gray = dot(rgbToGray, vf);
-        return gray * scale;
-    }
-};
 void RGBAToGrayF(ImageView<const ucvec4> src, ImageView<float> dst, float scale)
 {
-    src.copyToTransform(dst, RGBATOGRAYFTrans(scale));
+    ImageKernel::RGBAToGrayF(src, dst, scale);
 }
 
-struct Gray8ToRGBATrans
-{
-    unsigned char alpha;
-    Gray8ToRGBATrans(unsigned char alpha) : alpha(alpha) {}
-    ucvec4 operator()(const unsigned char& v) { return ucvec4(v, v, v, alpha); }
-};
-
 void Gray8ToRGBA(ImageView<unsigned char> src, ImageView<ucvec4> dst, unsigned char alpha)
 {
-    src.copyToTransform(dst, Gray8ToRGBATrans(alpha));
+    ImageKernel::Gray8ToRGBA(src, dst, alpha);
 }
 struct Gray8ToRGBTrans
 {
@@ -220,19 +189,113 @@ bool save(const std::string& path, ImageView<float> img, float vmin, float vmax)
 
 void ScaleDown2(ImageView<const ucvec4> src, ImageView<ucvec4> dst)
 {
-    for (int i : dst.rowRange())
+    ImageKernel::ScaleDown2(src.subImageView(0, 0, 2 * dst.h, 2 * dst.w), dst);
+}
+
+void FillBorderReflect101(ImageView<unsigned char> img, int border)
+{
+    int inner_h = img.h - 2 * border;
+    int inner_w = img.w - 2 * border;
+    SAIGA_ASSERT(border >= 0 && inner_h > 0 && inner_w > 0);
+    if (border == 0) return;
+    auto reflect = [](int i, int n) { return BorderIndex(i, n, ImageBorder::Mirror); };
+
+    for (int y = border; y < border + inner_h; ++y)
+    {
+        unsigned char* row = img.rowPtr(y);
+        for (int x = 0; x < border; ++x)
+        {
+            row[x]                    = row[border + reflect(x - border, inner_w)];
+            row[border + inner_w + x] = row[border + reflect(inner_w + x, inner_w)];
+        }
+    }
+
+    for (int y = 0; y < border; ++y)
+    {
+        memcpy(img.rowPtr(y), img.rowPtr(border + reflect(y - border, inner_h)), img.w);
+        memcpy(img.rowPtr(border + inner_h + y), img.rowPtr(border + reflect(inner_h + y, inner_h)), img.w);
+    }
+}
+
+void GaussianBlur(ImageView<const unsigned char> src, ImageView<unsigned char> dst, int radius, float sigma)
+{
+    ImageKernel::GaussianBlur(src, dst, radius, sigma, ImageBorder::Mirror);
+}
+
+void ResizeLinear(ImageView<const unsigned char> src, ImageView<unsigned char> dst)
+{
+    // 11 bit fixed point weights (same as cv::INTER_LINEAR)
+    constexpr int bits = 11;
+    constexpr int one  = 1 << bits;
+
+    auto compute_offsets = [](int src_size, int dst_size, std::vector<int>& offset, std::vector<int>& alpha) {
+        double scale = double(src_size) / dst_size;
+        offset.resize(dst_size);
+        alpha.resize(dst_size);
+        for (int i = 0; i < dst_size; ++i)
+        {
+            double f = (i + 0.5) * scale - 0.5;
+            int s    = int(std::floor(f));
+            f -= s;
+            if (s < 0)
+            {
+                s = 0;
+                f = 0;
+            }
+            if (s >= src_size - 1)
+            {
+                s = src_size - 1;
+                f = 0;
+            }
+            offset[i] = s;
+            alpha[i]  = iRound(f * one);
+        }
+    };
+
+    std::vector<int> xofs, xalpha, yofs, yalpha;
+    compute_offsets(src.w, dst.w, xofs, xalpha);
+    compute_offsets(src.h, dst.h, yofs, yalpha);
+
+    // Horizontally interpolated source rows. Two slots, tagged with the source row index.
+    int w = dst.w;
+    std::vector<int> rows(2 * w);
+    int row_ids[2] = {-1, -1};
+
+    auto filter_row = [&](int r) -> const int* {
+        int* out = rows.data() + (r & 1) * w;
+        if (row_ids[r & 1] == r) return out;
+        row_ids[r & 1] = r;
+
+        const unsigned char* in = src.rowPtr(r);
+        for (int x = 0; x < w; ++x)
+        {
+            int s  = xofs[x];
+            int a  = xalpha[x];
+            int s1 = std::min(s + 1, src.w - 1);
+            out[x] = in[s] * (one - a) + in[s1] * a;
+        }
+        return out;
+    };
+
+    for (int y = 0; y < dst.h; ++y)
     {
-        for (int j : dst.colRange())
+        int s  = yofs[y];
+        int b  = yalpha[y];
+        int s1 = std::min(s + 1, src.h - 1);
+
+        const int* r0 = filter_row(s);
+        const int* r1 = filter_row(s1);
+        if (s1 == s) r1 = r0;
+
+        unsigned char* out = dst.rowPtr(y);
+        int b0             = one - b;
+        for (int x = 0; x < w; ++x)
         {
-            int i_src = i * 2;
-            int j_src = j * 2;
-            ivec4 sum = src(i_src, j_src).cast<int>() + src(i_src + 1, j_src).cast<int>() +
-                        src(i_src, j_src + 1).cast<int>() + src(i_src + 1, j_src + 1).cast<int>();
-            sum /= 4;
-            dst(i, j) = sum.cast<unsigned char>();
+            out[x] = (r0[x] * b0 + r1[x] * b + (1 << (2 * bits - 1))) >> (2 * bits);
         }
     }
 }
+
 TemplatedImage<unsigned char> AbsolutePixelError(ImageView<const ucvec3> img1, ImageView<const ucvec3> img2)
 {
     TemplatedImage<unsigned char> result(img1.dimensions());
@@ -317,29 +380,11 @@ TemplatedImage<ucvec3> ColorizeTurbo(ImageView<float> img)
 
 long L1Difference(ImageView<const ucvec3> img1, ImageView<const ucvec3> img2)
 {
-    long result = 0;
-    for (int i : img1.rowRange())
-    {
-        for (int j : img1.colRange())
-        {
-            long diff = (img1(i, j).cast<int>() - img2(i, j).cast<int>()).array().abs().sum();
-            result += diff;
-        }
-    }
-    return result;
+    return ImageKernel::L1Difference(img1, img2);
 }
 long L1Difference(ImageView<const unsigned char> img1, ImageView<const unsigned char> img2)
 {
-    long result = 0;
-    for (int i : img1.rowRange())
-    {
-        for (int j : img1.colRange())
-        {
-            long diff = std::abs(img1(i, j) - img2(i, j));
-            result += diff;
-        }
-    }
-    return result;
+    return ImageKernel::L1Difference(img1, img2);
 }
 
 }  // namespace ImageTransformation
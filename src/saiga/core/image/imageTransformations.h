@@ -37,6 +37,19 @@ SAIGA_CORE_API void ScaleDown2(ImageView<const ucvec4> src, ImageView<ucvec4> ds
 
 
 SAIGA_CORE_API float sharpness(ImageView<const unsigned char> src);
+
+// Fills the outer 'border' pixels of the image by reflecting the inner part (cv::BORDER_REFLECT_101).
+// Usage: Write the image to img.subImageView(border, border, h - 2 * border, w - 2 * border) and call this function.
+SAIGA_CORE_API void FillBorderReflect101(ImageView<unsigned char> img, int border);
+
+// Separable gaussian filter with a (2 * radius + 1)^2 kernel and BORDER_REFLECT_101.
+// Same as ImageKernel::GaussianBlur with ImageBorder::Mirror. Matches cv::GaussianBlur up to +-1.
+// src and dst must not overlap.
+SAIGA_CORE_API void GaussianBlur(ImageView<const unsigned char> src, ImageView<unsigned char> dst, int radius,
+                                 float sigma);
+
+// Bilinear resize to the size of dst with the pixel center mapping of cv::INTER_LINEAR.
+SAIGA_CORE_API void ResizeLinear(ImageView<const unsigned char> src, ImageView<unsigned char> dst);
 /**
  * Converts a floating point image to a 8-bit image and saves it.
  * Useful for debugging.
@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+#include "saiga/core/util/assert.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+
+namespace Saiga
+{
+/**
+ * A vector which stores its elements in fixed size chunks of 2^LogChunkSize elements.
+ *
+ * In contrast to std::vector, growing never moves existing elements. Pointers and references stay valid until the
+ * element is removed by resize(). grow_to_at_least() is thread safe and may run concurrently to element access of
+ * other threads.
+ *
+ * The chunk directory has a fixed size, which limits the number of elements to MaxChunks * 2^LogChunkSize.
+ *
+ * Usage:
+ *
+ * ChunkedVector<int> v(100);
+ * int* p = &v[5];
+ * v.grow_to_at_least(100000);
+ * // p is still valid
+ */
+template <typename T, int LogChunkSize = 9, int MaxChunks = 8192>
+class SAIGA_TEMPLATE ChunkedVector
+{
+   public:
+    static constexpr size_t chunk_size = size_t(1) << LogChunkSize;
+    static constexpr size_t chunk_mask = chunk_size - 1;
+    static constexpr size_t max_size   = chunk_size * MaxChunks;
+
+    ChunkedVector(size_t n = 0) { resize(n); }
+    ChunkedVector(const ChunkedVector& other) { *this = other; }
+    ~ChunkedVector() { FreeChunks(0); }
+
+    ChunkedVector& operator=(const ChunkedVector& other)
+    {
+        if (this == &other) return *this;
+        resize(other.size());
+        for (size_t i = 0; i < other.size(); ++i)
+        {
+            (*this)[i] = other[i];
+        }
+        return *this;
+    }
+
+    T& operator[](size_t i)
+    {
+        SAIGA_DEBUG_ASSERT(i < size());
+        return chunks[i >> LogChunkSize].load(std::memory_order_acquire)[i & chunk_mask];
+    }
+
+    const T& operator[](size_t i) const
+    {
+        SAIGA_DEBUG_ASSERT(i < size());
+        return chunks[i >> LogChunkSize].load(std::memory_order_acquire)[i & chunk_mask];
+    }
+
+    T& front() { return (*this)[0]; }
+    const T& front() const { return (*this)[0]; }
+
+    size_t size() const { return _size.load(std::memory_order_acquire); }
+    size_t capacity() const { return num_chunks * chunk_size; }
+    bool empty() const { return size() == 0; }
+
+    // Not thread safe.
+    // New elements are value initialized. Chunks which are not required anymore are freed.
+    void resize(size_t n)
+    {
+        SAIGA_ASSERT(n <= max_size);
+        size_t old_size = size();
+
+        // Reset the removed elements of the last chunk, so they are value initialized after growing again.
+        size_t reset_end = std::min(old_size, iDivUpChunk(n) * chunk_size);
+        for (size_t i = n; i < reset_end; ++i)
+        {
+            (*this)[i] = T();
+        }
+
+        FreeChunks(iDivUpChunk(n));
+        AllocateChunks(iDivUpChunk(n));
+        _size.store(n, std::memory_order_release);
+    }
+
+    // Thread safe.
+    // Increases the size to at least n. Returns immediately if the vector is already large enough.
+    void grow_to_at_least(size_t n)
+    {
+        if (n <= size()) return;
+
+        std::unique_lock lock(grow_mutex);
+        if (n <= size()) return;
+        SAIGA_ASSERT(n <= max_size);
+        AllocateChunks(iDivUpChunk(n));
+        _size.store(n, std::memory_order_release);
+    }
+
+    size_t Memory() const { return capacity() * sizeof(T) + sizeof(*this); }
+
+   private:
+    std::array<std::atomic<T*>, MaxChunks> chunks = {};
+    size_t num_chunks                             = 0;
+    std::atomic<size_t> _size                     = 0;
+    std::mutex grow_mutex;
+
+    static size_t iDivUpChunk(size_t n) { return (n + chunk_mask) >> LogChunkSize; }
+
+    void AllocateChunks(size_t n)
+    {
+        for (; num_chunks < n; ++num_chunks)
+        {
+            chunks[num_chunks].store(new T[chunk_size](), std::memory_order_release);
+        }
+    }
+
+    void FreeChunks(size_t keep)
+    {
+        for (; num_chunks > keep; --num_chunks)
+        {
+            delete[] chunks[num_chunks - 1].exchange(nullptr);
+        }
+    }
+};
+
+}  // namespace Saiga
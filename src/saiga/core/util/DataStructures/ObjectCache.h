@@ -10,7 +10,14 @@
 #include "saiga/core/util/assert.h"
 #include "saiga/core/util/fileChecker.h"
 
-#include <tuple>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 namespace Saiga
@@ -24,48 +31,219 @@ SAIGA_CORE_API inline bool operator==(const NoParams&, const NoParams&)
     return true;
 }
 
+struct ObjectCacheStats
+{
+    size_t hits      = 0;
+    size_t misses    = 0;
+    size_t evictions = 0;
+    size_t entries   = 0;
+    size_t bytes     = 0;
+};
 
-template <typename KeyType, typename DataType, typename ParamType = NoParams>
+/**
+ * A thread safe key-value cache with LRU eviction.
+ *
+ * An object is identified by (key, params). Only the key is hashed, the params are compared with operator== to
+ * distinguish objects with the same key. Therefore ParamType does not require a hash function.
+ *
+ * The entries are distributed over 'num_shards' shards by the hash of the key. Each shard has its own mutex, LRU list
+ * and an equal part of the memory budget. If a put() exceeds the budget of the shard, the least recently used entries
+ * of this shard are evicted. The size of an entry is computed by the size function (default: sizeof(DataType)).
+ *
+ * The default budget is unlimited, so nothing is evicted unless a budget is given.
+ *
+ * Usage:
+ *
+ * ObjectCache<std::string, std::shared_ptr<Image>> cache(512 * 1000 * 1000,
+ *                                                        [](auto& img) { return img->size(); });
+ * std::shared_ptr<Image> img;
+ * if (!cache.get(file, img))
+ * {
+ *     img = std::make_shared<Image>(file);
+ *     cache.put(file, img);
+ * }
+ */
+template <typename KeyType, typename DataType, typename ParamType = NoParams, typename Hash = std::hash<KeyType>>
 class ObjectCache
 {
    public:
-    using InternalType = std::tuple<KeyType, ParamType, DataType>;
-    std::vector<InternalType> objects;
+    using SizeFunction = std::function<size_t(const DataType&)>;
 
-   public:
+    ObjectCache(size_t max_bytes = std::numeric_limits<size_t>::max(), SizeFunction size_function = SizeFunction(),
+                int num_shards = 16)
+        : size_function(size_function), max_bytes_per_shard(max_bytes / num_shards), shards(num_shards)
+    {
+        SAIGA_ASSERT(num_shards > 0);
+        for (auto& s : shards) s = std::make_unique<Shard>();
+    }
     virtual ~ObjectCache() { clear(); }
-    void clear() { objects.clear(); }
 
+    void clear()
+    {
+        for (auto& s : shards)
+        {
+            std::unique_lock lock(s->mutex);
+            s->lru.clear();
+            s->map.clear();
+            s->bytes = 0;
+        }
+    }
 
+    /**
+     * Inserts the object. An existing object with the same key and params is replaced.
+     * The new object is the most recently used object.
+     */
     void put(const KeyType& key, const DataType& obj, const ParamType& params = ParamType())
     {
-        SAIGA_ASSERT(!exists(key, params));
-        objects.emplace_back(key, params, obj);
+        size_t bytes = size_function ? size_function(obj) : sizeof(DataType);
+        auto& s      = shard(key);
+        std::unique_lock lock(s.mutex);
+
+        auto& bucket = s.map[key];
+        auto it      = find(bucket, params);
+        if (it != bucket.end())
+        {
+            s.bytes -= (*it)->bytes;
+            s.lru.erase(*it);
+            bucket.erase(it);
+        }
+        s.lru.push_front({key, params, obj, bytes});
+        bucket.push_back(s.lru.begin());
+        s.bytes += bytes;
+
+        // Evict from the back, but always keep the new object.
+        while (s.bytes > max_bytes_per_shard && s.lru.size() > 1)
+        {
+            auto& victim         = s.lru.back();
+            auto& victim_bucket  = s.map[victim.key];
+            auto victim_position = find(victim_bucket, victim.params);
+            SAIGA_ASSERT(victim_position != victim_bucket.end());
+            victim_bucket.erase(victim_position);
+            if (victim_bucket.empty()) s.map.erase(victim.key);
+
+            s.bytes -= victim.bytes;
+            s.lru.pop_back();
+            evictions++;
+        }
     }
 
+    /**
+     * Returns true and copies the object to 'obj' if it is in the cache.
+     * The object becomes the most recently used object.
+     */
     bool get(const KeyType& key, DataType& obj, const ParamType& params = ParamType())
     {
-        for (auto& data : objects)
+        auto& s = shard(key);
+        std::unique_lock lock(s.mutex);
+        auto bucket = s.map.find(key);
+        if (bucket != s.map.end())
         {
-            if (std::get<0>(data) == key && std::get<1>(data) == params)
+            auto it = find(bucket->second, params);
+            if (it != bucket->second.end())
             {
-                obj = std::get<2>(data);
+                s.lru.splice(s.lru.begin(), s.lru, *it);
+                obj = (*it)->data;
+                hits++;
                 return true;
             }
         }
+        misses++;
         return false;
     }
 
+    // Does not change the LRU order and the statistics.
     bool exists(const KeyType& key, const ParamType& params = ParamType())
     {
-        for (auto& data : objects)
+        auto& s = shard(key);
+        std::unique_lock lock(s.mutex);
+        auto bucket = s.map.find(key);
+        return bucket != s.map.end() && find(bucket->second, params) != bucket->second.end();
+    }
+
+    bool erase(const KeyType& key, const ParamType& params = ParamType())
+    {
+        auto& s = shard(key);
+        std::unique_lock lock(s.mutex);
+        auto bucket = s.map.find(key);
+        if (bucket == s.map.end()) return false;
+        auto it = find(bucket->second, params);
+        if (it == bucket->second.end()) return false;
+
+        s.bytes -= (*it)->bytes;
+        s.lru.erase(*it);
+        bucket->second.erase(it);
+        if (bucket->second.empty()) s.map.erase(bucket);
+        return true;
+    }
+
+    /**
+     * Calls f(key, params, data) for every object in the cache.
+     * The shard of the current object is locked, so f must not access the cache.
+     */
+    template <typename F>
+    void forEach(F f)
+    {
+        for (auto& s : shards)
         {
-            if (std::get<0>(data) == key && std::get<1>(data) == params)
-            {
-                return true;
-            }
+            std::unique_lock lock(s->mutex);
+            for (auto& e : s->lru) f(e.key, e.params, e.data);
         }
-        return false;
+    }
+
+    ObjectCacheStats stats()
+    {
+        ObjectCacheStats result;
+        result.hits      = hits;
+        result.misses    = misses;
+        result.evictions = evictions;
+        for (auto& s : shards)
+        {
+            std::unique_lock lock(s->mutex);
+            result.entries += s->lru.size();
+            result.bytes += s->bytes;
+        }
+        return result;
+    }
+
+   private:
+    struct Entry
+    {
+        KeyType key;
+        ParamType params;
+        DataType data;
+        size_t bytes;
+    };
+    using LRUList = std::list<Entry>;
+    // All entries with the same key (but different params).
+    using Bucket = std::vector<typename LRUList::iterator>;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        // Most recently used first
+        LRUList lru;
+        std::unordered_map<KeyType, Bucket, Hash> map;
+        size_t bytes = 0;
+    };
+
+    SizeFunction size_function;
+    size_t max_bytes_per_shard;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    std::atomic<size_t> hits      = 0;
+    std::atomic<size_t> misses    = 0;
+    std::atomic<size_t> evictions = 0;
+
+    Shard& shard(const KeyType& key)
+    {
+        // The map of the shard uses the same hash -> mix the bits before selecting the shard.
+        size_t h = Hash()(key) * size_t(0x9E3779B97F4A7C15ull);
+        return *shards[(h >> 32) % shards.size()];
+    }
+
+    static typename Bucket::iterator find(Bucket& bucket, const ParamType& params)
+    {
+        return std::find_if(bucket.begin(), bucket.end(), [&](auto& it) { return it->params == params; });
     }
 };
 
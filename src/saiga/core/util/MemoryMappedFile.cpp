@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "MemoryMappedFile.h"
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace Saiga
+{
+#ifdef _WIN32
+bool MemoryMappedFile::open(const std::string& file)
+{
+    close();
+
+    HANDLE fh = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (fh == INVALID_HANDLE_VALUE) return false;
+    file_handle = fh;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(fh, &file_size))
+    {
+        close();
+        return false;
+    }
+    size_ = file_size.QuadPart;
+
+    // Empty files cannot be mapped, but they are still valid files.
+    if (size_ > 0)
+    {
+        mapping_handle = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping_handle)
+        {
+            close();
+            return false;
+        }
+        data_ = (const char*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+        if (!data_)
+        {
+            close();
+            return false;
+        }
+    }
+    is_open = true;
+    return true;
+}
+
+void MemoryMappedFile::close()
+{
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_handle) CloseHandle(mapping_handle);
+    if (file_handle) CloseHandle(file_handle);
+    data_          = nullptr;
+    mapping_handle = nullptr;
+    file_handle    = nullptr;
+    size_          = 0;
+    is_open        = false;
+}
+#else
+bool MemoryMappedFile::open(const std::string& file)
+{
+    close();
+
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd == -1) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    size_ = st.st_size;
+
+    // Empty files cannot be mapped, but they are still valid files.
+    if (size_ > 0)
+    {
+        void* ptr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED)
+        {
+            ::close(fd);
+            size_ = 0;
+            return false;
+        }
+        data_ = (const char*)ptr;
+    }
+
+    // The mapping stays valid after closing the file descriptor.
+    ::close(fd);
+    is_open = true;
+    return true;
+}
+
+void MemoryMappedFile::close()
+{
+    if (data_) munmap((void*)data_, size_);
+    data_   = nullptr;
+    size_   = 0;
+    is_open = false;
+}
+#endif
+
+}  // namespace Saiga
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+
+#include <string>
+
+namespace Saiga
+{
+/**
+ * Read-only memory mapping of a complete file.
+ *
+ * Opening is cheap even for very large files, because the OS only loads the pages which are actually accessed.
+ * The mapping is released in the destructor, so all pointers into the file become invalid then.
+ *
+ * Usage:
+ *
+ * MemoryMappedFile mf(file);
+ * if (mf.valid())
+ * {
+ *     process(mf.data(), mf.size());
+ * }
+ */
+class SAIGA_CORE_API MemoryMappedFile
+{
+   public:
+    MemoryMappedFile() {}
+    MemoryMappedFile(const std::string& file) { open(file); }
+    ~MemoryMappedFile() { close(); }
+
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+    // Returns false if the file does not exist or could not be mapped.
+    bool open(const std::string& file);
+    void close();
+
+    bool valid() const { return is_open; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+   private:
+    bool is_open      = false;
+    const char* data_ = nullptr;
+    size_t size_      = 0;
+
+#ifdef _WIN32
+    void* file_handle    = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+};
+
+}  // namespace Saiga
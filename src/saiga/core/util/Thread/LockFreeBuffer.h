@@ -0,0 +1,371 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+#include "saiga/core/util/Thread/SpinLock.h"
+#include "saiga/core/util/assert.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include <condition_variable>
+
+namespace Saiga
+{
+/**
+ * Blocking helper for lock-free data structures.
+ * A waiting thread first spins for a few iterations. If 'park' is enabled, it then sleeps on a condition variable
+ * until notify() is called. Otherwise it keeps yielding.
+ *
+ * notify() is cheap if nobody is parked: one fence and one relaxed load.
+ */
+class SpinParkWaiter
+{
+   public:
+    static constexpr unsigned spin_count = 64;
+
+    // Blocks until 'ready()' returns true. 'ready' may have side effects, for example popping an element.
+    template <typename Pred>
+    void wait(Pred ready, bool park)
+    {
+        for (unsigned k = 0; k < spin_count; ++k)
+        {
+            if (ready()) return;
+            yield(k);
+        }
+
+        if (!park)
+        {
+            while (!ready()) std::this_thread::yield();
+            return;
+        }
+
+        std::unique_lock<std::mutex> l(mutex);
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        // Pairs with the fence in notify(). Either we see the new state or the notifier sees waiters > 0.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait(l, ready);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Same as wait() but returns false after the given duration.
+    template <typename Pred, typename TimeType>
+    bool waitFor(Pred ready, bool park, const TimeType& duration)
+    {
+        auto end = std::chrono::steady_clock::now() + duration;
+        for (unsigned k = 0; k < spin_count; ++k)
+        {
+            if (ready()) return true;
+            yield(k);
+        }
+
+        if (!park)
+        {
+            while (!ready())
+            {
+                if (std::chrono::steady_clock::now() >= end) return false;
+                std::this_thread::yield();
+            }
+            return true;
+        }
+
+        std::unique_lock<std::mutex> l(mutex);
+        waiters.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool result = cv.wait_until(l, end, ready);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_relaxed) > 0)
+        {
+            std::unique_lock<std::mutex> l(mutex);
+            cv.notify_all();
+        }
+    }
+
+   private:
+    std::atomic<int> waiters = {0};
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+/**
+ * A bounded lock-free ring buffer with the same interface as SynchronizedBuffer.
+ *
+ * The implementation is based on Dmitry Vyukov's bounded MPMC queue: every slot stores a sequence number that tells
+ * producers and consumers whether the slot is free or filled in the current round. Head and tail are on separate
+ * cache lines.
+ *
+ * MultiProducer == false
+ *      Only one thread may call add/tryAdd/addOverride. The producer updates the tail without CAS.
+ * MultiProducer == true
+ *      Any number of producers.
+ * MultiConsumer == false (requires MultiProducer == false)
+ *      Exactly one producer and one consumer thread. The per slot sequence numbers are not used. Both sides only
+ *      publish their index with a release store and read the other index with an acquire load (Lamport queue).
+ *      addOverride() is not available, because it would consume from the producer thread.
+ * MultiConsumer == true
+ *      Any number of consumers. addOverride() drops the oldest element by consuming it, so it is also available for
+ *      the single producer variant.
+ *
+ * Blocking calls (add, get, getTimeout) spin for a short time and then park the thread on a condition variable. Pass
+ * park = false to the constructor for pure busy waiting, which has a lower latency but burns a core.
+ *
+ * Like RingBuffer, T must be default constructible. A consumed slot is reset to T() to release its resources early.
+ */
+template <typename T, bool MultiProducer, bool MultiConsumer = true>
+class SAIGA_TEMPLATE LockFreeBuffer
+{
+    static_assert(MultiConsumer || !MultiProducer, "Multiple producers require multiple consumers.");
+
+   public:
+    // The capacity is rounded up to the next power of two.
+    LockFreeBuffer(int capacity, bool park = true) : park(park)
+    {
+        SAIGA_ASSERT(capacity > 0);
+        size_t c = 1;
+        while (c < size_t(capacity)) c *= 2;
+        mask  = c - 1;
+        slots = std::make_unique<Slot[]>(c);
+        for (size_t i = 0; i < c; ++i)
+        {
+            slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    LockFreeBuffer(const LockFreeBuffer&) = delete;
+    LockFreeBuffer& operator=(const LockFreeBuffer&) = delete;
+
+    int capacity() const { return int(mask + 1); }
+
+    // Approximate number of elements if other threads are currently modifying the buffer.
+    int count() const
+    {
+        auto t = tail.load(std::memory_order_relaxed);
+        auto h = head.load(std::memory_order_relaxed);
+        return t > h ? std::min<int>(int(t - h), capacity()) : 0;
+    }
+
+    bool empty() const { return count() == 0; }
+
+    // Removes all elements.
+    void clear()
+    {
+        T tmp;
+        while (tryGet(tmp))
+        {
+        }
+    }
+
+    // Blocks until there is space in the buffer.
+    template <typename G>
+    void add(G&& data)
+    {
+        not_full.wait([&]() { return push<G>(data); }, park);
+        not_empty.notify();
+    }
+
+    // Adds one element. If the buffer is full, the oldest element is removed.
+    // Returns true if an element was actually overriden.
+    template <typename G>
+    bool addOverride(G&& data)
+    {
+        static_assert(MultiConsumer, "addOverride() consumes from the producer thread.");
+        bool overridden = false;
+        while (!push<G>(data))
+        {
+            T tmp;
+            if (pop(tmp))
+            {
+                overridden = true;
+            }
+        }
+        not_empty.notify();
+        return overridden;
+    }
+
+    // Returns false if the buffer is full.
+    template <typename G>
+    bool tryAdd(G&& v)
+    {
+        if (!push<G>(v)) return false;
+        not_empty.notify();
+        return true;
+    }
+
+    // Blocks until an element is available.
+    T get()
+    {
+        T result;
+        not_empty.wait([&]() { return pop(result); }, park);
+        not_full.notify();
+        return result;
+    }
+
+    // Blocks until we got an elemnt or the duration has passed.
+    // Returns T() on timeout.
+    template <typename TimeType>
+    T getTimeout(const TimeType& duration)
+    {
+        T result;
+        if (!not_empty.waitFor([&]() { return pop(result); }, park, duration)) return T();
+        not_full.notify();
+        return result;
+    }
+
+    bool tryGet(T& v)
+    {
+        if (!pop(v)) return false;
+        not_full.notify();
+        return true;
+    }
+
+   private:
+    struct Slot
+    {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    // Copies or moves 'data' into the buffer depending on G. 'data' is only moved from if the push succeeded.
+    template <typename G>
+    bool push(std::remove_reference_t<G>& data)
+    {
+        if constexpr (!MultiConsumer)
+        {
+            // Only this thread writes the tail.
+            size_t pos = tail.load(std::memory_order_relaxed);
+            if (pos - cached_head > mask)
+            {
+                cached_head = head.load(std::memory_order_acquire);
+                if (pos - cached_head > mask) return false;
+            }
+            slots[pos & mask].value = std::forward<G>(data);
+            tail.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;)
+        {
+            slot       = &slots[pos & mask];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            auto dif   = intptr_t(seq) - intptr_t(pos);
+            if (dif == 0)
+            {
+                if constexpr (MultiProducer)
+                {
+                    if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                }
+                else
+                {
+                    tail.store(pos + 1, std::memory_order_relaxed);
+                    break;
+                }
+            }
+            else if (dif < 0)
+            {
+                // full
+                return false;
+            }
+            else
+            {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->value = std::forward<G>(data);
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& out)
+    {
+        if constexpr (!MultiConsumer)
+        {
+            // Only this thread writes the head.
+            size_t pos = head.load(std::memory_order_relaxed);
+            if (pos == cached_tail)
+            {
+                cached_tail = tail.load(std::memory_order_acquire);
+                if (pos == cached_tail) return false;
+            }
+            Slot& slot = slots[pos & mask];
+            out        = std::move(slot.value);
+            slot.value = T();
+            head.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        size_t pos = head.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;)
+        {
+            slot       = &slots[pos & mask];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            auto dif   = intptr_t(seq) - intptr_t(pos + 1);
+            if (dif == 0)
+            {
+                // Consumers always use a CAS, because addOverride() consumes from the producer thread.
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (dif < 0)
+            {
+                // empty
+                return false;
+            }
+            else
+            {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+
+        out         = std::move(slot->value);
+        slot->value = T();
+        slot->seq.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    bool park;
+
+    // The cached index of the other side is only used by the single consumer variant. It is on the same cache line
+    // as the index that is written by the same thread.
+    SAIGA_ALIGN_CACHE std::atomic<size_t> head = {0};
+    size_t cached_tail                         = 0;
+    SAIGA_ALIGN_CACHE std::atomic<size_t> tail = {0};
+    size_t cached_head                         = 0;
+    SAIGA_ALIGN_CACHE SpinParkWaiter not_empty;
+    SAIGA_ALIGN_CACHE SpinParkWaiter not_full;
+};
+
+// Single producer, single consumer.
+template <typename T>
+using SPSCBuffer = LockFreeBuffer<T, false, false>;
+
+// Single producer, any number of consumers.
+template <typename T>
+using SPMCBuffer = LockFreeBuffer<T, false, true>;
+
+// Multi producer, multi consumer.
+template <typename T>
+using MPMCBuffer = LockFreeBuffer<T, true, true>;
+
+}  // namespace Saiga
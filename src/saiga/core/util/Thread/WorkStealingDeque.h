@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace Saiga
+{
+/**
+ * A lock-free single-owner/multi-thief deque (Chase-Lev).
+ *
+ * The owner thread pushes and pops at the bottom (LIFO), while any other thread may steal from the top (FIFO).
+ * The implementation follows the C11 formulation from:
+ *
+ * Lê et al. "Correct and Efficient Work-Stealing for Weak Memory Models", PPoPP 2013.
+ *
+ * T must be trivially copyable (usually a pointer), because a thief may read a slot that is concurrently
+ * overwritten. The result of such a read is discarded when the CAS on 'top' fails.
+ *
+ * The buffer grows on demand. Old buffers are kept alive until the deque is destroyed, because a thief may still
+ * read from them.
+ */
+template <typename T>
+class SAIGA_TEMPLATE WorkStealingDeque
+{
+    static_assert(std::is_trivially_copyable_v<T>, "WorkStealingDeque only supports trivially copyable types.");
+
+   public:
+    explicit WorkStealingDeque(int64_t initial_capacity = 256)
+    {
+        int64_t c = 1;
+        while (c < initial_capacity) c *= 2;
+        buffers.emplace_back(std::make_unique<Array>(c));
+        array.store(buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only.
+    void push(T x)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Array* a  = array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1)
+        {
+            a = grow(a, t, b);
+        }
+        a->put(b, x);
+        // Release instead of a standalone fence + relaxed store. Same code on x86 and understood by TSAN.
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // Owner only. Returns false if the deque is empty.
+    bool pop(T& out)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Array* a  = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b)
+        {
+            // Empty
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        out = a->get(b);
+        if (t == b)
+        {
+            // Last element. Race against the thieves.
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread. Returns false if the deque is empty or the steal lost a race.
+    bool steal(T& out)
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b)
+        {
+            return false;
+        }
+
+        Array* a = array.load(std::memory_order_acquire);
+        T x      = a->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return false;
+        }
+        out = x;
+        return true;
+    }
+
+    // Approximate number of elements. Only exact if no other thread modifies the deque.
+    int64_t size() const
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+   private:
+    struct Array
+    {
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> data;
+
+        explicit Array(int64_t c) : capacity(c), mask(c - 1), data(new std::atomic<T>[c]) {}
+
+        T get(int64_t i) const { return data[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T x) { data[i & mask].store(x, std::memory_order_relaxed); }
+    };
+
+    Array* grow(Array* a, int64_t t, int64_t b)
+    {
+        auto n = std::make_unique<Array>(a->capacity * 2);
+        for (int64_t i = t; i < b; ++i)
+        {
+            n->put(i, a->get(i));
+        }
+        Array* result = n.get();
+        buffers.emplace_back(std::move(n));
+        array.store(result, std::memory_order_release);
+        return result;
+    }
+
+    // Owner and thieves touch different indices. Keep them on separate cache lines.
+    SAIGA_ALIGN_CACHE std::atomic<int64_t> top    = {0};
+    SAIGA_ALIGN_CACHE std::atomic<int64_t> bottom = {0};
+    SAIGA_ALIGN_CACHE std::atomic<Array*> array   = {nullptr};
+
+    // Only modified by the owner.
+    std::vector<std::unique_ptr<Array>> buffers;
+};
+
+}  // namespace Saiga
@@ -25,6 +25,7 @@
 
 #include "threadPool.h"
 
+#include "saiga/core/util/Thread/SpinLock.h"
 #include "saiga/core/util/Thread/threadName.h"
 #include "saiga/core/util/assert.h"
 
@@ -32,30 +33,200 @@
 
 namespace Saiga
 {
-ThreadPool::ThreadPool(size_t threads, const std::string& name) : name(name), stop(false)
+namespace ThreadPoolDetail
 {
-    workingThreads = threads;
-    for (size_t i = 0; i < threads; ++i)
+// Tasks are moved between threads in chains of 'batch_size'. A thread keeps at most 'max_cached_tasks' in its own
+// free list. Above that, one chain is moved to the shared free list, which holds at most 'max_shared_batches' chains.
+// Everything above is returned to the system.
+//
+// The shared list is required for tasks that are submitted from a non-worker thread: they are allocated by the
+// submitter but freed by the worker that ran them, so the free list of the submitter would always be empty.
+static constexpr int batch_size         = 64;
+static constexpr int max_cached_tasks   = 4 * batch_size;
+static constexpr int max_shared_batches = 64;
+
+static void deleteChain(Task* head)
+{
+    while (head)
+    {
+        Task* n = head->next;
+        delete head;
+        head = n;
+    }
+}
+
+struct TaskCache
+{
+    Task* head = nullptr;
+    int size   = 0;
+
+    ~TaskCache() { deleteChain(head); }
+};
+
+struct SharedTaskList
+{
+    SpinLock lock;
+    // Each entry is the head of a null-terminated chain of exactly 'batch_size' tasks.
+    std::vector<Task*> batches;
+
+    SharedTaskList() { batches.reserve(max_shared_batches); }
+    ~SharedTaskList()
+    {
+        for (auto b : batches) deleteChain(b);
+    }
+};
+
+static thread_local TaskCache task_cache;
+static SharedTaskList shared_tasks;
+
+Task* allocateTask()
+{
+    auto& cache = task_cache;
+    if (!cache.head)
+    {
+        std::unique_lock<SpinLock> lock(shared_tasks.lock);
+        if (!shared_tasks.batches.empty())
+        {
+            cache.head = shared_tasks.batches.back();
+            cache.size = batch_size;
+            shared_tasks.batches.pop_back();
+        }
+    }
+
+    if (cache.head)
+    {
+        Task* t    = cache.head;
+        cache.head = t->next;
+        cache.size--;
+        t->next = nullptr;
+        return t;
+    }
+    return new Task();
+}
+
+void freeTask(Task* task)
+{
+    auto& cache = task_cache;
+    task->next  = cache.head;
+    cache.head  = task;
+    cache.size++;
+    if (cache.size < max_cached_tasks) return;
+
+    // Detach the first 'batch_size' tasks and give them to the other threads.
+    Task* batch = cache.head;
+    Task* tail  = batch;
+    for (int i = 1; i < batch_size; ++i) tail = tail->next;
+    cache.head = tail->next;
+    cache.size -= batch_size;
+    tail->next = nullptr;
+
+    {
+        std::unique_lock<SpinLock> lock(shared_tasks.lock);
+        if (int(shared_tasks.batches.size()) < max_shared_batches)
+        {
+            shared_tasks.batches.push_back(batch);
+            return;
+        }
+    }
+    deleteChain(batch);
+}
+
+}  // namespace ThreadPoolDetail
+
+// The pool and worker index of the current thread.
+static thread_local const ThreadPool* current_pool = nullptr;
+static thread_local int current_worker_id          = -1;
+
+// Small xorshift generator for the victim selection.
+static thread_local uint32_t steal_rng = 0;
+
+static uint32_t nextVictimSeed()
+{
+    if (steal_rng == 0)
+    {
+        steal_rng = uint32_t(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1u;
+    }
+    steal_rng ^= steal_rng << 13;
+    steal_rng ^= steal_rng >> 17;
+    steal_rng ^= steal_rng << 5;
+    return steal_rng;
+}
+
+// Number of unsuccessful attempts to find work before a thread blocks.
+static constexpr unsigned idle_spin_count = 64;
+
+void TaskGroup::wait()
+{
+    helpUntilDone();
+
+    std::exception_ptr e;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::swap(e, exception);
+    }
+    if (e) std::rethrow_exception(e);
+}
+
+void TaskGroup::helpUntilDone()
+{
+    int worker    = pool.currentWorker();
+    unsigned idle = 0;
+    while (!done())
+    {
+        if (auto task = pool.findTask(worker))
+        {
+            pool.runTask(task);
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < idle_spin_count)
+        {
+            yield(idle);
+            continue;
+        }
+
+        // Nothing to steal. The remaining tasks of this group are currently executed by other threads.
+        // The timeout makes sure we check for new stealable work from time to time.
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::microseconds(100), [this]() { return done(); });
+    }
+
+    // The last finish() decrements the counter while holding the mutex.
+    // Acquiring it here guarantees that finish() has returned before this group can be destroyed.
+    std::unique_lock<std::mutex> lock(mutex);
+}
+
+void TaskGroup::finish(std::exception_ptr e)
+{
+    if (e)
     {
-        workers.emplace_back([this, i, name] {
-            setThreadName(name + std::to_string(i));
-            for (;;)
-            {
-                std::function<void()> task;
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!exception) exception = e;
+    }
 
-                {
-                    std::unique_lock<std::mutex> lock(this->queue_mutex);
-                    workingThreads--;
-                    this->condition.wait(lock, [this] { return this->stop || !this->tasks.empty(); });
-                    if (this->stop && this->tasks.empty()) return;
-                    workingThreads++;
-                    task = std::move(this->tasks.front());
-                    this->tasks.pop();
-                }
+    int p = pending.load(std::memory_order_relaxed);
+    while (p > 1)
+    {
+        if (pending.compare_exchange_weak(p, p - 1, std::memory_order_acq_rel, std::memory_order_relaxed)) return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    pending.fetch_sub(1, std::memory_order_acq_rel);
+    cv.notify_all();
+}
+
+
+ThreadPool::ThreadPool(size_t threads, const std::string& name) : name(name)
+{
+    for (size_t i = 0; i < threads; ++i)
+    {
+        queues.emplace_back(std::make_unique<WorkerQueue>());
+    }
 
-                task();
-            }
-        });
+    for (size_t i = 0; i < threads; ++i)
+    {
+        workers.emplace_back([this, i]() { workerLoop(int(i)); });
     }
 }
 
@@ -67,15 +238,177 @@ ThreadPool::~ThreadPool()
 void ThreadPool::quit()
 {
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        std::unique_lock<std::mutex> lock(sleep_mutex);
         if (stop) return;
-        stop = true;
+        {
+            // don't allow enqueueing after stopping the pool
+            std::unique_lock<std::mutex> lock2(injection_mutex);
+            stop = true;
+        }
     }
     condition.notify_all();
     for (std::thread& worker : workers) worker.join();
     workers.clear();
 }
 
+int ThreadPool::currentWorker() const
+{
+    return current_pool == this ? current_worker_id : -1;
+}
+
+void ThreadPool::push(Task* task)
+{
+    int worker = currentWorker();
+    if (worker >= 0)
+    {
+        // Nested task -> push to our own deque.
+        queues[worker]->deque.push(task);
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(injection_mutex);
+        if (stop)
+        {
+            lock.unlock();
+            task->destroy(task);
+            ThreadPoolDetail::freeTask(task);
+            throw std::runtime_error("enqueue on stopped ThreadPool");
+        }
+        injection.push_back(task);
+        injection_size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The sequentially consistent increment of 'pending' followed by the load of 'sleeping' pairs with the
+    // increment of 'sleeping' and the check of 'pending' in workerLoop. At least one side sees the other.
+    pending.fetch_add(1, std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        condition.notify_one();
+    }
+}
+
+ThreadPool::Task* ThreadPool::findTask(int worker)
+{
+    Task* task = nullptr;
+
+    if (worker >= 0 && queues[worker]->deque.pop(task))
+    {
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        return task;
+    }
+
+    if (injection_size.load(std::memory_order_relaxed) > 0)
+    {
+        std::unique_lock<std::mutex> lock(injection_mutex);
+        if (!injection.empty())
+        {
+            task = injection.front();
+            injection.pop_front();
+            injection_size.fetch_sub(1, std::memory_order_relaxed);
+            pending.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+
+    int n = int(queues.size());
+    if (n == 0) return nullptr;
+    int start = int(nextVictimSeed() % uint32_t(n));
+    for (int i = 0; i < n; ++i)
+    {
+        int victim = (start + i) % n;
+        if (victim == worker) continue;
+        if (queues[victim]->deque.steal(task))
+        {
+            pending.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void ThreadPool::runTask(Task* task)
+{
+    workingThreads.fetch_add(1, std::memory_order_relaxed);
+    TaskGroup* group = task->group;
+    if (group)
+    {
+        std::exception_ptr e;
+        try
+        {
+            task->invoke(task);
+        }
+        catch (...)
+        {
+            e = std::current_exception();
+        }
+        task->destroy(task);
+        ThreadPoolDetail::freeTask(task);
+        workingThreads.fetch_sub(1, std::memory_order_relaxed);
+        group->finish(e);
+    }
+    else
+    {
+        // Without catching, an exception would leave the worker and call std::terminate.
+        try
+        {
+            task->invoke(task);
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> lock(exception_mutex);
+            if (!exception) exception = std::current_exception();
+        }
+        task->destroy(task);
+        ThreadPoolDetail::freeTask(task);
+        workingThreads.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void ThreadPool::rethrowException()
+{
+    std::exception_ptr e;
+    {
+        std::unique_lock<std::mutex> lock(exception_mutex);
+        std::swap(e, exception);
+    }
+    if (e) std::rethrow_exception(e);
+}
+
+void ThreadPool::workerLoop(int id)
+{
+    current_pool      = this;
+    current_worker_id = id;
+    setThreadName(name + std::to_string(id));
+
+    unsigned idle = 0;
+    for (;;)
+    {
+        if (auto task = findTask(id))
+        {
+            runTask(task);
+            idle = 0;
+            continue;
+        }
+
+        if (++idle < idle_spin_count)
+        {
+            yield(idle);
+            continue;
+        }
+        idle = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            sleeping.fetch_add(1, std::memory_order_seq_cst);
+            condition.wait(lock, [this] { return stop || pending.load(std::memory_order_seq_cst) > 0; });
+            sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        }
+
+        if (stop && pending.load() <= 0 && queues[id]->deque.empty()) return;
+    }
+}
+
 std::unique_ptr<ThreadPool> globalThreadPool;
 
 void createGlobalThreadPool(int threads)
@@ -83,7 +416,7 @@ void createGlobalThreadPool(int threads)
     if (threads < 0)
     {
 #if defined(_OPENMP)
-        threads = omp_get_thread_num();
+        threads = omp_get_max_threads();
 #else
         threads = std::thread::hardware_concurrency();
         if (threads <= 0)
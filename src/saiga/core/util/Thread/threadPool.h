@@ -21,25 +21,155 @@
 
 /**
  * This file was modified by Darius Rueckert for libsaiga.
+ *
+ * The single locked queue of the original implementation has been replaced by a work-stealing scheduler:
+ *  - Every worker owns a lock-free deque (see WorkStealingDeque.h). Tasks spawned from a worker are pushed to its
+ *    own deque and idle workers steal from the other end.
+ *  - Tasks from non-worker threads go through a small injection queue.
+ *  - Task objects are recycled through thread-local free lists, which exchange chains of tasks with a shared list,
+ *    and store small callables inline. Only enqueue() allocates (the shared state of the returned std::future) and
+ *    the injection queue allocates a block every few tasks.
+ *  - TaskGroup::wait(), parallel_for and parallel_reduce execute pending tasks while waiting, so they can be
+ *    nested inside other tasks without blocking a worker.
  */
 
 #pragma once
 
 #include "saiga/config.h"
+#include "saiga/core/util/Thread/WorkStealingDeque.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <stdexcept>
+#include <string>
 #include <thread>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
 #include <condition_variable>
 
 namespace Saiga
 {
+class ThreadPool;
+class TaskGroup;
+
+namespace ThreadPoolDetail
+{
+/**
+ * A type erased, non-movable task.
+ * Callables up to 'inline_size' bytes are stored directly in the task object. Larger callables are moved to the
+ * heap.
+ */
+struct SAIGA_ALIGN_CACHE Task
+{
+    static constexpr size_t inline_size = 96;
+
+    void (*invoke)(Task*)  = nullptr;
+    void (*destroy)(Task*) = nullptr;
+    TaskGroup* group       = nullptr;
+    Task* next             = nullptr;
+
+    alignas(std::max_align_t) unsigned char storage[inline_size];
+
+    template <typename Fn>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(Fn) <= inline_size && alignof(Fn) <= alignof(std::max_align_t);
+    }
+
+    template <typename F>
+    void set(F&& f)
+    {
+        using Fn = std::decay_t<F>;
+        if constexpr (fitsInline<Fn>())
+        {
+            new (storage) Fn(std::forward<F>(f));
+            invoke  = [](Task* t) { (*std::launder(reinterpret_cast<Fn*>(t->storage)))(); };
+            destroy = [](Task* t) { std::launder(reinterpret_cast<Fn*>(t->storage))->~Fn(); };
+        }
+        else
+        {
+            Fn* ptr = new Fn(std::forward<F>(f));
+            std::memcpy(storage, &ptr, sizeof(Fn*));
+            invoke = [](Task* t) {
+                Fn* p;
+                std::memcpy(&p, t->storage, sizeof(Fn*));
+                (*p)();
+            };
+            destroy = [](Task* t) {
+                Fn* p;
+                std::memcpy(&p, t->storage, sizeof(Fn*));
+                delete p;
+            };
+        }
+    }
+};
+
+// Allocation from a thread local free list. Tasks can be freed by a different thread than the one that allocated
+// them. Full free lists pass chains of tasks to a shared free list, from which threads with an empty list refill.
+// Therefore tasks are also recycled if they are submitted from a non-worker thread. In the steady state no calls to
+// new/delete are made for the tasks.
+SAIGA_CORE_API Task* allocateTask();
+SAIGA_CORE_API void freeTask(Task* task);
+
+}  // namespace ThreadPoolDetail
+
+
+/**
+ * A set of tasks that can be waited on collectively.
+ *
+ * The waiting thread executes other pending tasks of the pool until all tasks of this group are finished. Therefore
+ * it is safe to create and wait on a group from inside a task (nested parallelism).
+ * If a task throws, the first exception is rethrown by wait().
+ *
+ * Usage:
+ *
+ * TaskGroup group(*globalThreadPool);
+ * for (int i = 0; i < 100; ++i) group.run([i]() { work(i); });
+ * group.wait();
+ */
+class SAIGA_CORE_API TaskGroup
+{
+   public:
+    explicit TaskGroup(ThreadPool& pool) : pool(pool) {}
+    ~TaskGroup() { helpUntilDone(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    template <typename F>
+    void run(F&& f);
+
+    void wait();
+
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+   private:
+    friend class ThreadPool;
+
+    void helpUntilDone();
+    void finish(std::exception_ptr e);
+
+    ThreadPool& pool;
+    std::atomic<int> pending = {0};
+
+    // Only used for blocking waits and exception transport.
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::exception_ptr exception;
+};
+
+
 class SAIGA_CORE_API ThreadPool
 {
    public:
@@ -49,28 +179,85 @@ class SAIGA_CORE_API ThreadPool
     template <class F, class... Args>
     auto enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result_t<F, Args...>>;
 
+    /**
+     * Fire-and-forget version of enqueue.
+     * Does not create a future and therefore does not allocate memory.
+     * If the task throws, the first exception is stored and rethrown by rethrowException().
+     */
+    template <class F>
+    void execute(F&& f);
+
+    // Rethrows (and clears) the first exception thrown by a task that was started with execute().
+    void rethrowException();
+
+    /**
+     * Calls f(i) for all i in [begin, end).
+     * The range is recursively split in halves until it is smaller than 'grain'. Idle workers steal the upper halves.
+     * The calling thread participates in the work. grain <= 0 selects a grain size automatically.
+     */
+    template <typename Index, typename F>
+    void parallel_for(Index begin, Index end, F&& f, Index grain = 0);
+
+    /**
+     * Computes reduce(...reduce(reduce(identity, map(begin)), map(begin+1))..., map(end-1)) in parallel.
+     * 'reduce' must be associative. The partial results are combined in a fixed order, therefore the result is
+     * deterministic for a given grain size.
+     */
+    template <typename Index, typename T, typename Map, typename Reduce>
+    T parallel_reduce(Index begin, Index end, T identity, Map&& map, Reduce&& reduce, Index grain = 0);
+
     void quit();
 
-    size_t queueSize()
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        return tasks.size();
-    }
-    size_t getWorkingThreads() { return workingThreads; }
+    size_t queueSize() { return std::max<int64_t>(0, pending.load(std::memory_order_relaxed)); }
+    size_t getWorkingThreads() { return workingThreads.load(std::memory_order_relaxed); }
+    size_t numThreads() const { return workers.size(); }
+
+    // The index of the calling thread in this pool or -1 if it is not a worker of this pool.
+    int currentWorker() const;
 
    private:
-    // number of currently working threads
-    size_t workingThreads = 0;
+    friend class TaskGroup;
+    using Task = ThreadPoolDetail::Task;
+
+    template <typename Index, typename F>
+    void parallelForSplit(TaskGroup& group, Index begin, Index end, F& f, Index grain);
+
+    template <typename F>
+    void submit(F&& f, TaskGroup* group);
+
+    void push(Task* task);
+    Task* findTask(int worker);
+    void runTask(Task* task);
+    void workerLoop(int id);
+
+    struct SAIGA_ALIGN_CACHE WorkerQueue
+    {
+        WorkStealingDeque<Task*> deque;
+    };
+
     std::string name;
     // need to keep track of threads so we can join them
     std::vector<std::thread> workers;
-    // the task queue
-    std::queue<std::function<void()> > tasks;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+    // Tasks from threads that are not part of this pool
+    std::mutex injection_mutex;
+    std::deque<Task*> injection;
+    std::atomic<int64_t> injection_size = {0};
+
+    // Number of tasks that are queued but not yet started
+    SAIGA_ALIGN_CACHE std::atomic<int64_t> pending = {0};
+    SAIGA_ALIGN_CACHE std::atomic<int> sleeping    = {0};
+    std::atomic<size_t> workingThreads             = {0};
+
+    // First exception of a task without future or group (see execute())
+    std::mutex exception_mutex;
+    std::exception_ptr exception;
 
-    // synchronization
-    std::mutex queue_mutex;
+    // synchronization for idle workers
+    std::mutex sleep_mutex;
     std::condition_variable condition;
-    bool stop;
+    std::atomic<bool> stop = {false};
 };
 
 template <class F, class... Args>
@@ -78,39 +265,150 @@ auto ThreadPool::enqueue(F&& f, Args&&... args) -> std::future<typename std::inv
 {
     using return_type = typename std::invoke_result_t<F, Args...>;
 
+    std::promise<return_type> promise;
+    std::future<return_type> res = promise.get_future();
 
-    auto task = std::make_shared<std::packaged_task<return_type()> >(
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-    std::future<return_type> res = task->get_future();
+    submit(
+        [promise = std::move(promise), f = std::forward<F>(f),
+         args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+            try
+            {
+                if constexpr (std::is_void_v<return_type>)
+                {
+                    std::apply(f, args);
+                    promise.set_value();
+                }
+                else
+                {
+                    promise.set_value(std::apply(f, args));
+                }
+            }
+            catch (...)
+            {
+                promise.set_exception(std::current_exception());
+            }
+        },
+        nullptr);
+    return res;
+}
+
+template <class F>
+void ThreadPool::execute(F&& f)
+{
+    submit(std::forward<F>(f), nullptr);
+}
 
+template <typename F>
+void ThreadPool::submit(F&& f, TaskGroup* group)
+{
+    Task* task = ThreadPoolDetail::allocateTask();
+    task->set(std::forward<F>(f));
+    task->group = group;
 
-    if (workers.size() == 0)
+    if (workers.empty())
     {
         // This is an empty thread pool
         // -> execute this task here without adding it to the queue
         // -> emulate single threaded behaviour
-        (*task)();
-        return res;
+        runTask(task);
+        return;
+    }
+    push(task);
+}
+
+template <typename F>
+void TaskGroup::run(F&& f)
+{
+    pending.fetch_add(1, std::memory_order_relaxed);
+    pool.submit(std::forward<F>(f), this);
+}
+
+template <typename Index, typename F>
+void ThreadPool::parallel_for(Index begin, Index end, F&& f, Index grain)
+{
+    static_assert(std::is_integral_v<Index>, "parallel_for requires an integral index type.");
+    if (end <= begin) return;
+
+    Index n = end - begin;
+    if (grain <= 0)
+    {
+        Index chunks = Index(std::max<size_t>(1, workers.size()) * 8);
+        grain        = std::max<Index>(1, n / chunks);
     }
 
+    if (workers.empty() || n <= grain)
+    {
+        for (Index i = begin; i < end; ++i) f(i);
+        return;
+    }
+
+    TaskGroup group(*this);
+    parallelForSplit(group, begin, end, f, grain);
+    group.wait();
+}
 
+template <typename Index, typename F>
+void ThreadPool::parallelForSplit(TaskGroup& group, Index begin, Index end, F& f, Index grain)
+{
+    // Push the upper half and continue with the lower half. The pushed tasks are split again by the thief.
+    while (end - begin > grain)
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        Index mid = begin + (end - begin) / 2;
+        group.run([this, &group, &f, mid, end, grain]() { parallelForSplit(group, mid, end, f, grain); });
+        end = mid;
+    }
+    for (Index i = begin; i < end; ++i) f(i);
+}
 
-        // don't allow enqueueing after stopping the pool
-        if (stop) throw std::runtime_error("enqueue on stopped ThreadPool");
+template <typename Index, typename T, typename Map, typename Reduce>
+T ThreadPool::parallel_reduce(Index begin, Index end, T identity, Map&& map, Reduce&& reduce, Index grain)
+{
+    static_assert(std::is_integral_v<Index>, "parallel_reduce requires an integral index type.");
+    if (end <= begin) return identity;
 
-        tasks.emplace([task]() { (*task)(); });
+    Index n = end - begin;
+    if (grain <= 0)
+    {
+        Index chunks = Index(std::max<size_t>(1, workers.size()) * 8);
+        grain        = std::max<Index>(1, n / chunks);
     }
-    condition.notify_one();
-    return res;
+
+    // One cache line per partial result. This prevents false sharing and also works for T = bool, where
+    // std::vector<bool> would pack the flags of different chunks into the same word.
+    struct SAIGA_ALIGN_CACHE Partial
+    {
+        T value;
+    };
+    Index num_chunks = (n + grain - 1) / grain;
+    std::vector<Partial> partial(num_chunks, Partial{identity});
+
+    parallel_for(
+        Index(0), num_chunks,
+        [&](Index c) {
+            Index chunk_begin = begin + c * grain;
+            Index chunk_end   = std::min<Index>(end, chunk_begin + grain);
+            T local           = identity;
+            for (Index i = chunk_begin; i < chunk_end; ++i)
+            {
+                local = reduce(local, map(i));
+            }
+            partial[c].value = local;
+        },
+        Index(1));
+
+    T result = identity;
+    for (auto& p : partial)
+    {
+        result = reduce(result, p.value);
+    }
+    return result;
 }
 
 /**
  * A global thread pool that can be used from everywhere.
  * Create it at the beginning with createGlobalThreadPool.
  *
- * -1 initializes the thread count with omp_get_thread_num
+ * -1 initializes the thread count with omp_get_max_threads
  */
 extern SAIGA_CORE_API std::unique_ptr<ThreadPool> globalThreadPool;
 extern SAIGA_CORE_API void createGlobalThreadPool(int threads = -1);
@@ -11,6 +11,8 @@
 #include "internal/noGraphicsAPI.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 
@@ -128,7 +130,207 @@ void removeWindowsLineEnding(std::vector<std::string>& file)
     }
 }
 
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
 
+/**
+ * Parses one number starting at 'str' and returns the end of it (or 'str' if it is not a number).
+ *
+ * Fast path: If the decimal mantissa has at most 19 digits, is exactly representable (<= 2^53) and the decimal exponent
+ * is in [-22, 22], the result of a single multiplication or division with an exact power of ten is correctly rounded.
+ * This covers almost all numbers written by printf. Everything else is passed to strtod.
+ */
+static inline const char* parseDouble(const char* str, double& result)
+{
+    static constexpr double exact_pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                             1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char* p     = str;
+    bool negative     = false;
+    bool truncated    = false;
+    bool any_digit    = false;
+    uint64_t mantissa = 0;
+    int digits        = 0;
+    int exponent      = 0;
+
+    if (*p == '-' || *p == '+')
+    {
+        negative = *p == '-';
+        ++p;
+    }
+    for (; isDigit(*p); ++p)
+    {
+        any_digit = true;
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa > 0) digits++;
+        }
+        else
+        {
+            truncated = true;
+            exponent++;
+        }
+    }
+    if (*p == '.')
+    {
+        ++p;
+        for (; isDigit(*p); ++p)
+        {
+            any_digit = true;
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa > 0) digits++;
+                exponent--;
+            }
+            else
+            {
+                truncated = true;
+            }
+        }
+    }
+    if (any_digit && (*p == 'e' || *p == 'E'))
+    {
+        const char* e     = p + 1;
+        bool exp_negative = false;
+        if (*e == '-' || *e == '+')
+        {
+            exp_negative = *e == '-';
+            ++e;
+        }
+        if (isDigit(*e))
+        {
+            int exp_value = 0;
+            for (; isDigit(*e); ++e)
+            {
+                if (exp_value < 10000) exp_value = exp_value * 10 + (*e - '0');
+            }
+            exponent += exp_negative ? -exp_value : exp_value;
+            p = e;
+        }
+    }
+
+    if (any_digit && !truncated && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double d = double(mantissa);
+        d        = exponent < 0 ? d / exact_pow10[-exponent] : d * exact_pow10[exponent];
+        result   = negative ? -d : d;
+        return p;
+    }
+
+    // Slow path (also handles inf, nan and hex floats)
+    char* end;
+    result = std::strtod(str, &end);
+    return end;
+}
+
+// Parses [begin, end) into 'result'. The chunk must start at the beginning of a line.
+static bool parseNumbersChunk(const char* begin, const char* end, std::vector<double>& result)
+{
+    const char* p = begin;
+    while (true)
+    {
+        while (p < end && isSpace(*p)) ++p;
+        if (p >= end) break;
+
+        if (*p == '#')
+        {
+            while (p < end && *p != '\n') ++p;
+            continue;
+        }
+
+        double d;
+        const char* next = parseDouble(p, d);
+        if (next == p || (next < end && !isSpace(*next)))
+        {
+            return false;
+        }
+        result.push_back(d);
+        p = next;
+    }
+    return true;
+}
+
+bool parseNumbers(const char* text, size_t size, std::vector<double>& result)
+{
+    const char* end = text + size;
+
+    // Split at line breaks into chunks of roughly equal size.
+    const size_t min_chunk_size = 1024 * 1024;
+    int num_chunks              = std::max<size_t>(1, std::min<size_t>(size / min_chunk_size, 256));
+    std::vector<const char*> chunk_begin(num_chunks + 1, end);
+    chunk_begin[0] = text;
+    for (int i = 1; i < num_chunks; ++i)
+    {
+        const char* p = std::max(text + size / num_chunks * i, chunk_begin[i - 1]);
+        while (p < end && *p != '\n') ++p;
+        chunk_begin[i] = p;
+    }
+
+    std::vector<std::vector<double>> chunk_result(num_chunks);
+    std::vector<size_t> chunk_offset(num_chunks + 1, 0);
+    bool valid = true;
+
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < num_chunks; ++i)
+    {
+        // Most numbers have at least 8 characters
+        chunk_result[i].reserve((chunk_begin[i + 1] - chunk_begin[i]) / 8);
+        if (!parseNumbersChunk(chunk_begin[i], chunk_begin[i + 1], chunk_result[i]))
+        {
+#pragma omp atomic write
+            valid = false;
+        }
+    }
+    if (!valid) return false;
+
+    for (int i = 0; i < num_chunks; ++i)
+    {
+        chunk_offset[i + 1] = chunk_offset[i] + chunk_result[i].size();
+    }
+
+    result.resize(chunk_offset.back());
+#pragma omp parallel for
+    for (int i = 0; i < num_chunks; ++i)
+    {
+        std::copy(chunk_result[i].begin(), chunk_result[i].end(), result.begin() + chunk_offset[i]);
+    }
+    return true;
+}
+
+bool loadFileNumbers(const std::string& file, std::vector<double>& result)
+{
+    std::ifstream is(file, std::ios::binary | std::ios::in | std::ios::ate);
+    if (!is.is_open())
+    {
+        std::cout << "File not found " << file << std::endl;
+        return false;
+    }
+
+    // One extra '\0' at the end, which is required by parseNumbers.
+    size_t size = is.tellg();
+    std::vector<char> data(size + 1, '\0');
+    is.seekg(0, std::ios::beg);
+    is.read(data.data(), size);
+    if (!is) return false;
+
+    // skip utf8 bom
+    size_t start = 0;
+    if (size >= 3 && (unsigned char)data[0] == 0XEF && (unsigned char)data[1] == 0XBB &&
+        (unsigned char)data[2] == 0XBF)
+    {
+        start = 3;
+    }
+    return parseNumbers(data.data() + start, size - start, result);
+}
 
 }  // namespace File
 }  // namespace Saiga
@@ -27,5 +27,18 @@ SAIGA_CORE_API void removeWindowsLineEnding(std::vector<std::string>& file);
 
 
 SAIGA_CORE_API void saveFileBinary(const std::string& file, const void* data, size_t size);
+
+/**
+ * Parses all whitespace separated numbers of a text into one array. A token starting with '#' is a comment until the
+ * end of the line. The text is split into chunks at line breaks, which are parsed in parallel. Integers are parsed as
+ * doubles and are exact up to 2^53.
+ *
+ * 'text[size]' must be readable and not part of a number (for example the terminating '\0' of a std::string).
+ * Returns false if a token is not a number.
+ */
+SAIGA_CORE_API bool parseNumbers(const char* text, size_t size, std::vector<double>& result);
+
+// Reads the file into memory and calls parseNumbers(). Returns false if the file does not exist or is invalid.
+SAIGA_CORE_API bool loadFileNumbers(const std::string& file, std::vector<double>& result);
 }  // namespace File
 }  // namespace Saiga
@@ -9,9 +9,18 @@
 #include "saiga/config.h"
 #include "saiga/core/util/Thread/SynchronizedBuffer.h"
 #include "saiga/core/util/Thread/threadName.h"
+#include "saiga/core/util/assert.h"
+#include "saiga/core/util/table.h"
 
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
 #include <condition_variable>
 
@@ -77,4 +86,670 @@ class SAIGA_TEMPLATE PipelineStage
     std::string name;
 };
 
+
+struct PipelineStageOptions
+{
+    // Number of threads that execute this stage.
+    int workers = 1;
+
+    // Capacity of the input queue of this stage. A full queue blocks the upstream stage (backpressure).
+    int queue_size = 4;
+
+    // Consume the input in the order produced by the source.
+    // Elements that arrive out of order (from a multi-threaded upstream stage) are reassembled first. The reorder
+    // window is queue_size plus the number of upstream workers. The source does not run further ahead.
+    bool ordered = false;
+};
+
+struct PipelineStageStatistics
+{
+    std::string name;
+    int workers = 0;
+
+    // Number of elements processed by this stage
+    uint64_t items = 0;
+
+    double items_per_second = 0;
+
+    // Fraction of the time the workers spent inside the user function. [0,1]
+    double utilisation = 0;
+
+    // Current and maximum number of elements in the input queue.
+    int queue_depth     = 0;
+    int max_queue_depth = 0;
+    int queue_capacity  = 0;
+};
+
+namespace PipelineDetail
+{
+template <typename T>
+struct Item
+{
+    uint64_t seq;
+    T value;
+};
+
+/**
+ * A bounded blocking queue that can be closed.
+ * After close() all blocked calls return false and pop() returns the remaining elements.
+ */
+template <typename T>
+class BoundedQueue
+{
+   public:
+    BoundedQueue(int capacity = 1) : capacity(capacity) { SAIGA_ASSERT(capacity > 0); }
+
+    bool push(T&& v)
+    {
+        std::unique_lock<std::mutex> l(lock);
+        not_full.wait(l, [this]() { return closed || (int)data.size() < capacity; });
+        if (closed) return false;
+        data.push_back(std::move(v));
+        max_depth = std::max<int>(max_depth, data.size());
+        not_empty.notify_one();
+        return true;
+    }
+
+    bool pop(T& v)
+    {
+        std::unique_lock<std::mutex> l(lock);
+        not_empty.wait(l, [this]() { return closed || !data.empty(); });
+        if (data.empty()) return false;
+        v = std::move(data.front());
+        data.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        {
+            std::unique_lock<std::mutex> l(lock);
+            closed = true;
+        }
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+    int size()
+    {
+        std::unique_lock<std::mutex> l(lock);
+        return data.size();
+    }
+
+    int maxSize()
+    {
+        std::unique_lock<std::mutex> l(lock);
+        return max_depth;
+    }
+
+    // Not synchronized. Only change it before the queue is used.
+    int capacity;
+
+   private:
+    std::mutex lock;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<T> data;
+    int max_depth = 0;
+    bool closed   = false;
+};
+
+/**
+ * A bounded blocking queue that returns the elements in the order of their sequence numbers.
+ *
+ * push() blocks while the element is 'capacity' or more positions ahead of the next element to be returned.
+ * The sequence numbers must be gapless and unique.
+ *
+ * Blocking in push() alone is not enough if the upstream stages reorder the elements: the blocked producers and the
+ * full queues in front of them can hold back the next element forever. Therefore the source of the pipeline also
+ * waits with waitForWindow() and does not create elements outside of the window (see Channel::waitForWindow). Then
+ * push() never blocks and the memory is still bounded by 'capacity' elements.
+ */
+template <typename T>
+class OrderedQueue
+{
+   public:
+    OrderedQueue(int capacity = 1) : capacity(capacity) { SAIGA_ASSERT(capacity > 0); }
+
+    bool push(Item<T>&& v)
+    {
+        std::unique_lock<std::mutex> l(lock);
+        not_full.wait(l, [&]() { return closed || v.seq < next_seq + capacity; });
+        if (closed) return false;
+        if (slots.empty())
+        {
+            slots.resize(capacity);
+            filled.resize(capacity, 0);
+        }
+
+        auto seq     = v.seq;
+        auto slot    = seq % capacity;
+        slots[slot]  = std::move(v);
+        filled[slot] = 1;
+        depth++;
+        max_depth = std::max(max_depth, depth);
+        if (seq == next_seq) not_empty.notify_one();
+        return true;
+    }
+
+    // Blocks until an element with this sequence number would be accepted by push().
+    // Returns false if the queue is closed.
+    bool waitForWindow(uint64_t seq)
+    {
+        std::unique_lock<std::mutex> l(lock);
+        not_full.wait(l, [&]() { return closed || seq < next_seq + capacity; });
+        return !closed;
+    }
+
+    // Returns false if the queue is closed and the next element is missing.
+    bool pop(Item<T>& v)
+    {
+        std::unique_lock<std::mutex> l(lock);
+        not_empty.wait(l, [this]() { return closed || nextAvailable(); });
+        if (!nextAvailable()) return false;
+
+        auto slot    = next_seq % capacity;
+        v            = std::move(slots[slot]);
+        filled[slot] = 0;
+        depth--;
+        next_seq++;
+
+        // Wake up the producers that wait for the window to move and the next consumer.
+        not_full.notify_all();
+        if (nextAvailable()) not_empty.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        {
+            std::unique_lock<std::mutex> l(lock);
+            closed = true;
+        }
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+    int size()
+    {
+        std::unique_lock<std::mutex> l(lock);
+        return depth;
+    }
+
+    int maxSize()
+    {
+        std::unique_lock<std::mutex> l(lock);
+        return max_depth;
+    }
+
+    // Not synchronized. Only change it before the queue is used.
+    int capacity;
+
+   private:
+    bool nextAvailable() const { return !slots.empty() && filled[next_seq % capacity]; }
+
+    std::mutex lock;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    // Ring buffer indexed by seq % capacity
+    std::vector<Item<T>> slots;
+    std::vector<char> filled;
+    uint64_t next_seq = 0;
+    int depth         = 0;
+    int max_depth     = 0;
+    bool closed       = false;
+};
+
+struct ChannelBase
+{
+    virtual ~ChannelBase() {}
+    virtual void close() = 0;
+
+    // Blocks until the ordered channels from here to the end of the pipeline accept the element with this sequence
+    // number. Returns false if one of them is closed.
+    virtual bool waitForWindow(uint64_t seq) = 0;
+
+    bool has_consumer = false;
+
+    // The output channel of the stage that consumes this channel.
+    ChannelBase* downstream = nullptr;
+
+    // The number of workers between the source and this channel. Each of them can hold back one element.
+    int upstream_workers = 0;
+};
+
+// The connection between two stages. Closed when all producing workers are finished.
+// Ordered channels use an OrderedQueue instead of the FIFO queue. Its reorder window is the capacity of the channel
+// plus the upstream workers, so that all upstream workers can be busy while the consumer waits for the next element.
+template <typename T>
+struct Channel : public ChannelBase
+{
+    void close() override
+    {
+        queue.close();
+        ordered_queue.close();
+    }
+
+    void producerDone()
+    {
+        if (producers.fetch_sub(1) == 1) close();
+    }
+
+    // Blocks while the channel is full. Returns false if the channel was closed.
+    bool push(Item<T>&& item) { return ordered ? ordered_queue.push(std::move(item)) : queue.push(std::move(item)); }
+
+    bool waitForWindow(uint64_t seq) override
+    {
+        if (ordered && !ordered_queue.waitForWindow(seq)) return false;
+        return !downstream || downstream->waitForWindow(seq);
+    }
+
+    // Returns the next element for a consumer. Blocks until an element is available.
+    // Returns false if the channel is closed and empty.
+    bool next(Item<T>& out) { return ordered ? ordered_queue.pop(out) : queue.pop(out); }
+
+    void setCapacity(int capacity)
+    {
+        queue.capacity         = capacity;
+        ordered_queue.capacity = capacity + upstream_workers;
+    }
+
+    int capacity() const { return ordered ? ordered_queue.capacity : queue.capacity; }
+    int size() { return ordered ? ordered_queue.size() : queue.size(); }
+    int maxSize() { return ordered ? ordered_queue.maxSize() : queue.maxSize(); }
+
+    std::atomic<int> producers = {0};
+    bool ordered               = false;
+
+   private:
+    BoundedQueue<Item<T>> queue;
+    OrderedQueue<T> ordered_queue;
+};
+
+class StageBase
+{
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    StageBase(const std::string& name, int workers) : name(name), num_workers(workers)
+    {
+        SAIGA_ASSERT(workers > 0);
+    }
+    virtual ~StageBase() { join(); }
+
+    void start(const std::atomic<bool>* stop)
+    {
+        stop_flag  = stop;
+        start_time = Clock::now();
+        running    = num_workers;
+        for (int i = 0; i < num_workers; ++i)
+        {
+            threads.emplace_back([this, i]() {
+                setThreadName(num_workers == 1 ? name : name + std::to_string(i));
+                work();
+                if (running.fetch_sub(1) == 1)
+                {
+                    end_time = Clock::now();
+                    finished = true;
+                }
+            });
+        }
+    }
+
+    void join()
+    {
+        for (auto& t : threads)
+        {
+            if (t.joinable()) t.join();
+        }
+        threads.clear();
+    }
+
+    PipelineStageStatistics statistics()
+    {
+        PipelineStageStatistics st;
+        st.name    = name;
+        st.workers = num_workers;
+        st.items   = items.load();
+
+        auto end       = finished ? end_time : Clock::now();
+        double elapsed = std::chrono::duration<double>(end - start_time).count();
+        if (elapsed > 0)
+        {
+            st.items_per_second = st.items / elapsed;
+            st.utilisation      = busy_ns.load() * 1e-9 / (elapsed * num_workers);
+        }
+        inputQueueStatistics(st);
+        return st;
+    }
+
+    const std::string name;
+    const int num_workers;
+
+   protected:
+    virtual void work() = 0;
+    virtual void inputQueueStatistics(PipelineStageStatistics&) {}
+
+    bool stopRequested() const { return stop_flag && stop_flag->load(std::memory_order_relaxed); }
+
+    void itemDone() { items.fetch_add(1, std::memory_order_relaxed); }
+
+    // Calls f and adds the execution time to the busy time of this stage.
+    template <typename F>
+    auto timed(F&& f)
+    {
+        auto t0 = Clock::now();
+        if constexpr (std::is_void_v<decltype(f())>)
+        {
+            f();
+            busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+        }
+        else
+        {
+            auto r = f();
+            busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+            return r;
+        }
+    }
+
+   private:
+    std::vector<std::thread> threads;
+    const std::atomic<bool>* stop_flag = nullptr;
+    std::atomic<int> running           = {0};
+    std::atomic<uint64_t> items        = {0};
+    std::atomic<uint64_t> busy_ns      = {0};
+    Clock::time_point start_time, end_time;
+    std::atomic<bool> finished = {false};
+};
+
+template <typename T>
+class InputStage : public StageBase
+{
+   public:
+    InputStage(const std::string& name, int workers, Channel<T>* input) : StageBase(name, workers), input(input) {}
+
+   protected:
+    void inputQueueStatistics(PipelineStageStatistics& st) override
+    {
+        st.queue_depth     = input->size();
+        st.max_queue_depth = input->maxSize();
+        st.queue_capacity  = input->capacity();
+    }
+
+    Channel<T>* input;
+};
+
+template <typename T, typename F>
+class SourceStage : public StageBase
+{
+   public:
+    SourceStage(const std::string& name, F f, Channel<T>* output) : StageBase(name, 1), f(std::move(f)), output(output)
+    {
+    }
+
+   protected:
+    void work() override
+    {
+        uint64_t seq = 0;
+        while (!stopRequested())
+        {
+            // Do not run ahead of the ordered channels. Otherwise the elements behind a slow element can fill all
+            // queues and block it (see OrderedQueue).
+            if (!output->waitForWindow(seq)) break;
+
+            Item<T> item;
+            item.seq = seq;
+            if (!timed([&]() { return f(item.value); })) break;
+            itemDone();
+            if (!output->push(std::move(item))) break;
+            seq++;
+        }
+        output->producerDone();
+    }
+
+    F f;
+    Channel<T>* output;
+};
+
+template <typename In, typename Out, typename F>
+class MapStage : public InputStage<In>
+{
+   public:
+    MapStage(const std::string& name, int workers, F f, Channel<In>* input, Channel<Out>* output)
+        : InputStage<In>(name, workers, input), f(std::move(f)), output(output)
+    {
+    }
+
+   protected:
+    void work() override
+    {
+        Item<In> in;
+        while (this->input->next(in))
+        {
+            Item<Out> out{in.seq, this->timed([&]() { return f(std::move(in.value)); })};
+            this->itemDone();
+            if (!output->push(std::move(out))) break;
+        }
+        output->producerDone();
+    }
+
+    F f;
+    Channel<Out>* output;
+};
+
+template <typename In, typename F>
+class SinkStage : public InputStage<In>
+{
+   public:
+    SinkStage(const std::string& name, int workers, F f, Channel<In>* input)
+        : InputStage<In>(name, workers, input), f(std::move(f))
+    {
+    }
+
+   protected:
+    void work() override
+    {
+        Item<In> in;
+        while (this->input->next(in))
+        {
+            this->timed([&]() { f(std::move(in.value)); });
+            this->itemDone();
+        }
+    }
+
+    F f;
+};
+
+}  // namespace PipelineDetail
+
+class ParallelPipeline;
+
+/**
+ * The typed output of a pipeline stage. Use map() to attach a processing stage and sink() to terminate the stream.
+ * Every stream must be consumed exactly once.
+ */
+template <typename T>
+class PipelineStream
+{
+   public:
+    template <typename F>
+    auto map(const std::string& name, F f, PipelineStageOptions options = {})
+        -> PipelineStream<std::decay_t<std::invoke_result_t<F, T&&>>>;
+
+    template <typename F>
+    void sink(const std::string& name, F f, PipelineStageOptions options = {});
+
+   private:
+    friend class ParallelPipeline;
+    template <typename U>
+    friend class PipelineStream;
+
+    PipelineStream(ParallelPipeline* pipeline, PipelineDetail::Channel<T>* channel)
+        : pipeline(pipeline), channel(channel)
+    {
+    }
+
+    PipelineDetail::Channel<T>* consume(const PipelineStageOptions& options);
+
+    ParallelPipeline* pipeline;
+    PipelineDetail::Channel<T>* channel;
+};
+
+/**
+ * A graph of pipeline stages connected by bounded queues.
+ *
+ * source -> map -> ... -> map -> sink
+ *
+ * Every stage runs on its own worker threads. Map and sink stages can have multiple workers. A full input queue
+ * blocks the producing stage, so memory is bounded by the sum of the queue sizes plus the elements currently being
+ * processed. Each element gets a sequence number from the source, which is used by 'ordered' stages to restore the
+ * original order.
+ *
+ * Usage:
+ *
+ * ParallelPipeline pipeline;
+ * pipeline.source<FrameData>("capture", [&](FrameData& f) { return camera.getImageSync(f); })
+ *     .map("undistort", [](FrameData f) { return undistort(f); }, {4, 8})
+ *     .map("features", [](FrameData f) { return detect(f); }, {4, 8})
+ *     .sink("fusion", [&](Features f) { fuse(f); }, {1, 8, true});
+ * pipeline.start();
+ * pipeline.wait();
+ * pipeline.printStatistics();
+ */
+class ParallelPipeline
+{
+   public:
+    ParallelPipeline() {}
+    ~ParallelPipeline() { stop(); }
+
+    ParallelPipeline(const ParallelPipeline&) = delete;
+    ParallelPipeline& operator=(const ParallelPipeline&) = delete;
+
+    /**
+     * Creates the source of the pipeline.
+     * The function is called repeatedly with a default constructed element. Return false to end the stream.
+     * bool f(T& out)
+     */
+    template <typename T, typename F>
+    PipelineStream<T> source(const std::string& name, F f)
+    {
+        SAIGA_ASSERT(!started);
+        auto channel = addChannel<T>();
+        stages.emplace_back(std::make_unique<PipelineDetail::SourceStage<T, F>>(name, std::move(f), channel));
+        channel->producers = 1;
+        return PipelineStream<T>(this, channel);
+    }
+
+    void start()
+    {
+        SAIGA_ASSERT(!started);
+        for (auto& c : channels)
+        {
+            SAIGA_ASSERT(c->has_consumer, "All pipeline streams must be terminated with a sink.");
+        }
+        started = true;
+        for (auto& s : stages) s->start(&stop_flag);
+    }
+
+    // Blocks until the source has ended and all elements have been processed.
+    void wait()
+    {
+        for (auto& s : stages) s->join();
+    }
+
+    // Stops the source and closes all channels. The consumers still process the elements that are already in their
+    // input queue (ordered consumers up to the first missing element). Elements that are pushed after the close are
+    // dropped.
+    void stop()
+    {
+        stop_flag = true;
+        for (auto& c : channels) c->close();
+        wait();
+    }
+
+    std::vector<PipelineStageStatistics> statistics()
+    {
+        std::vector<PipelineStageStatistics> result;
+        for (auto& s : stages) result.push_back(s->statistics());
+        return result;
+    }
+
+    void printStatistics(std::ostream& strm = std::cout)
+    {
+        Table table({20, 8, 10, 12, 10, 16}, strm);
+        table.setFloatPrecision(2);
+        table << "Stage"
+              << "Workers"
+              << "Items"
+              << "Items/s"
+              << "Util."
+              << "Queue (max/cap)";
+        for (auto& st : statistics())
+        {
+            table << st.name << st.workers << st.items << st.items_per_second << st.utilisation
+                  << (std::to_string(st.max_queue_depth) + "/" + std::to_string(st.queue_capacity));
+        }
+    }
+
+   private:
+    template <typename T>
+    friend class PipelineStream;
+
+    template <typename T>
+    PipelineDetail::Channel<T>* addChannel()
+    {
+        auto channel = std::make_unique<PipelineDetail::Channel<T>>();
+        auto ptr     = channel.get();
+        channels.push_back(std::move(channel));
+        return ptr;
+    }
+
+    bool started                = false;
+    std::atomic<bool> stop_flag = {false};
+    // The channels must outlive the stages. Members are destroyed in reverse order.
+    std::vector<std::unique_ptr<PipelineDetail::ChannelBase>> channels;
+    std::vector<std::unique_ptr<PipelineDetail::StageBase>> stages;
+};
+
+template <typename T>
+PipelineDetail::Channel<T>* PipelineStream<T>::consume(const PipelineStageOptions& options)
+{
+    SAIGA_ASSERT(!pipeline->started);
+    SAIGA_ASSERT(!channel->has_consumer, "A pipeline stream can only be consumed once.");
+    SAIGA_ASSERT(options.workers > 0 && options.queue_size > 0);
+
+    // The capacity and ordering of a channel are properties of the consumer.
+    channel->setCapacity(options.queue_size);
+    channel->ordered      = options.ordered;
+    channel->has_consumer = true;
+    return channel;
+}
+
+template <typename T>
+template <typename F>
+auto PipelineStream<T>::map(const std::string& name, F f, PipelineStageOptions options)
+    -> PipelineStream<std::decay_t<std::invoke_result_t<F, T&&>>>
+{
+    using Out = std::decay_t<std::invoke_result_t<F, T&&>>;
+
+    auto input               = consume(options);
+    auto output              = pipeline->template addChannel<Out>();
+    output->producers        = options.workers;
+    output->upstream_workers = input->upstream_workers + options.workers;
+    input->downstream        = output;
+    pipeline->stages.emplace_back(std::make_unique<PipelineDetail::MapStage<T, Out, F>>(
+        name, options.workers, std::move(f), input, output));
+    return PipelineStream<Out>(pipeline, output);
+}
+
+template <typename T>
+template <typename F>
+void PipelineStream<T>::sink(const std::string& name, F f, PipelineStageOptions options)
+{
+    auto input = consume(options);
+    pipeline->stages.emplace_back(
+        std::make_unique<PipelineDetail::SinkStage<T, F>>(name, options.workers, std::move(f), input));
+}
+
 }  // namespace Saiga
@@ -28,7 +28,7 @@ class SAIGA_OPENGL_API ShaderLoader
 
     void reload()
     {
-        for (auto& object : cache.objects) std::get<2>(object)->reload();
+        cache.forEach([](auto&, auto&, auto& shader) { shader->reload(); });
     }
 
     void clear() { cache.clear(); }
@@ -20,6 +20,9 @@ void DatasetParameters::fromConfigFile(const std::string& file)
     INI_GETADD(ini, group, maxFrames);
     INI_GETADD(ini, group, multiThreadedLoad);
     INI_GETADD(ini, group, preload);
+    INI_GETADD(ini, group, prefetch_window);
+    INI_GETADD(ini, group, prefetch_threads);
+    INI_GETADD(ini, group, evict_consumed);
     INI_GETADD(ini, group, normalize_timestamps);
     INI_GETADD(ini, group, ground_truth_time_offset);
     if (ini.changed()) ini.SaveFile(file.c_str());
@@ -38,6 +41,27 @@ DatasetCameraBase::DatasetCameraBase(const DatasetParameters& params) : params(p
     ResetTime();
 }
 
+DatasetCameraBase::~DatasetCameraBase()
+{
+    close();
+}
+
+void DatasetCameraBase::close()
+{
+    if (!prefetch_pool) return;
+    {
+        // Wait for the loader tasks, because they access this object.
+        std::unique_lock lock(prefetch_mutex);
+        for (auto& state : prefetch_state)
+        {
+            if (state == PrefetchState::Loading) state = PrefetchState::Cancelled;
+        }
+        prefetch_cv.wait(lock, [this]() { return prefetch_loading == 0; });
+    }
+    // Frames are loaded synchronously after this point
+    prefetch_pool.reset();
+}
+
 void DatasetCameraBase::ResetTime()
 {
     timer.start();
@@ -69,6 +93,13 @@ void DatasetCameraBase::Load()
             loadingBar.addProgress(1);
         }
     }
+    else if (params.prefetch_window > 0)
+    {
+        prefetch_state.assign(frames.size(), PrefetchState::Empty);
+        prefetch_waiters.assign(frames.size(), 0);
+        // At least one worker. Tasks of an empty pool are executed by the calling thread, which holds the lock.
+        prefetch_pool = std::make_unique<ThreadPool>(std::max(1, params.prefetch_threads), "DatasetLoader");
+    }
     ResetTime();
 }
 
@@ -97,14 +128,159 @@ bool DatasetCameraBase::getImageSync(FrameData& data)
     }
 
 
-    auto& img = frames[this->currentId];
-    SAIGA_ASSERT(this->currentId == img.id);
-    if (!params.preload)
+    int id = this->currentId++;
+    SAIGA_ASSERT(id == frames[id].id);
+    if (params.preload)
+    {
+        data = std::move(frames[id]);
+    }
+    else if (prefetch_pool)
+    {
+        {
+            std::unique_lock lock(prefetch_mutex);
+            Prefetch(id, params.prefetch_window);
+        }
+        TakeFrame(id, data);
+    }
+    else
+    {
+        // The meta data is copied, so the frame can be loaded again by GetFrame
+        data = frames[id];
+        LoadImageData(data);
+    }
+    return true;
+}
+
+bool DatasetCameraBase::GetFrame(int index, FrameData& data)
+{
+    if (index < 0 || index >= (int)frames.size()) return false;
+
+    if (params.preload)
+    {
+        data = frames[index];
+    }
+    else if (prefetch_pool)
+    {
+        {
+            std::unique_lock lock(prefetch_mutex);
+            Prefetch(index, 1);
+        }
+        TakeFrame(index, data);
+    }
+    else
+    {
+        data = frames[index];
+        LoadImageData(data);
+    }
+    return true;
+}
+
+void DatasetCameraBase::Seek(int index)
+{
+    SAIGA_ASSERT(index >= 0 && index <= (int)frames.size());
+    this->currentId = index;
+    if (!prefetch_pool || !params.evict_consumed) return;
+
+    std::unique_lock lock(prefetch_mutex);
+    auto outside = [&](int i) { return i < index || i >= index + params.prefetch_window; };
+    for (auto it = prefetched.begin(); it != prefetched.end();)
+    {
+        if (outside(it->first) && prefetch_waiters[it->first] == 0)
+        {
+            prefetch_state[it->first] = PrefetchState::Empty;
+            it                        = prefetched.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // The result of these loads is dropped when they finish
+    for (int i = 0; i < (int)prefetch_state.size(); ++i)
+    {
+        if (prefetch_state[i] == PrefetchState::Loading && outside(i) && prefetch_waiters[i] == 0)
+        {
+            prefetch_state[i] = PrefetchState::Cancelled;
+        }
+    }
+}
+
+int DatasetCameraBase::NumPrefetchedFrames()
+{
+    std::unique_lock lock(prefetch_mutex);
+    return prefetched.size() + prefetch_loading;
+}
+
+void DatasetCameraBase::Prefetch(int begin, int window)
+{
+    int end = std::min<int>(begin + window, frames.size());
+    for (int i = begin; i < end; ++i)
+    {
+        if (prefetch_state[i] == PrefetchState::Cancelled)
+        {
+            // The scheduled task is still running, so we use its result.
+            prefetch_state[i] = PrefetchState::Loading;
+            continue;
+        }
+        if (prefetch_state[i] != PrefetchState::Empty) continue;
+        prefetch_state[i] = PrefetchState::Loading;
+        prefetch_loading++;
+
+        prefetch_pool->execute([this, i]() {
+            std::unique_lock lock(prefetch_mutex);
+            FrameData frame;
+            // Loads that were cancelled before they started are skipped
+            if (prefetch_state[i] == PrefetchState::Loading)
+            {
+                lock.unlock();
+                // 'frames' is not modified in prefetch mode
+                frame = frames[i];
+                LoadImageData(frame);
+                lock.lock();
+            }
+
+            // Seek() or close() may have cancelled the load in the meantime
+            if (prefetch_state[i] == PrefetchState::Loading)
+            {
+                prefetched[i]     = std::move(frame);
+                prefetch_state[i] = PrefetchState::Loaded;
+            }
+            else
+            {
+                prefetch_state[i] = PrefetchState::Empty;
+            }
+            prefetch_loading--;
+            prefetch_cv.notify_all();
+        });
+    }
+}
+
+bool DatasetCameraBase::TakeFrame(int index, FrameData& data)
+{
+    std::unique_lock lock(prefetch_mutex);
+    // Seek does not cancel or evict frames with a waiter. It may have done so before this point (after the caller
+    // scheduled the frame), so the load is scheduled again in that case.
+    prefetch_waiters[index]++;
+    if (prefetch_state[index] != PrefetchState::Loading && prefetch_state[index] != PrefetchState::Loaded)
+    {
+        Prefetch(index, 1);
+    }
+    prefetch_cv.wait(lock, [&]() { return prefetch_state[index] == PrefetchState::Loaded; });
+    prefetch_waiters[index]--;
+
+    auto it = prefetched.find(index);
+    SAIGA_ASSERT(it != prefetched.end());
+    if (params.evict_consumed)
+    {
+        data = std::move(it->second);
+        prefetched.erase(it);
+        prefetch_state[index] = PrefetchState::Empty;
+    }
+    else
     {
-        LoadImageData(img);
+        data = it->second;
     }
-    this->currentId++;
-    data = std::move(img);
     return true;
 }
 
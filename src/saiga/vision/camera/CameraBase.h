@@ -8,12 +8,16 @@
 #include "saiga/core/time/timer.h"
 #include "saiga/core/util/ProgressBar.h"
 #include "saiga/core/util/Thread/omp.h"
+#include "saiga/core/util/Thread/threadPool.h"
+#include "saiga/core/util/pipeline.h"
 
 #include "CameraData.h"
 
+#include <condition_variable>
 #include <fstream>
 #include <iomanip>
 #include <thread>
+#include <unordered_map>
 
 namespace Saiga
 {
@@ -73,6 +77,18 @@ struct SAIGA_VISION_API DatasetParameters
     // Load all images to ram at the beginning.
     bool preload = true;
 
+    // Only used if preload == false.
+    // Number of frames after the current frame that are loaded in the background. With 0, each frame is loaded
+    // synchronously in getImageSync.
+    int prefetch_window = 0;
+
+    // Number of threads that load the prefetched frames.
+    int prefetch_threads = 4;
+
+    // The image data of a prefetched frame is released after it was returned by getImageSync or GetFrame. Otherwise
+    // all frames that were loaded once stay in memory.
+    bool evict_consumed = true;
+
     // Subtract the timestamp of the first image from everything.
     bool normalize_timestamps = false;
 
@@ -92,6 +108,7 @@ class SAIGA_VISION_API DatasetCameraBase : public CameraBase
 {
    public:
     DatasetCameraBase(const DatasetParameters& params);
+    ~DatasetCameraBase();
 
     void ResetTime();
 
@@ -114,6 +131,24 @@ class SAIGA_VISION_API DatasetCameraBase : public CameraBase
 
     bool getImageSync(FrameData& data) override;
 
+    // Random access to the frame 'index'. Blocks until the frame is loaded. The current position of getImageSync is
+    // not changed.
+    // In preload mode, frames that were already returned by getImageSync do not contain images anymore.
+    bool GetFrame(int index, FrameData& data);
+
+    // getImageSync continues at 'index'. Prefetched frames outside of the new window are evicted.
+    // Can be called concurrently with GetFrame. Must not be called concurrently with getImageSync, because both change
+    // the read position.
+    void Seek(int index);
+
+    // Number of frames which are currently loaded or loading in the background.
+    int NumPrefetchedFrames();
+
+    // Stops the background loading. Loads that have not started yet are cancelled and running loads are waited for.
+    // The loader tasks call the virtual LoadImageData, therefore every class that overrides LoadImageData must call
+    // close() in its destructor. Must not be called concurrently with getImageSync or GetFrame.
+    void close() override;
+
     virtual bool isOpened() override { return this->currentId < (int)frames.size(); }
     size_t getFrameCount() { return frames.size(); }
 
@@ -144,8 +179,47 @@ class SAIGA_VISION_API DatasetCameraBase : public CameraBase
     tick_t timeStep;
     tick_t lastFrameTime;
     tick_t nextFrameTime;
+
+    // Background loading (DatasetParameters::prefetch_window > 0).
+    // The images are loaded into copies of 'frames', so the meta data stays available for random access.
+    enum class PrefetchState : char
+    {
+        Empty,
+        Loading,
+        Loaded,
+        // A load task is scheduled or running, but the result is not needed anymore (Seek, close).
+        Cancelled
+    };
+    // Schedules all frames in [begin, begin + window). Requires prefetch_mutex.
+    void Prefetch(int begin, int window);
+    bool TakeFrame(int index, FrameData& data);
+
+    std::unique_ptr<ThreadPool> prefetch_pool;
+    std::mutex prefetch_mutex;
+    std::condition_variable prefetch_cv;
+    std::vector<PrefetchState> prefetch_state;
+    // Number of TakeFrame calls waiting for each frame
+    std::vector<int> prefetch_waiters;
+    std::unordered_map<int, FrameData> prefetched;
+    int prefetch_loading = 0;
 };
 
 
 
+/**
+ * Adds a source stage to the pipeline that streams all frames of this camera.
+ * Note: DatasetCameraBase::getImageSync limits the frame rate to DatasetParameters::playback_fps. Set it high enough
+ * if the pipeline should run as fast as possible.
+ *
+ * Usage:
+ *
+ * ParallelPipeline pipeline;
+ * AddCameraSource(pipeline, camera).map("undistort", undistort, {8, 16}).sink("fusion", fuse, {1, 16, true});
+ */
+inline PipelineStream<FrameData> AddCameraSource(ParallelPipeline& pipeline, CameraBase& camera,
+                                                 const std::string& name = "Camera")
+{
+    return pipeline.source<FrameData>(name, [&camera](FrameData& data) { return camera.getImageSync(data); });
+}
+
 }  // namespace Saiga
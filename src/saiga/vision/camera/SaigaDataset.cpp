@@ -28,7 +28,10 @@ SaigaDataset::SaigaDataset(const DatasetParameters& _params, bool scale_down_dep
     Load();
 }
 
-SaigaDataset::~SaigaDataset() {}
+SaigaDataset::~SaigaDataset()
+{
+    close();
+}
 
 
 
@@ -86,7 +86,10 @@ TumRGBDDataset::TumRGBDDataset(const DatasetParameters& _params, int freiburg)
     Load();
 }
 
-TumRGBDDataset::~TumRGBDDataset() {}
+TumRGBDDataset::~TumRGBDDataset()
+{
+    close();
+}
 
 
 SE3 TumRGBDDataset::getGroundTruth(int frame)
@@ -112,6 +115,10 @@ void TumRGBDDataset::saveRaw(const std::string& dir)
 
 void TumRGBDDataset::LoadImageData(FrameData& data)
 {
+    // Allocated here instead of LoadMetaData, so that only loaded frames use memory.
+    data.image_rgb.create(intrinsics().imageSize.h, intrinsics().imageSize.w);
+    data.depth_image.create(intrinsics().depthImageSize.h, intrinsics().depthImageSize.w);
+
     Image cimg(data.image_file);
     Image dimg(data.depth_file);
     if (cimg.type == UC3)
@@ -320,8 +327,6 @@ void TumRGBDDataset::load(const std::string& datasetDir, bool multithreaded)
             //            makeFrameData(f);
 
             f.id = i;
-            f.image_rgb.create(intrinsics().imageSize.h, intrinsics().imageSize.w);
-            f.depth_image.create(intrinsics().depthImageSize.h, intrinsics().depthImageSize.w);
             f.timeStamp  = d.rgb.timestamp;
             f.image_file       = datasetDir + "/" + d.rgb.img;
             f.depth_file = datasetDir + "/" + d.depth.img;
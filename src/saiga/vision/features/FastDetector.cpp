@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "FastDetector.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define SAIGA_FAST_X86
+#    include <immintrin.h>
+#endif
+
+namespace Saiga
+{
+// Circle offsets (x, y) in clockwise order. The first 9 are repeated at the end, so that every arc of 9 pixels is
+// a contiguous range.
+static constexpr int circle[16][2] = {{0, 3},  {1, 3},   {2, 2},   {3, 1},   {3, 0},  {3, -1}, {2, -2}, {1, -3},
+                                      {0, -3}, {-1, -3}, {-2, -2}, {-3, -1}, {-3, 0}, {-3, 1}, {-2, 2}, {-1, 3}};
+
+static void CircleOffsets(int pitch, int pixel[25])
+{
+    for (int k = 0; k < 25; ++k)
+    {
+        pixel[k] = circle[k % 16][0] + circle[k % 16][1] * pitch;
+    }
+}
+
+// Largest threshold t for which the pixel is still a corner.
+static int CornerScore(const unsigned char* ptr, const int pixel[25])
+{
+    int v = ptr[0];
+    int d[25];
+    for (int k = 0; k < 25; ++k) d[k] = v - ptr[pixel[k]];
+
+    // dark: max over all arcs of the minimum difference
+    // bright: min over all arcs of the maximum difference
+    int dark = -255, bright = 255;
+    for (int k = 0; k < 16; ++k)
+    {
+        int mn = d[k], mx = d[k];
+        for (int i = 1; i < 9; ++i)
+        {
+            mn = std::min(mn, d[k + i]);
+            mx = std::max(mx, d[k + i]);
+        }
+        dark   = std::max(dark, mn);
+        bright = std::min(bright, mx);
+    }
+    return std::max(dark, -bright) - 1;
+}
+
+// Appends the x coordinate of all corners of the row in [x_begin, x_end).
+static void DetectRowScalar(const unsigned char* row, const int pixel[25], int x_begin, int x_end, int threshold,
+                            std::vector<int>& corners)
+{
+    for (int x = x_begin; x < x_end; ++x)
+    {
+        const unsigned char* ptr = row + x;
+        int v                    = ptr[0];
+        int hi                   = v + threshold;
+        int lo                   = v - threshold;
+
+        // Every arc of 9 pixels contains two neighbouring compass pixels (0, 4, 8, 12).
+        int bright = 0, dark = 0;
+        for (int k = 0; k < 4; ++k)
+        {
+            int p = ptr[pixel[k * 4]];
+            bright |= (p > hi) << k;
+            dark |= (p < lo) << k;
+        }
+        auto has_pair = [](int m) { return (m & ((m >> 1) | (m << 3))) & 0xF; };
+        if (!has_pair(bright) && !has_pair(dark)) continue;
+
+        bright = dark = 0;
+        for (int k = 0; k < 16; ++k)
+        {
+            int p = ptr[pixel[k]];
+            bright |= (p > hi) << k;
+            dark |= (p < lo) << k;
+        }
+
+        // 9 contiguous bits in the cyclic 16 bit mask
+        auto has_arc = [](unsigned int m) {
+            m |= m << 16;
+            unsigned int r = m;
+            for (int i = 1; i < 9; ++i) r &= m >> i;
+            return r != 0;
+        };
+        if (has_arc(bright) || has_arc(dark)) corners.push_back(x);
+    }
+}
+
+#ifdef SAIGA_FAST_X86
+__attribute__((target("avx2"))) static inline __m256i LoadSigned(const unsigned char* p)
+{
+    return _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)p), _mm256_set1_epi8(char(0x80)));
+}
+
+// Same test as the SSE2 version of cv::FAST. The pixels are shifted by 128 to use the signed byte comparison.
+// The saturated v + t and v - t reject all pixels correctly at the value range boundaries.
+// Returns a bit mask of the corners in [ptr, ptr + 32).
+__attribute__((target("avx2"))) static inline unsigned int DetectBlockAVX2(const unsigned char* ptr,
+                                                                          const int pixel[25], __m256i t)
+{
+    __m256i v  = LoadSigned(ptr);
+    __m256i hi = _mm256_adds_epi8(v, t);
+    __m256i lo = _mm256_subs_epi8(v, t);
+
+    __m256i x0 = LoadSigned(ptr + pixel[0]);
+    __m256i x1 = LoadSigned(ptr + pixel[4]);
+    __m256i x2 = LoadSigned(ptr + pixel[8]);
+    __m256i x3 = LoadSigned(ptr + pixel[12]);
+
+    __m256i b0 = _mm256_cmpgt_epi8(x0, hi), b1 = _mm256_cmpgt_epi8(x1, hi);
+    __m256i b2 = _mm256_cmpgt_epi8(x2, hi), b3 = _mm256_cmpgt_epi8(x3, hi);
+    __m256i d0 = _mm256_cmpgt_epi8(lo, x0), d1 = _mm256_cmpgt_epi8(lo, x1);
+    __m256i d2 = _mm256_cmpgt_epi8(lo, x2), d3 = _mm256_cmpgt_epi8(lo, x3);
+
+    __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(b0, b1), _mm256_and_si256(b1, b2)),
+                                _mm256_or_si256(_mm256_and_si256(b2, b3), _mm256_and_si256(b3, b0)));
+    m         = _mm256_or_si256(m, _mm256_or_si256(_mm256_and_si256(d0, d1), _mm256_and_si256(d1, d2)));
+    m         = _mm256_or_si256(m, _mm256_or_si256(_mm256_and_si256(d2, d3), _mm256_and_si256(d3, d0)));
+    if (_mm256_movemask_epi8(m) == 0) return 0;
+
+    // Length of the current run (c) and the longest run (max) of brighter/darker pixels.
+    __m256i c0 = _mm256_setzero_si256(), c1 = c0, max0 = c0, max1 = c0;
+    for (int k = 0; k < 25; ++k)
+    {
+        __m256i p  = LoadSigned(ptr + pixel[k]);
+        __m256i m0 = _mm256_cmpgt_epi8(p, hi);
+        __m256i m1 = _mm256_cmpgt_epi8(lo, p);
+
+        c0   = _mm256_and_si256(_mm256_sub_epi8(c0, m0), m0);
+        c1   = _mm256_and_si256(_mm256_sub_epi8(c1, m1), m1);
+        max0 = _mm256_max_epu8(max0, c0);
+        max1 = _mm256_max_epu8(max1, c1);
+    }
+    return _mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_max_epu8(max0, max1), _mm256_set1_epi8(8)));
+}
+
+__attribute__((target("avx2"))) static void DetectRowAVX2(const unsigned char* row, const int pixel[25], int x_begin,
+                                                          int x_end, int threshold, std::vector<int>& corners)
+{
+    if (x_end - x_begin < 32)
+    {
+        DetectRowScalar(row, pixel, x_begin, x_end, threshold, corners);
+        return;
+    }
+
+    const __m256i t = _mm256_set1_epi8(char(threshold));
+    auto push       = [&corners](int x, unsigned int mask) {
+        while (mask)
+        {
+            corners.push_back(x + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    };
+
+    int x = x_begin;
+    for (; x + 32 <= x_end; x += 32)
+    {
+        push(x, DetectBlockAVX2(row + x, pixel, t));
+    }
+
+    // The remaining pixels are tested with one overlapping block at the end of the row.
+    if (x < x_end)
+    {
+        int last = x_end - 32;
+        push(last, DetectBlockAVX2(row + last, pixel, t) >> (x - last) << (x - last));
+    }
+}
+#endif
+
+bool FastBackendSupported(FastBackend backend)
+{
+    switch (backend)
+    {
+        case FastBackend::Scalar:
+            return true;
+#ifdef SAIGA_FAST_X86
+        case FastBackend::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+FastBackend BestFastBackend()
+{
+    static const FastBackend best =
+        FastBackendSupported(FastBackend::AVX2) ? FastBackend::AVX2 : FastBackend::Scalar;
+    return best;
+}
+
+const char* FastBackendName(FastBackend backend)
+{
+    switch (backend)
+    {
+        case FastBackend::AVX2:
+            return "AVX2";
+        default:
+            return "Scalar";
+    }
+}
+
+void DetectFAST(ImageView<const unsigned char> image, std::vector<KeyPoint<float>>& keypoints, int threshold,
+                bool nonmax_suppression, FastBackend backend)
+{
+    SAIGA_ASSERT(FastBackendSupported(backend));
+    keypoints.clear();
+    threshold = std::clamp(threshold, 0, 255);
+
+    int rows = image.rows;
+    int cols = image.cols;
+    if (rows < 7 || cols < 7) return;
+
+    int pixel[25];
+    CircleOffsets(image.pitchBytes, pixel);
+
+    // The signed byte arithmetic of the SIMD test only works for thresholds < 128.
+    if (threshold >= 128) backend = FastBackend::Scalar;
+
+    // Scores of the last 3 rows and the x coordinates of their corners.
+    std::vector<unsigned char> score_buffer(3 * cols);
+    std::vector<int> corner_buffer[3];
+
+    for (int y = 3; y < rows - 2; ++y)
+    {
+        unsigned char* curr = score_buffer.data() + ((y - 3) % 3) * cols;
+        auto& curr_corners  = corner_buffer[(y - 3) % 3];
+        memset(curr, 0, cols);
+        curr_corners.clear();
+
+        if (y < rows - 3)
+        {
+            const unsigned char* row = image.rowPtr(y);
+            switch (backend)
+            {
+#ifdef SAIGA_FAST_X86
+                case FastBackend::AVX2:
+                    DetectRowAVX2(row, pixel, 3, cols - 3, threshold, curr_corners);
+                    break;
+#endif
+                default:
+                    DetectRowScalar(row, pixel, 3, cols - 3, threshold, curr_corners);
+                    break;
+            }
+            for (int x : curr_corners) curr[x] = CornerScore(row + x, pixel);
+        }
+
+        if (y == 3) continue;
+
+        // Non-max suppression of the previous row. All neighbours are known now.
+        const unsigned char* prev  = score_buffer.data() + ((y - 4 + 3) % 3) * cols;
+        const unsigned char* pprev = score_buffer.data() + ((y - 5 + 3) % 3) * cols;
+        for (int x : corner_buffer[(y - 4 + 3) % 3])
+        {
+            int score = prev[x];
+            if (!nonmax_suppression ||
+                (score > prev[x + 1] && score > prev[x - 1] && score > pprev[x - 1] && score > pprev[x] &&
+                 score > pprev[x + 1] && score > curr[x - 1] && score > curr[x] && score > curr[x + 1]))
+            {
+                keypoints.emplace_back(float(x), float(y - 1), 7.f, -1.f, float(score));
+            }
+        }
+    }
+}
+
+}  // namespace Saiga
@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/core/image/imageView.h"
+#include "saiga/vision/features/Features.h"
+
+#include <vector>
+
+namespace Saiga
+{
+/**
+ * Implementations of the FAST segment test.
+ *
+ * AVX2:    32 pixels per iteration (compass pixel rejection + run length counting with saturated bytes)
+ * Scalar:  One pixel per iteration. Also used for the remaining pixels at the end of each row.
+ */
+enum class FastBackend
+{
+    Scalar,
+    AVX2
+};
+
+SAIGA_VISION_API bool FastBackendSupported(FastBackend backend);
+
+// The fastest backend of this CPU
+SAIGA_VISION_API FastBackend BestFastBackend();
+
+SAIGA_VISION_API const char* FastBackendName(FastBackend backend);
+
+/**
+ * FAST-9 corner detector on the 16 pixel circle of radius 3 (cv::FAST with TYPE_9_16).
+ *
+ * A pixel p is a corner if 9 contiguous circle pixels are all brighter than p + threshold or all darker than
+ * p - threshold. The response is the largest threshold for which p is still a corner. With nonmax_suppression only
+ * corners with a larger response than all 8 neighbours are kept.
+ *
+ * The 3 pixels at the image border are not tested. 'keypoints' is cleared and filled in row major order
+ * with size = 7 and angle = -1. All backends compute identical results.
+ */
+SAIGA_VISION_API void DetectFAST(ImageView<const unsigned char> image, std::vector<KeyPoint<float>>& keypoints,
+                                 int threshold, bool nonmax_suppression = true,
+                                 FastBackend backend = BestFastBackend());
+
+}  // namespace Saiga
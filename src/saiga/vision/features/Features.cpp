@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "Features.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define SAIGA_HAMMING_X86
+#    include <immintrin.h>
+#endif
+
+namespace Saiga
+{
+static void DistanceOneToManyScalar(const DescriptorORB& query, const DescriptorORB* train, int n, int* out)
+{
+    for (int j = 0; j < n; ++j)
+    {
+        out[j] = distance(query, train[j]);
+    }
+}
+
+#ifdef SAIGA_HAMMING_X86
+// The SIMD functions are compiled with target attributes, so the library itself doesn't require AVX2/AVX512.
+
+__attribute__((target("avx2"))) static inline __m256i PopcountBytesAVX2(__m256i x)
+{
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2,
+                                         2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i lo             = _mm256_and_si256(x, low_mask);
+    __m256i hi             = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+    return _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+}
+
+// Sums the four 64-bit lanes. Each lane holds four 16-bit counters, which don't overflow (max 256).
+__attribute__((target("avx2"))) static inline __m128i HorizontalSum16x4(__m256i t)
+{
+    __m128i h = _mm_add_epi64(_mm256_castsi256_si128(t), _mm256_extracti128_si256(t, 1));
+    return _mm_add_epi64(h, _mm_unpackhi_epi64(h, h));
+}
+
+__attribute__((target("avx2"))) static void DistanceOneToManyAVX2(const DescriptorORB& query,
+                                                                   const DescriptorORB* train, int n, int* out)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i q          = _mm256_loadu_si256((const __m256i*)query.data());
+
+    int j = 0;
+    for (; j + 4 <= n; j += 4)
+    {
+        auto t = (const __m256i*)train[j].data();
+        // Per descriptor: 4 partial sums in the 64-bit lanes
+        __m256i s0 = _mm256_sad_epu8(PopcountBytesAVX2(_mm256_xor_si256(q, _mm256_loadu_si256(t + 0))), zero);
+        __m256i s1 = _mm256_sad_epu8(PopcountBytesAVX2(_mm256_xor_si256(q, _mm256_loadu_si256(t + 1))), zero);
+        __m256i s2 = _mm256_sad_epu8(PopcountBytesAVX2(_mm256_xor_si256(q, _mm256_loadu_si256(t + 2))), zero);
+        __m256i s3 = _mm256_sad_epu8(PopcountBytesAVX2(_mm256_xor_si256(q, _mm256_loadu_si256(t + 3))), zero);
+
+        // Pack the four descriptors into 16-bit fields and reduce all of them at once
+        __m256i packed = _mm256_or_si256(_mm256_or_si256(s0, _mm256_slli_epi64(s1, 16)),
+                                         _mm256_or_si256(_mm256_slli_epi64(s2, 32), _mm256_slli_epi64(s3, 48)));
+        __m128i sum    = HorizontalSum16x4(packed);
+        _mm_storeu_si128((__m128i*)(out + j), _mm_cvtepu16_epi32(sum));
+    }
+    DistanceOneToManyScalar(query, train + j, n - j, out + j);
+}
+
+__attribute__((target("avx2,avx512f,avx512vpopcntdq"))) static void DistanceOneToManyAVX512(
+    const DescriptorORB& query, const DescriptorORB* train, int n, int* out)
+{
+    // Two copies of the query, because every register holds two descriptors
+    __m512i q = _mm512_broadcast_i64x4(_mm256_loadu_si256((const __m256i*)query.data()));
+
+    int j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        auto t = (const __m512i*)train[j].data();
+        // p0 = [j, j+1], p1 = [j+2, j+3], ...
+        __m512i p0 = _mm512_popcnt_epi64(_mm512_xor_si512(q, _mm512_loadu_si512(t + 0)));
+        __m512i p1 = _mm512_popcnt_epi64(_mm512_xor_si512(q, _mm512_loadu_si512(t + 1)));
+        __m512i p2 = _mm512_popcnt_epi64(_mm512_xor_si512(q, _mm512_loadu_si512(t + 2)));
+        __m512i p3 = _mm512_popcnt_epi64(_mm512_xor_si512(q, _mm512_loadu_si512(t + 3)));
+
+        __m512i packed = _mm512_or_si512(_mm512_or_si512(p0, _mm512_slli_epi64(p1, 16)),
+                                         _mm512_or_si512(_mm512_slli_epi64(p2, 32), _mm512_slli_epi64(p3, 48)));
+
+        // The lower half contains j, j+2, j+4, j+6 and the upper half j+1, j+3, j+5, j+7
+        __m128i even = HorizontalSum16x4(_mm512_castsi512_si256(packed));
+        __m128i odd  = HorizontalSum16x4(_mm512_extracti64x4_epi64(packed, 1));
+
+        // Interleave -> j, j+1, ..., j+7
+        __m128i all = _mm_unpacklo_epi16(even, odd);
+        _mm256_storeu_si256((__m256i*)(out + j), _mm256_cvtepu16_epi32(all));
+    }
+    DistanceOneToManyAVX2(query, train + j, n - j, out + j);
+}
+#endif
+
+bool HammingBackendSupported(HammingBackend backend)
+{
+    switch (backend)
+    {
+        case HammingBackend::Scalar:
+            return true;
+#ifdef SAIGA_HAMMING_X86
+        case HammingBackend::AVX2:
+            return __builtin_cpu_supports("avx2");
+        case HammingBackend::AVX512:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("avx512f") &&
+                   __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+        default:
+            return false;
+    }
+}
+
+HammingBackend BestHammingBackend()
+{
+    static const HammingBackend best = []() {
+        for (auto b : {HammingBackend::AVX512, HammingBackend::AVX2})
+        {
+            if (HammingBackendSupported(b)) return b;
+        }
+        return HammingBackend::Scalar;
+    }();
+    return best;
+}
+
+const char* HammingBackendName(HammingBackend backend)
+{
+    switch (backend)
+    {
+        case HammingBackend::AVX2:
+            return "AVX2";
+        case HammingBackend::AVX512:
+            return "AVX512";
+        default:
+            return "Scalar";
+    }
+}
+
+void DistanceOneToMany(const DescriptorORB& query, ArrayView<const DescriptorORB> train, int* out,
+                       HammingBackend backend)
+{
+    SAIGA_ASSERT(HammingBackendSupported(backend));
+    int n = train.size();
+    switch (backend)
+    {
+#ifdef SAIGA_HAMMING_X86
+        case HammingBackend::AVX512:
+            DistanceOneToManyAVX512(query, train.data(), n, out);
+            break;
+        case HammingBackend::AVX2:
+            DistanceOneToManyAVX2(query, train.data(), n, out);
+            break;
+#endif
+        default:
+            DistanceOneToManyScalar(query, train.data(), n, out);
+            break;
+    }
+}
+
+void DistanceManyToMany(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train, int* out,
+                        HammingBackend backend)
+{
+    // The train descriptors are processed in blocks that fit into the L1 cache (512 * 32 bytes). Each thread
+    // compares its chunk of query descriptors to one block before moving to the next.
+    constexpr int train_block = 512;
+    constexpr int query_block = 64;
+
+    int n = query.size();
+    int m = train.size();
+#pragma omp parallel for schedule(dynamic) if (size_t(n) * m > 100000)
+    for (int q = 0; q < n; q += query_block)
+    {
+        int q_end = std::min(q + query_block, n);
+        for (int t = 0; t < m; t += train_block)
+        {
+            auto block = train.slice_n(t, std::min(train_block, m - t));
+            for (int i = q; i < q_end; ++i)
+            {
+                DistanceOneToMany(query[i], block, out + size_t(i) * m + t, backend);
+            }
+        }
+    }
+}
+
+}  // namespace Saiga
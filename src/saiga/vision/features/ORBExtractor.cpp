@@ -60,17 +60,10 @@
 
 #include "ORBExtractor.h"
 
-
-#ifdef SAIGA_USE_OPENCV
-
-#    include "saiga/core/time/all.h"
-#    include "saiga/core/util/Thread/omp.h"
-#    include "saiga/vision/opencv/opencv.h"
-
-#    include <opencv2/core/core.hpp>
-#    include <opencv2/features2d/features2d.hpp>
-#    include <opencv2/highgui/highgui.hpp>
-#    include <opencv2/imgproc/imgproc.hpp>
+#include "saiga/core/image/imageTransformations.h"
+#include "saiga/core/time/all.h"
+#include "saiga/core/util/Thread/omp.h"
+#include "saiga/vision/features/FastDetector.h"
 
 
 namespace Saiga
@@ -90,13 +83,13 @@ ORBExtractor::ORBExtractor(int _nfeatures, float _scaleFactor, int _nlevels, int
 void ORBExtractor::DetectKeypoints()
 {
     const float W = 30;
-#    pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
     for (int level = 0; level < num_levels; ++level)
     {
         auto& level_data = levels[level];
         level_data.keypoints_tmp.clear();
 
-        auto image = Saiga::ImageViewToMat(level_data.image);
+        auto image = level_data.image;
 
         const int minBorderX = EDGE_THRESHOLD - 3;
         const int minBorderY = minBorderX;
@@ -112,43 +105,43 @@ void ORBExtractor::DetectKeypoints()
         const int wCell = ceil(width / nCols);
         const int hCell = ceil(height / nRows);
 
+        // FAST is computed once for the complete level. The cells of the grid overlap by 6 pixels, therefore
+        // every keypoint of the level belongs to exactly one cell (FAST skips 3 pixels at the border).
+        auto& cell_keypoints = level_data.keypoints_cell;
+        DetectFAST(image.subImageView(minBorderY, minBorderX, maxBorderY - minBorderY, maxBorderX - minBorderX),
+                   level_data.keypoints_tmp, th_fast, true);
+
+        std::vector<char> cell_has_keypoint(nRows * nCols, false);
+        for (auto& kp : level_data.keypoints_tmp)
+        {
+            int i = std::min((int(kp.point.y()) - 3) / hCell, nRows - 1);
+            int j = std::min((int(kp.point.x()) - 3) / wCell, nCols - 1);
+            cell_has_keypoint[i * nCols + j] = true;
+        }
+
+        // Empty cells are searched again with the lower threshold.
         for (int i = 0; i < nRows; i++)
         {
-            const float iniY = minBorderY + i * hCell;
-            float maxY       = iniY + hCell + 6;
+            const int iniY = minBorderY + i * hCell;
+            int maxY       = iniY + hCell + 6;
 
             if (iniY >= maxBorderY - 3) continue;
             if (maxY > maxBorderY) maxY = maxBorderY;
 
             for (int j = 0; j < nCols; j++)
             {
-                const float iniX = minBorderX + j * wCell;
-                float maxX       = iniX + wCell + 6;
+                const int iniX = minBorderX + j * wCell;
+                int maxX       = iniX + wCell + 6;
                 if (iniX >= maxBorderX - 6) continue;
                 if (maxX > maxBorderX) maxX = maxBorderX;
 
+                if (cell_has_keypoint[i * nCols + j]) continue;
 
-                std::vector<cv::KeyPoint> cv_KeysCell;
-
-                FAST(image.rowRange(iniY, maxY).colRange(iniX, maxX), cv_KeysCell, th_fast, true);
-                int dis_before = cv_KeysCell.size();
-
-                if (cv_KeysCell.empty())
-                {
-                    FAST(image.rowRange(iniY, maxY).colRange(iniX, maxX), cv_KeysCell, th_fast_min, true);
-                    dis_before = cv_KeysCell.size();
-                }
+                DetectFAST(image.subImageView(iniY, iniX, maxY - iniY, maxX - iniX), cell_keypoints, th_fast_min,
+                           true);
 
-                for (auto& cvkp : cv_KeysCell)
+                for (auto kp : cell_keypoints)
                 {
-                    KeypointType kp;
-                    kp.point    = Saiga::vec2(cvkp.pt.x, cvkp.pt.y);
-                    kp.size     = cvkp.size;
-                    kp.angle    = cvkp.angle;
-                    kp.response = cvkp.response;
-                    kp.octave   = cvkp.octave;
-
-
                     kp.point.x() += j * wCell;
                     kp.point.y() += i * hCell;
                     level_data.keypoints_tmp.push_back(kp);
@@ -168,8 +161,8 @@ void ORBExtractor::DetectKeypoints()
             kp.point.y() += minBorderY;
             kp.octave = level;
             kp.size   = scaledPatchSize;
-            kp.angle  = orb.ComputeAngle(level_data.image, kp.point);
         }
+        orb.ComputeAngles(level_data.image, level_data.keypoints_tmp);
     }
 }
 
@@ -178,7 +171,6 @@ void ORBExtractor::DetectKeypoints()
 void ORBExtractor::Detect(Saiga::ImageView<unsigned char> inputImage, std::vector<KeypointType>& _keypoints,
                           std::vector<Saiga::DescriptorORB>& outputDescriptors)
 {
-    cv::setNumThreads(1);
     if (inputImage.empty()) return;
 
 
@@ -198,7 +190,7 @@ void ORBExtractor::Detect(Saiga::ImageView<unsigned char> inputImage, std::vecto
     outputDescriptors.resize(nkeypoints);
     _keypoints.resize(nkeypoints);
 
-#    pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
     for (int level = 0; level < num_levels; ++level)
     {
         auto& level_data    = levels[level];
@@ -207,17 +199,11 @@ void ORBExtractor::Detect(Saiga::ImageView<unsigned char> inputImage, std::vecto
 
         if (nkeypointsLevel == 0) continue;
 
-        auto image       = Saiga::ImageViewToMat(level_data.image);
-        auto image_gauss = Saiga::ImageViewToMat(level_data.image_gauss.getImageView());
-
-        cv::GaussianBlur(image, image_gauss, cv::Size(7, 7), 2, 2, cv::BORDER_REFLECT_101);
+        ImageTransformation::GaussianBlur(level_data.image, level_data.image_gauss.getImageView(), 3, 2);
 
         int offset = level_data.offset;
-        for (size_t i = 0; i < keypoints.size(); i++)
-        {
-            outputDescriptors[offset + i] =
-                orb.ComputeDescriptor(level_data.image_gauss.getImageView(), keypoints[i].point, keypoints[i].angle);
-        }
+        orb.ComputeDescriptors(level_data.image_gauss.getImageView(), keypoints,
+                               ArrayView<DescriptorORB>(outputDescriptors.data() + offset, nkeypointsLevel));
 
         // Scale keypoint coordinates
         if (level != 0)
@@ -236,7 +222,7 @@ void ORBExtractor::Detect(Saiga::ImageView<unsigned char> inputImage, std::vecto
 void ORBExtractor::AllocatePyramid(int rows, int cols)
 {
     SAIGA_ASSERT(!levels.empty());
-    if (levels.front().image.valid()) return;
+    if (levels.front().image.valid() && levels.front().image.rows == rows && levels.front().image.cols == cols) return;
 
     for (int level = 0; level < num_levels; ++level)
     {
@@ -262,30 +248,18 @@ void ORBExtractor::ComputePyramid(Saiga::ImageView<unsigned char> image)
 {
     AllocatePyramid(image.rows, image.cols);
 
-    cv::Mat cv_image = Saiga::ImageViewToMat(image);
-    assert(cv_image.type() == CV_8UC1);
-
     SAIGA_ASSERT(!levels.empty());
-    cv::copyMakeBorder(cv_image, Saiga::ImageViewToMat(levels.front().image_with_border.getImageView()), EDGE_THRESHOLD,
-                       EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD, cv::BORDER_REFLECT_101);
+    image.copyTo(levels.front().image);
+    ImageTransformation::FillBorderReflect101(levels.front().image_with_border.getImageView(), EDGE_THRESHOLD);
 
     for (int level = 1; level < num_levels; ++level)
     {
         auto& level_data      = levels[level];
         auto& level_data_prev = levels[level - 1];
 
-        auto image      = Saiga::ImageViewToMat(level_data.image);
-        auto image_prev = Saiga::ImageViewToMat(level_data_prev.image);
-        auto temp       = Saiga::ImageViewToMat(levels.front().image_with_border.getImageView());
-
-
-        cv::resize(image_prev, image, cv::Size(image.cols, image.rows), 0, 0, cv::INTER_LINEAR);
-
-        cv::copyMakeBorder(image, temp, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD,
-                           cv::BORDER_REFLECT_101 + cv::BORDER_ISOLATED);
+        ImageTransformation::ResizeLinear(level_data_prev.image, level_data.image);
+        ImageTransformation::FillBorderReflect101(level_data.image_with_border.getImageView(), EDGE_THRESHOLD);
     }
 }
 
 }  // namespace Saiga
-
-#endif
@@ -37,10 +37,14 @@
 
 #include <vector>
 
-#ifdef SAIGA_USE_OPENCV
-
 namespace Saiga
 {
+/**
+ * ORB feature extraction (FAST keypoints in a grid, quadtree distribution, oriented BRIEF descriptors).
+ *
+ * The image pyramid, the gaussian blur and the FAST detection use the native ImageView kernels of
+ * ImageTransformation and DetectFAST. OpenCV is not required.
+ */
 class SAIGA_VISION_API ORBExtractor
 {
    public:
@@ -84,11 +88,10 @@ class SAIGA_VISION_API ORBExtractor
         Saiga::TemplatedImage<unsigned char> image_gauss;
         Saiga::ImageView<unsigned char> image;
         std::vector<KeypointType> keypoints_tmp;
+        std::vector<KeypointType> keypoints_cell;
         Saiga::QuadtreeFeatureDistributor distributor;
     };
     std::vector<Level> levels;
 };
 
 }  // namespace Saiga
-
-#endif
@@ -7,6 +7,11 @@
 #include "OrbPattern.h"
 
 #include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define SAIGA_ORB_X86
+#    include <immintrin.h>
+#endif
 using namespace std;
 
 namespace Saiga
@@ -21,6 +26,47 @@ ORB::ORB()
     u_max = ORBPattern::AngleUmax();
     descriptor_pattern =
         std::vector<ivec2>(ORBPattern::DescriptorPattern().begin(), ORBPattern::DescriptorPattern().end());
+
+    // Same rotation and rounding as in ComputeDescriptor
+    rotated_pattern.resize(angle_bins * 1024);
+    for (int bin = 0; bin < angle_bins; ++bin)
+    {
+        float angle = Saiga::radians(bin * (360.f / angle_bins));
+        float a = (float)cos(angle), b = (float)sin(angle);
+
+        int* table = rotated_pattern.data() + bin * 1024;
+        for (int i = 0; i < 256; ++i)
+        {
+            for (int k = 0; k < 2; ++k)
+            {
+                const ivec2& p           = descriptor_pattern[i * 2 + k];
+                table[k * 512 + i]       = iRound(p.x() * a - p.y() * b);
+                table[k * 512 + 256 + i] = iRound(p.x() * b + p.y() * a);
+            }
+        }
+    }
+
+    // Per row: u-weights of the pixels [-16, 0) and [0, 16), v-weights of the same pixels.
+    // Pixels outside of the circular patch have weight 0.
+    angle_weights.resize((2 * HALF_PATCH_SIZE + 1) * 64);
+    for (int v = -HALF_PATCH_SIZE; v <= HALF_PATCH_SIZE; ++v)
+    {
+        short* w = angle_weights.data() + (v + HALF_PATCH_SIZE) * 64;
+        int d    = u_max[std::abs(v)];
+        for (int k = 0; k < 32; ++k)
+        {
+            int u       = k - 16;
+            bool inside = std::abs(u) <= d;
+            w[k]        = inside ? u : 0;
+            w[32 + k]   = inside ? v : 0;
+        }
+    }
+}
+
+int ORB::AngleBin(float angle_degrees)
+{
+    int bin = iRound(angle_degrees * (angle_bins / 360.f)) % angle_bins;
+    return bin < 0 ? bin + angle_bins : bin;
 }
 
 float ORB::ComputeAngle(Saiga::ImageView<unsigned char> image, const Saiga::vec2& pt)
@@ -123,4 +169,140 @@ DescriptorORB ORB::ComputeDescriptor(Saiga::ImageView<unsigned char> image, cons
     }
     return result;
 }
+
+static void DescriptorScalar(const unsigned char* center, int step, const int* table, unsigned char* desc)
+{
+    for (int i = 0; i < 32; ++i)
+    {
+        int val = 0;
+        for (int j = 0; j < 8; ++j)
+        {
+            int k  = i * 8 + j;
+            int t0 = center[table[256 + k] * step + table[k]];
+            int t1 = center[table[768 + k] * step + table[512 + k]];
+            val |= (t0 < t1) << j;
+        }
+        desc[i] = val;
+    }
+}
+
+#ifdef SAIGA_ORB_X86
+// 8 tests per iteration. The pixels are loaded with 32 bit gathers (the upper 3 bytes are masked out).
+__attribute__((target("avx2"))) static void DescriptorAVX2(const unsigned char* center, int step, const int* table,
+                                                           unsigned char* desc)
+{
+    const __m256i vstep = _mm256_set1_epi32(step);
+    const __m256i mask  = _mm256_set1_epi32(0xFF);
+    const int* base     = (const int*)center;
+    for (int i = 0; i < 32; ++i)
+    {
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)(table + i * 8));
+        __m256i y0 = _mm256_loadu_si256((const __m256i*)(table + 256 + i * 8));
+        __m256i x1 = _mm256_loadu_si256((const __m256i*)(table + 512 + i * 8));
+        __m256i y1 = _mm256_loadu_si256((const __m256i*)(table + 768 + i * 8));
+
+        __m256i o0 = _mm256_add_epi32(_mm256_mullo_epi32(y0, vstep), x0);
+        __m256i o1 = _mm256_add_epi32(_mm256_mullo_epi32(y1, vstep), x1);
+
+        __m256i t0 = _mm256_and_si256(_mm256_i32gather_epi32(base, o0, 1), mask);
+        __m256i t1 = _mm256_and_si256(_mm256_i32gather_epi32(base, o1, 1), mask);
+
+        desc[i] = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(t1, t0)));
+    }
+}
+
+// Intensity centroid of the circular patch. Each row is loaded as 32 pixels [-16, 16) and multiplied with the
+// precomputed u and v weights (zero outside of the patch).
+__attribute__((target("avx2"))) static float AngleAVX2(const unsigned char* center, int step, const short* weights)
+{
+    __m256i m10 = _mm256_setzero_si256();
+    __m256i m01 = _mm256_setzero_si256();
+    for (int v = -HALF_PATCH_SIZE; v <= HALF_PATCH_SIZE; ++v)
+    {
+        const unsigned char* row = center + v * step;
+        const short* w           = weights + (v + HALF_PATCH_SIZE) * 64;
+
+        __m256i p0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(row - 16)));
+        __m256i p1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(row)));
+
+        m10 = _mm256_add_epi32(m10, _mm256_madd_epi16(p0, _mm256_loadu_si256((const __m256i*)(w))));
+        m10 = _mm256_add_epi32(m10, _mm256_madd_epi16(p1, _mm256_loadu_si256((const __m256i*)(w + 16))));
+        m01 = _mm256_add_epi32(m01, _mm256_madd_epi16(p0, _mm256_loadu_si256((const __m256i*)(w + 32))));
+        m01 = _mm256_add_epi32(m01, _mm256_madd_epi16(p1, _mm256_loadu_si256((const __m256i*)(w + 48))));
+    }
+
+    // Horizontal sums
+    __m256i s  = _mm256_hadd_epi32(m10, m01);
+    s          = _mm256_hadd_epi32(s, s);
+    __m128i r  = _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+    int sum_10 = _mm_cvtsi128_si32(r);
+    int sum_01 = _mm_extract_epi32(r, 1);
+
+    float angle = Saiga::degrees(atan2((float)sum_01, (float)sum_10));
+    return (angle < 0) * 360 + angle;
+}
+#endif
+
+static bool HasAVX2()
+{
+#ifdef SAIGA_ORB_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+void ORB::ComputeAngles(Saiga::ImageView<unsigned char> image, ArrayView<KeyPoint<float>> keypoints, int num_threads)
+{
+    const bool avx2 = HasAVX2();
+    int n           = keypoints.size();
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 64) if (num_threads > 1 && n > 128)
+    for (int i = 0; i < n; ++i)
+    {
+        auto& kp = keypoints[i];
+        int x    = iRound(kp.point.x());
+        int y    = iRound(kp.point.y());
+#ifdef SAIGA_ORB_X86
+        // The 32 pixel rows must be inside the image
+        if (avx2 && x >= 16 && x + 16 <= image.w && y >= HALF_PATCH_SIZE && y + HALF_PATCH_SIZE < image.h)
+        {
+            kp.angle = AngleAVX2(&image(y, x), image.pitchBytes, angle_weights.data());
+            continue;
+        }
+#endif
+        kp.angle = ComputeAngle(image, kp.point);
+    }
+}
+
+void ORB::ComputeDescriptors(Saiga::ImageView<unsigned char> image, ArrayView<const KeyPoint<float>> keypoints,
+                             ArrayView<DescriptorORB> descriptors, int num_threads)
+{
+    SAIGA_ASSERT(keypoints.size() == descriptors.size());
+    // The rotated pattern is inside a radius of 13 * sqrt(2) < 19 pixels.
+    // The gathers read 3 additional bytes after the last pixel.
+    const int r     = 19;
+    const bool avx2 = HasAVX2();
+    int n           = keypoints.size();
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic, 64) if (num_threads > 1 && n > 128)
+    for (int i = 0; i < n; ++i)
+    {
+        auto& kp   = keypoints[i];
+        int x      = iRound(kp.point.x());
+        int y      = iRound(kp.point.y());
+        auto table = rotated_pattern.data() + AngleBin(kp.angle) * 1024;
+        auto desc  = (unsigned char*)descriptors[i].data();
+
+        const unsigned char* center = &image(y, x);
+#ifdef SAIGA_ORB_X86
+        if (avx2 && x >= r && x + r + 3 < image.w && y >= r && y + r < image.h)
+        {
+            DescriptorAVX2(center, image.pitchBytes, table, desc);
+            continue;
+        }
+#endif
+        DescriptorScalar(center, image.pitchBytes, table, desc);
+    }
+}
+
 }  // namespace Saiga
@@ -31,14 +31,45 @@ namespace Saiga
 class SAIGA_VISION_API ORB
 {
    public:
+    // The batch functions use rotated patterns for angle_bins discrete angles (12 degree steps).
+    static constexpr int angle_bins = 30;
+
     ORB();
     float ComputeAngle(Saiga::ImageView<unsigned char> image, const vec2& pt);
     DescriptorORB ComputeDescriptor(Saiga::ImageView<unsigned char> image, const vec2& point, float angle_degrees);
 
+    /**
+     * Batch versions of ComputeAngle and ComputeDescriptor for all keypoints of one image (pyramid level).
+     *
+     * The keypoints are processed in chunks by num_threads threads. The AVX2 implementation is selected at runtime,
+     * keypoints close to the image border use a scalar fallback.
+     *
+     * ComputeAngles writes the same angles as ComputeAngle to keypoints[i].angle.
+     *
+     * ComputeDescriptors rounds the keypoint position to the nearest pixel and the angle to the nearest of the
+     * angle_bins rotated patterns. The result is ComputeDescriptor(image, round(point), BinAngle(angle)), except for
+     * a few bits where a rotated pattern point lies exactly between two pixels.
+     * The keypoints must be at least 19 pixels away from the image border (same as ComputeDescriptor).
+     */
+    void ComputeAngles(Saiga::ImageView<unsigned char> image, ArrayView<KeyPoint<float>> keypoints,
+                       int num_threads = 1);
+    void ComputeDescriptors(Saiga::ImageView<unsigned char> image, ArrayView<const KeyPoint<float>> keypoints,
+                            ArrayView<DescriptorORB> descriptors, int num_threads = 1);
+
+    // The angle (in degrees) of the rotated pattern that is used for 'angle_degrees'.
+    static int AngleBin(float angle_degrees);
+    static float BinAngle(float angle_degrees) { return AngleBin(angle_degrees) * (360.f / angle_bins); }
 
    private:
     std::vector<int> u_max;
     std::vector<ivec2> descriptor_pattern;
+
+    // For each angle bin 1024 integers: x of the first point of all 256 tests, y of the first point,
+    // x of the second point, y of the second point.
+    std::vector<int> rotated_pattern;
+
+    // Intensity centroid weights for the rows v = -15..15 of the circular patch (see ComputeAngles).
+    std::vector<short> angle_weights;
 };
 
 
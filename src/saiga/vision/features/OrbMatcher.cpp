@@ -0,0 +1,141 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "OrbMatcher.h"
+
+namespace Saiga
+{
+// The distances of 'query_block' x 'train_block' descriptors are computed at once. The train block (16KB) stays in
+// the L1 cache while it is compared to all queries of the block.
+static constexpr int query_block = 32;
+static constexpr int train_block = 512;
+
+// Inserts the match into the sorted list of length k. A match with the same distance as an existing one is inserted
+// behind it, therefore lower train indices win.
+static inline void InsertSorted(DescriptorMatch* list, int k, const DescriptorMatch& m)
+{
+    int p = k - 1;
+    while (p > 0 && list[p - 1].distance > m.distance)
+    {
+        list[p] = list[p - 1];
+        --p;
+    }
+    list[p] = m;
+}
+
+// If train_best != nullptr, the best query for each train descriptor is computed as well (for the cross check).
+static void MatchKnnImpl(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train, int k,
+                         DescriptorMatch* knn, DescriptorMatch* train_best)
+{
+    int n = query.size();
+    int m = train.size();
+
+    for (int i = 0; i < n; ++i)
+    {
+        for (int j = 0; j < k; ++j) knn[size_t(i) * k + j] = {i, -1, std::numeric_limits<int>::max()};
+    }
+    if (train_best)
+    {
+        for (int j = 0; j < m; ++j) train_best[j] = {-1, j, std::numeric_limits<int>::max()};
+    }
+
+    auto backend = BestHammingBackend();
+
+#pragma omp parallel if (size_t(n) * m > 100000)
+    {
+        std::vector<int> tile(query_block * train_block);
+        std::vector<DescriptorMatch> local_best;
+        if (train_best) local_best.assign(train_best, train_best + m);
+
+#pragma omp for schedule(dynamic)
+        for (int q = 0; q < n; q += query_block)
+        {
+            int q_end = std::min(q + query_block, n);
+            for (int t = 0; t < m; t += train_block)
+            {
+                int t_n    = std::min(train_block, m - t);
+                auto block = train.slice_n(t, t_n);
+                for (int i = q; i < q_end; ++i)
+                {
+                    DistanceOneToMany(query[i], block, tile.data() + (i - q) * train_block, backend);
+                }
+
+                for (int i = q; i < q_end; ++i)
+                {
+                    const int* dis        = tile.data() + (i - q) * train_block;
+                    DescriptorMatch* list = knn + size_t(i) * k;
+                    for (int j = 0; j < t_n; ++j)
+                    {
+                        if (dis[j] < list[k - 1].distance) InsertSorted(list, k, {i, t + j, dis[j]});
+                    }
+
+                    if (train_best)
+                    {
+                        for (int j = 0; j < t_n; ++j)
+                        {
+                            auto& best = local_best[t + j];
+                            if (dis[j] < best.distance) best = {i, t + j, dis[j]};
+                        }
+                    }
+                }
+            }
+        }
+
+        if (train_best)
+        {
+#pragma omp critical
+            {
+                // The queries of one thread are processed in increasing order. Use the same tie breaking here.
+                for (int j = 0; j < m; ++j)
+                {
+                    auto& a = train_best[j];
+                    auto& b = local_best[j];
+                    if (b.distance < a.distance || (b.distance == a.distance && b.query < a.query)) a = b;
+                }
+            }
+        }
+    }
+}
+
+void MatchKnnORB(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train, int k,
+                 ArrayView<DescriptorMatch> knn)
+{
+    SAIGA_ASSERT(k > 0);
+    SAIGA_ASSERT(knn.size() == query.size() * k);
+    MatchKnnImpl(query, train, k, knn.data(), nullptr);
+}
+
+std::vector<DescriptorMatch> MatchORB(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train,
+                                      const ORBMatchParams& params)
+{
+    int n = query.size();
+    int k = params.ratio < 1 ? 2 : 1;
+
+    std::vector<DescriptorMatch> knn(size_t(n) * k);
+    std::vector<DescriptorMatch> train_best(params.cross_check ? train.size() : 0);
+    MatchKnnImpl(query, train, k, knn.data(), params.cross_check ? train_best.data() : nullptr);
+
+    std::vector<DescriptorMatch> result;
+    result.reserve(n);
+    for (int i = 0; i < n; ++i)
+    {
+        auto& best = knn[size_t(i) * k];
+        if (best.train < 0 || best.distance > params.max_distance) continue;
+
+        if (k == 2)
+        {
+            auto& second = knn[size_t(i) * k + 1];
+            if (second.train >= 0 && float(best.distance) > float(second.distance) * params.ratio) continue;
+        }
+
+        if (params.cross_check && train_best[best.train].query != i) continue;
+
+        result.push_back(best);
+    }
+    return result;
+}
+
+}  // namespace Saiga
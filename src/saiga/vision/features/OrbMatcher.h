@@ -0,0 +1,54 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/vision/features/Features.h"
+
+#include <vector>
+
+namespace Saiga
+{
+struct DescriptorMatch
+{
+    int query    = -1;
+    int train    = -1;
+    int distance = std::numeric_limits<int>::max();
+};
+
+struct ORBMatchParams
+{
+    // Matches with a larger hamming distance are rejected.
+    int max_distance = 100;
+
+    // Lowe's ratio test: best <= ratio * second_best. Disabled if >= 1.
+    float ratio = 0.8;
+
+    // Only keep matches that are also the best match in the opposite direction.
+    bool cross_check = false;
+};
+
+/**
+ * Brute force k-nearest neighbor matching of ORB descriptors in contiguous arrays.
+ *
+ * The distances are computed tile by tile with DistanceOneToMany and the query descriptors are distributed over all
+ * OpenMP threads. On equal distances, the lower train index is preferred.
+ *
+ * The k results of query i are stored at knn[i * k, i * k + k) sorted by distance. If train has less than k
+ * descriptors, the remaining entries have train index -1.
+ */
+SAIGA_VISION_API void MatchKnnORB(ArrayView<const DescriptorORB> query, ArrayView<const DescriptorORB> train, int k,
+                                  ArrayView<DescriptorMatch> knn);
+
+/**
+ * Returns the best match of each query descriptor which passes the filters in params.
+ * The result is sorted by query index.
+ */
+SAIGA_VISION_API std::vector<DescriptorMatch> MatchORB(ArrayView<const DescriptorORB> query,
+                                                       ArrayView<const DescriptorORB> train,
+                                                       const ORBMatchParams& params = ORBMatchParams());
+
+}  // namespace Saiga
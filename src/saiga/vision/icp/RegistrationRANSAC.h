@@ -33,6 +33,10 @@ class RegistrationProjectRANSAC
     IntrinsicsPinholed camera1, camera2;
     double threshold;
 
+    // Optional. See RansacParameters.
+    double confidence = 0;
+    int preTestPoints = 0;
+
 
     void clear()
     {
@@ -69,7 +73,8 @@ class RegistrationProjectRANSAC
         int bestInliers  = 0;
         double bestScale = 1;
 
-        for (int i = 0; i < maxIterations; ++i)
+        int requiredIterations = maxIterations;
+        for (int i = 0; i < requiredIterations; ++i)
         {
             // Get 3 matches and store them in A,B
             for (auto j : Range(0, sampleSize))
@@ -100,11 +105,11 @@ class RegistrationProjectRANSAC
             {
                 DSim3 T(rel, scale);
                 // if we have that much scale drift something is broken an
-                if (scale > 0.2 && scale < 5) currentInliers = numInliers(T);
+                if (scale > 0.2 && scale < 5 && preTest(T, dis)) currentInliers = numInliers(T, bestInliers);
             }
             else
             {
-                currentInliers = numInliers(rel);
+                if (preTest(rel, dis)) currentInliers = numInliers(rel, bestInliers);
             }
 
             //            std::cout << "ransac test " << currentInliers << std::endl;
@@ -113,34 +118,59 @@ class RegistrationProjectRANSAC
                 bestInliers = currentInliers;
                 bestT       = rel;
                 bestScale   = scale;
+
+                if (confidence > 0)
+                {
+                    requiredIterations = RansacRequiredIterations(double(bestInliers) / N,
+                                                                  sampleSize + preTestPoints, confidence, maxIterations);
+                }
             }
         }
         return {bestT, bestScale, bestInliers};
     }
 
+    // Returns the number of inliers.
+    // The evaluation stops early if the result can't be larger than stopAt.
     template <typename Transformation>
-    int numInliers(const Transformation& T)
+    int numInliers(const Transformation& T, int stopAt = -1)
     {
         int count          = 0;
         Transformation T12 = T;
         Transformation T21 = T.inverse();
         for (auto i : Range(0, N))
         {
-            Vec3 point1inImage2 = camera2.project3(T12 * points1[i]);
-            Vec3 point2inImage1 = camera1.project3(T21 * points2[i]);
+            count += isInlier(T12, T21, i);
+            if (count + (N - i - 1) <= stopAt) break;
+        }
+        return count;
+    }
 
-            // projected point is behind one of the cameras
-            if (point1inImage2(2) < 0 || point2inImage1(2) < 0) continue;
+    template <typename Transformation>
+    bool isInlier(const Transformation& T12, const Transformation& T21, int i)
+    {
+        Vec3 point1inImage2 = camera2.project3(T12 * points1[i]);
+        Vec3 point2inImage1 = camera1.project3(T21 * points2[i]);
 
-            // check reprojection error
-            auto e1 = (point1inImage2.segment<2>(0) - ips2[i]).squaredNorm();
-            auto e2 = (point2inImage1.segment<2>(0) - ips1[i]).squaredNorm();
-            if (e1 < threshold && e2 < threshold)
-            {
-                count++;
-            }
+        // projected point is behind one of the cameras
+        if (point1inImage2(2) < 0 || point2inImage1(2) < 0) return false;
+
+        // check reprojection error
+        auto e1 = (point1inImage2.segment<2>(0) - ips2[i]).squaredNorm();
+        auto e2 = (point2inImage1.segment<2>(0) - ips1[i]).squaredNorm();
+        return e1 < threshold && e2 < threshold;
+    }
+
+    // T(d,d) test on preTestPoints random points.
+    template <typename Transformation>
+    bool preTest(const Transformation& T, std::uniform_int_distribution<unsigned int>& dis)
+    {
+        if (preTestPoints == 0) return true;
+        Transformation T21 = T.inverse();
+        for (int j = 0; j < preTestPoints; ++j)
+        {
+            if (!isInlier(T, T21, dis(gen))) return false;
         }
-        return count;
+        return true;
     }
 
 
@@ -8,13 +8,30 @@
 #include "saiga/core/geometry/all.h"
 #include "saiga/core/image/all.h"
 #include "saiga/core/util/BinaryFile.h"
+#include "saiga/core/util/DataStructures/ChunkedVector.h"
 #include "saiga/core/util/ProgressBar.h"
 #include "saiga/core/util/Thread/SpinLock.h"
 #include "saiga/core/util/Thread/omp.h"
 
+#include <algorithm>
+#include <shared_mutex>
+#include <tuple>
+
 
 namespace Saiga
 {
+// The voxel blocks are stored in a ChunkedVector, so pointers to blocks stay valid if the grid grows.
+// The hash map doubles its size when the average bucket length exceeds max_load_factor.
+//
+// Thread safety:
+//   - InsertBlockLock can be called from multiple threads at the same time. It also grows the block storage and
+//     rehashes the table if required.
+//   - All other functions (including GetBlock) must not run concurrently to InsertBlockLock.
+//
+// Dirty tracking:
+//   - Every block has a dirty flag, which is set on insertion and by all member functions that change voxels.
+//   - Code that writes to the voxels directly must call SetDirty for the modified blocks.
+//   - Consumers of the changes (for example SparseTSDFSurface) call ClearDirty after processing them.
 template <typename VoxelType, int _VOXEL_BLOCK_SIZE>
 struct SAIGA_TEMPLATE BlockSparseGrid
 {
@@ -59,8 +76,9 @@ struct SAIGA_TEMPLATE BlockSparseGrid
           voxel_size_inv(1.0 / voxel_size),
           hash_size(hash_size),
           blocks(reserve_blocks),
+          dirty(reserve_blocks),
           first_hashed_block(hash_size, -1),
-          hash_locks(hash_size)
+          hash_locks(num_hash_locks)
 
     {
         block_size_inv = 1.0 / (voxel_size * VOXEL_BLOCK_SIZE);
@@ -70,16 +88,19 @@ struct SAIGA_TEMPLATE BlockSparseGrid
     {
         voxel_size         = other.voxel_size;
         voxel_size_inv     = other.voxel_size_inv;
+        block_size_inv     = other.block_size_inv;
         hash_size          = other.hash_size;
+        max_load_factor    = other.max_load_factor;
         blocks             = other.blocks;
+        dirty              = other.dirty;
         first_hashed_block = other.first_hashed_block;
-        hash_locks         = std::vector<SpinLock>(hash_size);
+        hash_locks         = std::vector<SpinLock>(num_hash_locks);
         current_blocks     = other.current_blocks.load();
     }
 
     size_t Memory()
     {
-        size_t mem_blocks = blocks.size() * sizeof(VoxelBlock);
+        size_t mem_blocks = blocks.capacity() * sizeof(VoxelBlock);
         size_t mem_hash   = first_hashed_block.size() * sizeof(int);
         return mem_blocks + mem_hash + sizeof(*this);
     }
@@ -103,17 +124,16 @@ struct SAIGA_TEMPLATE BlockSparseGrid
 
         // Create block and insert as the first element.
         int new_index = current_blocks.fetch_add(1);
+        blocks.grow_to_at_least(new_index + 1);
+        dirty.grow_to_at_least(new_index + 1);
+        dirty[new_index] = 1;
 
-        if (new_index >= (int)blocks.size())
-        {
-            blocks.resize(blocks.size() * 2);
-        }
+        auto* new_block       = &blocks[new_index];
+        new_block->index      = i;
+        new_block->next_index = first_hashed_block[h];
+        first_hashed_block[h] = new_index;
 
-        int hash                 = H(i);
-        auto* new_block          = &blocks[new_index];
-        new_block->index         = i;
-        new_block->next_index    = first_hashed_block[hash];
-        first_hashed_block[hash] = new_index;
+        if (NeedsRehash()) Rehash(hash_size * 2);
         return new_block;
     }
 
@@ -131,6 +151,9 @@ struct SAIGA_TEMPLATE BlockSparseGrid
             // The removed block is at the end of the array -> just remove
             //            std::cout << "remove end" << std::endl;
             current_blocks--;
+            // Inserted blocks reuse the storage, so it must be empty.
+            blocks[block_id] = VoxelBlock();
+            dirty[block_id]  = 0;
             return true;
         }
         else
@@ -151,6 +174,9 @@ struct SAIGA_TEMPLATE BlockSparseGrid
             new_block->next_index      = first_hashed_block[last_h];
             first_hashed_block[last_h] = block_id;
             current_blocks--;
+            blocks[current_blocks] = VoxelBlock();
+            dirty[block_id]        = dirty[current_blocks];
+            dirty[current_blocks]  = 0;
             return true;
         }
     }
@@ -179,36 +205,67 @@ struct SAIGA_TEMPLATE BlockSparseGrid
         return true;
     }
 
+    // Thread safe version of InsertBlock.
+    // The table is locked in shared mode for insertion and exclusive for rehashing. The buckets are protected by
+    // num_hash_locks striped spin locks.
     VoxelBlock* InsertBlockLock(const VoxelBlockIndex& i)
     {
-        int h = H(i);
+        VoxelBlock* new_block;
+        bool rehash;
+        {
+            std::shared_lock table_lock(table_mutex);
+            int h = H(i);
+            std::unique_lock lock(hash_locks[h % num_hash_locks]);
 
-        std::unique_lock lock(hash_locks[h]);
+            auto block = GetBlock(i, h);
+            if (block)
+            {
+                // block already exists
+                return block;
+            }
 
-        auto block = GetBlock(i, h);
+            // Create block and insert as the first element.
+            int new_index = current_blocks.fetch_add(1);
+            blocks.grow_to_at_least(new_index + 1);
+            dirty.grow_to_at_least(new_index + 1);
+            dirty[new_index] = 1;
+
+            new_block             = &blocks[new_index];
+            new_block->index      = i;
+            new_block->next_index = first_hashed_block[h];
+            first_hashed_block[h] = new_index;
+            rehash                = NeedsRehash();
+        }
 
-        if (block)
+        if (rehash)
         {
-            // block already exists
-            return block;
+            std::unique_lock table_lock(table_mutex);
+            // Another thread might have rehashed in the meantime
+            if (NeedsRehash()) Rehash(hash_size * 2);
         }
+        return new_block;
+    }
 
-        // Create block and insert as the first element.
-        int new_index = current_blocks.fetch_add(1);
+    // Rebuilds the hash map with new_hash_size buckets.
+    // The block ids (and pointers) do not change.
+    void Rehash(int new_hash_size)
+    {
+        SAIGA_ASSERT(new_hash_size > 0);
+        hash_size = new_hash_size;
+        first_hashed_block.clear();
+        first_hashed_block.resize(hash_size, -1);
 
-        if (new_index >= (int)blocks.size())
+        for (int b = 0; b < current_blocks; ++b)
         {
-            SAIGA_EXIT_ERROR("Resizing not allowed during parallel insertion!");
+            auto& block           = blocks[b];
+            int h                 = H(block.index);
+            block.next_index      = first_hashed_block[h];
+            first_hashed_block[h] = b;
         }
-
-        int hash                 = H(i);
-        auto* new_block          = &blocks[new_index];
-        new_block->index         = i;
-        new_block->next_index    = first_hashed_block[hash];
-        first_hashed_block[hash] = new_index;
-        return new_block;
     }
 
+    bool NeedsRehash() const { return current_blocks > hash_size * max_load_factor; }
+
     void AllocateAroundPoint(const vec3& position, int r = 1)
     {
         auto block_id = GetBlockIndex(position);
@@ -332,6 +389,61 @@ struct SAIGA_TEMPLATE BlockSparseGrid
     }
 
 
+    // Coarse uniform grid over the allocated blocks. Each cell covers cell_size^3 blocks.
+    // The block ids of cells[i] are cell_blocks[cell_offset[i] .. cell_offset[i+1]).
+    struct BlockCells
+    {
+        int cell_size = 8;
+        std::vector<VoxelBlockIndex> cells;
+        std::vector<int> cell_offset;
+        std::vector<int> cell_blocks;
+    };
+
+    // Sorts the allocated blocks into cells. Spatial queries (for example frustum culling) can then reject a complete
+    // cell with a single test. The result is invalid after inserting or erasing blocks.
+    BlockCells ComputeBlockCells(int cell_size) const
+    {
+        SAIGA_ASSERT(cell_size > 0);
+        BlockCells result;
+        result.cell_size = cell_size;
+
+        int n = current_blocks;
+        std::vector<std::pair<VoxelBlockIndex, int>> cell_of_block(n);
+        for (int i = 0; i < n; ++i)
+        {
+            auto& index = blocks[i].index;
+            VoxelBlockIndex cell(iFloorDiv(index.x(), cell_size), iFloorDiv(index.y(), cell_size),
+                                 iFloorDiv(index.z(), cell_size));
+            cell_of_block[i] = {cell, i};
+        }
+
+        std::sort(cell_of_block.begin(), cell_of_block.end(), [](const auto& a, const auto& b) {
+            return std::tie(a.first.z(), a.first.y(), a.first.x(), a.second) <
+                   std::tie(b.first.z(), b.first.y(), b.first.x(), b.second);
+        });
+
+        result.cell_blocks.resize(n);
+        for (int i = 0; i < n; ++i)
+        {
+            if (i == 0 || cell_of_block[i].first != cell_of_block[i - 1].first)
+            {
+                result.cells.push_back(cell_of_block[i].first);
+                result.cell_offset.push_back(i);
+            }
+            result.cell_blocks[i] = cell_of_block[i].second;
+        }
+        result.cell_offset.push_back(n);
+        return result;
+    }
+
+    // Bounding sphere of all grid points in the given cell
+    Sphere CellBoundingSphere(const VoxelBlockIndex& cell, int cell_size)
+    {
+        float half_extent = (cell_size * VOXEL_BLOCK_SIZE - 1) * voxel_size * 0.5f;
+        vec3 center       = GlobalBlockOffset(cell * cell_size) + make_vec3(half_extent);
+        return Sphere(center, half_extent * sqrt(3.0f));
+    }
+
     VoxelBlockIndex GetBlockIndex(const vec3& position) { return GetBlockIndex(VirtualVoxelIndex(position)); }
 
     vec3 BlockCenter(const VoxelBlockIndex& i)
@@ -351,7 +463,24 @@ struct SAIGA_TEMPLATE BlockSparseGrid
     }
 
 
-    void Compact() { blocks.resize(current_blocks); }
+    void Compact()
+    {
+        blocks.resize(current_blocks);
+        dirty.resize(current_blocks);
+    }
+
+    bool IsDirty(int block_id) const { return dirty[block_id]; }
+    void SetDirty(int block_id) { dirty[block_id] = 1; }
+
+    void SetAllDirty()
+    {
+        for (int i = 0; i < current_blocks; ++i) dirty[i] = 1;
+    }
+
+    void ClearDirty()
+    {
+        for (int i = 0; i < current_blocks; ++i) dirty[i] = 0;
+    }
 
     int Size() { return current_blocks; }
 
@@ -363,18 +492,27 @@ struct SAIGA_TEMPLATE BlockSparseGrid
 
 
     unsigned int hash_size;
+    // Average number of blocks per bucket before the hash map grows.
+    float max_load_factor = 2;
+
     std::atomic_int current_blocks = 0;
-    std::vector<VoxelBlock> blocks;
+    ChunkedVector<VoxelBlock> blocks;
+    // Same size as 'blocks'. Kept separate, so that the file format of the blocks does not change.
+    ChunkedVector<uint8_t> dirty;
     std::vector<int> first_hashed_block;
+
+    static constexpr int num_hash_locks = 1024;
     std::vector<SpinLock> hash_locks;
+    std::shared_mutex table_mutex;
 
 
     void Clear()
     {
         current_blocks = 0;
-        for (auto& b : blocks)
+        for (size_t i = 0; i < blocks.size(); ++i)
         {
-            b = VoxelBlock();
+            blocks[i] = VoxelBlock();
+            dirty[i]  = 0;
         }
         for (auto& i : first_hashed_block)
         {
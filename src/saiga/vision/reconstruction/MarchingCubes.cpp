@@ -375,6 +375,38 @@ std::pair<std::array<std::array<vec3, 3>, 16>, int> MarchingCubes(const std::arr
 }
 
 
+static constexpr int edgeCorners[12][2] = {{0, 1}, {1, 2}, {2, 3}, {3, 0}, {4, 5}, {5, 6},
+                                           {6, 7}, {7, 4}, {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+
+int MarchingCubesEdges(const std::array<float, 8>& values, float isolevel, std::array<std::array<int, 3>, 5>& triangles)
+{
+    int cubeindex = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        if (values[i] < isolevel) cubeindex |= 1 << i;
+    }
+
+    int ntriang = 0;
+    for (int i = 0; triTable[cubeindex][i] != -1; i += 3)
+    {
+        triangles[ntriang][0] = triTable[cubeindex][i];
+        triangles[ntriang][1] = triTable[cubeindex][i + 1];
+        triangles[ntriang][2] = triTable[cubeindex][i + 2];
+        ntriang++;
+    }
+    return ntriang;
+}
+
+std::array<int, 2> MarchingCubesEdgeCorners(int edge)
+{
+    return {edgeCorners[edge][0], edgeCorners[edge][1]};
+}
+
+vec3 MarchingCubesInterpolate(float isolevel, const vec3& p1, const vec3& p2, float valp1, float valp2)
+{
+    return VertexInterp(isolevel, p1, p2, valp1, valp2);
+}
+
 std::vector<std::array<vec3, 3>> MarchingCubes(float* data, int depth, int height, int width, float isolevel)
 {
     auto sdf_grid = [&](int z, int y, int x) { return data[z * height * width + y * width + x]; };
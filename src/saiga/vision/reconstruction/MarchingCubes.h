@@ -21,4 +21,17 @@ SAIGA_VISION_API std::pair<std::array<std::array<vec3, 3>, 16>, int> MarchingCub
 
 SAIGA_VISION_API std::vector<std::array<vec3, 3>> MarchingCubes(float* data, int depth, int height, int width,
                                                                 float isolevel);
+
+// Indexed version of the marching cubes above (same corner order).
+// The triangle corners are returned as cube edges [0,11] instead of positions, so that neighbouring cubes can share
+// the vertices. The maximum number of triangles is 5.
+SAIGA_VISION_API int MarchingCubesEdges(const std::array<float, 8>& values, float isolevel,
+                                        std::array<std::array<int, 3>, 5>& triangles);
+
+// The two cube corners of an edge
+SAIGA_VISION_API std::array<int, 2> MarchingCubesEdgeCorners(int edge);
+
+// Intersection of the iso surface with the cube edge p1-p2
+SAIGA_VISION_API vec3 MarchingCubesInterpolate(float isolevel, const vec3& p1, const vec3& p2, float valp1,
+                                               float valp2);
 }  // namespace Saiga
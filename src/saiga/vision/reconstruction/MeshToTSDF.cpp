@@ -228,7 +228,7 @@ std::shared_ptr<SparseTSDF> MeshToTSDF(const std::vector<Triangle>& triangles, f
 
 
 
-    AccelerationStructure::ObjectMedianBVH bvh(triangles);
+    AccelerationStructure::SAHBVH bvh(triangles);
     bvh.triangle_epsilon = 0;
     {
         ProgressBar bar(std::cout, "M2TSDF Compute Unsigned Distance", tsdf->current_blocks);
@@ -24,6 +24,46 @@ void SparseTSDF::EraseEmptyBlocks()
     }
 }
 
+void SparseTSDF::GatherSurfaceValues(const VoxelBlock& block, float min_weight, SurfaceValues& values)
+{
+    // The block itself and the neighbours in +x, +y, +z. Indexed by [z][y][x].
+    const VoxelBlock* neighbours[2][2][2];
+    for (int z = 0; z < 2; ++z)
+    {
+        for (int y = 0; y < 2; ++y)
+        {
+            for (int x = 0; x < 2; ++x)
+            {
+                neighbours[z][y][x] = (x + y + z == 0) ? &block : GetBlock(block.index + ivec3(x, y, z));
+            }
+        }
+    }
+
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    for (int i = 0; i < VOXEL_BLOCK_SIZE + 1; ++i)
+    {
+        for (int j = 0; j < VOXEL_BLOCK_SIZE + 1; ++j)
+        {
+            for (int k = 0; k < VOXEL_BLOCK_SIZE + 1; ++k)
+            {
+                auto* read_block = neighbours[i / VOXEL_BLOCK_SIZE][j / VOXEL_BLOCK_SIZE][k / VOXEL_BLOCK_SIZE];
+                if (read_block)
+                {
+                    int li          = i % VOXEL_BLOCK_SIZE;
+                    int lj          = j % VOXEL_BLOCK_SIZE;
+                    int lk          = k % VOXEL_BLOCK_SIZE;
+                    auto& v         = read_block->data[li][lj][lk];
+                    values[i][j][k] = v.weight > min_weight ? v.distance : inf;
+                }
+                else
+                {
+                    values[i][j][k] = inf;
+                }
+            }
+        }
+    }
+}
+
 std::vector<std::vector<SparseTSDF::Triangle>> SparseTSDF::ExtractSurface(double iso, float outlier_factor,
                                                                           float min_weight, int threads, bool verbose)
 {
@@ -40,47 +80,8 @@ std::vector<std::vector<SparseTSDF::Triangle>> SparseTSDF::ExtractSurface(double
     {
         auto& triangle_soup = triangle_soup_per_block[b];
         auto& block         = blocks[b];
-        // Compute positions and values of (n+1) x (n+1) x (n+1) block.
-        // The (+1) data point is taken from neighbouring blocks to close the holes.
-        std::pair<vec3, float> local_data[VOXEL_BLOCK_SIZE + 1][VOXEL_BLOCK_SIZE + 1][VOXEL_BLOCK_SIZE + 1];
-
-        // Fill from own block
-        for (int i = 0; i < VOXEL_BLOCK_SIZE + 1; ++i)
-        {
-            for (int j = 0; j < VOXEL_BLOCK_SIZE + 1; ++j)
-            {
-                for (int k = 0; k < VOXEL_BLOCK_SIZE + 1; ++k)
-                {
-                    int li = i % VOXEL_BLOCK_SIZE;
-                    int lj = j % VOXEL_BLOCK_SIZE;
-                    int lk = k % VOXEL_BLOCK_SIZE;
-
-                    int bi = i / VOXEL_BLOCK_SIZE;
-                    int bj = j / VOXEL_BLOCK_SIZE;
-                    int bk = k / VOXEL_BLOCK_SIZE;
-
-                    VoxelBlockIndex read_block_id = block.index + ivec3(bk, bj, bi);
-
-                    auto* read_block = GetBlock(read_block_id);
-
-
-                    vec3 p = GlobalPosition(block.index, i, j, k);
-
-                    if (read_block)
-                    {
-                        float dis           = read_block->data[li][lj][lk].distance;
-                        float wei           = read_block->data[li][lj][lk].weight;
-                        local_data[i][j][k] = {p, wei > min_weight ? dis : std::numeric_limits<float>::infinity()};
-                        //                        local_data[i][j][k] = {p, dis};
-                    }
-                    else
-                    {
-                        local_data[i][j][k] = {p, std::numeric_limits<float>::infinity()};
-                    }
-                }
-            }
-        }
-
+        SurfaceValues values;
+        GatherSurfaceValues(block, min_weight, values);
 
         // create triangles
         for (int i = 0; i < VOXEL_BLOCK_SIZE; ++i)
@@ -90,15 +91,12 @@ std::vector<std::vector<SparseTSDF::Triangle>> SparseTSDF::ExtractSurface(double
                 for (int k = 0; k < VOXEL_BLOCK_SIZE; ++k)
                 {
                     std::array<std::pair<vec3, float>, 8> cell;
-
-                    cell[0] = local_data[i][j][k];
-                    cell[1] = local_data[i][j][k + 1];
-                    cell[2] = local_data[i + 1][j][k + 1];
-                    cell[3] = local_data[i + 1][j][k];
-                    cell[4] = local_data[i][j + 1][k];
-                    cell[5] = local_data[i][j + 1][k + 1];
-                    cell[6] = local_data[i + 1][j + 1][k + 1];
-                    cell[7] = local_data[i + 1][j + 1][k];
+                    for (int c = 0; c < 8; ++c)
+                    {
+                        ivec3 o = MarchingCubesCorner(c);
+                        cell[c] = {GlobalPosition(block.index, i + o.z(), j + o.y(), k + o.x()),
+                                   values[i + o.z()][j + o.y()][k + o.x()]};
+                    }
 
                     bool finite   = true;
                     float abs_max = 0;
@@ -161,11 +159,28 @@ UnifiedMesh SparseTSDF::CreateMesh(const std::vector<std::vector<SparseTSDF::Tri
 }
 
 
+// Same format as a std::vector<VoxelBlock>
+template <typename Stream, typename Blocks>
+static void WriteBlocks(Stream& strm, const Blocks& blocks)
+{
+    strm << (size_t)blocks.size();
+    for (size_t i = 0; i < blocks.size(); ++i) strm << blocks[i];
+}
+
+template <typename Stream, typename Blocks>
+static void ReadBlocks(Stream& strm, Blocks& blocks)
+{
+    size_t n;
+    strm >> n;
+    blocks.resize(n);
+    for (size_t i = 0; i < n; ++i) strm >> blocks[i];
+}
+
 void SparseTSDF::Save(const std::string& file)
 {
     BinaryFile strm(file, std::ios_base::out);
     strm << voxel_size << voxel_size_inv << block_size_inv << hash_size << current_blocks;
-    strm << blocks;
+    WriteBlocks(strm, blocks);
     strm << first_hashed_block;
 }
 
@@ -174,8 +189,10 @@ void SparseTSDF::Load(const std::string& file)
     BinaryFile strm(file, std::ios_base::in);
     SAIGA_ASSERT(strm.strm.is_open());
     strm >> voxel_size >> voxel_size_inv >> block_size_inv >> hash_size >> current_blocks;
-    strm >> blocks;
+    ReadBlocks(strm, blocks);
     strm >> first_hashed_block;
+    dirty.resize(blocks.size());
+    SetAllDirty();
 }
 
 void SparseTSDF::SaveCompressed(const std::string& file)
@@ -183,7 +200,7 @@ void SparseTSDF::SaveCompressed(const std::string& file)
 #ifdef SAIGA_USE_ZLIB
     BinaryOutputVector strm;
     strm << voxel_size << voxel_size_inv << block_size_inv << hash_size << current_blocks;
-    strm << blocks;
+    WriteBlocks(strm, blocks);
     strm << first_hashed_block;
     auto compressed = compress(strm.data.data(), strm.data.size());
     File::saveFileBinary(file, compressed.data(), compressed.size());
@@ -199,13 +216,63 @@ void SparseTSDF::LoadCompressed(const std::string& file)
     auto data            = uncompress(compressed_data.data());
     BinaryInputVector strm(data.data(), data.size());
     strm >> voxel_size >> voxel_size_inv >> block_size_inv >> hash_size >> current_blocks;
-    strm >> blocks;
+    ReadBlocks(strm, blocks);
     strm >> first_hashed_block;
+    dirty.resize(blocks.size());
+    SetAllDirty();
 #else
     SAIGA_EXIT_ERROR("zlib not found.");
 #endif
 }
 
+void SparseTSDF::SaveBlocks(const std::string& file, const std::vector<VoxelBlockIndex>& indices)
+{
+    std::vector<VoxelBlock> selected;
+    selected.reserve(indices.size());
+    for (auto& i : indices)
+    {
+        auto* block = GetBlock(i);
+        SAIGA_ASSERT(block);
+        selected.push_back(*block);
+    }
+
+    BinaryOutputVector strm(sizeof(VoxelBlock) * selected.size() + 100);
+    strm << voxel_size;
+    WriteBlocks(strm, selected);
+
+#ifdef SAIGA_USE_ZLIB
+    auto compressed = compress(strm.data.data(), strm.data.size());
+    File::saveFileBinary(file, compressed.data(), compressed.size());
+#else
+    File::saveFileBinary(file, strm.data.data(), strm.data.size());
+#endif
+}
+
+int SparseTSDF::LoadBlocks(const std::string& file)
+{
+    auto file_data = File::loadFileBinary(file);
+    SAIGA_ASSERT(!file_data.empty());
+#ifdef SAIGA_USE_ZLIB
+    auto data = uncompress(file_data.data());
+#else
+    auto& data = file_data;
+#endif
+    BinaryInputVector strm(data.data(), data.size());
+
+    float file_voxel_size;
+    std::vector<VoxelBlock> loaded;
+    strm >> file_voxel_size;
+    SAIGA_ASSERT(file_voxel_size == voxel_size);
+    ReadBlocks(strm, loaded);
+
+    for (auto& b : loaded)
+    {
+        InsertBlock(b.index)->data = b.data;
+        SetDirty(GetBlockId(b.index));
+    }
+    return loaded.size();
+}
+
 bool SparseTSDF::operator==(const SparseTSDF& other) const
 {
     if (voxel_size != other.voxel_size || voxel_size_inv != other.voxel_size_inv ||
@@ -234,6 +301,7 @@ bool SparseTSDF::operator==(const SparseTSDF& other) const
 
 void SparseTSDF::ClampDistance(float distance)
 {
+    SetAllDirty();
     for (int b = 0; b < current_blocks; ++b)
     {
         auto& block = blocks[b];
@@ -253,6 +321,7 @@ void SparseTSDF::ClampDistance(float distance)
 
 void SparseTSDF::EraseAboveDistance(float threshold)
 {
+    SetAllDirty();
     for (int i = 0; i < current_blocks; ++i)
     {
         auto& b = blocks[i];
@@ -320,6 +389,7 @@ int SparseTSDF::NumNonZeroVoxels() const
 
 void SparseTSDF::SetForAll(float distance, float weight)
 {
+    SetAllDirty();
     for (int b = 0; b < current_blocks; ++b)
     {
         auto& block = blocks[b];
@@ -341,7 +411,7 @@ void SparseTSDF::SetForAll(float distance, float weight)
 
 std::ostream& operator<<(std::ostream& strm, const SparseTSDF& tsdf)
 {
-    size_t mem_blocks = tsdf.blocks.size() * sizeof(SparseTSDF::VoxelBlock);
+    size_t mem_blocks = tsdf.blocks.capacity() * sizeof(SparseTSDF::VoxelBlock);
     size_t mem_hash   = tsdf.first_hashed_block.size() * sizeof(int);
 
     // Compute some statistics
@@ -51,16 +51,7 @@ struct SAIGA_VISION_API SparseTSDF : public BlockSparseGrid<TSDFVoxel, 8>
     SparseTSDF(const std::string& file) { Load(file); }
 
 
-    SparseTSDF(const SparseTSDF& other)
-    {
-        voxel_size         = other.voxel_size;
-        voxel_size_inv     = other.voxel_size_inv;
-        hash_size          = other.hash_size;
-        blocks             = other.blocks;
-        first_hashed_block = other.first_hashed_block;
-        hash_locks         = std::vector<SpinLock>(hash_size);
-        current_blocks     = other.current_blocks.load();
-    }
+    SparseTSDF(const SparseTSDF& other) : BlockSparseGrid(other) {}
 
     SAIGA_VISION_API friend std::ostream& operator<<(std::ostream& os, const SparseTSDF& tsdf);
 
@@ -271,6 +262,21 @@ struct SAIGA_VISION_API SparseTSDF : public BlockSparseGrid<TSDFVoxel, 8>
 
     using Triangle = std::array<vec3, 3>;
 
+    // Distances of the (n+1)^3 grid points of the marching cubes of one block. Indexed by [z][y][x].
+    // The last layer is read from the neighbours in +x, +y and +z.
+    // Missing voxels and voxels with a weight <= min_weight are set to infinity.
+    using SurfaceValues = std::array<std::array<std::array<float, VOXEL_BLOCK_SIZE + 1>, VOXEL_BLOCK_SIZE + 1>,
+                                     VOXEL_BLOCK_SIZE + 1>;
+    void GatherSurfaceValues(const VoxelBlock& block, float min_weight, SurfaceValues& values);
+
+    // Offset (x,y,z) of a cube corner in the order of MarchingCubes()
+    static ivec3 MarchingCubesCorner(int corner)
+    {
+        static constexpr int offsets[8][3] = {{0, 0, 0}, {1, 0, 0}, {1, 0, 1}, {0, 0, 1},
+                                              {0, 1, 0}, {1, 1, 0}, {1, 1, 1}, {0, 1, 1}};
+        return ivec3(offsets[corner][0], offsets[corner][1], offsets[corner][2]);
+    }
+
     // Triangle surface extraction on the sparse TSDF.
     // Returns for each block a list of triangles
     //
@@ -305,6 +311,13 @@ struct SAIGA_VISION_API SparseTSDF : public BlockSparseGrid<TSDFVoxel, 8>
     void SaveCompressed(const std::string& file);
     void LoadCompressed(const std::string& file);
 
+    // Writes only the given blocks to a file (zlib compressed if available). The TSDF is not changed.
+    void SaveBlocks(const std::string& file, const std::vector<VoxelBlockIndex>& indices);
+
+    // Inserts all blocks of a file written by SaveBlocks. Existing blocks with the same index are overwritten.
+    // Returns the number of loaded blocks.
+    int LoadBlocks(const std::string& file);
+
     bool operator==(const SparseTSDF& other) const;
 };
 
@@ -0,0 +1,372 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "SparseTSDFRaycast.h"
+
+#include "saiga/core/util/Thread/omp.h"
+
+namespace Saiga
+{
+// Trilinear access with a cache of block pointers.
+// Consecutive samples of a ray are usually in the same block and need no hash lookup.
+struct SparseTSDFRaycast::Sampler
+{
+    enum Result
+    {
+        // The block of the lower corner voxel does not exist
+        MISSING,
+        // At least one of the 8 voxels is not allocated or has a weight <= min_weight
+        INVALID,
+        VALID
+    };
+
+    static constexpr int N = SparseTSDF::VOXEL_BLOCK_SIZE;
+
+    Sampler(SparseTSDF& tsdf, float min_weight) : tsdf(tsdf), min_weight(min_weight) {}
+
+    const SparseTSDF::VoxelBlock* Block(const ivec3& index)
+    {
+        if (cached_valid && index == cached_index) return cached_block;
+
+        auto& entry = cache[(uint32_t(index.x() * 73856093) ^ uint32_t(index.y() * 19349669) ^
+                             uint32_t(index.z() * 83492791)) %
+                            cache.size()];
+        if (!entry.valid || entry.index != index)
+        {
+            entry.index = index;
+            entry.block = tsdf.GetBlock(index);
+            entry.valid = true;
+            block_lookups++;
+        }
+
+        cached_valid = true;
+        cached_index = index;
+        cached_block = entry.block;
+        return cached_block;
+    }
+
+    Result Sample(const vec3& position, TSDFVoxel& result)
+    {
+        samples++;
+        vec3 normalized = position * tsdf.voxel_size_inv;
+        vec3 ipos       = normalized.array().floor();
+        vec3 frac       = normalized - ipos;
+        ivec3 corner    = ipos.cast<int>();
+
+        ivec3 block_index = tsdf.GetBlockIndex(corner);
+        auto block        = Block(block_index);
+        if (!block) return MISSING;
+        ivec3 local = corner - block_index * N;
+
+        // v[dz][dy][dx]
+        TSDFVoxel v[2][2][2];
+        if ((local.array() < N - 1).all())
+        {
+            for (int dz = 0; dz < 2; ++dz)
+                for (int dy = 0; dy < 2; ++dy)
+                    for (int dx = 0; dx < 2; ++dx)
+                        v[dz][dy][dx] = block->data[local.z() + dz][local.y() + dy][local.x() + dx];
+        }
+        else
+        {
+            // Some voxels are in the neighbour blocks in +x, +y or +z.
+            for (int dz = 0; dz < 2; ++dz)
+            {
+                for (int dy = 0; dy < 2; ++dy)
+                {
+                    for (int dx = 0; dx < 2; ++dx)
+                    {
+                        ivec3 l         = local + ivec3(dx, dy, dz);
+                        ivec3 neighbour = (l.array() >= N).cast<int>();
+                        auto b          = neighbour.isZero() ? block : Block(block_index + neighbour);
+                        if (!b) return INVALID;
+                        l -= neighbour * N;
+                        v[dz][dy][dx] = b->data[l.z()][l.y()][l.x()];
+                    }
+                }
+            }
+        }
+
+        for (int dz = 0; dz < 2; ++dz)
+            for (int dy = 0; dy < 2; ++dy)
+                for (int dx = 0; dx < 2; ++dx)
+                    if (v[dz][dy][dx].weight <= min_weight) return INVALID;
+
+        auto lerp = [](const TSDFVoxel& a, const TSDFVoxel& b, float alpha) {
+            TSDFVoxel r;
+            r.distance = a.distance + alpha * (b.distance - a.distance);
+            r.weight   = a.weight + alpha * (b.weight - a.weight);
+            return r;
+        };
+
+        TSDFVoxel y0 = lerp(lerp(v[0][0][0], v[0][0][1], frac.x()), lerp(v[0][1][0], v[0][1][1], frac.x()), frac.y());
+        TSDFVoxel y1 = lerp(lerp(v[1][0][0], v[1][0][1], frac.x()), lerp(v[1][1][0], v[1][1][1], frac.x()), frac.y());
+        result       = lerp(y0, y1, frac.z());
+        return VALID;
+    }
+
+    // Same as SparseTSDF::TrilinearGradient
+    vec3 Gradient(const vec3& position)
+    {
+        float h = tsdf.voxel_size * 0.5f;
+        vec3 grad;
+        for (int a = 0; a < 3; ++a)
+        {
+            vec3 offset = vec3::Zero();
+            offset(a)   = h;
+            TSDFVoxel v1, v2;
+            if (Sample(position - offset, v1) != VALID || Sample(position + offset, v2) != VALID)
+            {
+                return vec3::Zero();
+            }
+            grad(a) = (v2.distance - v1.distance) / (2 * h);
+        }
+        return grad;
+    }
+
+    SparseTSDF& tsdf;
+    float min_weight;
+
+    struct CacheEntry
+    {
+        bool valid                         = false;
+        ivec3 index                        = ivec3::Zero();
+        const SparseTSDF::VoxelBlock* block = nullptr;
+    };
+    // Direct mapped. Neighbouring rays of a tile traverse mostly the same blocks.
+    std::array<CacheEntry, 256> cache;
+
+    // The block of the last sample
+    bool cached_valid                          = false;
+    ivec3 cached_index                         = ivec3::Zero();
+    const SparseTSDF::VoxelBlock* cached_block = nullptr;
+
+    long samples       = 0;
+    long block_lookups = 0;
+    long skipped       = 0;
+};
+
+SparseTSDFRaycast::SparseTSDFRaycast(SparseTSDF& tsdf, const TSDFRaycastParams& params) : params(params), tsdf(tsdf)
+{
+}
+
+TSDFRaycastStatistics SparseTSDFRaycast::Raycast(const IntrinsicsPinholed& K, const SE3& V, int h, int w,
+                                                 TSDFRaycastImages& result)
+{
+    SAIGA_ASSERT(params.tile_size > 0);
+    if (result.depth.h != h || result.depth.w != w)
+    {
+        result.depth.create(h, w);
+        result.normal.create(h, w);
+        result.confidence.create(h, w);
+    }
+    result.depth.makeZero();
+    result.normal.makeZero();
+    result.confidence.makeZero();
+
+    TSDFRaycastStatistics stats;
+    if (tsdf.current_blocks == 0) return stats;
+    UpdateBounds();
+
+    SE3 V_inv    = V.inverse();
+    vec3 origin  = V_inv.translation().cast<float>();
+    Mat3 R       = V_inv.so3().matrix();
+    mat3 R_world = R.cast<float>();
+    mat3 R_cam   = R_world.transpose();
+    auto Kf      = K.cast<float>();
+
+    int tiles_x   = iDivUp(w, params.tile_size);
+    int tiles_y   = iDivUp(h, params.tile_size);
+    long samples  = 0;
+    long lookups  = 0;
+    long skipped  = 0;
+    int hits      = 0;
+
+#pragma omp parallel for schedule(dynamic) reduction(+ : samples, lookups, skipped, hits)
+    for (int tile = 0; tile < tiles_x * tiles_y; ++tile)
+    {
+        Sampler sampler(tsdf, params.min_weight);
+
+        int x_begin = (tile % tiles_x) * params.tile_size;
+        int y_begin = (tile / tiles_x) * params.tile_size;
+        int x_end   = std::min(x_begin + params.tile_size, w);
+        int y_end   = std::min(y_begin + params.tile_size, h);
+
+        for (int y = y_begin; y < y_end; ++y)
+        {
+            for (int x = x_begin; x < x_end; ++x)
+            {
+                vec2 np = Kf.unproject2(vec2(x, y));
+                vec3 dir_cam(np(0), np(1), 1);
+                float dir_length = dir_cam.norm();
+                vec3 dir         = R_world * (dir_cam / dir_length);
+
+                // t is the distance along the normalized ray, depth = t / dir_length
+                float t_min = params.min_depth * dir_length;
+                float t_max = params.max_depth * dir_length;
+
+                TSDFVoxel hit;
+                float t = Trace(sampler, origin, dir, t_min, t_max, hit);
+                if (t >= t_max) continue;
+
+                vec3 p    = origin + t * dir;
+                vec3 grad = sampler.Gradient(p);
+                float l   = grad.norm();
+                if (l < 1e-5) continue;
+
+                result.depth(y, x)      = t / dir_length;
+                result.normal(y, x)     = R_cam * (grad / l);
+                result.confidence(y, x) = hit.weight;
+                hits++;
+            }
+        }
+
+        samples += sampler.samples;
+        lookups += sampler.block_lookups;
+        skipped += sampler.skipped;
+    }
+
+    stats.samples        = samples;
+    stats.block_lookups  = lookups;
+    stats.skipped_blocks = skipped;
+    stats.hits           = hits;
+    return stats;
+}
+
+float SparseTSDFRaycast::TraceRay(const vec3& origin, const vec3& direction, float t_min, float t_max)
+{
+    if (tsdf.current_blocks == 0) return t_max;
+    UpdateBounds();
+    Sampler sampler(tsdf, params.min_weight);
+    TSDFVoxel hit;
+    return Trace(sampler, origin, direction, t_min, t_max, hit);
+}
+
+float SparseTSDFRaycast::Trace(Sampler& sampler, const vec3& origin, const vec3& direction, float t_min, float t_max,
+                               TSDFVoxel& hit)
+{
+    float t_begin = t_min;
+    float t_end   = t_max;
+    if (!ClipToBounds(origin, direction, t_begin, t_end)) return t_max;
+
+    constexpr int N  = SparseTSDF::VOXEL_BLOCK_SIZE;
+    float vs         = tsdf.voxel_size;
+    float min_step   = params.min_step * vs;
+    float max_step   = params.max_step * vs;
+    float block_size = vs * N;
+
+    float t           = t_begin;
+    bool has_last     = false;
+    float last_t      = 0;
+    float last_d      = 0;
+
+    while (t < t_end)
+    {
+        vec3 p = origin + t * direction;
+
+        TSDFVoxel sample;
+        auto r = sampler.Sample(p, sample);
+
+        if (r == Sampler::MISSING)
+        {
+            // Empty space skipping: all samples until the ray leaves this block are missing.
+            vec3 block_min = sampler.cached_index.cast<float>() * block_size;
+            float t_exit   = std::numeric_limits<float>::infinity();
+            for (int a = 0; a < 3; ++a)
+            {
+                if (direction(a) > 0) t_exit = std::min(t_exit, (block_min(a) + block_size - origin(a)) / direction(a));
+                if (direction(a) < 0) t_exit = std::min(t_exit, (block_min(a) - origin(a)) / direction(a));
+            }
+            t        = std::max(t + 1e-3f * vs, t_exit + 1e-3f * vs);
+            has_last = false;
+            sampler.skipped++;
+            continue;
+        }
+
+        if (r == Sampler::INVALID)
+        {
+            has_last = false;
+            t += min_step;
+            continue;
+        }
+
+        if (has_last && last_d > 0 && sample.distance < 0)
+        {
+            float t_hit;
+            if (Bisection(sampler, origin, direction, last_t, t, last_d, sample.distance, t_hit))
+            {
+                if (sampler.Sample(origin + t_hit * direction, hit) != Sampler::VALID) hit = sample;
+                return t_hit;
+            }
+        }
+
+        has_last = true;
+        last_t   = t;
+        last_d   = sample.distance;
+
+        float step = sample.distance > 0 ? clamp(sample.distance * params.step_factor, min_step, max_step) : min_step;
+        t += step;
+    }
+    return t_max;
+}
+
+bool SparseTSDFRaycast::Bisection(Sampler& sampler, const vec3& origin, const vec3& direction, float t1, float t2,
+                                  float d1, float d2, float& t)
+{
+    float a     = t1;
+    float b     = t2;
+    float a_dist = d1;
+    float b_dist = d2;
+    float c      = tsdf.IntersectionLinear(a, b, a_dist, b_dist);
+
+    for (int i = 0; i < params.bisect_iterations; ++i)
+    {
+        TSDFVoxel sample;
+        if (sampler.Sample(origin + c * direction, sample) != Sampler::VALID) return false;
+
+        if (a_dist * sample.distance > 0)
+        {
+            a      = c;
+            a_dist = sample.distance;
+        }
+        else
+        {
+            b      = c;
+            b_dist = sample.distance;
+        }
+        c = tsdf.IntersectionLinear(a, b, a_dist, b_dist);
+    }
+    t = c;
+    return true;
+}
+
+void SparseTSDFRaycast::UpdateBounds()
+{
+    auto bounds = tsdf.Bounds();
+    bounds_min  = tsdf.GlobalBlockOffset(bounds.begin);
+    bounds_max  = tsdf.GlobalBlockOffset(bounds.end);
+}
+
+bool SparseTSDFRaycast::ClipToBounds(const vec3& origin, const vec3& direction, float& t_min, float& t_max) const
+{
+    for (int a = 0; a < 3; ++a)
+    {
+        if (direction(a) == 0)
+        {
+            if (origin(a) < bounds_min(a) || origin(a) > bounds_max(a)) return false;
+            continue;
+        }
+        float inv = 1.0f / direction(a);
+        float t1  = (bounds_min(a) - origin(a)) * inv;
+        float t2  = (bounds_max(a) - origin(a)) * inv;
+        if (t1 > t2) std::swap(t1, t2);
+        t_min = std::max(t_min, t1);
+        t_max = std::min(t_max, t2);
+    }
+    return t_min < t_max;
+}
+
+}  // namespace Saiga
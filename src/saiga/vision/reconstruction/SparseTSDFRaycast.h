@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+#include "saiga/vision/VisionTypes.h"
+
+#include "SparseTSDF.h"
+
+namespace Saiga
+{
+struct SAIGA_VISION_API TSDFRaycastParams
+{
+    // Range of the camera space depth (z).
+    float min_depth = 0.1;
+    float max_depth = 5;
+
+    // Samples with a voxel weight <= min_weight are treated as unobserved.
+    float min_weight = 0;
+
+    // In front of the surface the step is step_factor * sdf, clamped to [min_step, max_step] voxels.
+    // The sdf is measured along the camera rays of the fused images, therefore step_factor should be < 1.
+    float step_factor = 0.8;
+    float min_step    = 1;
+    float max_step    = 8;
+
+    int bisect_iterations = 2;
+
+    // The image is rendered in tiles of tile_size^2 pixels. Rays of a tile are traced by the same thread and access
+    // the same blocks.
+    int tile_size = 16;
+};
+
+struct TSDFRaycastImages
+{
+    // Camera space depth (z). 0 if the ray does not hit the surface.
+    TemplatedImage<float> depth;
+    // Camera space normal. Zero if the ray does not hit the surface.
+    TemplatedImage<vec3> normal;
+    // Interpolated TSDF weight at the surface.
+    TemplatedImage<float> confidence;
+};
+
+struct TSDFRaycastStatistics
+{
+    long samples        = 0;
+    long block_lookups  = 0;
+    long skipped_blocks = 0;
+    int hits            = 0;
+};
+
+/**
+ * Renders depth, normal and confidence images of a SparseTSDF.
+ *
+ * Compared to SparseTSDF::RaySurfaceIntersection:
+ *   - Unallocated blocks are skipped completely (the ray jumps to the block exit).
+ *   - The last accessed block is cached. A trilinear sample inside a block does not need a hash lookup.
+ *   - The step size is computed from the sdf instead of a fixed step.
+ *   - The rays are clipped to the bounding box of all blocks.
+ *
+ * The TSDF must not be modified during Raycast().
+ *
+ * Usage (model-to-frame tracking):
+ *
+ * SparseTSDFRaycast raycast(*scene.tsdf);
+ * TSDFRaycastImages model;
+ * raycast.Raycast(K, V_last, h, w, model);
+ * // align the new depth map to model.depth/model.normal
+ */
+class SAIGA_VISION_API SparseTSDFRaycast
+{
+   public:
+    SparseTSDFRaycast(SparseTSDF& tsdf, const TSDFRaycastParams& params = TSDFRaycastParams());
+
+    // V is the world->camera transformation. The images are (re)created if they do not have the size h x w.
+    TSDFRaycastStatistics Raycast(const IntrinsicsPinholed& K, const SE3& V, int h, int w, TSDFRaycastImages& result);
+
+    // Intersects one ray with the surface. Returns t_max if there is no intersection.
+    // The direction must be normalized.
+    float TraceRay(const vec3& origin, const vec3& direction, float t_min, float t_max);
+
+    TSDFRaycastParams params;
+
+   private:
+    struct Sampler;
+
+    float Trace(Sampler& sampler, const vec3& origin, const vec3& direction, float t_min, float t_max,
+                TSDFVoxel& hit);
+    bool Bisection(Sampler& sampler, const vec3& origin, const vec3& direction, float t1, float t2, float d1,
+                   float d2, float& t);
+
+    void UpdateBounds();
+    // Clips the ray to the bounding box of all blocks
+    bool ClipToBounds(const vec3& origin, const vec3& direction, float& t_min, float& t_max) const;
+
+    SparseTSDF& tsdf;
+    vec3 bounds_min, bounds_max;
+};
+
+}  // namespace Saiga
@@ -0,0 +1,335 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "SparseTSDFSurface.h"
+
+#include "saiga/core/util/Thread/omp.h"
+
+#include "MarchingCubes.h"
+
+#include <numeric>
+
+namespace Saiga
+{
+static uint64_t BlockKey(const ivec3& block)
+{
+    constexpr int64_t offset = 1 << 20;
+    SAIGA_ASSERT((block.array().abs() < offset).all());
+    return (uint64_t(block.x() + offset) << 42) | (uint64_t(block.y() + offset) << 21) | uint64_t(block.z() + offset);
+}
+
+// A vertex is identified by the grid edge from 'voxel' to 'voxel + unit(axis)'
+static uint64_t EdgeKey(const ivec3& voxel, int axis)
+{
+    constexpr int64_t offset = 1 << 19;
+    SAIGA_ASSERT((voxel.array().abs() < offset).all());
+    return (uint64_t(voxel.x() + offset) << 42) | (uint64_t(voxel.y() + offset) << 22) |
+           (uint64_t(voxel.z() + offset) << 2) | uint64_t(axis);
+}
+
+static std::pair<ivec3, int> DecodeEdgeKey(uint64_t key)
+{
+    constexpr int64_t offset = 1 << 19;
+    constexpr uint64_t mask  = (1 << 20) - 1;
+    ivec3 voxel(int64_t((key >> 42) & mask) - offset, int64_t((key >> 22) & mask) - offset,
+                int64_t((key >> 2) & mask) - offset);
+    return {voxel, int(key & 3)};
+}
+
+static ivec3 Unit(int axis)
+{
+    ivec3 u = ivec3::Zero();
+    u(axis) = 1;
+    return u;
+}
+
+int SparseTSDFSurface::Update(SparseTSDF& tsdf, float iso, float outlier_factor, float min_weight)
+{
+    if (iso != this->iso || outlier_factor != this->outlier_factor || min_weight != this->min_weight ||
+        tsdf.voxel_size != voxel_size)
+    {
+        cache.clear();
+        this->iso            = iso;
+        this->outlier_factor = outlier_factor;
+        this->min_weight     = min_weight;
+        voxel_size           = tsdf.voxel_size;
+    }
+
+    std::vector<int> update_ids;
+    if (cache.empty())
+    {
+        update_ids.resize(tsdf.current_blocks);
+        std::iota(update_ids.begin(), update_ids.end(), 0);
+    }
+    else
+    {
+        std::vector<ivec3> changed;
+        for (auto it = cache.begin(); it != cache.end();)
+        {
+            if (!tsdf.GetBlock(it->second.index))
+            {
+                changed.push_back(it->second.index);
+                it = cache.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        for (int b = 0; b < tsdf.current_blocks; ++b)
+        {
+            if (tsdf.IsDirty(b)) changed.push_back(tsdf.blocks[b].index);
+        }
+
+        // The surface of a block depends on the neighbours in +x, +y and +z.
+        std::vector<uint8_t> marked(tsdf.current_blocks, 0);
+        for (auto& c : changed)
+        {
+            for (int z = 0; z <= 1; ++z)
+            {
+                for (int y = 0; y <= 1; ++y)
+                {
+                    for (int x = 0; x <= 1; ++x)
+                    {
+                        int id = tsdf.GetBlockId(c - ivec3(x, y, z));
+                        if (id >= 0 && !marked[id])
+                        {
+                            marked[id] = 1;
+                            update_ids.push_back(id);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // References to elements of an unordered_map stay valid during insertion.
+    std::vector<BlockSurface*> targets(update_ids.size());
+    for (size_t i = 0; i < update_ids.size(); ++i)
+    {
+        targets[i] = &cache[BlockKey(tsdf.blocks[update_ids[i]].index)];
+    }
+
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < (int)update_ids.size(); ++i)
+    {
+        ExtractBlock(tsdf, tsdf.blocks[update_ids[i]], *targets[i]);
+    }
+
+    tsdf.ClearDirty();
+    return update_ids.size();
+}
+
+void SparseTSDFSurface::ExtractBlock(SparseTSDF& tsdf, const SparseTSDF::VoxelBlock& block,
+                                     BlockSurface& surface) const
+{
+    constexpr int N = SparseTSDF::VOXEL_BLOCK_SIZE;
+
+    SparseTSDF::SurfaceValues values;
+    tsdf.GatherSurfaceValues(block, min_weight, values);
+
+    surface.index = block.index;
+    surface.vertex_keys.clear();
+    surface.vertices.clear();
+    surface.triangles.clear();
+
+    // Local vertex id of the 3 edges starting at each grid point. Indexed by [z][y][x][axis].
+    std::array<std::array<std::array<std::array<int, 3>, N + 1>, N + 1>, N + 1> edge_vertex;
+    for (auto& z : edge_vertex)
+        for (auto& y : z)
+            for (auto& x : y) x = {-1, -1, -1};
+
+    auto value = [&](const ivec3& p) { return values[p.z()][p.y()][p.x()]; };
+    auto pos   = [&](const ivec3& p) { return tsdf.GlobalPosition(block.index, p.z(), p.y(), p.x()); };
+
+    ivec3 voxel_offset = block.index * N;
+    std::array<std::array<int, 3>, 5> cube_triangles;
+
+    for (int i = 0; i < N; ++i)
+    {
+        for (int j = 0; j < N; ++j)
+        {
+            for (int k = 0; k < N; ++k)
+            {
+                ivec3 cube(k, j, i);
+
+                // Same rejection as SparseTSDF::ExtractSurface
+                std::array<float, 8> cell;
+                bool finite   = true;
+                float abs_max = 0;
+                for (int c = 0; c < 8; ++c)
+                {
+                    cell[c] = value(cube + SparseTSDF::MarchingCubesCorner(c));
+                    finite &= std::isfinite(cell[c]);
+                    abs_max = std::max(abs_max, std::abs(cell[c]));
+                }
+                if (abs_max > outlier_factor * tsdf.voxel_size || !finite) continue;
+
+                int count = MarchingCubesEdges(cell, iso, cube_triangles);
+                for (int t = 0; t < count; ++t)
+                {
+                    ivec3 tri;
+                    for (int e = 0; e < 3; ++e)
+                    {
+                        auto corners = MarchingCubesEdgeCorners(cube_triangles[t][e]);
+                        ivec3 a      = cube + SparseTSDF::MarchingCubesCorner(corners[0]);
+                        ivec3 b      = cube + SparseTSDF::MarchingCubesCorner(corners[1]);
+                        ivec3 lower  = a.cwiseMin(b);
+                        int axis     = a.x() != b.x() ? 0 : (a.y() != b.y() ? 1 : 2);
+
+                        int& id = edge_vertex[lower.z()][lower.y()][lower.x()][axis];
+                        if (id < 0)
+                        {
+                            id = surface.vertices.size();
+                            surface.vertices.push_back(MarchingCubesInterpolate(iso, pos(a), pos(b), value(a), value(b)));
+                            surface.vertex_keys.push_back(EdgeKey(voxel_offset + lower, axis));
+                        }
+                        tri(e) = id;
+                    }
+                    surface.triangles.push_back(tri);
+                }
+            }
+        }
+    }
+
+    // Sort the vertices by key for FindVertex
+    int n = surface.vertices.size();
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&](int a, int b) { return surface.vertex_keys[a] < surface.vertex_keys[b]; });
+
+    std::vector<int> new_id(n);
+    std::vector<uint64_t> keys(n);
+    std::vector<vec3> vertices(n);
+    for (int i = 0; i < n; ++i)
+    {
+        new_id[order[i]] = i;
+        keys[i]          = surface.vertex_keys[order[i]];
+        vertices[i]      = surface.vertices[order[i]];
+    }
+    surface.vertex_keys = std::move(keys);
+    surface.vertices    = std::move(vertices);
+    for (auto& t : surface.triangles)
+    {
+        t = ivec3(new_id[t(0)], new_id[t(1)], new_id[t(2)]);
+    }
+}
+
+int SparseTSDFSurface::FindVertex(const BlockSurface& surface, uint64_t key)
+{
+    auto it = std::lower_bound(surface.vertex_keys.begin(), surface.vertex_keys.end(), key);
+    if (it == surface.vertex_keys.end() || *it != key) return -1;
+    return it - surface.vertex_keys.begin();
+}
+
+UnifiedMesh SparseTSDFSurface::CreateMesh() const
+{
+    constexpr int N = SparseTSDF::VOXEL_BLOCK_SIZE;
+
+    // Sorted by key, so that the vertex order does not depend on the hash map.
+    std::vector<std::pair<uint64_t, const BlockSurface*>> sorted;
+    sorted.reserve(cache.size());
+    for (auto& [key, surface] : cache) sorted.emplace_back(key, &surface);
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    int n = sorted.size();
+    std::unordered_map<uint64_t, int> position;
+    position.reserve(n);
+    for (int s = 0; s < n; ++s) position[sorted[s].first] = s;
+
+    // The owner of a vertex is the first block (in the order below) that contains the vertex. All blocks that share
+    // the vertex agree on the owner, so it is emitted exactly once.
+    std::vector<std::vector<std::pair<int, int>>> owner(n);
+    std::vector<std::vector<int>> rank(n);
+    std::vector<int> num_owned(n);
+
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int s = 0; s < n; ++s)
+    {
+        auto& surface = *sorted[s].second;
+        int nv        = surface.vertices.size();
+        owner[s].resize(nv);
+        rank[s].assign(nv, -1);
+
+        int owned = 0;
+        for (int v = 0; v < nv; ++v)
+        {
+            auto key           = surface.vertex_keys[v];
+            auto [voxel, axis] = DecodeEdgeKey(key);
+            int b              = (axis + 1) % 3;
+            int c              = (axis + 2) % 3;
+
+            // The 4 cubes around the edge
+            std::array<ivec3, 4> cube_offsets = {ivec3::Zero(), Unit(b), Unit(c), Unit(b) + Unit(c)};
+            for (auto& o : cube_offsets)
+            {
+                ivec3 cube = voxel - o;
+                ivec3 block(iFloorDiv(cube.x(), N), iFloorDiv(cube.y(), N), iFloorDiv(cube.z(), N));
+                if (block == surface.index)
+                {
+                    owner[s][v] = {s, v};
+                    break;
+                }
+                auto it = position.find(BlockKey(block));
+                if (it == position.end()) continue;
+                int other_v = FindVertex(*sorted[it->second].second, key);
+                if (other_v >= 0)
+                {
+                    owner[s][v] = {it->second, other_v};
+                    break;
+                }
+            }
+            if (owner[s][v].first == s) rank[s][v] = owned++;
+        }
+        num_owned[s] = owned;
+    }
+
+    std::vector<int> vertex_offset(n + 1, 0);
+    std::vector<int> triangle_offset(n + 1, 0);
+    for (int s = 0; s < n; ++s)
+    {
+        vertex_offset[s + 1]   = vertex_offset[s] + num_owned[s];
+        triangle_offset[s + 1] = triangle_offset[s] + sorted[s].second->triangles.size();
+    }
+
+    UnifiedMesh mesh;
+    mesh.position.resize(vertex_offset[n]);
+    mesh.triangles.resize(triangle_offset[n]);
+
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int s = 0; s < n; ++s)
+    {
+        auto& surface = *sorted[s].second;
+        std::vector<int> global_id(surface.vertices.size());
+        for (int v = 0; v < (int)surface.vertices.size(); ++v)
+        {
+            auto [os, ov] = owner[s][v];
+            global_id[v]  = vertex_offset[os] + rank[os][ov];
+            if (os == s) mesh.position[global_id[v]] = surface.vertices[v];
+        }
+
+        for (int t = 0; t < (int)surface.triangles.size(); ++t)
+        {
+            auto& tri                                = surface.triangles[t];
+            mesh.triangles[triangle_offset[s] + t] = ivec3(global_id[tri(0)], global_id[tri(1)], global_id[tri(2)]);
+        }
+    }
+
+    mesh.CalculateVertexNormals();
+    mesh.SetVertexColor(vec4(1, 1, 1, 1));
+    return mesh;
+}
+
+int SparseTSDFSurface::NumTriangles() const
+{
+    int n = 0;
+    for (auto& c : cache) n += c.second.triangles.size();
+    return n;
+}
+
+}  // namespace Saiga
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+#include "saiga/core/model/UnifiedMesh.h"
+
+#include "SparseTSDF.h"
+
+#include <unordered_map>
+
+namespace Saiga
+{
+/**
+ * Incremental surface extraction of a SparseTSDF with shared vertices.
+ *
+ * The triangles of every block are cached. Update() only recomputes the blocks that are dirty (see BlockSparseGrid) or
+ * have a dirty neighbour in -x, -y, -z, because the marching cubes of a block also read the first layer of these
+ * neighbours. Erased blocks are removed from the cache.
+ *
+ * The vertices are identified by the grid edge they are on. CreateMesh() merges vertices on the same edge without a
+ * spatial search. Each vertex is emitted by exactly one block (the owner), so the mesh is assembled in parallel.
+ *
+ * Usage:
+ *
+ * SparseTSDFSurface surface;
+ * while (fusing)
+ * {
+ *     scene.FuseIncrement(image, first);
+ *     surface.Update(*scene.tsdf, iso, outlier_factor, min_weight);
+ *     UnifiedMesh mesh = surface.CreateMesh();
+ * }
+ */
+class SAIGA_VISION_API SparseTSDFSurface
+{
+   public:
+    // Updates the cache and clears the dirty flags of the TSDF.
+    // The complete cache is recomputed if the parameters are different from the last call.
+    // Returns the number of blocks which were meshed.
+    int Update(SparseTSDF& tsdf, float iso, float outlier_factor, float min_weight);
+
+    // Indexed triangle mesh with shared vertices and vertex normals.
+    UnifiedMesh CreateMesh() const;
+
+    int NumTriangles() const;
+    int NumBlocks() const { return cache.size(); }
+
+    void Clear() { cache.clear(); }
+
+   private:
+    struct BlockSurface
+    {
+        ivec3 index;
+        // Sorted by key
+        std::vector<uint64_t> vertex_keys;
+        std::vector<vec3> vertices;
+        std::vector<ivec3> triangles;
+    };
+
+    void ExtractBlock(SparseTSDF& tsdf, const SparseTSDF::VoxelBlock& block, BlockSurface& surface) const;
+
+    // Returns -1 if the vertex does not exist in this block
+    static int FindVertex(const BlockSurface& surface, uint64_t key);
+
+    std::unordered_map<uint64_t, BlockSurface> cache;
+
+    float iso            = 0;
+    float outlier_factor = 0;
+    float min_weight     = 0;
+    float voxel_size     = 0;
+};
+
+}  // namespace Saiga
@@ -0,0 +1,272 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "StreamingFusion.h"
+
+#include "saiga/core/util/FileSystem.h"
+
+#include <map>
+#include <random>
+
+namespace Saiga
+{
+// Creates a new directory that did not exist before. Two instances never share their swap files.
+static std::string CreateUniqueDirectory(const std::string& parent)
+{
+    std::filesystem::path base =
+        parent.empty() ? std::filesystem::temp_directory_path() : std::filesystem::path(parent);
+    std::filesystem::create_directories(base);
+
+    std::random_device rd;
+    std::mt19937_64 gen(((uint64_t)rd() << 32) ^ rd());
+    while (true)
+    {
+        auto dir = base / ("tsdf_swap_" + std::to_string(gen()));
+        if (std::filesystem::create_directory(dir)) return dir.string();
+    }
+}
+
+StreamingFusion::StreamingFusion(const IntrinsicsPinholed& K, const Distortion& dis, const FusionParams& params,
+                                 const StreamingFusionParams& stream_params)
+    : stream_params(stream_params), queue(stream_params.queue_size)
+{
+    SAIGA_ASSERT(stream_params.region_size > 0);
+    scene.K      = K;
+    scene.dis    = dis;
+    scene.params = params;
+    swap_path    = CreateUniqueDirectory(stream_params.swap_directory);
+
+    worker = ScopedThread([this]() {
+        setThreadName("StreamingFusion");
+        while (true)
+        {
+            auto frame = queue.get();
+            if (!frame) break;
+            Process(*frame);
+        }
+    });
+}
+
+StreamingFusion::~StreamingFusion()
+{
+    Finish();
+    std::filesystem::remove_all(swap_path);
+}
+
+void StreamingFusion::Add(ImageView<const float> depth_map, const SE3& V)
+{
+    SAIGA_ASSERT(!finished);
+    auto frame = std::make_shared<Frame>();
+    frame->depth_map.create(depth_map.dimensions());
+    depth_map.copyTo(frame->depth_map.getImageView());
+    frame->V = V;
+    queue.add(frame);
+}
+
+void StreamingFusion::Finish()
+{
+    if (finished) return;
+    queue.add(std::shared_ptr<Frame>());
+    worker.join();
+    finished = true;
+}
+
+void StreamingFusion::Process(Frame& frame)
+{
+    FusionImage fi;
+    fi.depthMap = frame.depth_map.getImageView();
+    fi.V        = frame.V;
+
+    bool first = statistics.frames == 0;
+    if (!first)
+    {
+        SwapIn(frame.V);
+    }
+    scene.FuseIncrement(fi, first);
+    // The depth map is released after this function
+    scene.images.clear();
+
+    int resident = scene.tsdf->current_blocks;
+
+    // Nothing outside the frustum is required for this frame
+    vec3 camera_position = frame.V.inverse().translation().cast<float>();
+    auto frustum         = scene.VisibilityFrustum(frame.V);
+    float radius         = stream_params.working_radius;
+    for (auto& v : frustum.vertices)
+    {
+        radius = std::max(radius, (v - camera_position).norm());
+    }
+    SwapOut(camera_position, radius);
+
+    std::unique_lock lock(statistics_lock);
+    statistics.frames++;
+    statistics.max_resident_blocks = std::max(statistics.max_resident_blocks, resident);
+    statistics.resident_blocks     = scene.tsdf->current_blocks;
+}
+
+void StreamingFusion::SwapIn(const SE3& V)
+{
+    if (swapped_regions.empty()) return;
+
+    auto frustum = scene.VisibilityFrustum(V);
+
+    std::vector<Region> to_load;
+    for (auto& r : swapped_regions)
+    {
+        if (frustum.sphereInFrustum(RegionSphere(r)) != Frustum::OUTSIDE) to_load.push_back(r);
+    }
+
+    for (auto& r : to_load)
+    {
+        LoadRegion(r);
+    }
+}
+
+void StreamingFusion::SwapOut(const vec3& camera_position, float radius)
+{
+    auto& tsdf = scene.tsdf;
+
+    std::map<Region, std::vector<ivec3>> outside;
+    for (int b = 0; b < tsdf->current_blocks; ++b)
+    {
+        auto& index = tsdf->blocks[b].index;
+        auto region = RegionOfBlock(index);
+        auto sphere = RegionSphere(region);
+        if ((sphere.pos - camera_position).norm() - sphere.r > radius)
+        {
+            outside[region].push_back(index);
+        }
+    }
+
+    for (auto& [region, indices] : outside)
+    {
+        int new_blocks = indices.size();
+        if (swapped_regions.count(region) == 0)
+        {
+            tsdf->SaveBlocks(RegionFile(region), indices);
+        }
+        else
+        {
+            // New blocks are only allocated inside the visibility frustum and all regions intersecting it have been
+            // loaded before the integration. If a block is allocated in a region on disk anyway (for example due to
+            // rounding at the frustum border), the file is merged instead of overwritten. The block in memory is newer.
+            SparseTSDF merged(tsdf->voxel_size, 1000, 10000);
+            int on_disk = merged.LoadBlocks(RegionFile(region));
+            for (auto& index : indices)
+            {
+                merged.InsertBlock(index)->data = tsdf->GetBlock(index)->data;
+            }
+            std::vector<ivec3> merged_indices;
+            for (int b = 0; b < merged.current_blocks; ++b)
+            {
+                merged_indices.push_back(merged.blocks[b].index);
+            }
+            merged.SaveBlocks(RegionFile(region), merged_indices);
+            new_blocks = merged.current_blocks - on_disk;
+        }
+
+        for (auto& index : indices)
+        {
+            tsdf->EraseBlock(index);
+        }
+        swapped_regions.insert(region);
+
+        std::unique_lock lock(statistics_lock);
+        statistics.regions_swapped_out++;
+        statistics.swapped_blocks += new_blocks;
+    }
+}
+
+void StreamingFusion::LoadRegion(const Region& region)
+{
+    auto file = RegionFile(region);
+    int n     = scene.tsdf->LoadBlocks(file);
+    std::filesystem::remove(file);
+    swapped_regions.erase(region);
+
+    std::unique_lock lock(statistics_lock);
+    statistics.regions_swapped_in++;
+    statistics.swapped_blocks -= n;
+}
+
+void StreamingFusion::LoadAll()
+{
+    SAIGA_ASSERT(finished);
+    auto regions = swapped_regions;
+    for (auto& r : regions)
+    {
+        LoadRegion(r);
+    }
+    statistics.resident_blocks = scene.tsdf ? scene.tsdf->current_blocks.load() : 0;
+}
+
+UnifiedMesh StreamingFusion::ExtractMesh()
+{
+    SAIGA_ASSERT(finished);
+    if (!scene.tsdf) return UnifiedMesh();
+
+    // Handle all regions the same way
+    SwapOut(vec3::Zero(), -std::numeric_limits<float>::infinity());
+    statistics.resident_blocks = 0;
+
+    int rs = stream_params.region_size;
+    std::vector<std::vector<SparseTSDF::Triangle>> triangles;
+    for (auto& r : swapped_regions)
+    {
+        // The triangles of a block also depend on the first voxel layer of the neighbours in +x, +y and +z.
+        SparseTSDF local(scene.tsdf->voxel_size, 1000, 10000);
+        for (int z = 0; z <= 1; ++z)
+        {
+            for (int y = 0; y <= 1; ++y)
+            {
+                for (int x = 0; x <= 1; ++x)
+                {
+                    Region n = {std::get<0>(r) + x, std::get<1>(r) + y, std::get<2>(r) + z};
+                    if (swapped_regions.count(n)) local.LoadBlocks(RegionFile(n));
+                }
+            }
+        }
+        ivec3 begin = ivec3(std::get<0>(r), std::get<1>(r), std::get<2>(r)) * rs;
+        local.CropToRect(iRect<3>(begin, begin + ivec3(rs + 1, rs + 1, rs + 1)));
+
+        auto local_triangles = local.ExtractSurface(scene.params.extract_iso, scene.params.extract_outlier_factor, 0,
+                                                    OMP::getMaxThreads(), false);
+        for (int b = 0; b < local.current_blocks; ++b)
+        {
+            if (RegionOfBlock(local.blocks[b].index) == r) triangles.push_back(std::move(local_triangles[b]));
+        }
+    }
+    return scene.tsdf->CreateMesh(triangles, scene.params.post_process_mesh);
+}
+
+StreamingFusionStatistics StreamingFusion::Statistics()
+{
+    std::unique_lock lock(statistics_lock);
+    return statistics;
+}
+
+StreamingFusion::Region StreamingFusion::RegionOfBlock(const ivec3& block) const
+{
+    int rs = stream_params.region_size;
+    return {iFloorDiv(block.x(), rs), iFloorDiv(block.y(), rs), iFloorDiv(block.z(), rs)};
+}
+
+Sphere StreamingFusion::RegionSphere(const Region& region)
+{
+    auto sphere = scene.tsdf->CellBoundingSphere(ivec3(std::get<0>(region), std::get<1>(region), std::get<2>(region)),
+                                                 stream_params.region_size);
+    // A point belongs to the block of the nearest grid point, so it can be half a voxel outside of the grid points.
+    sphere.r += scene.tsdf->voxel_size;
+    return sphere;
+}
+
+std::string StreamingFusion::RegionFile(const Region& region) const
+{
+    return swap_path + "/region_" + std::to_string(std::get<0>(region)) + "_" +
+           std::to_string(std::get<1>(region)) + "_" + std::to_string(std::get<2>(region)) + ".tsdf";
+}
+
+}  // namespace Saiga
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+#include "saiga/core/util/Thread/SynchronizedBuffer.h"
+#include "saiga/core/util/Thread/threadName.h"
+
+#include "VoxelFusion.h"
+
+#include <set>
+#include <tuple>
+
+namespace Saiga
+{
+struct SAIGA_VISION_API StreamingFusionParams
+{
+    // Blocks are swapped in regions of region_size^3 blocks.
+    int region_size = 8;
+
+    // Regions outside of this sphere around the camera are written to disk and removed from the TSDF.
+    // The radius is increased automatically if it is smaller than the range of the visibility frustum.
+    float working_radius = 8;
+
+    // Each instance creates its own unique subdirectory in this directory for the swapped regions and removes it in
+    // the destructor. Empty = the temporary directory of the system.
+    std::string swap_directory = "";
+
+    // Number of frames that can wait for integration. Add() blocks if the queue is full.
+    int queue_size = 4;
+};
+
+struct StreamingFusionStatistics
+{
+    int frames              = 0;
+    int regions_swapped_out = 0;
+    int regions_swapped_in  = 0;
+    int max_resident_blocks = 0;
+    int resident_blocks     = 0;
+    int swapped_blocks      = 0;
+};
+
+/**
+ * Incremental TSDF fusion of a depth map stream with bounded memory.
+ *
+ * The frames are integrated by a worker thread in the order of Add(). After each frame, all regions of blocks which
+ * are outside of the working sphere around the camera are written to disk (SparseTSDF::SaveBlocks) and erased from the
+ * TSDF. Before a frame is integrated, all swapped regions that intersect its visibility frustum are loaded again.
+ * Therefore the result is identical to FusionScene::FuseIncrement, but the number of resident blocks only depends on
+ * the working radius.
+ *
+ * Usage:
+ *
+ * StreamingFusion fusion(K, dis, params, stream_params);
+ * for (auto& frame : frames)
+ * {
+ *     fusion.Add(frame.depth, frame.V);
+ * }
+ * fusion.Finish();
+ * UnifiedMesh mesh = fusion.ExtractMesh();
+ */
+class SAIGA_VISION_API StreamingFusion
+{
+   public:
+    StreamingFusion(const IntrinsicsPinholed& K, const Distortion& dis, const FusionParams& params,
+                    const StreamingFusionParams& stream_params = StreamingFusionParams());
+    ~StreamingFusion();
+
+    StreamingFusion(const StreamingFusion&) = delete;
+    StreamingFusion& operator=(const StreamingFusion&) = delete;
+
+    // Queues a depth map with the world->camera transformation V. The image is copied.
+    void Add(ImageView<const float> depth_map, const SE3& V);
+
+    // Blocks until all queued frames are integrated and stops the worker thread.
+    // No frames can be added afterwards.
+    void Finish();
+
+    // Loads all swapped regions into the TSDF. The memory is not bounded anymore after this call.
+    void LoadAll();
+
+    // Extracts the complete surface region by region. Only a region and its neighbours are in memory at the same
+    // time. Must be called after Finish(). All regions are swapped out afterwards.
+    UnifiedMesh ExtractMesh();
+
+    // The scene and TSDF are modified by the worker thread. Only access them after Finish().
+    FusionScene& Scene() { return scene; }
+
+    StreamingFusionStatistics Statistics();
+
+   private:
+    using Region = std::tuple<int, int, int>;
+
+    struct Frame
+    {
+        TemplatedImage<float> depth_map;
+        SE3 V;
+    };
+
+    void Process(Frame& frame);
+    void SwapIn(const SE3& V);
+    // Swaps out all regions outside of the sphere.
+    void SwapOut(const vec3& camera_position, float radius);
+
+    Region RegionOfBlock(const ivec3& block) const;
+    Sphere RegionSphere(const Region& region);
+    std::string RegionFile(const Region& region) const;
+    void LoadRegion(const Region& region);
+
+    FusionScene scene;
+    StreamingFusionParams stream_params;
+
+    // Unique directory of this instance inside stream_params.swap_directory
+    std::string swap_path;
+
+    // Regions which are currently on disk
+    std::set<Region> swapped_regions;
+
+    // nullptr signals the end of the stream
+    SynchronizedBuffer<std::shared_ptr<Frame>> queue;
+    ScopedThread worker;
+    bool finished = false;
+
+    std::mutex statistics_lock;
+    StreamingFusionStatistics statistics;
+};
+
+}  // namespace Saiga
@@ -15,11 +15,29 @@ namespace Saiga
 {
 static std::stringstream strm;
 
+// The camera used for the visibility test
+static IntrinsicsPinholed VisibilityIntrinsics(const IntrinsicsPinholed& K, const FusionParams& params)
+{
+    auto K2 = K;
+    if (params.increase_visibility_frustum)
+    {
+        K2.fx *= 0.95;
+        K2.fy *= 0.95;
+    }
+    return K2;
+}
+
+static double VisibilityMaxDepth(const FusionParams& params)
+{
+    return params.maxIntegrationDistance + 0.4;
+}
+
 void FusionScene::Preprocess()
 {
     triangle_soup_inclusive_prefix_sum.clear();
     triangle_soup.clear();
     mesh = UnifiedMesh();
+    surface.Clear();
     tsdf = std::make_unique<SparseTSDF>(params.voxelSize, params.block_count, params.hash_size);
 
     if (images.empty()) return;
@@ -41,6 +59,39 @@ void FusionScene::Preprocess()
         }
         loading_bar.addProgress(1);
     }
+
+    // Maximum undistorted view angle on the image border (+1 pixel for the rounding)
+    auto K2               = VisibilityIntrinsics(K, params);
+    visibility_tan        = vec2::Zero();
+    auto add_border_point = [&](double x, double y) {
+        // Inverse of normalizedToImage (including the skew)
+        Vec2 p;
+        p(1)           = (y - K2.cy) / K2.fy;
+        p(0)           = (x - K2.cx - K2.s * p(1)) / K2.fx;
+        p              = undistortPointGN(p, p, dis);
+        visibility_tan = visibility_tan.array().max(p.cwiseAbs().cast<float>().array());
+    };
+    for (int x = -2; x <= depth_map_size.w + 1; ++x)
+    {
+        add_border_point(x, -2);
+        add_border_point(x, depth_map_size.h + 1);
+    }
+    for (int y = -2; y <= depth_map_size.h + 1; ++y)
+    {
+        add_border_point(-2, y);
+        add_border_point(depth_map_size.w + 1, y);
+    }
+}
+
+Frustum FusionScene::VisibilityFrustum(const SE3& V) const
+{
+    float fovy   = 2 * atan(visibility_tan.y());
+    float aspect = visibility_tan.x() / visibility_tan.y();
+
+    // Vision camera: x right, y down, looking along +z
+    mat4 model = V.inverse().matrix().cast<float>();
+    return Frustum(model, fovy, aspect, params.voxelSize * 0.01, VisibilityMaxDepth(params) + params.voxelSize, false,
+                   true);
 }
 
 
@@ -63,7 +114,8 @@ void FusionScene::AnalyseSparseStructure()
 
         //        std::set<std::tuple<int, int, int>> leset;
 
-        //        for (auto i : dm.depthMap.rowRange())
+        // The rays of all pixels are traced in parallel. InsertBlockLock grows the tsdf if required.
+#pragma omp parallel for schedule(dynamic, 8)
         for (int i = 0; i < dm.depthMap.rows; ++i)
         {
             for (auto j : dm.depthMap.colRange())
@@ -157,7 +209,7 @@ void FusionScene::AnalyseSparseStructure()
                 while (true)
                 {
                     //                    leset.insert({idCurrentVoxel(0), idCurrentVoxel(1), idCurrentVoxel(2)});
-                    tsdf->InsertBlock(idCurrentVoxel);
+                    tsdf->InsertBlockLock(idCurrentVoxel);
                     // Traverse voxel grid
                     if (tMax.x() < tMax.y() && tMax.x() < tMax.z())
                     {
@@ -257,50 +309,75 @@ void FusionScene::Visibility()
     {
         ProgressBar loading_bar(params.verbose ? std::cout : strm, "Visibility ", Size());
 
-        auto K2 = K;
+        auto K2          = VisibilityIntrinsics(K, params);
+        double max_depth = VisibilityMaxDepth(params);
 
-        if (params.increase_visibility_frustum)
+        // A block is visible if the center projects into the depth map and the depth is in [0, max_depth].
+        // VisibilityFrustum contains all these points. Therefore a cell of blocks with a bounding sphere outside of
+        // the frustum can be skipped without changing the result.
+        bool culling = params.visibility_cell_size > 0 && !images.empty();
+        SparseTSDF::BlockCells cells;
+        std::vector<Sphere> cell_spheres;
+        if (culling)
         {
-            K2.fx *= 0.95;
-            K2.fy *= 0.95;
+            cells = tsdf->ComputeBlockCells(params.visibility_cell_size);
+            cell_spheres.resize(cells.cells.size());
+            for (int c = 0; c < (int)cells.cells.size(); ++c)
+            {
+                cell_spheres[c] = tsdf->CellBoundingSphere(cells.cells[c], cells.cell_size);
+            }
         }
 
+        auto is_visible = [&](const FusionImage& dm, const ivec3& index) {
+            Vec3 c = tsdf->BlockCenter(index).cast<double>();
 
-#pragma omp parallel for
-        for (int i = 0; i < Size(); ++i)
-        {
-            auto& dm = images[i];
-            dm.visible_blocks.clear();
-
+            // project to image
+            Vec3 pos = dm.V * c;
 
-            //            for (auto& block : tsdf->blocks)
-            for (int i = 0; i < tsdf->current_blocks; ++i)
-            {
-                auto block = tsdf->blocks[i];
-                Vec3 c     = tsdf->BlockCenter(block.index).cast<double>();
+            Vec2 np           = pos.head<2>() / pos.z();
+            double voxelDepth = pos.z();
 
-                // project to image
-                Vec3 pos = dm.V * c;
+            if (voxelDepth < 0 || voxelDepth > max_depth) return false;
 
-                Vec2 np           = pos.head<2>() / pos.z();
-                double voxelDepth = pos.z();
+            np      = distortNormalizedPoint(np, dis);
+            Vec2 ip = K2.normalizedToImage(np);
 
-                if (voxelDepth < 0 || voxelDepth > params.maxIntegrationDistance + 0.4) continue;
+            // nearest neighbour lookup
+            ip      = ip.array().round();
+            int ipx = ip(0);
+            int ipy = ip(1);
 
-                np      = distortNormalizedPoint(np, dis);
-                Vec2 ip = K2.normalizedToImage(np);
+            return dm.depthMap.inImage(ipy, ipx);
+        };
 
-                // nearest neighbour lookup
-                ip      = ip.array().round();
-                int ipx = ip(0);
-                int ipy = ip(1);
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < Size(); ++i)
+        {
+            auto& dm = images[i];
+            dm.visible_blocks.clear();
 
-                if (!dm.depthMap.inImage(ipy, ipx))
+            if (!culling)
+            {
+                for (int b = 0; b < tsdf->current_blocks; ++b)
                 {
-                    continue;
+                    auto& index = tsdf->blocks[b].index;
+                    if (is_visible(dm, index)) dm.visible_blocks.push_back(index);
                 }
+            }
+            else
+            {
+                Frustum frustum = VisibilityFrustum(dm.V);
 
-                dm.visible_blocks.push_back(block.index);
+                for (int c = 0; c < (int)cells.cells.size(); ++c)
+                {
+                    if (frustum.sphereInFrustum(cell_spheres[c]) == Frustum::OUTSIDE) continue;
+
+                    for (int k = cells.cell_offset[c]; k < cells.cell_offset[c + 1]; ++k)
+                    {
+                        auto& index = tsdf->blocks[cells.cell_blocks[k]].index;
+                        if (is_visible(dm, index)) dm.visible_blocks.push_back(index);
+                    }
+                }
             }
             loading_bar.addProgress(1);
         }
@@ -321,11 +398,15 @@ void FusionScene::Integrate()
 #pragma omp parallel for
             for (int i = 0; i < (int)dm.visible_blocks.size(); ++i)
             {
-                auto& id    = dm.visible_blocks[i];
-                auto* block = tsdf->GetBlock(id);
-                SAIGA_ASSERT(block);
+                auto& id     = dm.visible_blocks[i];
+                int block_id = tsdf->GetBlockId(id);
+                SAIGA_ASSERT(block_id >= 0);
+                auto* block = &tsdf->blocks[block_id];
                 SAIGA_ASSERT(block->index == id);
 
+                // The visible blocks of an image are unique
+                tsdf->SetDirty(block_id);
+
                 //        Vec3 offset = tsdf.GlobalBlockOffset(id).cast<double>();
 
                 for (int i = 0; i < tsdf->VOXEL_BLOCK_SIZE; ++i)
@@ -761,6 +842,12 @@ void FusionScene::ExtractMesh()
 
 
 
+UnifiedMesh FusionScene::ExtractMeshIncremental()
+{
+    surface.Update(*tsdf, params.extract_iso, params.extract_outlier_factor, 0);
+    return surface.CreateMesh();
+}
+
 void FusionScene::Fuse()
 {
     std::cout << "Fusing " << Size() << " depth maps..." << std::endl;
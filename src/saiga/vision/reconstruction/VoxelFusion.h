@@ -12,6 +12,7 @@
 #include "saiga/vision/util/DepthmapPreprocessor.h"
 
 #include "SparseTSDF.h"
+#include "SparseTSDFSurface.h"
 
 #include <saiga/core/model/UnifiedMesh.h>
 #include <set>
@@ -53,8 +54,13 @@ struct SAIGA_VISION_API FusionParams
     float newWeight              = 0.1;
     float maxWeight              = 250;
 
-    int hash_size          = 5 * 1000 * 1000;
-    int block_count        = 25 * 1000;
+    // The visibility test culls cells of visibility_cell_size^3 blocks with the view frustum of each image.
+    // 0 disables the culling, every allocated block is tested for every image.
+    int visibility_cell_size = 8;
+
+    // Initial size of the block hash map and block storage. Both grow automatically.
+    int hash_size          = 64 * 1024;
+    int block_count        = 1000;
     bool post_process_mesh = true;
 
     // added to projet image points.
@@ -109,9 +115,18 @@ struct SAIGA_VISION_API FusionScene
 
     std::vector<int> triangle_soup_inclusive_prefix_sum;
 
+    // Cached per block surface for ExtractMeshIncremental
+    SparseTSDFSurface surface;
+
     TemplatedImage<vec2> unproject_undistort_map;
 
 
+    // Maximum tangent of the undistorted view angle on the image border. Computed in Preprocess.
+    vec2 visibility_tan = vec2::Zero();
+
+    // Contains all blocks that can pass the visibility test of an image with pose V.
+    Frustum VisibilityFrustum(const SE3& V) const;
+
     void Preprocess();
     void AnalyseSparseStructure();
     void ComputeWeight();
@@ -119,6 +134,9 @@ struct SAIGA_VISION_API FusionScene
     void Integrate();
     void IntegratePointBased();
     void ExtractMesh();
+
+    // Only re-meshes the blocks modified since the last call. The vertices are shared and not post processed.
+    UnifiedMesh ExtractMeshIncremental();
 };
 
 
@@ -23,7 +23,8 @@
 
 namespace Saiga
 {
-void BARec::reserve(int n, int m)
+template <typename T>
+void BARecBase<T>::reserve(int n, int m)
 {
     validImages.reserve(n);
     validPoints.reserve(m);
@@ -44,7 +45,8 @@ void BARec::reserve(int n, int m)
     oldx_v.reserve(n);
 }
 
-void BARec::init()
+template <typename T>
+void BARecBase<T>::init()
 {
     //    OMP::setWaitPolicy(OMP::WaitPolicy::Active);
     //    threads = 4;
@@ -173,6 +175,15 @@ void BARec::init()
     pointCameraCountsScan.resize(m);
     observations = 0;
 
+    sceneObservations.build(scene, false);
+    auto& obs = sceneObservations;
+
+    observationPoint.resize(obs.size());
+    for (int o = 0; o < obs.size(); ++o)
+    {
+        observationPoint[o] = pointToValidMap[obs.wp[o]];
+    }
+
     std::vector<int> innerElements;
     for (auto&& info : validImages)
     {
@@ -181,13 +192,9 @@ void BARec::init()
         //        std::cout << imgId << " " << offset << std::endl;
         if (offset == -1) continue;
 
-        auto& img = scene.images[imgId];
-
-        for (auto& ip : img.stereoPoints)
+        for (int o = obs.image_offset[imgId]; o < obs.image_offset[imgId + 1]; ++o)
         {
-            if (ip.wp == -1) continue;
-
-            int j = pointToValidMap[ip.wp];
+            int j = observationPoint[o];
             cameraPointCounts[offset]++;
             pointCameraCounts[j]++;
             innerElements.push_back(j);
@@ -219,6 +226,25 @@ void BARec::init()
         A.w.innerIndexPtr()[i] = innerElements[i];
     }
 
+    if constexpr (!std::is_same_v<T, double>)
+    {
+        // Transposed structure of W for the residual computation of the iterative refinement
+        pointObservations.resize(observations);
+        std::vector<int> position = pointCameraCountsScan;
+        for (int i = 0; i < n; ++i)
+        {
+            for (int k = A.w.outerIndexPtr()[i]; k < A.w.outerIndexPtr()[i + 1]; ++k)
+            {
+                pointObservations[position[A.w.innerIndexPtr()[k]]++] = {k, i};
+            }
+        }
+
+        delta_u.resize(n);
+        delta_v.resize(m);
+        refine_x.resize(n, m);
+        refine_b.resize(n, m);
+    }
+
     // ===== Threading Tmps ======
 
     SAIGA_ASSERT(baOptions.helper_threads > 0);
@@ -238,7 +264,9 @@ void BARec::init()
                               : Eigen::Recursive::LinearSolverOptions::SolverType::Iterative;
     loptions.buildExplizitSchur = optimizationOptions.buildExplizitSchur;
 
-    if (baOptions.solver_threads == 1)
+    // The multi threaded schur solver only supports the iterative solver
+    if (baOptions.solver_threads == 1 ||
+        loptions.solverType == Eigen::Recursive::LinearSolverOptions::SolverType::Direct)
     {
         solver.analyzePattern(A, loptions);
     }
@@ -339,23 +367,29 @@ void BARec::init()
     }
 }
 
-double BARec::computeQuadraticForm()
+template <typename T>
+void BARecBase<T>::setThreadCount(int n)
 {
-    Scene& scene = *_scene;
-
-    //    SAIGA_OPTIONAL_BLOCK_TIMER(RECURSIVE_BA_USE_TIMERS && optimizationOptions.debugOutput);
-
-    using T = BlockBAScalar;
-    //    using KernelType = Saiga::Kernel::BAPosePointMono<T>;
-
-
-    //    b.u.setZero();
-    //    b.v.setZero();
-    //    A.u.setZero();
-    //    A.v.setZero();
-
+    baOptions.helper_threads = n;
+    baOptions.solver_threads = n;
+}
 
+template <typename T>
+double BARecBase<T>::sumLocalChi2()
+{
+    double chi2 = 0;
+    for (int i = 0; i < OMP::getNumThreads(); ++i)
+    {
+        chi2 += localChi2[i];
+    }
+    // The next call resets localChi2 -> wait until all threads have read it.
+#pragma omp barrier
+    return chi2;
+}
 
+template <typename T>
+double BARecBase<T>::computeQuadraticForm()
+{
     SAIGA_ASSERT(A.w.IsRowMajor);
 
     if (n == 0)
@@ -363,8 +397,28 @@ double BARec::computeQuadraticForm()
         return 0;
     }
 
+    if (OMP::inParallel())
+    {
+        return computeQuadraticFormOMP();
+    }
 
+    double chi2 = 0;
 #pragma omp parallel num_threads(baOptions.helper_threads)
+    {
+        double local_result = computeQuadraticFormOMP();
+#pragma omp master
+        chi2 = local_result;
+    }
+    return chi2;
+}
+
+template <typename T>
+double BARecBase<T>::computeQuadraticFormOMP()
+{
+    Scene& scene = *_scene;
+
+    SAIGA_ASSERT(OMP::getNumThreads() <= baOptions.helper_threads);
+
     {
         int tid = OMP::getThreadNum();
 
@@ -400,12 +454,10 @@ double BARec::computeQuadraticForm()
             // int imgid        = info.sceneImageId;
             int actualOffset = info.variableId;
 
-            int k = A.w.outerIndexPtr()[actualOffset];
-
             bool constant = actualOffset == -1;
-            //            std::cout << "img " << imgid << " " << actualOffset << " " << k << " const " << constant <<
-            //            std::endl; SAIGA_ASSERT(k == A.w.outerIndexPtr()[i]);
 
+            // Index of the first observation of this image in A.w
+            int k = constant ? -1 : A.w.outerIndexPtr()[actualOffset];
 
 
             auto& img    = scene.images[info.sceneImageId];
@@ -425,10 +477,12 @@ double BARec::computeQuadraticForm()
                 targetPoseRes.setZero();
             }
 
-            for (auto& ip : img.stereoPoints)
+            auto& obs     = sceneObservations;
+            int obs_begin = obs.image_offset[info.sceneImageId];
+            int obs_end   = obs.image_offset[info.sceneImageId + 1];
+            for (int o = obs_begin; o < obs_end; ++o)
             {
-                if (ip.wp == -1) continue;
-                if (ip.outlier)
+                if (obs.outlier[o])
                 {
                     if (!constant)
                     {
@@ -437,8 +491,8 @@ double BARec::computeQuadraticForm()
                     }
                     continue;
                 }
-                BlockBAScalar w = ip.weight * scene.scale();
-                int j           = pointToValidMap[ip.wp];
+                double w = obs.weight[o] * scene.scale();
+                int j    = observationPoint[o];
 
 
                 auto& wp = x_v[j];
@@ -448,20 +502,20 @@ double BARec::computeQuadraticForm()
                 BDiag& targetPointPoint = bdiagArray[j];
                 BRes& targetPointRes    = bresArray[j];
 
-                if (ip.IsStereoOrDepth())
+                if (obs.IsStereoOrDepth(o))
                 {
-                    auto stereo_point = ip.GetStereoPoint(scene.bf);
+                    auto stereo_point = obs.GetStereoPoint(o, scene.bf);
 
                     Matrix<double, 3, 6> JrowPose;
                     Matrix<double, 3, 3> JrowPoint;
-                    auto [res, depth] = BundleAdjustmentStereo(scam, ip.point, stereo_point, extr, wp, w,
+                    auto [res, depth] = BundleAdjustmentStereo(scam, obs.point[o], stereo_point, extr, wp, w,
                                                                w * scene.stereo_weight, &JrowPose, &JrowPoint);
 
-                    T loss_weight = 1.0;
+                    double loss_weight = 1.0;
                     auto res_2    = res.squaredNorm();
                     if (baOptions.huberStereo > 0)
                     {
-                        auto rw = Kernel::HuberLoss<T>(baOptions.huberStereo, res_2);
+                        auto rw = Kernel::HuberLoss<double>(baOptions.huberStereo, res_2);
                         //                        auto rw     = Kernel::CauchyLoss<T>(baOptions.huberStereo, res_2);
                         res_2       = rw(0);
                         loss_weight = rw(1);
@@ -475,24 +529,24 @@ double BARec::computeQuadraticForm()
                     {
                         auto& targetPosePose = A.u.diagonal()(actualOffset).get();
                         auto& targetPoseRes  = b.u(actualOffset).get();
-                        targetPosePose += loss_weight * JrowPose.transpose() * JrowPose;
-                        targetPosePoint = loss_weight * JrowPose.transpose() * JrowPoint;
-                        targetPoseRes -= loss_weight * JrowPose.transpose() * res;
+                        targetPosePose += (loss_weight * JrowPose.transpose() * JrowPose).template cast<T>();
+                        targetPosePoint = (loss_weight * JrowPose.transpose() * JrowPoint).template cast<T>();
+                        targetPoseRes -= (loss_weight * JrowPose.transpose() * res).template cast<T>();
                     }
-                    targetPointPoint += loss_weight * JrowPoint.transpose() * JrowPoint;
-                    targetPointRes -= loss_weight * JrowPoint.transpose() * res;
+                    targetPointPoint += (loss_weight * JrowPoint.transpose() * JrowPoint).template cast<T>();
+                    targetPointRes -= (loss_weight * JrowPoint.transpose() * res).template cast<T>();
                 }
                 else
                 {
                     Matrix<double, 2, 6> JrowPose;
                     Matrix<double, 2, 3> JrowPoint;
-                    auto [res, depth] = BundleAdjustment(camera, ip.point, extr, wp, w, &JrowPose, &JrowPoint);
+                    auto [res, depth] = BundleAdjustment(camera, obs.point[o], extr, wp, w, &JrowPose, &JrowPoint);
 
-                    T loss_weight = 1.0;
+                    double loss_weight = 1.0;
                     auto res_2    = res.squaredNorm();
                     if (baOptions.huberMono > 0)
                     {
-                        auto rw = Kernel::HuberLoss<T>(baOptions.huberMono, res_2);
+                        auto rw = Kernel::HuberLoss<double>(baOptions.huberMono, res_2);
                         //                        auto rw     = Kernel::CauchyLoss<T>(baOptions.huberMono, res_2);
                         res_2       = rw(0);
                         loss_weight = rw(1);
@@ -504,12 +558,12 @@ double BARec::computeQuadraticForm()
                     {
                         auto& targetPosePose = A.u.diagonal()(actualOffset).get();
                         auto& targetPoseRes  = b.u(actualOffset).get();
-                        targetPosePose += loss_weight * JrowPose.transpose() * JrowPose;
-                        targetPosePoint = loss_weight * JrowPose.transpose() * JrowPoint;
-                        targetPoseRes -= loss_weight * JrowPose.transpose() * res;
+                        targetPosePose += (loss_weight * JrowPose.transpose() * JrowPose).template cast<T>();
+                        targetPosePoint = (loss_weight * JrowPose.transpose() * JrowPoint).template cast<T>();
+                        targetPoseRes -= (loss_weight * JrowPose.transpose() * res).template cast<T>();
                     }
-                    targetPointPoint += loss_weight * JrowPoint.transpose() * JrowPoint;
-                    targetPointRes -= loss_weight * JrowPoint.transpose() * res;
+                    targetPointPoint += (loss_weight * JrowPoint.transpose() * JrowPoint).template cast<T>();
+                    targetPointRes -= (loss_weight * JrowPoint.transpose() * res).template cast<T>();
                 }
 
                 if (!constant)
@@ -523,7 +577,7 @@ double BARec::computeQuadraticForm()
 #pragma omp for
         for (int i = 0; i < m; ++i)
         {
-            for (int j = 0; j < baOptions.helper_threads - 1; ++j)
+            for (int j = 0; j < OMP::getNumThreads() - 1; ++j)
             {
                 A.v.diagonal()(i).get() += pointDiagTemp[j][i];
                 b.v(i).get() += pointResTemp[j][i];
@@ -531,18 +585,11 @@ double BARec::computeQuadraticForm()
         }
     }
 
-
-    chi2_sum = 0;
-    for (int i = 0; i < baOptions.helper_threads; ++i)
-    {
-        chi2_sum += localChi2[i];
-    }
-
-
-    return chi2_sum;
+    return sumLocalChi2();
 }
 
-bool BARec::addDelta()
+template <typename T>
+bool BARecBase<T>::addDelta()
 {
     //#pragma omp parallel num_threads(baOptions.helper_threads)
     {
@@ -558,7 +605,7 @@ bool BARec::addDelta()
 
 
 
-            auto t = delta_x.u(offset).get();
+            Vec6 t = deltaU(offset);
 
             x_u[id] = Sophus::se3_expd(t) * x_u[id];
 
@@ -571,14 +618,15 @@ bool BARec::addDelta()
         for (int i = 0; i < m; ++i)
         {
             oldx_v[i] = x_v[i];
-            auto t    = delta_x.v(i).get();
+            Vec3 t    = deltaV(i);
             x_v[i] += t;
         }
     }
     return true;
 }
 
-void BARec::revertDelta()
+template <typename T>
+void BARecBase<T>::revertDelta()
 {
     //#pragma omp parallel num_threads(threads)
     //#pragma omp parallel num_threads(baOptions.helper_threads)
@@ -593,7 +641,8 @@ void BARec::revertDelta()
 
             x_u[info.validId] = oldx_u[info.validId];
         }
-#pragma omp for nowait
+        // No nowait here, because computeQuadraticForm of the next iteration reads x_v.
+#pragma omp for
         for (int i = 0; i < (int)x_v.size(); ++i)
         {
             x_v[i] = oldx_v[i];
@@ -602,7 +651,8 @@ void BARec::revertDelta()
     //    x_u = oldx_u;
     //    x_v = oldx_v;
 }
-void BARec::finalize()
+template <typename T>
+void BARecBase<T>::finalize()
 {
     Scene& scene = *_scene;
 
@@ -623,7 +673,6 @@ void BARec::finalize()
 #pragma omp for
         for (int i = 0; i < (int)validPoints.size(); ++i)
         {
-            Eigen::Matrix<BlockBAScalar, 3, 1> t;
             auto id = validPoints[i];
             auto& p = scene.worldPoints[id].p;
             p       = x_v[i];
@@ -632,7 +681,8 @@ void BARec::finalize()
 }
 
 
-void BARec::addLambda(double lambda)
+template <typename T>
+void BARecBase<T>::addLambda(double lambda)
 {
     //    if (1 == 1)
     //    {
@@ -652,33 +702,201 @@ void BARec::addLambda(double lambda)
 
 
 
-void BARec::solveLinearSystem()
+template <typename T>
+void BARecBase<T>::solveLinearSystem()
 {
     SAIGA_OPTIONAL_BLOCK_TIMER(RECURSIVE_BA_USE_TIMERS && optimizationOptions.debugOutput);
 
-    if (baOptions.solver_threads == 1)
+    solveSchur(delta_x, b);
+    if constexpr (!std::is_same_v<T, double>)
     {
-        solver.solve(A, delta_x, b, loptions);
+        refineSolution();
     }
-    else
+}
+
+template <typename T>
+void BARecBase<T>::solveSchur(BAVector& x, BAVector& rhs, bool factorized)
+{
+    bool use_omp_solver = baOptions.solver_threads > 1 &&
+                          loptions.solverType == Eigen::Recursive::LinearSolverOptions::SolverType::Iterative;
+
+    auto solve = [&]() {
+        if (factorized)
+            solver.solveFactorized(A, x, rhs, loptions);
+        else
+            solver.solve(A, x, rhs, loptions);
+    };
+    auto solve_omp = [&]() {
+        if (factorized)
+            solver.solveFactorized_omp(A, x, rhs, loptions);
+        else
+            solver.solve_omp(A, x, rhs, loptions);
+    };
+
+    if (OMP::inParallel())
+    {
+        if (use_omp_solver)
+        {
+            solve_omp();
+        }
+        else
+        {
+            // The direct solver is not parallelized over the threads of this region
+#pragma omp single
+            solve();
+        }
+    }
+    else if (use_omp_solver)
     {
 #pragma omp parallel num_threads(baOptions.solver_threads)
         {
-            solver.solve_omp(A, delta_x, b, loptions);
+            solve_omp();
         }
     }
-    //#pragma omp single
+    else
+    {
+        solve();
+    }
 }
 
-double BARec::computeCost()
+template <typename T>
+double BARecBase<T>::refinementResidual(bool with_correction)
 {
-    Scene& scene = *_scene;
+    // refine_b = b - A * delta in double precision
+    //   | U   W | * |delta_u|
+    //   | WT  V |   |delta_v|
+    // If with_correction is set, delta + refine_x is used instead of delta.
+    auto du = [&](int i) -> Vec6 {
+        return with_correction ? Vec6(delta_u[i] + refine_x.u(i).get().template cast<double>()) : delta_u[i];
+    };
+    auto dv = [&](int j) -> Vec3 {
+        return with_correction ? Vec3(delta_v[j] + refine_x.v(j).get().template cast<double>()) : delta_v[j];
+    };
+
+    double& norm2 = localChi2[OMP::getThreadNum()];
+    norm2         = 0;
 
+#pragma omp for
+    for (int i = 0; i < n; ++i)
+    {
+        Vec6 r = b.u(i).get().template cast<double>() - A.u.diagonal()(i).get().template cast<double>() * du(i);
+        for (int k = A.w.outerIndexPtr()[i]; k < A.w.outerIndexPtr()[i + 1]; ++k)
+        {
+            r -= A.w.valuePtr()[k].get().template cast<double>() * dv(A.w.innerIndexPtr()[k]);
+        }
+        refine_b.u(i).get() = r.template cast<T>();
+        norm2 += r.squaredNorm();
+    }
+#pragma omp for
+    for (int j = 0; j < m; ++j)
+    {
+        Vec3 r = b.v(j).get().template cast<double>() - A.v.diagonal()(j).get().template cast<double>() * dv(j);
+        for (int p = pointCameraCountsScan[j]; p < pointCameraCountsScan[j] + pointCameraCounts[j]; ++p)
+        {
+            auto [k, i] = pointObservations[p];
+            r -= A.w.valuePtr()[k].get().transpose().template cast<double>() * du(i);
+        }
+        refine_b.v(j).get() = r.template cast<T>();
+        norm2 += r.squaredNorm();
+    }
+    return sumLocalChi2();
+}
+
+template <typename T>
+void BARecBase<T>::refineSolution()
+{
+    // Start with the single precision solution
+#pragma omp for
+    for (int i = 0; i < n; ++i)
+    {
+        delta_u[i] = delta_x.u(i).get().template cast<double>();
+    }
+#pragma omp for
+    for (int j = 0; j < m; ++j)
+    {
+        delta_v[j] = delta_x.v(j).get().template cast<double>();
+    }
+
+    if (optimizationOptions.refinementSteps <= 0) return;
+
+    double residual_norm2 = refinementResidual(false);
+    for (int step = 0; step < optimizationOptions.refinementSteps; ++step)
+    {
+        // Only back substitution with the single precision factorization of solveLinearSystem()
+        solveSchur(refine_x, refine_b, true);
+
+        // If the single precision solve is too inaccurate (ill conditioned system, small lambda) the refinement
+        // diverges. The correction is only applied if it reduces the residual.
+        double new_residual_norm2 = refinementResidual(true);
+        if (!(new_residual_norm2 < residual_norm2)) break;
+        residual_norm2 = new_residual_norm2;
+
+#pragma omp for
+        for (int i = 0; i < n; ++i)
+        {
+            delta_u[i] += refine_x.u(i).get().template cast<double>();
+        }
+#pragma omp for
+        for (int j = 0; j < m; ++j)
+        {
+            delta_v[j] += refine_x.v(j).get().template cast<double>();
+        }
+    }
+}
+
+template <typename T>
+Vec6 BARecBase<T>::deltaU(int i) const
+{
+    if constexpr (std::is_same_v<T, double>)
+    {
+        return delta_x.u(i).get();
+    }
+    else
+    {
+        return delta_u[i];
+    }
+}
+
+template <typename T>
+Vec3 BARecBase<T>::deltaV(int i) const
+{
+    if constexpr (std::is_same_v<T, double>)
+    {
+        return delta_x.v(i).get();
+    }
+    else
+    {
+        return delta_v[i];
+    }
+}
+
+template <typename T>
+double BARecBase<T>::computeCost()
+{
     SAIGA_OPTIONAL_BLOCK_TIMER(RECURSIVE_BA_USE_TIMERS && optimizationOptions.debugOutput);
 
-    using T = BlockBAScalar;
+    if (OMP::inParallel())
+    {
+        return computeCostOMP();
+    }
 
+    double chi2 = 0;
 #pragma omp parallel num_threads(baOptions.helper_threads)
+    {
+        double local_result = computeCostOMP();
+#pragma omp master
+        chi2 = local_result;
+    }
+    return chi2;
+}
+
+template <typename T>
+double BARecBase<T>::computeCostOMP()
+{
+    Scene& scene = *_scene;
+
+    SAIGA_ASSERT(OMP::getNumThreads() <= baOptions.helper_threads);
+
     {
         int tid = OMP::getThreadNum();
 
@@ -697,23 +915,24 @@ double BARec::computeCost()
 
             StereoCamera4 scam(camera, scene.bf);
 
-            for (auto& ip : img.stereoPoints)
+            auto& obs = sceneObservations;
+            for (int o = obs.image_offset[info.sceneImageId]; o < obs.image_offset[info.sceneImageId + 1]; ++o)
             {
-                if (!ip) continue;
-                BlockBAScalar w = ip.weight * scene.scale();
-                int j           = pointToValidMap[ip.wp];
+                if (obs.outlier[o]) continue;
+                double w = obs.weight[o] * scene.scale();
+                int j    = observationPoint[o];
                 SAIGA_ASSERT(j >= 0);
                 auto& wp = x_v[j];
 
-                if (ip.IsStereoOrDepth())
+                if (obs.IsStereoOrDepth(o))
                 {
-                    auto stereo_point = ip.GetStereoPoint(scene.bf);
+                    auto stereo_point = obs.GetStereoPoint(o, scene.bf);
                     auto [res, depth] =
-                        BundleAdjustmentStereo(scam, ip.point, stereo_point, extr, wp, w, w * scene.stereo_weight);
+                        BundleAdjustmentStereo(scam, obs.point[o], stereo_point, extr, wp, w, w * scene.stereo_weight);
                     auto res_2 = res.squaredNorm();
                     if (baOptions.huberStereo > 0)
                     {
-                        auto rw = Kernel::HuberLoss<T>(baOptions.huberStereo, res_2);
+                        auto rw = Kernel::HuberLoss<double>(baOptions.huberStereo, res_2);
                         //                        auto rw = Kernel::CauchyLoss<T>(baOptions.huberStereo, res_2);
                         res_2 = rw(0);
                     }
@@ -721,12 +940,12 @@ double BARec::computeCost()
                 }
                 else
                 {
-                    auto [res, depth] = BundleAdjustment(scam, ip.point, extr, wp, w);
+                    auto [res, depth] = BundleAdjustment(scam, obs.point[o], extr, wp, w);
 
                     auto res_2 = res.squaredNorm();
                     if (baOptions.huberMono > 0)
                     {
-                        auto rw = Kernel::HuberLoss<T>(baOptions.huberMono, res_2);
+                        auto rw = Kernel::HuberLoss<double>(baOptions.huberMono, res_2);
                         //                        auto rw = Kernel::CauchyLoss<T>(baOptions.huberMono, res_2);
                         res_2 = rw(0);
                     }
@@ -736,14 +955,10 @@ double BARec::computeCost()
         }
     }
 
+    return sumLocalChi2();
+}
 
-    chi2_sum = 0;
-    for (int i = 0; i < baOptions.helper_threads; ++i)
-    {
-        chi2_sum += localChi2[i];
-    }
-
+template class BARecBase<double>;
+template class BARecBase<float>;
 
-    return chi2_sum;
-}
 }  // namespace Saiga
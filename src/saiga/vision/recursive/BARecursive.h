@@ -13,13 +13,25 @@
 
 namespace Saiga
 {
-class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
+/**
+ * Recursive BA with a Schur complement solver.
+ *
+ * The linear system (Hessian blocks, Schur complement and PCG vectors) uses the scalar type T. The residuals, the chi2
+ * and the state (poses and points) are always double.
+ *
+ * With T = float (BARecFloat) the memory traffic of the linear solver is halved. The delta can be improved with
+ * optimizationOptions.refinementSteps steps of iterative refinement, where the residual of the linear system and the
+ * refined delta are computed in double precision. The steps reuse the single precision Schur complement and its
+ * factorization, so with the direct solver every step only costs one back substitution.
+ */
+template <typename T>
+class SAIGA_VISION_API BARecBase : public BABase, public LMOptimizer
 {
    public:
     // ============== Recusrive Matrix Types ==============
     static constexpr int blockSizeCamera = 6;
     static constexpr int blockSizePoint  = 3;
-    using BlockBAScalar                  = double;
+    using BlockBAScalar                  = T;
 
     using ADiag  = Eigen::Matrix<BlockBAScalar, blockSizeCamera, blockSizeCamera, Eigen::RowMajor>;
     using BDiag  = Eigen::Matrix<BlockBAScalar, blockSizePoint, blockSizePoint, Eigen::RowMajor>;
@@ -49,8 +61,8 @@ class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
    public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-    BARec() : BABase("Recursive BA") {}
-    virtual ~BARec() {}
+    BARecBase() : BABase(std::is_same_v<T, double> ? "Recursive BA" : "Recursive BA (float)") {}
+    virtual ~BARecBase() {}
     virtual void create(Scene& scene) override { _scene = &scene; }
 
     // resserve space for n cameras and m points
@@ -72,6 +84,11 @@ class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
     AlignedVector<SE3> x_u, oldx_u;
     AlignedVector<Vec3> x_v, oldx_v;
 
+    // The delta in double precision. Only used if T != double.
+    AlignedVector<Vec6> delta_u;
+    AlignedVector<Vec3> delta_v;
+    BAVector refine_x, refine_b;
+
     // ============== Structure information ==============
 
     int observations;
@@ -105,6 +122,13 @@ class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
     std::vector<int> validPoints;
     std::vector<int> pointToValidMap;
 
+    // Compact copy of the image points. The valid point index of every observation is stored in observationPoint.
+    SceneObservations sceneObservations;
+    std::vector<int> observationPoint;
+
+    // The observations of A.w sorted by point: (index into A.w.valuePtr(), camera)
+    std::vector<std::pair<int, int>> pointObservations;
+
 
 
     bool explizitSchur = false;
@@ -117,7 +141,6 @@ class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
     std::vector<AlignedVector<BDiag>> pointDiagTemp;
     std::vector<AlignedVector<BRes>> pointResTemp;
     std::vector<double> localChi2;
-    double chi2_sum;
 
 
     // ============== LM Functions ==============
@@ -130,7 +153,30 @@ class SAIGA_VISION_API BARec : public BABase, public LMOptimizer
     virtual void solveLinearSystem() override;
     virtual double computeCost() override;
     virtual void finalize() override;
+
+    // The LM functions can be called from the parallel region of LMOptimizer::solveOMP. In that case, the work is
+    // distributed over the threads of this region. Otherwise, they create their own parallel region with
+    // baOptions.helper_threads threads.
+    virtual void setThreadCount(int n) override;
+    virtual bool supportOMP() override { return true; }
+
+    // Must be called by all threads of a parallel region. Every thread returns the total chi2.
+    double computeQuadraticFormOMP();
+    double computeCostOMP();
+    double sumLocalChi2();
+
+    // With factorized = true, the Schur complement and its factorization of the last call are reused.
+    void solveSchur(BAVector& x, BAVector& rhs, bool factorized = false);
+    // Iterative refinement of delta_x (see class description)
+    void refineSolution();
+    // Computes refine_b = b - A * delta and returns its squared norm. Must be called by all threads.
+    double refinementResidual(bool with_correction);
+    Vec6 deltaU(int i) const;
+    Vec3 deltaV(int i) const;
 };
 
+using BARec      = BARecBase<double>;
+using BARecFloat = BARecBase<float>;
+
 
 }  // namespace Saiga
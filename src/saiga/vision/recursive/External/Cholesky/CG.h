@@ -413,8 +413,9 @@ EIGEN_DONT_INLINE void recursive_conjugate_gradient_OMP(const MultFunction& appl
         z = precond.solve(residual);  // approximately solve for "A z = residual"
 
         RealScalar absOld = absNew;
-        dot_omp_local(residual, z, tmpResults[tid].data);
-        absNew          = accumulate(tmpResults);
+        // Use the other buffer, because slower threads might still accumulate residualNorm2.
+        dot_omp_local(residual, z, tmpResults1[tid].data);
+        absNew          = accumulate(tmpResults1);
         RealScalar beta = absNew / absOld;  // calculate the Gram-Schmidt value used to create the new search direction
                                             //        std::cout << "absnew " << absNew << " beta " << beta << std::endl;
 #    pragma omp for
@@ -0,0 +1,620 @@
+/**
+ * This file is part of the Eigen Recursive Matrix Extension (ERME).
+ *
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "../Core.h"
+#include "Eigen/Cholesky"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <vector>
+
+namespace Eigen::Recursive
+{
+/**
+ * Supernodal LL^T factorization of a symmetric positive definite block sparse matrix.
+ *
+ * The input is a Eigen::SparseMatrix<MatrixScalar<Block>> with fixed size quadratic blocks (for example 6x6 in BA and
+ * PGO). Only the upper triangle (including the diagonal blocks) is read.
+ *
+ * The analysis works on the block structure:
+ *  1. Fill reducing AMD ordering + postordering of the elimination tree
+ *  2. Fundamental supernodes: consecutive block columns with the same nonzero structure below the diagonal
+ *  3. Row structure of each supernode and the list of descendants which update it
+ *
+ * Every supernode is stored as a dense column-major panel. The numeric factorization is left-looking: a supernode
+ * first gathers the updates of all its descendants (one GEMM per descendant) and then factorizes its panel with a
+ * dense LLT and a triangular solve. Supernodes with the same height in the elimination tree are independent and are
+ * processed in parallel with OpenMP. The chain of single supernodes at the top of the tree (usually the largest
+ * panels) is processed outside the parallel region, so the dense kernels of Eigen can use all threads.
+ *
+ * The analysis is reused by factorize() as long as the sparsity pattern of A doesn't change. This is the case in
+ * the LM iterations of BA and PGO.
+ *
+ * Usage:
+ *
+ * RecursiveSupernodalLLT<SparseMatrix<MatrixScalar<Matrix6>, RowMajor>> llt;
+ * llt.compute(A);
+ * x = llt.solve(b);
+ * // In the next iteration with the same structure
+ * llt.factorize(A);
+ */
+template <typename _MatrixType>
+class RecursiveSupernodalLLT
+{
+   public:
+    using MatrixType  = _MatrixType;
+    using BlockScalar = typename MatrixType::Scalar;
+    using Block       = typename BlockScalar::M;
+    using Scalar      = typename Block::Scalar;
+    using DenseMatrix = Eigen::Matrix<Scalar, -1, -1>;
+    using DenseVector = Eigen::Matrix<Scalar, -1, 1>;
+
+    static constexpr int block_size = Block::RowsAtCompileTime;
+    static_assert(Block::RowsAtCompileTime == Block::ColsAtCompileTime && block_size > 0,
+                  "Only fixed size quadratic blocks are supported.");
+
+    RecursiveSupernodalLLT() {}
+    explicit RecursiveSupernodalLLT(const MatrixType& A) { compute(A); }
+
+    RecursiveSupernodalLLT& compute(const MatrixType& A)
+    {
+        analyzePattern(A);
+        factorize(A);
+        return *this;
+    }
+
+    void analyzePattern(const MatrixType& A);
+    void factorize(const MatrixType& A);
+
+    /**
+     * Solves A * x = b. The vector type is a block vector, for example Matrix<MatrixScalar<Vector6>, -1, 1>.
+     */
+    template <typename VectorType>
+    VectorType solve(const VectorType& b) const;
+
+    ComputationInfo info() const { return m_info; }
+
+    int numSupernodes() const { return snodes.size(); }
+
+    // Number of scalar nonzeros in L (including the explicit zeros of the supernodes)
+    size_t factorNonZeros() const { return values.size(); }
+
+    // perm[i] is the position of block row i of A in the factorization.
+    const std::vector<int>& permutation() const { return perm; }
+
+   private:
+    struct Supernode
+    {
+        // Block columns [first, last]
+        int first, last;
+        // Scalar size of the panel. The first 'cols' rows are the diagonal block.
+        int rows, cols;
+        size_t offset;
+        // Block row indices below 'last'. Sorted.
+        std::vector<int> below;
+        int parent = -1;
+    };
+
+    // Descendant d updates the columns of this supernode with its rows below[p0, p1).
+    struct Update
+    {
+        int d, p0, p1;
+    };
+
+    // Destination of a block of A in the panels
+    struct Target
+    {
+        size_t offset;
+        int ld;
+        bool transpose;
+    };
+
+    struct Workspace
+    {
+        DenseMatrix tmp;
+        std::vector<int> rel;
+    };
+
+    int n = 0;
+    std::vector<int> perm;
+    std::vector<int> snode_of;
+    std::vector<Supernode> snodes;
+    std::vector<std::vector<Update>> updates;
+    // Parallel levels ordered bottom up. The levels [top_chain, end) contain a single supernode.
+    std::vector<std::vector<int>> levels;
+    int top_chain = 0;
+
+    std::vector<Target> targets;
+    std::vector<Scalar> values;
+
+    bool m_analysisIsOk = false;
+    ComputationInfo m_info = InvalidInput;
+
+    // Lower triangular block pattern of P * A * P^T (without the diagonal) and its elimination tree.
+    void permutedPattern(const MatrixType& A, const std::vector<int>& p, std::vector<int>& col_ptr,
+                         std::vector<int>& row_ptr, std::vector<int>& rows, std::vector<int>& cols) const;
+    static std::vector<int> eliminationTree(int n, const std::vector<int>& row_ptr, const std::vector<int>& cols);
+
+    bool factorSupernode(int s, Workspace& ws);
+};
+
+template <typename _MatrixType>
+void RecursiveSupernodalLLT<_MatrixType>::permutedPattern(const MatrixType& A, const std::vector<int>& p,
+                                                          std::vector<int>& col_ptr, std::vector<int>& row_ptr,
+                                                          std::vector<int>& rows, std::vector<int>& cols) const
+{
+    std::vector<std::pair<int, int>> entries;
+    entries.reserve(A.nonZeros());
+    for (int k = 0; k < A.outerSize(); ++k)
+    {
+        for (typename MatrixType::InnerIterator it(A, k); it; ++it)
+        {
+            if (it.row() >= it.col()) continue;
+            int i = p[it.row()], j = p[it.col()];
+            entries.emplace_back(std::max(i, j), std::min(i, j));
+        }
+    }
+
+    // Column compressed (rows of each column) and row compressed (cols of each row)
+    col_ptr.assign(n + 1, 0);
+    row_ptr.assign(n + 1, 0);
+    for (auto& e : entries)
+    {
+        col_ptr[e.second + 1]++;
+        row_ptr[e.first + 1]++;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        col_ptr[i + 1] += col_ptr[i];
+        row_ptr[i + 1] += row_ptr[i];
+    }
+    rows.resize(entries.size());
+    cols.resize(entries.size());
+    std::vector<int> cp(col_ptr.begin(), col_ptr.end() - 1), rp(row_ptr.begin(), row_ptr.end() - 1);
+    for (auto& e : entries)
+    {
+        rows[cp[e.second]++] = e.first;
+        cols[rp[e.first]++]  = e.second;
+    }
+}
+
+template <typename _MatrixType>
+std::vector<int> RecursiveSupernodalLLT<_MatrixType>::eliminationTree(int n, const std::vector<int>& row_ptr,
+                                                                      const std::vector<int>& cols)
+{
+    // Liu's algorithm with path compression
+    std::vector<int> parent(n, -1), ancestor(n, -1);
+    for (int k = 0; k < n; ++k)
+    {
+        for (int p = row_ptr[k]; p < row_ptr[k + 1]; ++p)
+        {
+            int i = cols[p];
+            while (i != -1 && i < k)
+            {
+                int next    = ancestor[i];
+                ancestor[i] = k;
+                if (next == -1) parent[i] = k;
+                i = next;
+            }
+        }
+    }
+    return parent;
+}
+
+template <typename _MatrixType>
+void RecursiveSupernodalLLT<_MatrixType>::analyzePattern(const MatrixType& A)
+{
+    eigen_assert(A.rows() == A.cols());
+    n = A.rows();
+    const int B = block_size;
+
+    std::vector<int> col_ptr, row_ptr, rows, cols;
+
+    // ==== Fill reducing ordering ====
+    std::vector<int> identity(n);
+    std::iota(identity.begin(), identity.end(), 0);
+    {
+        permutedPattern(A, identity, col_ptr, row_ptr, rows, cols);
+        // AMD requires the full symmetric pattern. With only one triangle the ordering is much worse.
+        Eigen::SparseMatrix<Scalar, ColMajor, int> pattern(n, n);
+        std::vector<Eigen::Triplet<Scalar>> trips;
+        trips.reserve(2 * rows.size() + n);
+        for (int j = 0; j < n; ++j)
+        {
+            trips.emplace_back(j, j, 1);
+            for (int p = col_ptr[j]; p < col_ptr[j + 1]; ++p)
+            {
+                trips.emplace_back(rows[p], j, 1);
+                trips.emplace_back(j, rows[p], 1);
+            }
+        }
+        pattern.setFromTriplets(trips.begin(), trips.end());
+
+        // The ordering methods compute the inverse permutation (new -> old)
+        Eigen::PermutationMatrix<-1, -1, int> pinv;
+        Eigen::AMDOrdering<int> amd;
+        amd(pattern, pinv);
+        perm.resize(n);
+        for (int i = 0; i < n; ++i) perm[pinv.indices()[i]] = i;
+    }
+
+    // ==== Postorder of the elimination tree ====
+    // Subtrees become consecutive column ranges, which is required for the supernode detection.
+    {
+        permutedPattern(A, perm, col_ptr, row_ptr, rows, cols);
+        auto parent = eliminationTree(n, row_ptr, cols);
+
+        std::vector<int> head(n, -1), next(n, -1), post, stack;
+        for (int j = n - 1; j >= 0; --j)
+        {
+            if (parent[j] == -1) continue;
+            next[j]         = head[parent[j]];
+            head[parent[j]] = j;
+        }
+        post.reserve(n);
+        for (int j = 0; j < n; ++j)
+        {
+            if (parent[j] != -1) continue;
+            stack.push_back(j);
+            while (!stack.empty())
+            {
+                int p = stack.back();
+                int c = head[p];
+                if (c == -1)
+                {
+                    stack.pop_back();
+                    post.push_back(p);
+                }
+                else
+                {
+                    head[p] = next[c];
+                    stack.push_back(c);
+                }
+            }
+        }
+        eigen_assert((int)post.size() == n);
+
+        std::vector<int> new_position(n);
+        for (int k = 0; k < n; ++k) new_position[post[k]] = k;
+        for (auto& p : perm) p = new_position[p];
+    }
+
+    permutedPattern(A, perm, col_ptr, row_ptr, rows, cols);
+    auto parent = eliminationTree(n, row_ptr, cols);
+
+    // ==== Column counts of L (without diagonal) ====
+    // Row k of L is the union of the paths from the nonzeros of row k of A to k in the elimination tree.
+    std::vector<int> count(n, 0), mark(n, -1), num_children(n, 0);
+    snode_of.resize(n);
+    for (int k = 0; k < n; ++k)
+    {
+        mark[k] = k;
+        for (int p = row_ptr[k]; p < row_ptr[k + 1]; ++p)
+        {
+            for (int i = cols[p]; mark[i] != k; i = parent[i])
+            {
+                mark[i] = k;
+                count[i]++;
+            }
+        }
+        if (parent[k] != -1) num_children[parent[k]]++;
+    }
+
+    // ==== Supernodes ====
+    // Fundamental supernodes: j belongs to the supernode of j-1 if j-1 is the only child of j and the structures are
+    // identical.
+    std::vector<std::pair<int, int>> fundamental;
+    for (int j = 0; j < n; ++j)
+    {
+        if (j > 0 && parent[j - 1] == j && count[j - 1] == count[j] + 1 && num_children[j] == 1)
+            fundamental.back().second = j;
+        else
+            fundamental.push_back({j, j});
+    }
+
+    // Relaxed amalgamation with the thresholds of CHOLMOD. A supernode is merged with its parent if the parent
+    // directly follows it and the merged panel [f, l] doesn't contain too many explicit zeros. All columns are
+    // descendants of l, therefore the rows below l are the structure of column l.
+    std::vector<double> count_sum(n + 1, 0);
+    for (int j = 0; j < n; ++j) count_sum[j + 1] = count_sum[j] + count[j];
+    auto relax = [&](int f, int l) {
+        double w     = l - f + 1;
+        double zeros = w * (w - 1) / 2 + w * count[l] - (count_sum[l + 1] - count_sum[f]);
+        double z     = zeros / (w * (w + 1) / 2 + w * count[l]);
+        double c     = w * B;
+        return c <= 4 || (c <= 16 && z < 0.8) || (c <= 48 && z < 0.1) || z < 0.05;
+    };
+
+    snodes.clear();
+    for (auto [f, l] : fundamental)
+    {
+        if (!snodes.empty() && parent[snodes.back().last] == f && relax(snodes.back().first, l))
+        {
+            snodes.back().last = l;
+        }
+        else
+        {
+            snodes.emplace_back();
+            snodes.back().first = f;
+            snodes.back().last  = l;
+        }
+    }
+    for (int s = 0; s < (int)snodes.size(); ++s)
+    {
+        for (int j = snodes[s].first; j <= snodes[s].last; ++j) snode_of[j] = s;
+    }
+    int ns = snodes.size();
+
+    // ==== Row structure ====
+    // The children have smaller indices -> their structure is already known.
+    std::vector<std::vector<int>> children(ns);
+    std::fill(mark.begin(), mark.end(), -1);
+    size_t total_size = 0;
+    for (int s = 0; s < ns; ++s)
+    {
+        auto& S = snodes[s];
+        S.below.clear();
+        auto add = [&](int r) {
+            if (r > S.last && mark[r] != s)
+            {
+                mark[r] = s;
+                S.below.push_back(r);
+            }
+        };
+        for (int j = S.first; j <= S.last; ++j)
+        {
+            for (int p = col_ptr[j]; p < col_ptr[j + 1]; ++p) add(rows[p]);
+        }
+        for (int c : children[s])
+        {
+            for (int r : snodes[c].below) add(r);
+        }
+        std::sort(S.below.begin(), S.below.end());
+        eigen_assert((int)S.below.size() == count[S.last]);
+
+        S.parent = parent[S.last] == -1 ? -1 : snode_of[parent[S.last]];
+        if (S.parent != -1) children[S.parent].push_back(s);
+
+        S.cols   = (S.last - S.first + 1) * B;
+        S.rows   = S.cols + S.below.size() * B;
+        S.offset = total_size;
+        total_size += size_t(S.rows) * S.cols;
+    }
+    values.resize(total_size);
+
+    // ==== Update lists ====
+    updates.assign(ns, {});
+    for (int d = 0; d < ns; ++d)
+    {
+        auto& below = snodes[d].below;
+        for (int p0 = 0; p0 < (int)below.size();)
+        {
+            int t  = snode_of[below[p0]];
+            int p1 = p0 + 1;
+            while (p1 < (int)below.size() && below[p1] <= snodes[t].last) ++p1;
+            updates[t].push_back({d, p0, p1});
+            p0 = p1;
+        }
+    }
+
+    // ==== Parallel schedule ====
+    std::vector<int> height(ns, 0);
+    int max_height = 0;
+    for (int s = 0; s < ns; ++s)
+    {
+        for (int c : children[s]) height[s] = std::max(height[s], height[c] + 1);
+        max_height = std::max(max_height, height[s]);
+    }
+    levels.assign(ns > 0 ? max_height + 1 : 0, {});
+    for (int s = 0; s < ns; ++s) levels[height[s]].push_back(s);
+    top_chain = levels.size();
+    while (top_chain > 0 && levels[top_chain - 1].size() == 1) --top_chain;
+
+    // ==== Assembly targets of the blocks of A ====
+    targets.clear();
+    targets.reserve(A.nonZeros());
+    for (int k = 0; k < A.outerSize(); ++k)
+    {
+        for (typename MatrixType::InnerIterator it(A, k); it; ++it)
+        {
+            if (it.row() > it.col())
+            {
+                // Lower triangle is ignored
+                targets.push_back({0, -1, false});
+                continue;
+            }
+            int i = perm[it.row()], j = perm[it.col()];
+            int r = std::max(i, j), c = std::min(i, j);
+
+            auto& S = snodes[snode_of[c]];
+            int local_row;
+            if (r <= S.last)
+            {
+                local_row = r - S.first;
+            }
+            else
+            {
+                auto pos = std::lower_bound(S.below.begin(), S.below.end(), r);
+                eigen_assert(pos != S.below.end() && *pos == r);
+                local_row = (S.last - S.first + 1) + (pos - S.below.begin());
+            }
+            int local_col = c - S.first;
+
+            // A(row, col) is stored at L(r, c). Diagonal blocks are transposed as well, because the dense LLT reads
+            // the lower triangle and only the upper triangle is guaranteed to be valid.
+            bool transpose = i <= j;
+            targets.push_back({S.offset + size_t(local_col) * B * S.rows + size_t(local_row) * B, S.rows, transpose});
+        }
+    }
+
+    m_analysisIsOk = true;
+    m_info         = Success;
+}
+
+template <typename _MatrixType>
+void RecursiveSupernodalLLT<_MatrixType>::factorize(const MatrixType& A)
+{
+    eigen_assert(m_analysisIsOk && "analyzePattern() must be called before factorize()");
+    eigen_assert(A.rows() == n && (size_t)A.nonZeros() == targets.size() && "The pattern of A has changed");
+    const int B = block_size;
+
+    std::fill(values.begin(), values.end(), Scalar(0));
+    {
+        size_t idx = 0;
+        for (int k = 0; k < A.outerSize(); ++k)
+        {
+            for (typename MatrixType::InnerIterator it(A, k); it; ++it, ++idx)
+            {
+                auto& t = targets[idx];
+                if (t.ld < 0) continue;
+                Eigen::Map<Eigen::Matrix<Scalar, block_size, block_size>, 0, Eigen::OuterStride<>> dst(
+                    values.data() + t.offset, B, B, Eigen::OuterStride<>(t.ld));
+                if (t.transpose)
+                    dst = it.value().get().transpose();
+                else
+                    dst = it.value().get();
+            }
+        }
+    }
+
+    std::atomic<bool> success = true;
+
+#pragma omp parallel
+    {
+        Workspace ws;
+        for (int l = 0; l < top_chain; ++l)
+        {
+            auto& level = levels[l];
+#pragma omp for schedule(dynamic)
+            for (int i = 0; i < (int)level.size(); ++i)
+            {
+                if (!factorSupernode(level[i], ws)) success = false;
+            }
+        }
+    }
+
+    Workspace ws;
+    for (int l = top_chain; l < (int)levels.size(); ++l)
+    {
+        if (!factorSupernode(levels[l].front(), ws)) success = false;
+    }
+
+    m_info = success ? Success : NumericalIssue;
+}
+
+template <typename _MatrixType>
+bool RecursiveSupernodalLLT<_MatrixType>::factorSupernode(int s, Workspace& ws)
+{
+    const int B  = block_size;
+    auto& S      = snodes[s];
+    int ncolumns = S.last - S.first + 1;
+    Eigen::Map<DenseMatrix> panel(values.data() + S.offset, S.rows, S.cols);
+
+    // ==== Gather the updates of all descendants ====
+    for (auto& u : updates[s])
+    {
+        auto& D = snodes[u.d];
+        Eigen::Map<const DenseMatrix> dpanel(values.data() + D.offset, D.rows, D.cols);
+
+        int row_start = D.cols + u.p0 * B;
+        int m1        = (u.p1 - u.p0) * B;
+        int m2        = D.rows - row_start;
+        ws.tmp.resize(m2, m1);
+        ws.tmp.noalias() = dpanel.bottomRows(m2) * dpanel.middleRows(row_start, m1).transpose();
+
+        // Position of the descendant rows in this panel. The rows of D are a subset of the rows of S.
+        int num = D.below.size() - u.p0;
+        ws.rel.resize(num);
+        int q = 0;
+        for (int p = 0; p < num; ++p)
+        {
+            int r = D.below[u.p0 + p];
+            if (r <= S.last)
+            {
+                ws.rel[p] = r - S.first;
+            }
+            else
+            {
+                while (S.below[q] < r) ++q;
+                ws.rel[p] = ncolumns + q;
+            }
+        }
+
+        for (int jj = 0; jj < u.p1 - u.p0; ++jj)
+        {
+            int c = ws.rel[jj];
+            for (int ii = jj; ii < num; ++ii)
+            {
+                panel.template block<block_size, block_size>(ws.rel[ii] * B, c * B) -=
+                    ws.tmp.template block<block_size, block_size>(ii * B, jj * B);
+            }
+        }
+    }
+
+    // ==== Dense factorization of the panel ====
+    Eigen::Ref<DenseMatrix> diag = panel.topRows(S.cols);
+    Eigen::LLT<Eigen::Ref<DenseMatrix>> llt(diag);
+    if (llt.info() != Success) return false;
+
+    if (S.rows > S.cols)
+    {
+        diag.template triangularView<Lower>().transpose().template solveInPlace<OnTheRight>(
+            panel.bottomRows(S.rows - S.cols));
+    }
+    return true;
+}
+
+template <typename _MatrixType>
+template <typename VectorType>
+VectorType RecursiveSupernodalLLT<_MatrixType>::solve(const VectorType& b) const
+{
+    eigen_assert(m_info == Success && "factorize() failed or was not called");
+    eigen_assert(b.rows() == n);
+    const int B = block_size;
+
+    DenseVector y(n * B);
+    for (int i = 0; i < n; ++i) y.segment(perm[i] * B, B) = b(i).get();
+
+    DenseVector tmp;
+
+    // L * z = y
+    for (auto& S : snodes)
+    {
+        Eigen::Map<const DenseMatrix> panel(values.data() + S.offset, S.rows, S.cols);
+        auto x1 = y.segment(S.first * B, S.cols);
+        panel.topRows(S.cols).template triangularView<Lower>().solveInPlace(x1);
+        if (S.below.empty()) continue;
+
+        tmp.noalias() = panel.bottomRows(S.rows - S.cols) * x1;
+        for (int p = 0; p < (int)S.below.size(); ++p) y.segment(S.below[p] * B, B) -= tmp.segment(p * B, B);
+    }
+
+    // L^T * x = z
+    for (int s = snodes.size() - 1; s >= 0; --s)
+    {
+        auto& S = snodes[s];
+        Eigen::Map<const DenseMatrix> panel(values.data() + S.offset, S.rows, S.cols);
+        auto x1 = y.segment(S.first * B, S.cols);
+        if (!S.below.empty())
+        {
+            tmp.resize(S.rows - S.cols);
+            for (int p = 0; p < (int)S.below.size(); ++p) tmp.segment(p * B, B) = y.segment(S.below[p] * B, B);
+            x1.noalias() -= panel.bottomRows(S.rows - S.cols).transpose() * tmp;
+        }
+        panel.topRows(S.cols).transpose().template triangularView<Upper>().solveInPlace(x1);
+    }
+
+    VectorType x(n);
+    for (int i = 0; i < n; ++i) x(i).get() = y.segment(perm[i] * B, B);
+    return x;
+}
+
+}  // namespace Eigen::Recursive
@@ -28,9 +28,12 @@ struct LinearSolverOptions
     bool buildExplizitSchur = false;
 
     // Well the cholmod supernodal ist extremly fast
-    // -> Maybe in the future when I have implemented a supernodal recursive factorization
-    //      I switch it back to false ;)
+    // -> Only used by the sparse solver if saiga was compiled with cholmod.
     bool cholmod = true;
+
+    // Use the recursive supernodal LLT (RecursiveSupernodalLLT) for direct solves instead of the simplicial LDLT.
+    // If the LLT fails, the simplicial LDLT is used as a fallback.
+    bool supernodal = true;
 };
 
 /**
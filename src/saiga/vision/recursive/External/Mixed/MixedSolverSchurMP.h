@@ -60,6 +60,7 @@ class MixedSymmetricRecursiveSolver<
     using S2Type = Eigen::SparseMatrix<VBlock, Eigen::RowMajor>;
 
     using LDLT         = Eigen::RecursiveSimplicialLDLT<S1Type, Eigen::Upper>;
+    using LLT          = RecursiveSupernodalLLT<S1Type>;
     using InnerSolver1 = MixedSymmetricRecursiveSolver<S1Type, XUType>;
 
 
@@ -87,6 +88,7 @@ class MixedSymmetricRecursiveSolver<
             hasWT         = true;
             explizitSchur = true;
             ldlt          = nullptr;
+            llt           = nullptr;
         }
         else
         {
@@ -150,17 +152,38 @@ class MixedSymmetricRecursiveSolver<
 
         if (solverOptions.solverType == LinearSolverOptions::SolverType::Direct)
         {
-            // Direct recusive ldlt solver
-            if (!ldlt)
+            if (solverOptions.supernodal && !ldlt)
             {
-                ldlt = std::make_unique<LDLT>();
-                ldlt->compute(S1);
+                // Direct recursive supernodal llt solver
+                if (!llt)
+                {
+                    llt = std::make_unique<LLT>();
+                    llt->compute(S1);
+                }
+                else
+                {
+                    llt->factorize(S1);
+                }
+            }
+
+            if (llt && llt->info() == Eigen::Success)
+            {
+                da = llt->solve(ej);
             }
             else
             {
-                ldlt->factorize(S1);
+                // Direct recusive ldlt solver
+                if (!ldlt)
+                {
+                    ldlt = std::make_unique<LDLT>();
+                    ldlt->compute(S1);
+                }
+                else
+                {
+                    ldlt->factorize(S1);
+                }
+                da = ldlt->solve(ej);
             }
-            da = ldlt->solve(ej);
         }
         else
         {
@@ -216,6 +239,7 @@ class MixedSymmetricRecursiveSolver<
     //    InnerSolver1 solver1;
 
     std::unique_ptr<LDLT> ldlt;
+    std::unique_ptr<LLT> llt;
 
     bool patternAnalyzed = false;
     bool hasWT           = true;
@@ -269,6 +293,7 @@ class MixedSymmetricRecursiveSolver<
     using S2Type = Eigen::SparseMatrix<VBlock, Eigen::RowMajor>;
 
     using LDLT         = Eigen::RecursiveSimplicialLDLT<S1Type, Eigen::Upper>;
+    using LLT          = RecursiveSupernodalLLT<S1Type>;
     using InnerSolver1 = MixedSymmetricRecursiveSolver<S1Type, XUType>;
 
 
@@ -297,6 +322,7 @@ class MixedSymmetricRecursiveSolver<
             hasWT         = true;
             explizitSchur = true;
             ldlt          = nullptr;
+            llt           = nullptr;
         }
         else
         {
@@ -321,13 +347,9 @@ class MixedSymmetricRecursiveSolver<
     void solve(AType& A, XType& x, XType& b, const LinearSolverOptions& solverOptions = LinearSolverOptions())
     {
         // Some references for easier access
-        const AUType& U  = A.u;
-        const AVType& V  = A.v;
-        const AWType& W  = A.w;
-        XUType& da       = x.u;
-        XVType& db       = x.v;
-        const XUType& ea = b.u;
-        const XVType& eb = b.v;
+        const AUType& U = A.u;
+        const AVType& V = A.v;
+        const AWType& W = A.w;
 
 
         if (!patternAnalyzed) analyzePattern(A, solverOptions);
@@ -357,23 +379,35 @@ class MixedSymmetricRecursiveSolver<
             Sdiag.diagonal() = U.diagonal() - Sdiag.diagonal();
         }
 
-        // r = a - W * V^-1 * b
-        ej = ea + -(Y * eb);
-
-
         if (solverOptions.solverType == LinearSolverOptions::SolverType::Direct)
         {
-            // Direct recusive ldlt solver
-            if (!ldlt)
+            if (solverOptions.supernodal && !ldlt)
             {
-                ldlt = std::make_unique<LDLT>();
-                ldlt->compute(S1);
+                // Direct recursive supernodal llt solver
+                if (!llt)
+                {
+                    llt = std::make_unique<LLT>();
+                    llt->compute(S1);
+                }
+                else
+                {
+                    llt->factorize(S1);
+                }
             }
-            else
+
+            if (!llt || llt->info() != Eigen::Success)
             {
-                ldlt->factorize(S1);
+                // Direct recusive ldlt solver
+                if (!ldlt)
+                {
+                    ldlt = std::make_unique<LDLT>();
+                    ldlt->compute(S1);
+                }
+                else
+                {
+                    ldlt->factorize(S1);
+                }
             }
-            da = ldlt->solve(ej);
         }
         else
         {
@@ -385,6 +419,39 @@ class MixedSymmetricRecursiveSolver<
             {
                 P.compute(Sdiag);
             }
+        }
+
+        solveFactorized(A, x, b, solverOptions);
+    }
+
+    // Solves A * x = b with the Schur complement (and its factorization) of the last solve() call. A must not have
+    // changed since then. Only the right hand side is reduced and the factorization is reused, which makes repeated
+    // solves with the same matrix (for example iterative refinement) much cheaper than solve().
+    void solveFactorized(AType& A, XType& x, XType& b, const LinearSolverOptions& solverOptions = LinearSolverOptions())
+    {
+        const AUType& U  = A.u;
+        const AWType& W  = A.w;
+        XUType& da       = x.u;
+        XVType& db       = x.v;
+        const XUType& ea = b.u;
+        const XVType& eb = b.v;
+
+        // r = a - W * V^-1 * b
+        ej = ea + -(Y * eb);
+
+        if (solverOptions.solverType == LinearSolverOptions::SolverType::Direct)
+        {
+            if (llt && llt->info() == Eigen::Success)
+            {
+                da = llt->solve(ej);
+            }
+            else
+            {
+                da = ldlt->solve(ej);
+            }
+        }
+        else
+        {
             da.setZero();
 
             // Iterative CG solver
@@ -469,13 +536,9 @@ class MixedSymmetricRecursiveSolver<
     void solve_omp(AType& A, XType& x, XType& b, const LinearSolverOptions& solverOptions = LinearSolverOptions())
     {
         // Some references for easier access
-        const AUType& U  = A.u;
-        const AVType& V  = A.v;
-        const AWType& W  = A.w;
-        XUType& da       = x.u;
-        XVType& db       = x.v;
-        const XUType& ea = b.u;
-        const XVType& eb = b.v;
+        const AUType& U = A.u;
+        const AVType& V = A.v;
+        const AWType& W = A.w;
 
 
 
@@ -494,6 +557,21 @@ class MixedSymmetricRecursiveSolver<
 #pragma omp for
         for (int i = 0; i < n; ++i) Sdiag.diagonal()(i).get() = U.diagonal()(i).get() - Sdiag.diagonal()(i).get();
 
+        P.compute(Sdiag);
+
+        solveFactorized_omp(A, x, b, solverOptions);
+    }
+
+    // solveFactorized() for the iterative solver inside an OpenMP parallel region. Reuses the data of the last
+    // solve_omp() call.
+    void solveFactorized_omp(AType& A, XType& x, XType& b,
+                             const LinearSolverOptions& solverOptions = LinearSolverOptions())
+    {
+        const AUType& U  = A.u;
+        XUType& da       = x.u;
+        XVType& db       = x.v;
+        const XUType& ea = b.u;
+        const XVType& eb = b.v;
 
         sparse_mv_omp(Y, eb, ej);
 
@@ -504,19 +582,8 @@ class MixedSymmetricRecursiveSolver<
             da(i).get().setZero();
         }
 
-
-        {
-            // A special implicit schur solver.
-            // We cannot use the recursive inner solver here.
-            // (Maybe a todo for the future)
-            //            da.setZero();
-        }
-
         Eigen::Index iters = solverOptions.maxIterativeIterations;
         double tol         = solverOptions.iterativeTolerance;
-        P.compute(Sdiag);
-
-
 
         recursive_conjugate_gradient_OMP(
             [&](const XUType& v, XUType& result) {
@@ -563,6 +630,7 @@ class MixedSymmetricRecursiveSolver<
     //    InnerSolver1 solver1;
 
     std::unique_ptr<LDLT> ldlt;
+    std::unique_ptr<LLT> llt;
 
     bool patternAnalyzed = false;
     bool hasWT           = true;
@@ -29,6 +29,7 @@ class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::Matrix
    public:
     using AType = typename Eigen::SparseMatrix<Eigen::Recursive::MatrixScalar<T>, _Options>;
     using LDLT  = Eigen::RecursiveSimplicialLDLT<AType, Eigen::Upper>;
+    using LLT   = RecursiveSupernodalLLT<AType>;
 
     using ExpandedType = Eigen::SparseMatrix<typename T::Scalar, Eigen::RowMajor>;
 #ifdef SOLVER_USE_CHOLMOD
@@ -41,6 +42,7 @@ class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::Matrix
     void Init()
     {
         ldlt = nullptr;
+        llt  = nullptr;
 #ifdef SOLVER_USE_CHOLMOD
         cholmodldlt = nullptr;
 #endif
@@ -48,7 +50,6 @@ class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::Matrix
 
     void solve(AType& A, XType& x, XType& b, const LinearSolverOptions& solverOptions = LinearSolverOptions())
     {
-        int n = A.rows();
         if (solverOptions.solverType == LinearSolverOptions::SolverType::Direct)
         {
 #ifdef SOLVER_USE_CHOLMOD
@@ -71,16 +72,31 @@ class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::Matrix
                     // This line computes the factorization without analyzing the structure again
                     cholmodldlt->factorize(*expandS);
                 }
-                Eigen::Matrix<double, -1, 1> ex = cholmodldlt->solve(eb);
-                // convert back to block x
-                for (int i = 0; i < x.rows(); ++i)
-                {
-                    x(i).get() = ex.segment(i * T::RowsAtCompileTime, T::RowsAtCompileTime);
-                }
+                solveCholmod(x, eb);
             }
             else
 #endif
             {
+                if (solverOptions.supernodal && !ldlt)
+                {
+                    if (!llt)
+                    {
+                        llt = std::make_unique<LLT>();
+                        llt->compute(A);
+                    }
+                    else
+                    {
+                        llt->factorize(A);
+                    }
+
+                    if (llt->info() == Eigen::Success)
+                    {
+                        x = llt->solve(b);
+                        return;
+                    }
+                    // Not positive definite -> fall back to the simplicial ldlt for this and all following solves
+                }
+
                 if (!ldlt)
                 {
 #if 0
@@ -138,22 +154,69 @@ class MixedSymmetricRecursiveSolver<Eigen::SparseMatrix<Eigen::Recursive::Matrix
         }
         else
         {
-            x.setZero();
-            RecursiveDiagonalPreconditioner<MatrixScalar<T>> P;
-            Eigen::Index iters = solverOptions.maxIterativeIterations;
-            double tol         = solverOptions.iterativeTolerance;
-
-            P.compute(A);
+            solveIterative(A, x, b, solverOptions);
+        }
+    }
 
-            XType tmp(n);
-            recursive_conjugate_gradient(
-                [&](const XType& v, XType& result) { result = A.template selfadjointView<Eigen::Upper>() * v; }, b, x,
-                P, iters, tol);
+    // Solves A * x = b with the factorization of the last solve() call. A must not have changed since then. This is
+    // much cheaper than solve() for repeated solves with the same matrix (for example iterative refinement). The
+    // iterative solver has no factorization and just runs again.
+    void solveFactorized(AType& A, XType& x, XType& b, const LinearSolverOptions& solverOptions = LinearSolverOptions())
+    {
+        if (solverOptions.solverType != LinearSolverOptions::SolverType::Direct)
+        {
+            solveIterative(A, x, b, solverOptions);
+            return;
+        }
+#ifdef SOLVER_USE_CHOLMOD
+        if (solverOptions.cholmod)
+        {
+            auto eb = expand(b);
+            solveCholmod(x, eb);
+            return;
+        }
+#endif
+        // Same selection as in solve()
+        if (!ldlt && llt && llt->info() == Eigen::Success)
+        {
+            x = llt->solve(b);
+        }
+        else
+        {
+            x = ldlt->solve(b);
         }
     }
 
    private:
+    void solveIterative(AType& A, XType& x, XType& b, const LinearSolverOptions& solverOptions)
+    {
+        x.setZero();
+        RecursiveDiagonalPreconditioner<MatrixScalar<T>> P;
+        Eigen::Index iters = solverOptions.maxIterativeIterations;
+        double tol         = solverOptions.iterativeTolerance;
+
+        P.compute(A);
+
+        recursive_conjugate_gradient(
+            [&](const XType& v, XType& result) { result = A.template selfadjointView<Eigen::Upper>() * v; }, b, x, P,
+            iters, tol);
+    }
+
+#ifdef SOLVER_USE_CHOLMOD
+    template <typename EB>
+    void solveCholmod(XType& x, const EB& eb)
+    {
+        Eigen::Matrix<double, -1, 1> ex = cholmodldlt->solve(eb);
+        // convert back to block x
+        for (int i = 0; i < x.rows(); ++i)
+        {
+            x(i).get() = ex.segment(i * T::RowsAtCompileTime, T::RowsAtCompileTime);
+        }
+    }
+#endif
+
     std::unique_ptr<LDLT> ldlt;
+    std::unique_ptr<LLT> llt;
     Eigen::PermutationMatrix<-1> permFull;
     std::vector<int> orderingFull;
 #ifdef SOLVER_USE_CHOLMOD
@@ -15,13 +15,21 @@
 
 namespace Saiga
 {
-void PGORec::init()
+template <typename T>
+void PGORecBase<T>::init()
 {
     auto& scene = *_scene;
 
     n = scene.vertices.size();
     b.resize(n);
     delta_x.resize(n);
+    if constexpr (!std::is_same_v<T, double>)
+    {
+        delta_u.resize(n);
+        refine_r.resize(n);
+        refine_x.resize(n);
+        refine_b.resize(n);
+    }
 
     x_u.resize(n);
     oldx_u.resize(n);
@@ -105,7 +113,8 @@ void PGORec::init()
     }
 }
 
-double PGORec::computeQuadraticForm()
+template <typename T>
+double PGORecBase<T>::computeQuadraticForm()
 {
     auto& scene = *_scene;
 
@@ -154,14 +163,14 @@ double PGORec::computeQuadraticForm()
             auto c = res.squaredNorm();
 
             // JtJ
-            target_ij = Jrowi.transpose() * Jrowj;
+            target_ij = (Jrowi.transpose() * Jrowj).template cast<T>();
 
-            target_ii += Jrowi.transpose() * Jrowi;
-            target_jj += Jrowj.transpose() * Jrowj;
+            target_ii += (Jrowi.transpose() * Jrowi).template cast<T>();
+            target_jj += (Jrowj.transpose() * Jrowj).template cast<T>();
 
             // Jtb
-            target_ir -= Jrowi.transpose() * res;
-            target_jr -= Jrowj.transpose() * res;
+            target_ir -= (Jrowi.transpose() * res).template cast<T>();
+            target_jr -= (Jrowj.transpose() * res).template cast<T>();
 
 
             chi2local += c;
@@ -188,7 +197,8 @@ double PGORec::computeQuadraticForm()
 }
 
 
-double PGORec::computeCost()
+template <typename T>
+double PGORecBase<T>::computeCost()
 {
     auto& scene = *_scene;
 
@@ -222,7 +232,8 @@ double PGORec::computeCost()
     return chi2;
 }
 
-void PGORec::addLambda(double lambda)
+template <typename T>
+void PGORecBase<T>::addLambda(double lambda)
 {
     // apply lm
     for (int i = 0; i < n; ++i)
@@ -232,7 +243,8 @@ void PGORec::addLambda(double lambda)
     }
 }
 
-bool PGORec::addDelta()
+template <typename T>
+bool PGORecBase<T>::addDelta()
 {
     auto& scene = *_scene;
     oldx_u      = x_u;
@@ -240,7 +252,7 @@ bool PGORec::addDelta()
     for (int i = 0; i < n; ++i)
     {
         if (scene.vertices[i].constant) continue;
-        auto t = delta_x(i).get();
+        Vec6 t = deltaU(i);
         //#ifdef PGO_SIM3
         //        if (scene.fixScale) t[6] = 0;
         //#endif
@@ -254,7 +266,8 @@ bool PGORec::addDelta()
     return true;
 }
 
-void PGORec::solveLinearSystem()
+template <typename T>
+void PGORecBase<T>::solveLinearSystem()
 {
     using namespace Eigen::Recursive;
 
@@ -269,13 +282,95 @@ void PGORec::solveLinearSystem()
 
 
     solver.solve(S, delta_x, b, loptions);
+    if constexpr (!std::is_same_v<T, double>)
+    {
+        refineSolution(loptions);
+    }
+}
+
+template <typename T>
+double PGORecBase<T>::refinementResidual(bool with_correction)
+{
+    // refine_b = b - S * delta in double precision. Only the upper triangle of S is stored.
+    // If with_correction is set, delta + refine_x is used instead of delta.
+    auto du = [&](int i) -> Vec6 {
+        return with_correction ? Vec6(delta_u[i] + refine_x(i).get().template cast<double>()) : delta_u[i];
+    };
+
+    for (int i = 0; i < n; ++i)
+    {
+        refine_r[i] = b(i).get().template cast<double>();
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        Vec6 dui = du(i);
+        for (int k = S.outerIndexPtr()[i]; k < S.outerIndexPtr()[i + 1]; ++k)
+        {
+            int j                         = S.innerIndexPtr()[k];
+            Eigen::Matrix<double, 6, 6> B = S.valuePtr()[k].get().template cast<double>();
+            refine_r[i] -= B * du(j);
+            if (i != j) refine_r[j] -= B.transpose() * dui;
+        }
+    }
+
+    double norm2 = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        refine_b(i).get() = refine_r[i].template cast<T>();
+        norm2 += refine_r[i].squaredNorm();
+    }
+    return norm2;
+}
+
+template <typename T>
+void PGORecBase<T>::refineSolution(const Eigen::Recursive::LinearSolverOptions& loptions)
+{
+    // Start with the single precision solution
+    for (int i = 0; i < n; ++i)
+    {
+        delta_u[i] = delta_x(i).get().template cast<double>();
+    }
+
+    if (optimizationOptions.refinementSteps <= 0) return;
+
+    double residual_norm2 = refinementResidual(false);
+    for (int step = 0; step < optimizationOptions.refinementSteps; ++step)
+    {
+        // Only back substitution with the single precision factorization of solveLinearSystem()
+        solver.solveFactorized(S, refine_x, refine_b, loptions);
+
+        // Same as in BARecBase: the correction is only applied if it reduces the residual.
+        double new_residual_norm2 = refinementResidual(true);
+        if (!(new_residual_norm2 < residual_norm2)) break;
+        residual_norm2 = new_residual_norm2;
+
+        for (int i = 0; i < n; ++i)
+        {
+            delta_u[i] += refine_x(i).get().template cast<double>();
+        }
+    }
+}
+
+template <typename T>
+Vec6 PGORecBase<T>::deltaU(int i) const
+{
+    if constexpr (std::is_same_v<T, double>)
+    {
+        return delta_x(i).get();
+    }
+    else
+    {
+        return delta_u[i];
+    }
 }
 
-void PGORec::revertDelta()
+template <typename T>
+void PGORecBase<T>::revertDelta()
 {
     x_u = oldx_u;
 }
-void PGORec::finalize()
+template <typename T>
+void PGORecBase<T>::finalize()
 {
     auto& scene = *_scene;
 
@@ -289,4 +384,7 @@ void PGORec::finalize()
     }
 }
 
+template class PGORecBase<double>;
+template class PGORecBase<float>;
+
 }  // namespace Saiga
@@ -13,14 +13,21 @@
 
 namespace Saiga
 {
-class SAIGA_VISION_API PGORec : public PGOBase, public LMOptimizer
+/**
+ * Recursive PGO with a sparse block solver.
+ *
+ * The linear system uses the scalar type T. The residuals, the chi2 and the poses are always double. See BARecBase
+ * for the single precision mode (PGORecFloat) and the iterative refinement.
+ */
+template <typename T>
+class SAIGA_VISION_API PGORecBase : public PGOBase, public LMOptimizer
 {
    public:
     using PGOTransformation = SE3;
     // ============== Recusrive Matrix Types ==============
 
     static constexpr int pgoBlockSizeCamera = PGOTransformation::DoF;
-    using BlockPGOScalar                    = double;
+    using BlockPGOScalar                    = T;
 
     using PGOBlock   = Eigen::Matrix<BlockPGOScalar, pgoBlockSizeCamera, pgoBlockSizeCamera>;
     using PGOVector  = Eigen::Matrix<BlockPGOScalar, pgoBlockSizeCamera, 1>;
@@ -32,8 +39,8 @@ class SAIGA_VISION_API PGORec : public PGOBase, public LMOptimizer
 
    public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-    PGORec() : PGOBase("recursive PGO") {}
-    virtual ~PGORec() {}
+    PGORecBase() : PGOBase(std::is_same_v<T, double> ? "recursive PGO" : "recursive PGO (float)") {}
+    virtual ~PGORecBase() {}
     virtual void create(PoseGraph& scene) override { _scene = &scene; }
 
 
@@ -48,6 +55,10 @@ class SAIGA_VISION_API PGORec : public PGOBase, public LMOptimizer
 
     AlignedVector<PGOTransformation> x_u, oldx_u;
 
+    // The delta and the residual of the refinement in double precision. Only used if T != double.
+    AlignedVector<Vec6> delta_u, refine_r;
+    PBType refine_x, refine_b;
+
 
     std::vector<int> edgeOffsets;
     PoseGraph* _scene;
@@ -62,6 +73,15 @@ class SAIGA_VISION_API PGORec : public PGOBase, public LMOptimizer
     virtual void solveLinearSystem() override;
     virtual double computeCost() override;
     virtual void finalize() override;
+
+    // Iterative refinement of delta_x
+    void refineSolution(const Eigen::Recursive::LinearSolverOptions& loptions);
+    // Computes refine_b = b - S * delta and returns its squared norm.
+    double refinementResidual(bool with_correction);
+    Vec6 deltaU(int i) const;
 };
 
+using PGORec      = PGORecBase<double>;
+using PGORecFloat = PGORecBase<float>;
+
 }  // namespace Saiga
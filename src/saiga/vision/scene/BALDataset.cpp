@@ -10,7 +10,9 @@
 #include "saiga/core/util/file.h"
 #include "saiga/core/util/tostring.h"
 
+#include <cmath>
 #include <fstream>
+#include <limits>
 
 #ifdef SAIGA_USE_CERES
 #    include "saiga/vision/ceres/CeresBAL.h"
@@ -20,53 +22,79 @@
 
 namespace Saiga
 {
+// The parser returns all numbers as double. Counts and indices must be exact non-negative integers that fit into an
+// int, otherwise the file is rejected instead of silently truncating the value.
+static bool toIndex(double d, int& result)
+{
+    if (!(d >= 0 && d <= double(std::numeric_limits<int>::max())) || std::floor(d) != d)
+    {
+        return false;
+    }
+    result = int(d);
+    return true;
+}
+
 BALDataset::BALDataset(const std::string& file)
 {
     std::cout << "> Loading BALDataset " << file << std::endl;
 
-    auto data = File::loadFileStringArray(file);
+    // The complete file is parsed in parallel into one array of numbers.
+    // Layout: <header> <observations> <cameras> <points>
+    std::vector<double> data;
+    if (!File::loadFileNumbers(file, data) || data.size() < 3)
+    {
+        SAIGA_EXIT_ERROR("Invalid BAL file " + file);
+    }
 
     int num_cameras, num_points, num_observations;
+    if (!toIndex(data[0], num_cameras) || !toIndex(data[1], num_points) || !toIndex(data[2], num_observations))
+    {
+        SAIGA_EXIT_ERROR("Invalid BAL file " + file + ". The header must contain three non-negative integers.");
+    }
 
-    std::stringstream in(data.front());
-    in >> num_cameras >> num_points >> num_observations;
+    size_t expected_size = 3 + size_t(num_observations) * 4 + size_t(num_cameras) * 9 + size_t(num_points) * 3;
+    if (data.size() != expected_size)
+    {
+        SAIGA_EXIT_ERROR("Invalid BAL file " + file + ". Expected " + std::to_string(expected_size) +
+                         " numbers, but got " + std::to_string(data.size()));
+    }
 
     cameras.resize(num_cameras);
     observations.resize(num_observations);
     points.resize(num_points);
 
-
-
-    int start = 1;
+    const double* obs_data = data.data() + 3;
+    bool valid_indices     = true;
 #pragma omp parallel for
     for (int i = 0; i < num_observations; ++i)
     {
-        std::stringstream in(data[start + i]);
+        const double* d = obs_data + size_t(i) * 4;
         BALObservation o;
-        in >> o.camera_index >> o.point_index >> o.point[0] >> o.point[1];
+        if (!toIndex(d[0], o.camera_index) || !toIndex(d[1], o.point_index) || o.camera_index >= num_cameras ||
+            o.point_index >= num_points)
+        {
+#pragma omp atomic write
+            valid_indices = false;
+        }
+        o.point         = Vec2(d[2], d[3]);
         observations[i] = (o);
     }
+    if (!valid_indices)
+    {
+        SAIGA_EXIT_ERROR("Invalid BAL file " + file + ". Observation index is not an integer or out of range.");
+    }
 
-    start += num_observations;
+    const double* camera_data = obs_data + size_t(num_observations) * 4;
 #pragma omp parallel for
     for (int i = 0; i < num_cameras; ++i)
     {
+        const double* d = camera_data + size_t(i) * 9;
         BALCamera c;
-        Vec3 r;
-        Vec3 t;
-
-
-        r(0) = Saiga::to_double(data[start + i * 9 + 0]);
-        r(1) = Saiga::to_double(data[start + i * 9 + 1]);
-        r(2) = Saiga::to_double(data[start + i * 9 + 2]);
-
-        t(0) = Saiga::to_double(data[start + i * 9 + 3]);
-        t(1) = Saiga::to_double(data[start + i * 9 + 4]);
-        t(2) = Saiga::to_double(data[start + i * 9 + 5]);
-
-        c.f  = Saiga::to_double(data[start + i * 9 + 6]);
-        c.k1 = Saiga::to_double(data[start + i * 9 + 7]);
-        c.k2 = Saiga::to_double(data[start + i * 9 + 8]);
+        Vec3 r(d[0], d[1], d[2]);
+        Vec3 t(d[3], d[4], d[5]);
+        c.f  = d[6];
+        c.k1 = d[7];
+        c.k2 = d[8];
 
         auto angle           = r.norm();
         Eigen::Vector3d axis = angle > 0.00001 ? r / angle : Eigen::Vector3d(0, 1, 0);
@@ -74,18 +102,14 @@ BALDataset::BALDataset(const std::string& file)
         c.se3      = SE3((Quat)a, t);
         cameras[i] = (c);
     }
-    start += num_cameras * 9;
 
+    const double* point_data = camera_data + size_t(num_cameras) * 9;
 #pragma omp parallel for
     for (int i = 0; i < num_points; ++i)
     {
+        const double* d = point_data + size_t(i) * 3;
         BALPoint p;
-
-        p.point(0) = Saiga::to_double(data[start + i * 3 + 0]);
-        p.point(1) = Saiga::to_double(data[start + i * 3 + 1]);
-        p.point(2) = Saiga::to_double(data[start + i * 3 + 2]);
-
-
+        p.point   = Vec3(d[0], d[1], d[2]);
         points[i] = (p);
     }
 
@@ -167,7 +191,6 @@ double BALDataset::rms()
 
 Scene BALDataset::makeScene()
 {
-    SAIGA_EXIT_ERROR("not implemented after extrinsic change");
     Scene scene;
     std::vector<double> fs;
     for (BALCamera& c : cameras)
@@ -176,6 +199,7 @@ Scene BALDataset::makeScene()
 
         SceneImage si;
         si.intr = id;
+        si.se3  = c.extr().first;
         scene.images.push_back(si);
         scene.intrinsics.push_back(c.intr());
         fs.push_back(c.f);
@@ -0,0 +1,183 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "BinarySceneFile.h"
+
+#include "saiga/core/util/assert.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace Saiga
+{
+bool BinarySceneFileView::isBinarySceneFile(const std::string& file)
+{
+    std::ifstream strm(file, std::ios::binary);
+    char data[8];
+    if (!strm.read(data, 8)) return false;
+    return std::memcmp(data, magic, 8) == 0;
+}
+
+bool BinarySceneFileView::open(const std::string& file)
+{
+    close();
+    if (!this->file.open(file)) return false;
+
+    auto size = this->file.size();
+    if (size < sizeof(BinarySceneHeader))
+    {
+        close();
+        return false;
+    }
+
+    header_ = reinterpret_cast<const BinarySceneHeader*>(this->file.data());
+    auto& h = *header_;
+
+    if (std::memcmp(h.magic, magic, 8) != 0 || h.version != current_version ||
+        h.header_size != sizeof(BinarySceneHeader))
+    {
+        close();
+        return false;
+    }
+
+    auto section_valid = [size](uint64_t offset, uint64_t count, uint64_t element_size) {
+        return offset % 8 == 0 && offset <= size && count <= (size - offset) / element_size;
+    };
+
+    if (!section_valid(h.intrinsics_offset, h.num_intrinsics, sizeof(BinarySceneIntrinsics)) ||
+        !section_valid(h.images_offset, h.num_images, sizeof(BinarySceneImage)) ||
+        !section_valid(h.observations_offset, h.num_observations, sizeof(BinarySceneObservation)) ||
+        !section_valid(h.world_points_offset, h.num_world_points, sizeof(BinarySceneWorldPoint)))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void BinarySceneFileView::close()
+{
+    file.close();
+    header_       = nullptr;
+    validated     = false;
+    valid_content = false;
+}
+
+ArrayView<const BinarySceneIntrinsics> BinarySceneFileView::intrinsics() const
+{
+    return section<BinarySceneIntrinsics>(header_->intrinsics_offset, header_->num_intrinsics);
+}
+
+ArrayView<const BinarySceneImage> BinarySceneFileView::images() const
+{
+    return section<BinarySceneImage>(header_->images_offset, header_->num_images);
+}
+
+ArrayView<const BinarySceneObservation> BinarySceneFileView::observations() const
+{
+    return section<BinarySceneObservation>(header_->observations_offset, header_->num_observations);
+}
+
+ArrayView<const BinarySceneWorldPoint> BinarySceneFileView::worldPoints() const
+{
+    return section<BinarySceneWorldPoint>(header_->world_points_offset, header_->num_world_points);
+}
+
+bool BinarySceneFileView::validate()
+{
+    SAIGA_ASSERT(header_);
+    if (validated) return valid_content;
+
+    auto imgs = images();
+    auto obs  = observations();
+
+    // The observations of the images must be consecutive. The count is checked against the remaining
+    // observations before adding it, so a crafted count cannot wrap first_obs around.
+    bool valid         = true;
+    uint64_t first_obs = 0;
+    for (auto& img : imgs)
+    {
+        if (img.first_observation != first_obs || img.intr < 0 || img.intr >= (int64_t)header_->num_intrinsics ||
+            img.num_observations > obs.size() - first_obs)
+        {
+            valid = false;
+            break;
+        }
+        first_obs += img.num_observations;
+    }
+    valid = valid && first_obs == obs.size();
+
+    int64_t num_world_points = header_->num_world_points;
+    int64_t num_obs          = obs.size();
+#pragma omp parallel for reduction(&& : valid)
+    for (int64_t i = 0; i < num_obs; ++i)
+    {
+        valid = valid && obs[i].wp >= -1 && obs[i].wp < num_world_points;
+    }
+
+    validated     = true;
+    valid_content = valid;
+    return valid_content;
+}
+
+bool BinarySceneFileView::toScene(Scene& scene)
+{
+    if (!validate()) return false;
+
+    scene             = Scene();
+    scene.bf          = header_->bf;
+    scene.globalScale = header_->global_scale;
+
+    auto intr = intrinsics();
+    auto imgs = images();
+    auto obs  = observations();
+    auto wps  = worldPoints();
+
+    scene.intrinsics.resize(intr.size());
+    scene.images.resize(imgs.size());
+    scene.worldPoints.resize(wps.size());
+
+    for (size_t i = 0; i < intr.size(); ++i)
+    {
+        scene.intrinsics[i] = Vec5(Eigen::Map<const Vec5>(intr[i].coeffs));
+    }
+
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int64_t i = 0; i < (int64_t)imgs.size(); ++i)
+    {
+        auto& src = imgs[i];
+        auto& img = scene.images[i];
+
+        Eigen::Map<Sophus::Vector<double, SE3::num_parameters>>(img.se3.data()) =
+            Eigen::Map<const Sophus::Vector<double, SE3::num_parameters>>(src.se3);
+        Eigen::Map<Sophus::Vector<double, SE3::num_parameters>>(img.velocity.data()) =
+            Eigen::Map<const Sophus::Vector<double, SE3::num_parameters>>(src.velocity);
+        img.intr     = src.intr;
+        img.constant = src.constant != 0;
+
+        img.stereoPoints.resize(src.num_observations);
+        for (uint64_t j = 0; j < src.num_observations; ++j)
+        {
+            auto& o   = obs[src.first_observation + j];
+            auto& ip  = img.stereoPoints[j];
+            ip.wp     = o.wp;
+            ip.depth  = o.depth;
+            ip.point  = Vec2(o.point[0], o.point[1]);
+            ip.weight = o.weight;
+        }
+    }
+
+#pragma omp parallel for
+    for (int64_t i = 0; i < (int64_t)wps.size(); ++i)
+    {
+        scene.worldPoints[i].p = Vec3(wps[i].p[0], wps[i].p[1], wps[i].p[2]);
+    }
+
+    scene.fixWorldPointReferences();
+    return true;
+}
+
+}  // namespace Saiga
@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+#include "saiga/core/util/DataStructures/ArrayView.h"
+#include "saiga/core/util/MemoryMappedFile.h"
+#include "saiga/vision/scene/Scene.h"
+
+#include <cstdint>
+
+namespace Saiga
+{
+/**
+ * Versioned binary scene format (.sceneb).
+ *
+ * All sections are flat arrays of fixed size records, so the file can be memory mapped and used without parsing. The
+ * byte order is the one of the writing machine (little endian on all supported platforms).
+ *
+ * Layout:
+ *   BinarySceneHeader
+ *   BinarySceneIntrinsics   [num_intrinsics]
+ *   BinarySceneImage        [num_images]
+ *   BinarySceneObservation  [num_observations]   (grouped by image)
+ *   BinarySceneWorldPoint   [num_world_points]
+ *
+ * The same data as in the text format (Scene::save) is stored.
+ */
+struct BinarySceneHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+
+    uint64_t num_intrinsics;
+    uint64_t num_images;
+    uint64_t num_observations;
+    uint64_t num_world_points;
+
+    double bf;
+    double global_scale;
+
+    // Offsets in bytes from the beginning of the file
+    uint64_t intrinsics_offset;
+    uint64_t images_offset;
+    uint64_t observations_offset;
+    uint64_t world_points_offset;
+};
+
+struct BinarySceneIntrinsics
+{
+    // fx fy cx cy s
+    double coeffs[5];
+};
+
+struct BinarySceneImage
+{
+    double se3[7];
+    double velocity[7];
+    int32_t intr;
+    int32_t constant;
+    uint64_t first_observation;
+    uint64_t num_observations;
+};
+
+struct BinarySceneObservation
+{
+    int32_t wp;
+    float weight;
+    double depth;
+    double point[2];
+};
+
+struct BinarySceneWorldPoint
+{
+    double p[3];
+};
+
+static_assert(sizeof(BinarySceneHeader) == 96, "Invalid header size");
+static_assert(sizeof(BinarySceneImage) == 136, "Invalid record size");
+static_assert(sizeof(BinarySceneObservation) == 32, "Invalid record size");
+
+/**
+ * Read-only view of a memory mapped binary scene file.
+ *
+ * open() only checks the header and that all sections are inside the file, which is independent of the file size.
+ * The content (index ranges of the images and observations) is checked by validate() when it is needed for the first
+ * time, so inspecting a large file is cheap.
+ *
+ * Usage:
+ *
+ * BinarySceneFileView view;
+ * if (view.open(file))
+ * {
+ *     std::cout << view.images().size() << " images" << std::endl;
+ *     view.toScene(scene);
+ * }
+ */
+class SAIGA_VISION_API BinarySceneFileView
+{
+   public:
+    static constexpr const char* magic        = "SAIGASCN";
+    static constexpr uint32_t current_version = 1;
+
+    // Only checks the magic number in the first bytes of the file.
+    static bool isBinarySceneFile(const std::string& file);
+
+    bool open(const std::string& file);
+    void close();
+
+    const BinarySceneHeader& header() const { return *header_; }
+    ArrayView<const BinarySceneIntrinsics> intrinsics() const;
+    ArrayView<const BinarySceneImage> images() const;
+    ArrayView<const BinarySceneObservation> observations() const;
+    ArrayView<const BinarySceneWorldPoint> worldPoints() const;
+
+    // Checks all indices. The result is cached.
+    bool validate();
+
+    // Validates the file and copies it into the scene.
+    bool toScene(Scene& scene);
+
+   private:
+    MemoryMappedFile file;
+    const BinarySceneHeader* header_ = nullptr;
+    bool validated                   = false;
+    bool valid_content               = false;
+
+    template <typename T>
+    ArrayView<const T> section(uint64_t offset, uint64_t count) const
+    {
+        return ArrayView<const T>(reinterpret_cast<const T*>(file.data() + offset), count);
+    }
+};
+
+}  // namespace Saiga
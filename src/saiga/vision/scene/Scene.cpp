@@ -15,35 +15,31 @@
 #include <fstream>
 namespace Saiga
 {
-Eigen::Vector3d Scene::residual3(const SceneImage& img, const StereoImagePoint& ip)
+// Residuals of a single observation. Shared by the StereoImagePoint and the SceneObservations interface.
+static Vec3 observationResidual3(const Scene& scene, const SceneImage& img, const Vec3& wp, const Vec2& point,
+                                 double depth, float weight)
 {
-    WorldPoint& wp = worldPoints[ip.wp];
-
-    SAIGA_ASSERT(ip);
-    SAIGA_ASSERT(wp);
-    SAIGA_ASSERT(ip.depth > 0);
-
     // project to screen
-    Vec3 p = img.se3 * wp.p;
+    Vec3 p = img.se3 * wp;
     auto z = p(2);
 
     Vec2 p_norm = p.head<2>() / z;
 
-    if (!distortion.empty())
+    if (!scene.distortion.empty())
     {
-        p_norm = distortNormalizedPoint(p_norm, distortion[img.intr]);
+        p_norm = distortNormalizedPoint(p_norm, scene.distortion[img.intr]);
     }
 
-    auto p_img = intrinsics[img.intr].normalizedToImage(p_norm);
+    auto p_img = scene.intrinsics[img.intr].normalizedToImage(p_norm);
 
-    auto w = ip.weight * scale();
+    auto w = weight * scene.globalScale;
 
     Eigen::Vector3d res;
-    res.head<2>() = (ip.point - p_img);
+    res.head<2>() = (point - p_img);
     //    res(2)        = (1.0 / ip.depth - 1.0 / z) * bf;
 
-    auto disparity      = p_img(0) - bf / z;
-    auto stereoPointObs = ip.point(0) - bf / ip.depth;
+    auto disparity      = p_img(0) - scene.bf / z;
+    auto stereoPointObs = point(0) - scene.bf / depth;
     res(2)              = stereoPointObs - disparity;
 
     res *= w;
@@ -53,32 +49,57 @@ Eigen::Vector3d Scene::residual3(const SceneImage& img, const StereoImagePoint&
     return res;
 }
 
-Eigen::Vector2d Scene::residual2(const SceneImage& img, const StereoImagePoint& ip)
+static Vec2 observationResidual2(const Scene& scene, const SceneImage& img, const Vec3& wp, const Vec2& point,
+                                 float weight)
 {
-    WorldPoint& wp = worldPoints[ip.wp];
-
-
-    auto p = img.se3 * wp.p;
+    auto p = img.se3 * wp;
     auto z = p(2);
 
     Vec2 p_norm = p.head<2>() / z;
 
-    if (!distortion.empty())
+    if (!scene.distortion.empty())
     {
-        p_norm = distortNormalizedPoint(p_norm, distortion[img.intr]);
+        p_norm = distortNormalizedPoint(p_norm, scene.distortion[img.intr]);
     }
 
-    auto p_img = intrinsics[img.intr].normalizedToImage(p_norm);
+    auto p_img = scene.intrinsics[img.intr].normalizedToImage(p_norm);
 
-    auto w = ip.weight * scale();
+    auto w = weight * scene.globalScale;
     Eigen::Vector2d res;
-    res.head<2>() = (ip.point - p_img);
+    res.head<2>() = (point - p_img);
     res *= w;
 
     // if (z <= 0) res *= 10000000;
     return res;
 }
 
+static double observationResidualNorm2(const Scene& scene, const SceneObservations& obs, int o)
+{
+    auto& img = scene.images[obs.image[o]];
+    auto& wp  = scene.worldPoints[obs.wp[o]].p;
+    if (obs.IsStereoOrDepth(o))
+        return observationResidual3(scene, img, wp, obs.point[o], obs.depth[o], obs.weight[o]).squaredNorm();
+    else
+        return observationResidual2(scene, img, wp, obs.point[o], obs.weight[o]).squaredNorm();
+}
+
+Eigen::Vector3d Scene::residual3(const SceneImage& img, const StereoImagePoint& ip)
+{
+    WorldPoint& wp = worldPoints[ip.wp];
+
+    SAIGA_ASSERT(ip);
+    SAIGA_ASSERT(wp);
+    SAIGA_ASSERT(ip.depth > 0);
+
+    return observationResidual3(*this, img, wp.p, ip.point, ip.depth, ip.weight);
+}
+
+Eigen::Vector2d Scene::residual2(const SceneImage& img, const StereoImagePoint& ip)
+{
+    WorldPoint& wp = worldPoints[ip.wp];
+    return observationResidual2(*this, img, wp.p, ip.point, ip.weight);
+}
+
 void Scene::clear()
 {
     intrinsics.clear();
@@ -89,6 +110,8 @@ void Scene::clear()
 
 void Scene::reserve(int _images, int points, int observations)
 {
+    // The image points are stored per image
+    (void)observations;
     intrinsics.reserve(1);
     worldPoints.reserve(points);
     images.reserve(_images);
@@ -375,13 +398,35 @@ std::vector<int> Scene::validPoints()
     return res;
 }
 
-double Scene::chi2(double huber)
+// Adds the rel pose constraints to the image errors. The images are summed up in a fixed order, therefore the result
+// does not depend on the number of threads.
+static double sumChi2(Scene& scene, const std::vector<double>& image_errors)
 {
     double error = 0;
+    for (auto e : image_errors)
+    {
+        error += e;
+    }
 
-    //    int stereoEdges = 0;
-    //    int monoEdges   = 0;
+    //    std::cout << "RPC SIze: " << rel_pose_constraints.size() << std::endl;
+    for (auto& rpc : scene.rel_pose_constraints)
+    {
+        SAIGA_ASSERT(rpc.img1 >= 0);
+        SAIGA_ASSERT(rpc.img2 >= 0);
+        auto& p1 = scene.images[rpc.img1].se3;
+        auto& p2 = scene.images[rpc.img2].se3;
+        auto e   = rpc.Residual(p1, p2).squaredNorm();
+        error += e;
+        //        std::cout << "RPC " << rpc.img1 << " - " << rpc.img2 << " Error: " << e << std::endl;
+    }
+    return error;
+}
+
+double Scene::chi2(double huber)
+{
+    std::vector<double> image_errors(images.size());
 
+#pragma omp parallel for schedule(dynamic, 16)
     for (int i = 0; i < (int)images.size(); ++i)
     {
         SceneImage& im     = images[i];
@@ -399,62 +444,97 @@ double Scene::chi2(double huber)
             }
             image_error += res_2;
         }
-        error += image_error;
-        //        std::cout << "Rep " << i << " " << image_error << std::endl;
+        image_errors[i] = image_error;
     }
 
-    //    std::cout << "Scene stereo/mono/dense " << stereoEdges << "/" << monoEdges << "/" << 0 << " chi2: " << error
-    //              << std::endl;
-    //    std::cout << "BA error: " << error << std::endl;
+    return sumChi2(*this, image_errors);
+}
 
-    //    std::cout << "RPC SIze: " << rel_pose_constraints.size() << std::endl;
-    for (auto& rpc : rel_pose_constraints)
+double Scene::chi2(const SceneObservations& obs, double huber)
+{
+    SAIGA_ASSERT(obs.numImages() == (int)images.size());
+
+    std::vector<double> image_errors(images.size());
+
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < (int)images.size(); ++i)
     {
-        SAIGA_ASSERT(rpc.img1 >= 0);
-        SAIGA_ASSERT(rpc.img2 >= 0);
-        auto& p1 = images[rpc.img1].se3;
-        auto& p2 = images[rpc.img2].se3;
-        auto e   = rpc.Residual(p1, p2).squaredNorm();
-        error += e;
-        //        std::cout << "RPC " << rpc.img1 << " - " << rpc.img2 << " Error: " << e << std::endl;
-    }
+        double image_error = 0;
 
-    //    for (auto& i : images)
-    //    {
-    //        std::cout << i.se3 << std::endl;
-    //    }
+        for (int o = obs.image_offset[i]; o < obs.image_offset[i + 1]; ++o)
+        {
+            if (obs.outlier[o]) continue;
+            double res_2 = observationResidualNorm2(*this, obs, o);
 
-    return error;
+            if (huber > 0)
+            {
+                auto rw = Kernel::HuberLoss<double>(huber, res_2);
+                res_2   = rw(0);
+            }
+            image_error += res_2;
+        }
+        image_errors[i] = image_error;
+    }
+
+    return sumChi2(*this, image_errors);
 }
 
 
 double Scene::rms()
 {
-    double error = 0;
-
-    int stereoEdges = 0;
-    int monoEdges   = 0;
+    std::vector<double> image_errors(images.size());
+    int edges = 0;
 
-    for (SceneImage& im : images)
+#pragma omp parallel for schedule(dynamic, 16) reduction(+ : edges)
+    for (int i = 0; i < (int)images.size(); ++i)
     {
+        SceneImage& im     = images[i];
+        double image_error = 0;
+
         for (auto& o : im.stereoPoints)
         {
             if (!o) continue;
-            double res_2 = residualNorm2(im, o);
+            image_error += residualNorm2(im, o);
+            edges++;
+        }
+        image_errors[i] = image_error;
+    }
+
+    double error = 0;
+    for (auto e : image_errors)
+    {
+        error += e;
+    }
+    return sqrt(error / edges);
+}
 
-            if (o.depth > 0)
-                stereoEdges++;
-            else
-                monoEdges++;
-            error += res_2;
+double Scene::rms(const SceneObservations& obs)
+{
+    SAIGA_ASSERT(obs.numImages() == (int)images.size());
+
+    std::vector<double> image_errors(images.size());
+    int edges = 0;
+
+#pragma omp parallel for schedule(dynamic, 16) reduction(+ : edges)
+    for (int i = 0; i < (int)images.size(); ++i)
+    {
+        double image_error = 0;
+
+        for (int o = obs.image_offset[i]; o < obs.image_offset[i + 1]; ++o)
+        {
+            if (obs.outlier[o]) continue;
+            image_error += observationResidualNorm2(*this, obs, o);
+            edges++;
         }
+        image_errors[i] = image_error;
     }
 
-    auto error2 = error / (monoEdges + stereoEdges);
-    error2      = sqrt(error2);
-    //    std::cout << "Scene stereo/mono/dense " << stereoEdges << "/" << monoEdges << "/" << 0 << " Error: " << error2
-    //              << " chi2: " << error << std::endl;
-    return error2;
+    double error = 0;
+    for (auto e : image_errors)
+    {
+        error += e;
+    }
+    return sqrt(error / edges);
 }
 
 
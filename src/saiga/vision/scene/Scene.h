@@ -10,6 +10,7 @@
 #include "saiga/core/image/image.h"
 #include "saiga/core/util/statistics.h"
 #include "saiga/vision/VisionTypes.h"
+#include "saiga/vision/scene/SceneObservations.h"
 
 #include <vector>
 
@@ -209,6 +210,11 @@ class SAIGA_VISION_API Scene
 
     double chi2(double huber = 0);
     double rms();
+
+    // Same as above, but evaluated on a prebuilt observation list. Use this for repeated evaluations of the same
+    // structure, for example in an optimization loop. The image points of the scene are not read.
+    double chi2(const SceneObservations& obs, double huber = 0);
+    double rms(const SceneObservations& obs);
     void rmsPrint();
 
     /**
@@ -257,7 +263,13 @@ class SAIGA_VISION_API Scene
     // returns true if the scene was changed by a user action
     bool imgui();
     void save(const std::string& file);
+
+    // Loads the text format or the binary format (detected by the file header).
     void load(const std::string& file);
+
+    // Versioned binary format, see BinarySceneFile.h. Much faster to load than the text format.
+    void saveBinary(const std::string& file);
+    bool loadBinary(const std::string& file);
     double chi2Huber(double huber);
 };
 
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "SceneObservations.h"
+
+#include "saiga/core/util/assert.h"
+#include "saiga/vision/scene/Scene.h"
+
+namespace Saiga
+{
+void SceneObservations::build(const Scene& scene, bool point_major)
+{
+    int num_images = scene.images.size();
+
+    image_offset.resize(num_images + 1);
+    image_offset[0] = 0;
+    for (int i = 0; i < num_images; ++i)
+    {
+        int count = 0;
+        for (auto& ip : scene.images[i].stereoPoints)
+        {
+            if (ip.wp != -1) count++;
+        }
+        image_offset[i + 1] = image_offset[i] + count;
+    }
+
+    int n = image_offset.back();
+    point.resize(n);
+    depth.resize(n);
+    weight.resize(n);
+    wp.resize(n);
+    image.resize(n);
+    image_point.resize(n);
+    outlier.resize(n);
+
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < num_images; ++i)
+    {
+        auto& img = scene.images[i];
+        int o     = image_offset[i];
+        for (int j = 0; j < (int)img.stereoPoints.size(); ++j)
+        {
+            auto& ip = img.stereoPoints[j];
+            if (ip.wp == -1) continue;
+            point[o]       = ip.point;
+            depth[o]       = ip.depth;
+            weight[o]      = ip.weight;
+            wp[o]          = ip.wp;
+            image[o]       = i;
+            image_point[o] = j;
+            outlier[o]     = ip.outlier;
+            ++o;
+        }
+    }
+
+    if (!point_major)
+    {
+        point_offset.clear();
+        point_observations.clear();
+        return;
+    }
+
+    // Counting sort by world point. The observations are visited in image order, therefore the observations of each
+    // point are sorted by image.
+    int num_points = scene.worldPoints.size();
+    point_offset.clear();
+    point_offset.resize(num_points + 1, 0);
+    for (int o = 0; o < n; ++o)
+    {
+        SAIGA_ASSERT(wp[o] >= 0 && wp[o] < num_points);
+        point_offset[wp[o] + 1]++;
+    }
+    for (int j = 0; j < num_points; ++j)
+    {
+        point_offset[j + 1] += point_offset[j];
+    }
+
+    point_observations.resize(n);
+    std::vector<int> position(point_offset.begin(), point_offset.end() - 1);
+    for (int o = 0; o < n; ++o)
+    {
+        point_observations[position[wp[o]]++] = o;
+    }
+}
+
+void SceneObservations::apply(Scene& scene) const
+{
+    SAIGA_ASSERT(numImages() == (int)scene.images.size());
+
+#pragma omp parallel for
+    for (int o = 0; o < size(); ++o)
+    {
+        auto& ip   = scene.images[image[o]].stereoPoints[image_point[o]];
+        ip.point   = point[o];
+        ip.depth   = depth[o];
+        ip.weight  = weight[o];
+        ip.wp      = wp[o];
+        ip.outlier = outlier[o];
+    }
+}
+
+}  // namespace Saiga
@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#pragma once
+
+#include "saiga/config.h"
+#include "saiga/vision/VisionTypes.h"
+
+#include <vector>
+
+namespace Saiga
+{
+class Scene;
+
+/**
+ * Compact structure-of-arrays copy of the image points of a scene.
+ *
+ * The observations are stored image-major in CSR format: the observations of image i are the indices
+ * [image_offset[i], image_offset[i+1]) of the per-observation arrays. Inside an image they have the same order as in
+ * SceneImage::stereoPoints. Only image points with a world point (wp != -1) are stored. Outliers are kept and marked,
+ * so the indices match the structure of the BA matrices.
+ *
+ * The optional point-major index lists the observations of world point j in
+ * point_observations[point_offset[j] .. point_offset[j+1]), sorted by image.
+ *
+ * The copy pays off when the same structure is evaluated many times, as in the residual and Jacobian loops of the
+ * recursive BA. One-off evaluations (Scene::chi2(), Scene::rms(), Scene::compress()) work directly on the image points.
+ *
+ * This is a snapshot. If the scene is changed, build() has to be called again.
+ *
+ * Usage:
+ *
+ * SceneObservations obs;
+ * obs.build(scene);
+ * for (int i = 0; i < obs.numImages(); ++i)
+ *     for (int o = obs.image_offset[i]; o < obs.image_offset[i + 1]; ++o)
+ *         process(obs.wp[o], obs.point[o]);
+ */
+struct SAIGA_VISION_API SceneObservations
+{
+    // Image-major index. Size = number of images + 1
+    std::vector<int> image_offset;
+
+    // Per observation
+    AlignedVector<Vec2> point;
+    std::vector<double> depth;
+    std::vector<float> weight;
+    std::vector<int> wp;
+    std::vector<int> image;
+    // Index into SceneImage::stereoPoints
+    std::vector<int> image_point;
+    std::vector<char> outlier;
+
+    // Point-major index. Size = number of world points + 1
+    std::vector<int> point_offset;
+    std::vector<int> point_observations;
+
+    void build(const Scene& scene, bool point_major = true);
+
+    // Writes point, depth, weight, wp and outlier back to the image points of the scene.
+    void apply(Scene& scene) const;
+
+    int size() const { return wp.size(); }
+    int numImages() const { return image_offset.empty() ? 0 : image_offset.size() - 1; }
+    bool IsStereoOrDepth(int o) const { return depth[o] > 0; }
+    double GetStereoPoint(int o, double bf) const { return point[o](0) - bf / depth[o]; }
+};
+
+}  // namespace Saiga
@@ -6,11 +6,14 @@
 
 #include "saiga/core/imgui/imgui.h"
 #include "saiga/core/util/assert.h"
+#include "saiga/core/util/file.h"
 #include "saiga/core/util/fileChecker.h"
 #include "saiga/vision/util/Random.h"
 
+#include "BinarySceneFile.h"
 #include "Scene.h"
 
+#include <cstring>
 #include <fstream>
 namespace Saiga
 {
@@ -132,73 +135,177 @@ void Scene::load(const std::string& file)
         return;
     }
 
-    std::ifstream strm(f);
-    SAIGA_ASSERT(strm.is_open());
+    if (BinarySceneFileView::isBinarySceneFile(f))
+    {
+        loadBinary(f);
+        return;
+    }
 
+    // All numbers of the file are parsed in parallel. The comments at the beginning are skipped by the parser.
+    std::vector<double> data;
+    if (!File::loadFileNumbers(f, data))
+    {
+        std::cout << "invalid scene file " << f << std::endl;
+        return;
+    }
 
-    auto consumeComment = [&]() {
-        while (true)
-        {
-            auto c = strm.peek();
-            if (c == '#')
-            {
-                std::string s;
-                std::getline(strm, s);
-            }
-            else
-            {
-                break;
-            }
-        }
+    size_t pos = 0;
+    auto next  = [&]() {
+        if (pos >= data.size()) SAIGA_EXIT_ERROR("Unexpected end of scene file");
+        return data[pos++];
+    };
+    auto nextVector = [&](auto& v) {
+        for (int i = 0; i < v.rows(); ++i) v(i) = next();
     };
 
-
-    consumeComment();
-    int num_intrinsics, num_images, num_worldPoints;
-    strm >> num_intrinsics >> num_images >> num_worldPoints >> bf >> globalScale;
+    int num_intrinsics  = next();
+    int num_images      = next();
+    int num_worldPoints = next();
+    bf                  = next();
+    globalScale         = next();
     intrinsics.resize(num_intrinsics);
     images.resize(num_images);
     worldPoints.resize(num_worldPoints);
     for (auto& i : intrinsics)
     {
         Vec5 test;
-        strm >> test;
+        nextVector(test);
         i = test;
     }
 
 
     for (auto& img : images)
     {
-        Sophus::Vector<double, SE3::num_parameters> pose;
-        Sophus::Vector<double, SE3::num_parameters> velocity;
-        strm >> img.constant >> pose >> velocity;
-
+        img.constant = next() != 0;
 
         Eigen::Map<Sophus::Vector<double, SE3::num_parameters>> pose_map(img.se3.data());
-        pose_map = pose;
+        nextVector(pose_map);
 
         Eigen::Map<Sophus::Vector<double, SE3::num_parameters>> velocity_map(img.velocity.data());
-        velocity_map = velocity;
-
+        nextVector(velocity_map);
 
-        int numpoints;
-        strm >> img.intr >> numpoints;
+        img.intr      = next();
+        int numpoints = next();
         img.stereoPoints.resize(numpoints);
         for (auto& ip : img.stereoPoints)
         {
-            strm >> ip.wp >> ip.depth >> ip.point >> ip.weight;
+            ip.wp    = next();
+            ip.depth = next();
+            nextVector(ip.point);
+            ip.weight = next();
         }
     }
 
     for (auto& wp : worldPoints)
     {
-        strm >> wp.p;
+        nextVector(wp.p);
     }
 
     fixWorldPointReferences();
     SAIGA_ASSERT(valid());
 }
 
+void Scene::saveBinary(const std::string& file)
+{
+    SAIGA_ASSERT(valid());
+
+    std::cout << "Saving binary scene to " << file << "." << std::endl;
+
+    std::vector<BinarySceneIntrinsics> bin_intrinsics(intrinsics.size());
+    std::vector<BinarySceneImage> bin_images(images.size());
+    std::vector<BinarySceneWorldPoint> bin_world_points(worldPoints.size());
+
+    for (size_t i = 0; i < intrinsics.size(); ++i)
+    {
+        Eigen::Map<Vec5>(bin_intrinsics[i].coeffs) = intrinsics[i].coeffs();
+    }
+
+    uint64_t num_observations = 0;
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        auto& img = images[i];
+        auto& bin = bin_images[i];
+        Eigen::Map<Sophus::Vector<double, SE3::num_parameters>>(bin.se3) = img.se3.params();
+        Eigen::Map<Sophus::Vector<double, SE3::num_parameters>>(bin.velocity) = img.velocity.params();
+
+        bin.intr              = img.intr;
+        bin.constant          = img.constant;
+        bin.first_observation = num_observations;
+        bin.num_observations  = img.stereoPoints.size();
+        num_observations += img.stereoPoints.size();
+    }
+
+    std::vector<BinarySceneObservation> bin_observations(num_observations);
+#pragma omp parallel for
+    for (int i = 0; i < (int)images.size(); ++i)
+    {
+        auto& img = images[i];
+        for (size_t j = 0; j < img.stereoPoints.size(); ++j)
+        {
+            auto& ip = img.stereoPoints[j];
+            auto& o  = bin_observations[bin_images[i].first_observation + j];
+            o.wp     = ip.wp;
+            o.weight = ip.weight;
+            o.depth  = ip.depth;
+
+            Eigen::Map<Vec2>(o.point) = ip.point;
+        }
+    }
+
+    for (size_t i = 0; i < worldPoints.size(); ++i)
+    {
+        Eigen::Map<Vec3>(bin_world_points[i].p) = worldPoints[i].p;
+    }
+
+    BinarySceneHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, BinarySceneFileView::magic, 8);
+    header.version          = BinarySceneFileView::current_version;
+    header.header_size      = sizeof(BinarySceneHeader);
+    header.num_intrinsics   = bin_intrinsics.size();
+    header.num_images       = bin_images.size();
+    header.num_observations = bin_observations.size();
+    header.num_world_points = bin_world_points.size();
+    header.bf               = bf;
+    header.global_scale     = globalScale;
+
+    // All record sizes are multiples of 8 -> the sections stay 8 byte aligned
+    header.intrinsics_offset   = sizeof(BinarySceneHeader);
+    header.images_offset       = header.intrinsics_offset + bin_intrinsics.size() * sizeof(BinarySceneIntrinsics);
+    header.observations_offset = header.images_offset + bin_images.size() * sizeof(BinarySceneImage);
+    header.world_points_offset =
+        header.observations_offset + bin_observations.size() * sizeof(BinarySceneObservation);
+
+    std::ofstream strm(file, std::ios::binary);
+    SAIGA_ASSERT(strm.is_open());
+    auto write = [&](const auto& vec) {
+        strm.write(reinterpret_cast<const char*>(vec.data()), vec.size() * sizeof(vec[0]));
+    };
+    strm.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write(bin_intrinsics);
+    write(bin_images);
+    write(bin_observations);
+    write(bin_world_points);
+    SAIGA_ASSERT(strm.good());
+}
+
+bool Scene::loadBinary(const std::string& file)
+{
+    BinarySceneFileView view;
+    if (!view.open(file))
+    {
+        std::cout << "invalid binary scene file " << file << std::endl;
+        return false;
+    }
+    if (!view.toScene(*this))
+    {
+        std::cout << "corrupted binary scene file " << file << std::endl;
+        return false;
+    }
+    SAIGA_ASSERT(valid());
+    return true;
+}
+
 
 std::ostream& operator<<(std::ostream& strm, Scene& scene)
 {
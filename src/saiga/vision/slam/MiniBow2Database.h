@@ -0,0 +1,293 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+#pragma once
+
+#include "saiga/vision/slam/MiniBow2.h"
+
+#include <mutex>
+#include <shared_mutex>
+
+namespace MiniBow2
+{
+using EntryId = int;
+
+struct QueryResult
+{
+    EntryId id;
+    WordValue score;
+};
+
+/**
+ * Database of bow vectors for place recognition and loop detection.
+ *
+ * For every word, the inverted file stores the entries containing this word together with the word value. A query
+ * only visits the entries which share at least one word with the query vector. The score is the same as
+ * FeatureVector::score (L1-score of two normalized vectors), which is in [0, 1] with 1 for identical vectors.
+ *
+ * If the direct index is enabled, the FeatureVector of each entry is stored as well. It can be used to match only
+ * features of the same vocabulary node after a successful query.
+ *
+ * Queries are thread safe and can run concurrently. add(), remove(), clear() and loadRaw() lock the database
+ * exclusively.
+ *
+ * Usage:
+ *
+ * BowDatabase db(true);
+ * for (auto& kf : keyframes) kf.db_id = db.add(kf.bow, kf.fv);
+ * auto candidates = db.query(frame.bow, 10);
+ */
+class BowDatabase
+{
+   public:
+    BowDatabase(bool use_direct_index = false) : use_direct_index(use_direct_index) {}
+
+    /**
+     * Adds a new entry and returns its id.
+     * The ids are assigned in increasing order starting at 0 and are not reused after remove().
+     * @param v the (normalized) bow vector
+     * @param fv the feature vector. Ignored if the direct index is disabled.
+     */
+    EntryId add(const BowVector& v, const FeatureVector& fv = FeatureVector())
+    {
+        std::unique_lock lock(mutex);
+        EntryId id = entries.size();
+        addToInvertedFile(id, v);
+        entries.push_back(v);
+        active.push_back(1);
+        if (use_direct_index) direct_index.push_back(fv);
+        num_active++;
+        return id;
+    }
+
+    /**
+     * Removes an entry from the inverted file and the direct index.
+     * The cost is linear in the length of the inverted lists of its words.
+     */
+    void remove(EntryId id)
+    {
+        std::unique_lock lock(mutex);
+        SAIGA_ASSERT(contains_nolock(id));
+        for (auto& w : entries[id])
+        {
+            // The lists are sorted by id, because new entries always get the largest id.
+            auto& list = inverted_file[w.first];
+            auto it    = std::lower_bound(list.begin(), list.end(), id,
+                                       [](const InvertedEntry& a, EntryId b) { return a.id < b; });
+            SAIGA_ASSERT(it != list.end() && it->id == id);
+            list.erase(it);
+        }
+        BowVector().swap(entries[id]);
+        if (use_direct_index) FeatureVector().swap(direct_index[id]);
+        active[id] = 0;
+        num_active--;
+    }
+
+    void clear()
+    {
+        std::unique_lock lock(mutex);
+        inverted_file.clear();
+        entries.clear();
+        direct_index.clear();
+        active.clear();
+        num_active = 0;
+    }
+
+    /**
+     * Returns the (at most) k entries with the highest score sorted by decreasing score. On equal score the lower id
+     * comes first. Entries with a score <= min_score are not returned. Entries without a common word have score 0
+     * and are never returned.
+     *
+     * The cost is linear in the length of the visited inverted lists, not in the size of the database.
+     */
+    std::vector<QueryResult> query(const BowVector& v, int k, WordValue min_score = 0) const
+    {
+        std::shared_lock lock(mutex);
+
+        // Concurrent queries are allowed, so every thread has its own accumulator. It is all zero between queries
+        // and only the touched entries are visited and reset.
+        thread_local QueryScratch scratch;
+        if (scratch.accumulator.size() < entries.size())
+        {
+            scratch.accumulator.resize(entries.size(), 0);
+            scratch.is_touched.resize(entries.size(), 0);
+        }
+        auto& accumulator = scratch.accumulator;
+        auto& is_touched  = scratch.is_touched;
+        auto& touched     = scratch.touched;
+
+        // Same summation order as FeatureVector::score (increasing word id) -> identical results.
+        for (auto& w : v)
+        {
+            if (w.first >= (int)inverted_file.size()) continue;
+            WordValue qv = w.second;
+            for (auto& e : inverted_file[w.first])
+            {
+                if (!is_touched[e.id])
+                {
+                    is_touched[e.id] = 1;
+                    touched.push_back(e.id);
+                }
+                accumulator[e.id] += std::abs(qv - e.value) - std::abs(qv) - std::abs(e.value);
+            }
+        }
+
+        // Removed entries are not in the inverted file.
+        std::vector<QueryResult> result;
+        for (EntryId i : touched)
+        {
+            WordValue score = accumulator[i] * WordValue(-0.5);
+            if (score > min_score) result.push_back({i, score});
+            accumulator[i] = 0;
+            is_touched[i]  = 0;
+        }
+        touched.clear();
+
+        auto cmp = [](const QueryResult& a, const QueryResult& b) {
+            return a.score > b.score || (a.score == b.score && a.id < b.id);
+        };
+        k = std::min<int>(k, result.size());
+        std::partial_sort(result.begin(), result.begin() + k, result.end(), cmp);
+        result.resize(k);
+        return result;
+    }
+
+    bool contains(EntryId id) const
+    {
+        std::shared_lock lock(mutex);
+        return contains_nolock(id);
+    }
+
+    BowVector getBowVector(EntryId id) const
+    {
+        std::shared_lock lock(mutex);
+        SAIGA_ASSERT(contains_nolock(id));
+        return entries[id];
+    }
+
+    FeatureVector getFeatureVector(EntryId id) const
+    {
+        std::shared_lock lock(mutex);
+        SAIGA_ASSERT(use_direct_index);
+        SAIGA_ASSERT(contains_nolock(id));
+        return direct_index[id];
+    }
+
+    bool usingDirectIndex() const { return use_direct_index; }
+
+    /**
+     * Number of active (not removed) entries.
+     */
+    int size() const
+    {
+        std::shared_lock lock(mutex);
+        return num_active;
+    }
+
+    /**
+     * The ids and values of all entries (including the removed ones) are stored. After loading, the ids are the same
+     * as before saving.
+     */
+    void saveRaw(const std::string& file) const;
+    void loadRaw(const std::string& file);
+
+   private:
+    struct InvertedEntry
+    {
+        EntryId id;
+        WordValue value;
+    };
+    using InvertedList = std::vector<InvertedEntry>;
+
+    bool use_direct_index;
+    int num_active = 0;
+
+    // Indexed by word id.
+    std::vector<InvertedList> inverted_file;
+
+    // Indexed by entry id. Removed entries are empty.
+    std::vector<BowVector> entries;
+    std::vector<FeatureVector> direct_index;
+    std::vector<char> active;
+
+    mutable std::shared_mutex mutex;
+
+    struct QueryScratch
+    {
+        // Indexed by entry id.
+        std::vector<WordValue> accumulator;
+        std::vector<char> is_touched;
+        std::vector<EntryId> touched;
+    };
+
+    bool contains_nolock(EntryId id) const { return id >= 0 && id < (EntryId)entries.size() && active[id]; }
+
+    void addToInvertedFile(EntryId id, const BowVector& v)
+    {
+        for (auto& w : v)
+        {
+            SAIGA_ASSERT(w.first >= 0);
+            if (w.first >= (int)inverted_file.size()) inverted_file.resize(w.first + 1);
+            inverted_file[w.first].push_back({id, w.second});
+        }
+    }
+};
+
+
+inline void BowDatabase::saveRaw(const std::string& file) const
+{
+    std::shared_lock lock(mutex);
+    Saiga::BinaryFile bf(file, std::ios_base::out);
+    bf << use_direct_index << (size_t)entries.size();
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        bf << active[i] << static_cast<const std::vector<std::pair<WordId, WordValue>>&>(entries[i]);
+        if (use_direct_index)
+        {
+            bf << (size_t)direct_index[i].size();
+            for (auto& node : direct_index[i])
+            {
+                bf << node.first << node.second;
+            }
+        }
+    }
+}
+
+inline void BowDatabase::loadRaw(const std::string& file)
+{
+    Saiga::BinaryFile bf(file, std::ios_base::in);
+    if (!bf.strm.is_open())
+    {
+        throw std::runtime_error("Could not load BowDatabase file.");
+    }
+
+    std::unique_lock lock(mutex);
+    inverted_file.clear();
+    num_active = 0;
+
+    size_t n;
+    bf >> use_direct_index >> n;
+    entries.resize(n);
+    active.resize(n);
+    direct_index.resize(use_direct_index ? n : 0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        bf >> active[i] >> static_cast<std::vector<std::pair<WordId, WordValue>>&>(entries[i]);
+        if (use_direct_index)
+        {
+            size_t nodes;
+            bf >> nodes;
+            direct_index[i].resize(nodes);
+            for (auto& node : direct_index[i])
+            {
+                bf >> node.first >> node.second;
+            }
+        }
+        addToInvertedFile(i, entries[i]);
+        num_active += active[i];
+    }
+}
+
+}  // namespace MiniBow2
@@ -7,8 +7,11 @@
 #include "DepthmapPreprocessor.h"
 
 #include "saiga/core/imgui/imgui.h"
+#include "saiga/core/util/Thread/omp.h"
 #include "saiga/core/util/ini/ini.h"
 
+#include <cstring>
+
 
 namespace Saiga
 {
@@ -190,7 +193,7 @@ void DMPP::applyFilterToImage(DepthMap vsrc, DepthMap vdst)
     for (int it = 0; it < params.filterIterations; ++it)
     {
         // filter
-        //#pragma omp parallel for
+#pragma omp parallel for
         for (int i = 0; i < vdst.height; ++i)
         {
             for (int j = 0; j < vdst.width; ++j)
@@ -459,142 +462,249 @@ void DMPP::renderGui()
 
 
 
-DepthProcessor2::DepthProcessor2(const Settings& settings_in) : settings(settings_in) {}
-
-void DepthProcessor2::remove_occlusion_edges(ImageView<float> depthImageView)
+// exp(-x) for x >= 0. Relative error < 1e-4.
+// x is clamped to 64 so that the weights (and their products) never become denormal, which is very slow.
+// Branch free (the clamp is done on the integer bits) so that it is vectorized inside the filter loops.
+static inline float ExpNegative(float x)
 {
-    TemplatedImage<vec3> unprojected_image(depthImageView.height, depthImageView.width);
-    unprojected_image.makeZero();
-
-    // unproject the depth image
-    unproject_depth_image(depthImageView, unprojected_image);
-
-    // create images for the extra data used by the occlusion edge paper (4.2.1)
-    TemplatedImage<float> p(depthImageView.height, depthImageView.width);
-
-    // find / delete occlusion edge pixels paper
-    compute_image_aspect_ratio(unprojected_image, depthImageView, p);
+    const int max_bits = 0x42800000;  // 64.0f
+    int xb;
+    memcpy(&xb, &x, sizeof(float));
+    xb = xb - ((xb - max_bits) & ((max_bits - xb) >> 31));
+    memcpy(&x, &xb, sizeof(float));
+
+    // 2^t = 2^i * 2^f with f in [0,1)
+    float t = x * -1.44269504f;
+    int i   = int(t + 128.0f) - 128;
+    float f = t - float(i);
+    float p = 1.33335581e-3f;
+    p       = p * f + 9.61812911e-3f;
+    p       = p * f + 5.55041087e-2f;
+    p       = p * f + 2.40226507e-1f;
+    p       = p * f + 6.93147181e-1f;
+    p       = p * f + 1.0f;
+
+    int bits = (i + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(float));
+    return p * scale;
+}
 
-    // delete pixels from image that surpass the threshold using a looped hysteresis threshold
-    use_hysteresis_threshold(depthImageView, unprojected_image, p);
+// Adds the tap t (guide g) with the spatial weight k to all pixels of a line, which are still alive.
+// A pixel dies at the first broken tap.
+template <DepthFilterMode mode>
+static inline void AccumulateTap(const float* __restrict t, const float* __restrict g,
+                                 const float* __restrict center, const float* __restrict g_center, float k,
+                                 float broken, float inv_sigma, int w, float* __restrict alive,
+                                 float* __restrict sum, float* __restrict wsum)
+{
+    for (int x = 0; x < w; ++x)
+    {
+        float v  = t[x];
+        alive[x] = alive[x] * float(v != broken);
+        float wx = k * alive[x];
+        if (mode == DepthFilterMode::Bilateral)
+        {
+            float d = v - center[x];
+            wx *= ExpNegative(d * d * inv_sigma);
+        }
+        if (mode == DepthFilterMode::JointBilateral)
+        {
+            float d = g[x] - g_center[x];
+            wx *= ExpNegative(d * d * inv_sigma);
+        }
+        sum[x] += wx * v;
+        wsum[x] += wx;
+    }
 }
 
-void DepthProcessor2::unproject_depth_image(ImageView<const float> depth_imageView, ImageView<vec3> unprojected_image)
+// Filters one line of w pixels (a row in the x-pass, all columns of a row in the y-pass).
+// taps[k] points to the values at offset k - radius, guide_taps the same for the guide image.
+// Scratch must have space for 3 * w floats.
+template <DepthFilterMode mode>
+static void FilterLine(const float* const* taps, const float* const* guide_taps, const float* kernel, int radius,
+                       int w, const DepthFilterParams& params, float* scratch, float* out)
 {
-    int height = depth_imageView.height;
-    int width  = depth_imageView.width;
+    float* sum   = scratch;
+    float* wsum  = scratch + w;
+    float* alive = scratch + 2 * w;
+
+    const float broken    = params.broken_values;
+    const bool joint      = mode == DepthFilterMode::JointBilateral;
+    const float* center   = taps[radius];
+    const float* g_center = joint ? guide_taps[radius] : nullptr;
+    const float sigma     = joint ? params.sigma_guide : params.sigma_depth;
+    const float inv_sigma = 1.0f / (2 * sigma * sigma);
+
+    for (int x = 0; x < w; ++x)
+    {
+        sum[x]  = kernel[0] * center[x];
+        wsum[x] = kernel[0];
+    }
 
-    for (int h = 0; h < height; ++h)
+    for (int side : {-1, 1})
     {
-        for (int w = 0; w < width; ++w)
+        for (int x = 0; x < w; ++x) alive[x] = 1;
+
+        for (int j = 1; j <= radius; ++j)
         {
-            float z                 = depth_imageView(h, w);
-            unprojected_image(h, w) = settings.cameraParameters.unproject(vec2(w + 0.5f, h + 0.5f), z);
+            const float* g = joint ? guide_taps[radius + side * j] : nullptr;
+            AccumulateTap<mode>(taps[radius + side * j], g, center, g_center, kernel[j], broken, inv_sigma, w, alive,
+                                sum, wsum);
         }
     }
+
+    for (int x = 0; x < w; ++x)
+    {
+        out[x] = center[x] == broken ? broken : sum[x] / wsum[x];
+    }
 }
 
+template <DepthFilterMode mode>
+static void FilterLine(const float* const* taps, const float* const* guide_taps, const std::vector<float>& kernel,
+                       int w, const DepthFilterParams& params, float* scratch, float* out)
+{
+    FilterLine<mode>(taps, guide_taps, kernel.data(), kernel.size() - 1, w, params, scratch, out);
+}
 
-void DepthProcessor2::filter_gaussian(ImageView<const float> input, ImageView<float> output)
+void DepthFilter::Filter(ImageView<const float> input, ImageView<float> output, ImageView<const float> guide)
 {
-    if (settings.gauss_radius == 0)
+    SAIGA_ASSERT(input.dimensions() == output.dimensions());
+    const bool joint = params.mode == DepthFilterMode::JointBilateral;
+    if (joint)
     {
-        input.copyTo(output);
+        SAIGA_ASSERT(guide.dimensions() == input.dimensions());
     }
 
-    std::vector<float> filter((settings.gauss_radius * 2) + 1);
-    for (int i = -settings.gauss_radius; i <= settings.gauss_radius; ++i)
+    int h = input.h;
+    int w = input.w;
+    int r = std::max(params.radius, 0);
+
+    if (r == 0)
     {
-        filter[i + settings.gauss_radius] =
-            1.0f / (sqrt(2.0f * pi<float>()) * settings.gauss_standard_deviation) *
-            std::exp(-(i * i / (2.0f * settings.gauss_standard_deviation * settings.gauss_standard_deviation)));
+        if (input.data != output.data) input.copyTo(output);
+        return;
     }
-    int filter_mid = filter.size() / 2;
 
-    // a temporal image for the first filter pass
-    TemplatedImage<float> temp_image(input.height, input.width);
-
-    // go through the pixels and filter in x-direction
-    for (int h = 0; h < input.height; ++h)
+    // Half kernel: kernel[j] is the weight at distance j
+    kernel.resize(r + 1);
+    for (int j = 0; j <= r; ++j)
     {
-        for (int w = 0; w < input.width; ++w)
-        {
-            // if the current pixel already is broken I don't want a new value for it
-            if (input(h, w) == settings.broken_values) continue;
+        kernel[j] = std::exp(-(j * j) / (2.0f * params.sigma_spatial * params.sigma_spatial));
+    }
 
-            float weights = 0.0f;
-            float value   = 0.0f;
+    temp.create(h, w);
+    broken_row.assign(w, params.broken_values);
 
-            // filter for the current pixel
-            float cur_weight = filter[filter_mid];
-            weights += cur_weight;
-            value += cur_weight * input(h, w);
+    int padded_w = w + 2 * r;
+    thread_scratch.resize(OMP::getMaxThreads());
+    for (auto& s : thread_scratch) s.resize(3 * w + 2 * padded_w);
 
-            // filter to the left until radius is reached or a broken vertex is found
-            for (int x = -1; x >= -settings.gauss_radius; --x)
-            {
-                if ((w + x) < 0 || input(h, w + x) == settings.broken_values) break;
+    auto filter_line = [&](const float* const* taps, const float* const* guide_taps, float* scratch, float* out) {
+        switch (params.mode)
+        {
+            case DepthFilterMode::Bilateral:
+                FilterLine<DepthFilterMode::Bilateral>(taps, guide_taps, kernel, w, params, scratch, out);
+                break;
+            case DepthFilterMode::JointBilateral:
+                FilterLine<DepthFilterMode::JointBilateral>(taps, guide_taps, kernel, w, params, scratch, out);
+                break;
+            default:
+                FilterLine<DepthFilterMode::Gaussian>(taps, guide_taps, kernel, w, params, scratch, out);
+                break;
+        }
+    };
 
-                cur_weight = filter[filter_mid + x];
-                weights += cur_weight;
-                value += cur_weight * input(h, w + x);
-            }
+    // x-pass: input -> temp
+    // The row is copied into a buffer with r broken values on each side.
+#pragma omp parallel
+    {
+        auto& scratch = thread_scratch[OMP::getThreadNum()];
+        float* padded = scratch.data() + 3 * w;
+        float* gpad   = padded + padded_w;
+        std::vector<const float*> taps(2 * r + 1), guide_taps(2 * r + 1);
+
+        std::fill(padded, padded + padded_w, params.broken_values);
+        std::fill(gpad, gpad + padded_w, 0.0f);
+        for (int k = 0; k <= 2 * r; ++k)
+        {
+            taps[k]       = padded + k;
+            guide_taps[k] = gpad + k;
+        }
 
-            // filter to the right until radius is reached or a broken vertex is found
-            for (int x = 1; x <= settings.gauss_radius; ++x)
-            {
-                if ((w + x) >= input.width || input(h, w + x) == settings.broken_values) break;
+#pragma omp for
+        for (int y = 0; y < h; ++y)
+        {
+            std::copy(input.rowPtr(y), input.rowPtr(y) + w, padded + r);
+            if (joint) std::copy(guide.rowPtr(y), guide.rowPtr(y) + w, gpad + r);
+            filter_line(taps.data(), joint ? guide_taps.data() : nullptr, scratch.data(), temp.rowPtr(y));
+        }
 
-                cur_weight = filter[filter_mid + x];
-                weights += cur_weight;
-                value += cur_weight * input(h, w + x);
+        // y-pass: temp -> output
+        // Rows outside of the image are replaced by the broken row.
+#pragma omp for
+        for (int y = 0; y < h; ++y)
+        {
+            for (int k = 0; k <= 2 * r; ++k)
+            {
+                int yk        = y + k - r;
+                bool inside   = yk >= 0 && yk < h;
+                taps[k]       = inside ? temp.rowPtr(yk) : broken_row.data();
+                guide_taps[k] = inside && joint ? guide.rowPtr(yk) : broken_row.data();
             }
-
-            temp_image(h, w) = value / weights;
+            filter_line(taps.data(), joint ? guide_taps.data() : nullptr, scratch.data(), output.rowPtr(y));
         }
     }
+}
 
-    // go through the pixels and filter in y-direction
-    for (int h = 0; h < input.height; ++h)
-    {
-        for (int w = 0; w < input.width; ++w)
-        {
-            // if the current pixel already is broken I don't want a new value for it
-            if (temp_image(h, w) == settings.broken_values) continue;
+DepthProcessor2::DepthProcessor2(const Settings& settings_in) : settings(settings_in) {}
 
-            float weights = 0.0f;
-            float value   = 0.0f;
+void DepthProcessor2::remove_occlusion_edges(ImageView<float> depthImageView)
+{
+    unprojected_image.create(depthImageView.height, depthImageView.width);
 
-            // filter for the current pixel
-            float cur_weight = filter[filter_mid];
-            weights += cur_weight;
-            value += cur_weight * input(h, w);
+    // unproject the depth image
+    unproject_depth_image(depthImageView, unprojected_image);
 
-            // filter to the left until radius is reached or a broken vertex is found
-            for (int y = -1; y >= -settings.gauss_radius; --y)
-            {
-                if ((h + y) < 0 || input(h + y, w) == settings.broken_values) break;
+    // create images for the extra data used by the occlusion edge paper (4.2.1)
+    p_image.create(depthImageView.height, depthImageView.width);
 
-                cur_weight = filter[filter_mid + y];
-                weights += cur_weight;
-                value += cur_weight * input(h + y, w);
-            }
+    // find / delete occlusion edge pixels paper
+    compute_image_aspect_ratio(unprojected_image, depthImageView, p_image);
 
-            // filter to the right until radius is reached or a broken vertex is found
-            for (int y = 1; y <= settings.gauss_radius; ++y)
-            {
-                if ((h + y) >= input.height || input(h + y, w) == settings.broken_values) break;
+    // delete pixels from image that surpass the threshold using a looped hysteresis threshold
+    use_hysteresis_threshold(depthImageView, unprojected_image, p_image);
+}
 
-                cur_weight = filter[filter_mid + y];
-                weights += cur_weight;
-                value += cur_weight * input(h + y, w);
-            }
+void DepthProcessor2::unproject_depth_image(ImageView<const float> depth_imageView, ImageView<vec3> unprojected_image)
+{
+    int height = depth_imageView.height;
+    int width  = depth_imageView.width;
 
-            output(h, w) = value / weights;
+#pragma omp parallel for
+    for (int h = 0; h < height; ++h)
+    {
+        for (int w = 0; w < width; ++w)
+        {
+            float z                 = depth_imageView(h, w);
+            unprojected_image(h, w) = settings.cameraParameters.unproject(vec2(w + 0.5f, h + 0.5f), z);
         }
     }
 }
 
+
+void DepthProcessor2::filter_gaussian(ImageView<const float> input, ImageView<float> output)
+{
+    auto mode = settings.filter_bilateral ? DepthFilterMode::Bilateral : DepthFilterMode::Gaussian;
+
+    depth_filter.params.mode          = mode;
+    depth_filter.params.radius        = settings.gauss_radius;
+    depth_filter.params.sigma_spatial = settings.gauss_standard_deviation;
+    depth_filter.params.sigma_depth   = settings.filter_sigma_depth;
+    depth_filter.params.broken_values = settings.broken_values;
+    depth_filter.Filter(input, output);
+}
+
 // --- PRIVATE ---
 
 float DepthProcessor2::compute_quad_max_aspect_ratio(const vec3& left_up, const vec3& right_up, const vec3& left_down,
@@ -602,13 +712,13 @@ float DepthProcessor2::compute_quad_max_aspect_ratio(const vec3& left_up, const
 {
     // all edge lengths
     float len_up, len_right, len_down, len_left, len_diag_0, len_diag_1;
-    len_up    = (left_up - right_up).stableNorm();
-    len_right = (right_up - right_down).stableNorm();
-    len_down  = (right_down - left_down).stableNorm();
-    len_left  = (left_down - left_up).stableNorm();
+    len_up    = (left_up - right_up).norm();
+    len_right = (right_up - right_down).norm();
+    len_down  = (right_down - left_down).norm();
+    len_left  = (left_down - left_up).norm();
 
-    len_diag_0 = (left_up - right_down).stableNorm();
-    len_diag_1 = (right_up - left_down).stableNorm();
+    len_diag_0 = (left_up - right_down).norm();
+    len_diag_1 = (right_up - left_down).norm();
 
     // edge direction: left up to right down
     float aspect_0 =
@@ -634,82 +744,65 @@ void DepthProcessor2::compute_image_aspect_ratio(ImageView<const vec3> image, Im
                                                  ImageView<float> p)
 {
     // get disparity data
-    TemplatedImage<float> disparity(depthImageView.h, depthImageView.w);
+    disparity.create(depthImageView.h, depthImageView.w);
     float median_disparity = get_median_disparity(depthImageView, disparity);
 
     int height       = disparity.height;
     int width        = disparity.width;
     int quads_height = height - 1;
     int quads_width  = width - 1;
+    float broken     = settings.broken_values;
 
     // temporay information on the p per quad (maximum of aspect ratio using the better triangulation)
-    TemplatedImage<float> quad_p(height - 1, width - 1);
+    quad_p.create(height - 1, width - 1);
 
     // check quad properties: quad_p
+#pragma omp parallel for
     for (int h = 0; h < quads_height; ++h)
     {
         for (int w = 0; w < quads_width; ++w)
         {
             // check if any vertex has broken depth
-            if (image(h, w)[2] == settings.broken_values || image(h + 1, w)[2] == settings.broken_values ||
-                image(h, w + 1)[2] == settings.broken_values || image(h + 1, w + 1)[2] == settings.broken_values)
+            if (image(h, w)[2] == broken || image(h + 1, w)[2] == broken || image(h, w + 1)[2] == broken ||
+                image(h + 1, w + 1)[2] == broken)
             {
                 // the quad has broken depth
-                quad_p(h, w) = settings.broken_values;
+                quad_p(h, w) = broken;
                 continue;
             }
 
             // if not then get the worse aspect ratio using the better triangulation
-            float q_p =
+            quad_p(h, w) =
                 compute_quad_max_aspect_ratio(image(h, w), image(h, w + 1), image(h + 1, w), image(h + 1, w + 1));
-            quad_p(h, w) = q_p;
+        }
+    }
 
-            // compute the data for the next pixel
-            if (h == 0 || w == 0)
+    // find the maximum p for each pixel (highest aspect ratio --> highest error)
+    // the edge is not needed as hysteresis will ignore it
+#pragma omp parallel for
+    for (int h = 1; h < quads_height; ++h)
+    {
+        for (int w = 1; w < quads_width; ++w)
+        {
+            float quad_left_up    = quad_p(h - 1, w - 1);
+            float quad_left_down  = quad_p(h, w - 1);
+            float quad_right_up   = quad_p(h - 1, w);
+            float quad_right_down = quad_p(h, w);
+
+            // if any of those contains a broken value propagate it, ...
+            if (quad_left_up == broken || quad_left_down == broken || quad_right_up == broken ||
+                quad_right_down == broken)
             {
-                // not needed as hysteresis will ignore edges
+                p(h, w) = broken;
+                continue;
             }
-            else
-            {
-                // find the maximum p for this pixel (highest aspect ratio --> highest error)
-
-                // initialize p at current pixel
-                float quad_left_up    = quad_p(h - 1, w - 1);
-                float quad_left_down  = quad_p(h, w - 1);
-                float quad_right_up   = quad_p(h - 1, w);
-                float quad_right_down = quad_p(h, w);
+            // else choose the max
+            float pixel_p = std::max(std::max(std::max(quad_left_up, quad_left_down), quad_right_up), quad_right_down);
 
-                // check the surroundings for p (quads) and d_p (vertices)
+            // --- find d_D per pixel ---
+            float pixel_d_D = std::min(2.0f, std::max(0.5f, disparity(h, w) / median_disparity));
 
-                // if any of those contains a broken value propagate it, ...
-                if (quad_left_up == settings.broken_values || quad_left_down == settings.broken_values ||
-                    quad_right_up == settings.broken_values || quad_right_down == settings.broken_values)
-                {
-                    p(h, w) = settings.broken_values;
-                    continue;
-                }
-                // else choose the max
-                p(h, w) = std::max(std::max(std::max(quad_left_up, quad_left_down), quad_right_up), quad_right_down);
-
-                // --- find d_P and d_D per pixel ---
-
-                // initialize the surrounding pixels for calculating the normal
-                vec3 left  = image(h, w - 1);
-                vec3 right = image(h, w + 1);
-                vec3 up    = image(h - 1, w);
-                vec3 down  = image(h + 1, w);
-
-                vec3 viewing = -image(h, w);
-                viewing.normalize();
-                vec3 normal = cross(right - left, up - down);
-                normal.normalize();
-
-                // --- find d_D per pixel ---
-                float pixel_d_D = std::min(2.0f, std::max(0.5f, disparity(h, w) / median_disparity));
-
-                // --- p ---
-                p(h, w) *= pixel_d_D;
-            }
+            p(h, w) = pixel_p * pixel_d_D;
         }
     }
 }
@@ -717,7 +810,7 @@ void DepthProcessor2::compute_image_aspect_ratio(ImageView<const vec3> image, Im
 float DepthProcessor2::get_median_disparity(ImageView<float> depth_imageView, ImageView<float> disparity_imageView)
 {
     // median disparity (broken pixels will not be used)
-    std::vector<float> disparities;
+    disparities.clear();
     disparities.reserve(disparity_imageView.height * disparity_imageView.width);
 
     for (int h = 0; h < depth_imageView.height; ++h)
@@ -738,17 +831,20 @@ float DepthProcessor2::get_median_disparity(ImageView<float> depth_imageView, Im
         }
     }
 
-    std::sort(disparities.begin(), disparities.end());
+    // Partial sort. The lower middle element (even length) is the maximum of the lower half.
     int disp_len = disparities.size();
     if (disp_len > 0)
     {
+        auto mid = disparities.begin() + disp_len / 2;
+        std::nth_element(disparities.begin(), mid, disparities.end());
         if (disp_len % 2 == 0)
         {
-            return (disparities[(disp_len / 2) - 1] + disparities[disp_len / 2]) / 2;
+            float lower = *std::max_element(disparities.begin(), mid);
+            return (lower + *mid) / 2;
         }
         else
         {
-            return disparities[disp_len / 2];
+            return *mid;
         }
     }
     return 0.0f;
@@ -759,7 +855,15 @@ void DepthProcessor2::use_hysteresis_threshold(ImageView<float> depth_image, Ima
 {
     int height = depth_image.height;
     int width  = depth_image.width;
-    std::vector<bool> sure_edges_vec(height * width, false);
+    sure_edges.assign(height * width, false);
+    edge_stack.clear();
+
+    auto delete_pixel = [&](int h, int w) {
+        depth_image(h, w)         = settings.broken_values;
+        unprojected_image(h, w)   = vec3::Zero();
+        sure_edges[h * width + w] = true;
+        edge_stack.push_back(h * width + w);
+    };
 
     // find the sure-edges
     for (int h = 1; h < height - 1; ++h)
@@ -769,43 +873,29 @@ void DepthProcessor2::use_hysteresis_threshold(ImageView<float> depth_image, Ima
             // everything above maxVal or broken is sure to be part of the edge
             if (computed_values(h, w) >= settings.hyst_max || computed_values(h, w) == settings.broken_values)
             {
-                depth_image(h, w)             = settings.broken_values;
-                unprojected_image(h, w)       = vec3::Zero();
-                sure_edges_vec[h * width + w] = true;
+                delete_pixel(h, w);
             }
         }
     }
 
-    // loop the whole process until nothing changes anymore
-    bool something_changed = true;
-    while (something_changed)
+    // Unsure edges (between minVal and maxVal) with a sure edge neighbour become sure edges.
+    // The flood fill from all sure edges computes the same fixpoint as repeated sweeps over the image.
+    while (!edge_stack.empty())
     {
-        something_changed = false;
+        int idx = edge_stack.back();
+        edge_stack.pop_back();
+        int eh = idx / width;
+        int ew = idx % width;
 
-        // check for all unsure edges if a sure edge is among its neighbours
-        for (int h = 1; h < depth_image.height - 1; ++h)
+        for (int h = std::max(eh - 1, 1); h <= std::min(eh + 1, height - 2); ++h)
         {
-            for (int w = 1; w < depth_image.width - 1; ++w)
+            for (int w = std::max(ew - 1, 1); w <= std::min(ew + 1, width - 2); ++w)
             {
-                // everything between minVal and maxVal may be part of the edge
-                if (computed_values(h, w) > settings.hyst_min && computed_values(h, w) < settings.hyst_max &&
-                    sure_edges_vec[h * width + w] == false)
+                float v = computed_values(h, w);
+                if (!sure_edges[h * width + w] && v > settings.hyst_min && v < settings.hyst_max)
                 {
-                    // check the 8 neighbours for sure-edges
-                    bool sure_edge_neighbour =
-                        sure_edges_vec[(h - 1) * width + w - 1] || sure_edges_vec[(h - 1) * width + w] ||
-                        sure_edges_vec[(h - 1) * width + w + 1] || sure_edges_vec[h * width + w - 1] ||
-                        sure_edges_vec[h * width + w + 1] || sure_edges_vec[(h + 1) * width + w - 1] ||
-                        sure_edges_vec[(h + 1) * width + w] || sure_edges_vec[(h + 1) * width + w + 1];
-
-                    if (sure_edge_neighbour)
-                    {
-                        // there is a neighbour that is a sure edge --> this is an edge too
-                        depth_image(h, w)             = settings.broken_values;
-                        unprojected_image(h, w)       = vec3::Zero();
-                        sure_edges_vec[h * width + w] = true;
-                        something_changed             = true;
-                    }
+                    // there is a neighbour that is a sure edge --> this is an edge too
+                    delete_pixel(h, w);
                 }
             }
         }
@@ -818,6 +908,9 @@ void DepthProcessor2::Settings::imgui()
     ImGui::InputFloat("hyst max", &hyst_max);
     ImGui::InputFloat("gauss standard deviation", &gauss_standard_deviation);
     ImGui::InputInt("gauss radius", &gauss_radius);
+
+    ImGui::Checkbox("bilateral", &filter_bilateral);
+    if (filter_bilateral) ImGui::InputFloat("sigma depth", &filter_sigma_depth);
 }
 
 }  // namespace Saiga
@@ -69,6 +69,68 @@ class SAIGA_VISION_API DMPP
 };
 
 
+enum class DepthFilterMode
+{
+    // Spatial gaussian only
+    Gaussian,
+    // Spatial gaussian * gaussian of the depth difference to the center pixel
+    Bilateral,
+    // Spatial gaussian * gaussian of the difference in a guide image (for example the intensity image)
+    JointBilateral
+};
+
+struct SAIGA_VISION_API DepthFilterParams
+{
+    DepthFilterMode mode = DepthFilterMode::Gaussian;
+
+    int radius          = 4;
+    float sigma_spatial = 1.2f;
+
+    // Standard deviation of the depth difference (Bilateral) and the guide difference (JointBilateral).
+    float sigma_depth = 0.05f;
+    float sigma_guide = 10.0f;
+
+    // Pixels with this value are not filtered and stop the filter in their direction.
+    float broken_values = 0.0f;
+};
+
+/**
+ * Separable edge-aware depth filter.
+ *
+ * The filter is applied in x-direction and then in y-direction. In each direction the kernel is cut at the first
+ * broken pixel (or the image border), so depth values are never averaged over holes. Broken pixels stay broken.
+ * The weights are normalized by their sum.
+ *
+ * The scratch buffers are kept between calls, therefore one DepthFilter should be reused for a depth stream.
+ * The rows are filtered in parallel with OpenMP. The inner loops use 0/1 masks instead of branches so they are
+ * vectorized by the compiler.
+ *
+ * Usage:
+ *   DepthFilter filter;
+ *   filter.params.mode = DepthFilterMode::Bilateral;
+ *   filter.Filter(depth, depth);  // in-place
+ */
+class SAIGA_VISION_API DepthFilter
+{
+   public:
+    DepthFilter(const DepthFilterParams& params = DepthFilterParams()) : params(params) {}
+
+    // input and output may be the same image.
+    // The guide must have the size of the input and is only used in the JointBilateral mode.
+    void Filter(ImageView<const float> input, ImageView<float> output,
+                ImageView<const float> guide = ImageView<const float>());
+
+    DepthFilterParams params;
+
+   private:
+    // Result of the x-pass
+    TemplatedImage<float> temp;
+    // A row of broken values (used for the rows outside of the image)
+    std::vector<float> broken_row;
+    std::vector<std::vector<float>> thread_scratch;
+    std::vector<float> kernel;
+};
+
 class SAIGA_VISION_API DepthProcessor2
 {
    public:
@@ -81,6 +143,11 @@ class SAIGA_VISION_API DepthProcessor2
         int gauss_radius               = 4;
         float gauss_standard_deviation = 1.2f;
 
+        // Bilateral instead of gaussian filter. The joint bilateral filter needs a guide image, which is not
+        // available here. Use DepthFilter directly for it.
+        bool filter_bilateral    = false;
+        float filter_sigma_depth = 0.05f;
+
         // options for using the hysteresis threshold
         // if a pixel in the filtered image...
         // ... is greater than hyst_max, it gets deleted
@@ -113,11 +180,21 @@ class SAIGA_VISION_API DepthProcessor2
 
 
     // works in-place!
+    // Gaussian or bilateral filter, see Settings::filter_bilateral (the name is kept for compatibility).
     void filter_gaussian(ImageView<const float> input, ImageView<float> output);
 
    private:
     Settings settings;
 
+    DepthFilter depth_filter;
+
+    // Scratch buffers of remove_occlusion_edges. Kept between frames.
+    TemplatedImage<vec3> unprojected_image;
+    TemplatedImage<float> p_image, quad_p, disparity;
+    std::vector<float> disparities;
+    std::vector<char> sure_edges;
+    std::vector<int> edge_stack;
+
     // computes the aspect ratios for all possible triangulations of a quad and returns the better triangulation and the
     // worse aspect ratio from those triangles
     // -- input --
@@ -262,19 +262,22 @@ OptimizationResults LMOptimizer::solveOMP()
 
             addLambda(lambda);
 
-            if (i == 0)
+            if (tid == 0)
             {
-                current_chi2        = chi2;
-                result.cost_initial = chi2;
+                if (i == 0)
+                {
+                    current_chi2        = chi2;
+                    result.cost_initial = chi2;
+                }
+                result.cost_final = chi2;
             }
-            result.cost_final = chi2;
 
-            double ltime;
+            double ltime = 0;
             {
                 auto timer = (tid == 0) ? std::make_shared<Saiga::ScopedTimer<double>>(ltime) : nullptr;
                 solveLinearSystem();
             }
-            result.linear_solver_time += ltime;
+            if (tid == 0) result.linear_solver_time += ltime;
 
             addDelta();
 
@@ -43,6 +43,11 @@ struct SAIGA_VISION_API OptimizationOptions
     double iterativeTolerance  = 1e-5;
     bool buildExplizitSchur    = false;
 
+    // Iterative refinement of the linear system solution. Only used by the solvers with a single precision linear
+    // system (for example BARecFloat). The residual of the linear system and the refined solution are computed in
+    // double precision. Each step solves the linear system again.
+    int refinementSteps = 0;
+
     // early termiante if the chi2 delta is smaller than this value
     double minChi2Delta  = 1e-5;
     double initialLambda = 1.00e-04;
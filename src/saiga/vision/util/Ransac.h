@@ -34,9 +34,41 @@ struct RansacParameters
     // Number of omp threads in that group
     // Note:
     int threads = 1;
+
+    // Adaptive termination. Disabled if <= 0.
+    // After each improvement, the number of required iterations is recomputed from the current inlier ratio, such
+    // that an all-inlier sample is drawn with this probability. maxIterations is still the upper bound.
+    // Typical value: 0.999
+    double confidence = 0;
+
+    // T(d,d) pre-test. Disabled if 0.
+    // Each hypothesis is first evaluated on this number of random points. If one of them is an outlier, the
+    // hypothesis is rejected without computing all N residuals. Typical value: 1
+    int preTestPoints = 0;
 };
 
+// The number of iterations required to draw at least one all-inlier sample with the given probability.
+// sampleSize is the number of points that have to be inliers (model size + pre-test points).
+inline int RansacRequiredIterations(double inlierRatio, int sampleSize, double confidence, int maxIterations)
+{
+    double p_good = std::pow(inlierRatio, sampleSize);
+    if (p_good >= 1) return 1;
+    if (p_good <= 0) return maxIterations;
+
+    double k = std::ceil(std::log(1 - confidence) / std::log(1 - p_good));
+    return std::max(1, (int)std::min<double>(k, maxIterations));
+}
 
+
+/**
+ * Parallel RANSAC with static thread scheduling.
+ *
+ * Each thread only keeps its best model, therefore the memory is O(threads * N). compute() returns the index of the
+ * best thread and the result can be read from models[idx], inliers[idx], residuals[idx] and numInliers[idx].
+ *
+ * Hypotheses are rejected early if they can't beat the current best model of the thread anymore. See
+ * RansacParameters for the adaptive termination and the pre-test.
+ */
 template <typename Derived, typename Model, int ModelSize>
 class RansacBase
 {
@@ -45,20 +77,26 @@ class RansacBase
     {
         params = _params;
         SAIGA_ASSERT(params.maxIterations > 0);
+        SAIGA_ASSERT(params.preTestPoints >= 0);
         SAIGA_ASSERT(OMP::getNumThreads() == 1);
 
-        numInliers.resize(params.maxIterations);
-        models.resize(params.maxIterations);
-
-        residuals.resize(params.maxIterations);
-        for (auto&& r : residuals) r.reserve(params.reserveN);
+        SAIGA_ASSERT(params.threads >= 1);
+        numInliers.resize(params.threads);
+        models.resize(params.threads);
 
-        inliers.resize(params.maxIterations);
-        for (auto&& r : inliers) r.reserve(params.reserveN);
+        residuals.resize(params.threads);
+        tmpResiduals.resize(params.threads);
+        inliers.resize(params.threads);
+        tmpInliers.resize(params.threads);
+        for (int i = 0; i < params.threads; ++i)
+        {
+            residuals[i].reserve(params.reserveN);
+            tmpResiduals[i].reserve(params.reserveN);
+            inliers[i].reserve(params.reserveN);
+            tmpInliers[i].reserve(params.reserveN);
+        }
 
-        SAIGA_ASSERT(params.threads >= 1);
         generators.resize(params.threads);
-        threadLocalBestModel.resize(params.threads);
         for (int i = 0; i < params.threads; ++i)
         {
             generators[i].seed(ransacRandomSeed + 6643838879UL * i);
@@ -67,6 +105,9 @@ class RansacBase
 
     const RansacParameters& Params() const { return params; }
 
+    // Number of hypotheses generated in the last call to compute.
+    int Iterations() const { return performedIterations; }
+
    protected:
     // indices of subset
     using Subset = std::array<int, ModelSize>;
@@ -86,22 +127,38 @@ class RansacBase
         std::uniform_int_distribution<int> dis(0, _N - 1);
         auto& gen = generators[tid];
 
+        auto& bestModel    = models[tid];
+        auto& bestInlier   = inliers[tid];
+        auto& bestResidual = residuals[tid];
+        auto& bestCount    = numInliers[tid];
+        auto& inlier       = tmpInliers[tid];
+        auto& residual     = tmpResiduals[tid];
 
-        auto& bestModel = threadLocalBestModel[tid]();
-        bestModel       = {0, 0};
+        bestCount = 0;
+        bestInlier.assign(_N, 0);
+        bestResidual.assign(_N, 0);
+        inlier.resize(_N);
+        residual.resize(_N);
 
+#pragma omp single
+        {
+            requiredIterations  = params.maxIterations;
+            performedIterations = 0;
+        }
 
-#pragma omp for
+        Model model;
+
+        // Round robin, so that the first iterations are distributed over all threads if we terminate early.
+#pragma omp for schedule(static, 1)
         for (int it = 0; it < params.maxIterations; ++it)
         {
-            auto& model     = models[it];
-            auto& inlier    = inliers[it];
-            auto& residual  = residuals[it];
-            auto& numInlier = numInliers[it];
+            int required;
+#pragma omp atomic read
+            required = requiredIterations;
+            if (it >= required) continue;
 
-            numInlier = 0;
-            residual.resize(_N);
-            inlier.resize(_N);
+#pragma omp atomic
+            performedIterations++;
 
             Subset set;
             for (auto j : Range(0, ModelSize))
@@ -112,6 +169,9 @@ class RansacBase
 
             if (!derived().computeModel(set, model)) continue;
 
+            if (!PreTest(model, dis, gen)) continue;
+
+            int numInlier = 0;
             for (int j = 0; j < _N; ++j)
             {
                 residual[j] = derived().computeResidual(model, j);
@@ -119,12 +179,18 @@ class RansacBase
                 bool inl  = residual[j] < params.residualThreshold;
                 inlier[j] = inl;
                 numInlier += inl;
+
+                // Even if all remaining points are inliers, this model is not better.
+                if (numInlier + (_N - j - 1) <= bestCount) break;
             }
 
-            if (numInlier > bestModel.first)
+            if (numInlier > bestCount)
             {
-                bestModel.first  = numInlier;
-                bestModel.second = it;
+                bestCount = numInlier;
+                bestModel = model;
+                std::swap(bestInlier, inlier);
+                std::swap(bestResidual, residual);
+                UpdateRequiredIterations(numInlier, _N);
             }
         }
 
@@ -135,14 +201,10 @@ class RansacBase
             int bestCount = 0;
             for (int th = 0; th < params.threads; ++th)
             {
-                auto&& thbestModel = threadLocalBestModel[th]();
-                auto inl           = thbestModel.first;
-                auto it            = thbestModel.second;
-                //                std::cout << "th best " << th << " " << it << " " << inl << std::endl;
-                if (inl > bestCount)
+                if (numInliers[th] > bestCount)
                 {
-                    bestCount = inl;
-                    bestIdx   = it;
+                    bestCount = numInliers[th];
+                    bestIdx   = th;
                 }
             }
         }
@@ -153,21 +215,54 @@ class RansacBase
     // total number of sample points
     int N;
     RansacParameters params;
+
+    // The best model of each thread
     AlignedVector<std::vector<double>> residuals;
     AlignedVector<std::vector<char>> inliers;
     AlignedVector<int> numInliers;
     AlignedVector<Model> models;
 
-    // make sure we don't run into false sharing
-    AlignedVector<AlignedStruct<std::pair<int, int>, SAIGA_CACHE_LINE_SIZE>> threadLocalBestModel;
+    // Temporary per thread storage of the current hypothesis
+    AlignedVector<std::vector<double>> tmpResiduals;
+    AlignedVector<std::vector<char>> tmpInliers;
 
     // each thread has one generator
     std::vector<std::mt19937> generators;
 
     int bestIdx;
 
+    // Shared between the threads of compute()
+    int requiredIterations  = 0;
+    int performedIterations = 0;
+
    private:
     Derived& derived() { return *static_cast<Derived*>(this); }
+
+    bool PreTest(const Model& model, std::uniform_int_distribution<int>& dis, std::mt19937& gen)
+    {
+        for (int j = 0; j < params.preTestPoints; ++j)
+        {
+            if (!(derived().computeResidual(model, dis(gen)) < params.residualThreshold)) return false;
+        }
+        return true;
+    }
+
+    void UpdateRequiredIterations(int inlierCount, int _N)
+    {
+        if (params.confidence <= 0) return;
+        int k = RansacRequiredIterations(double(inlierCount) / _N, ModelSize + params.preTestPoints,
+                                         params.confidence, params.maxIterations);
+        // The critical section serializes the writers. The store must still be atomic, because the loop in compute()
+        // reads the value with 'omp atomic read' outside of the critical section.
+#pragma omp critical(RansacRequiredIterations)
+        {
+            if (k < requiredIterations)
+            {
+#pragma omp atomic write
+                requiredIterations = k;
+            }
+        }
+    }
 };
 
 inline int RansacIterationsFromProbability(int input_N, double probability, int minInliers, int maxIterations)
@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/geometry/AccelerationStructure.h"
+#include "saiga/core/math/random.h"
+
+#include "gtest/gtest.h"
+
+using namespace Saiga;
+using namespace Saiga::AccelerationStructure;
+
+// Small random triangles in [-1,1]^3
+std::vector<Triangle> RandomTriangles(int n)
+{
+    std::vector<Triangle> result;
+    for (int i = 0; i < n; ++i)
+    {
+        vec3 c = Random::MatrixUniform<vec3>(-1, 1);
+        result.emplace_back(c + Random::MatrixUniform<vec3>(-0.1, 0.1), c + Random::MatrixUniform<vec3>(-0.1, 0.1),
+                            c + Random::MatrixUniform<vec3>(-0.1, 0.1));
+    }
+    return result;
+}
+
+// Coherent rays from a common origin through a grid, like the pixels of a camera.
+std::vector<Ray> CameraRays(int w, int h)
+{
+    std::vector<Ray> result;
+    vec3 origin(0.3, -0.2, 3);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            vec3 target(-1.2 + 2.4 * x / w, -1.2 + 2.4 * y / h, 0);
+            result.emplace_back((target - origin).normalized(), origin);
+        }
+    }
+    return result;
+}
+
+// Incoherent rays with random origin and direction
+std::vector<Ray> RandomRays(int n)
+{
+    std::vector<Ray> result;
+    for (int i = 0; i < n; ++i)
+    {
+        vec3 d = Random::MatrixUniform<vec3>(-1, 1).normalized();
+        result.emplace_back(d, Random::MatrixUniform<vec3>(-1.5, 1.5));
+    }
+    return result;
+}
+
+void ExpectSameIntersection(const RayTriangleIntersection& expected, const RayTriangleIntersection& actual)
+{
+    ASSERT_EQ(expected.valid, actual.valid);
+    if (expected.valid)
+    {
+        EXPECT_NEAR(expected.t, actual.t, 1e-5);
+        EXPECT_EQ(expected.triangleIndex, actual.triangleIndex);
+        EXPECT_EQ(expected.backFace, actual.backFace);
+    }
+}
+
+template <typename Tree>
+void CompareWithBruteForce(int num_triangles)
+{
+    Random::setSeed(3592375);
+    auto triangles = RandomTriangles(num_triangles);
+    BruteForce bf(triangles);
+    Tree bvh(triangles);
+
+    auto rays       = CameraRays(48, 37);
+    auto incoherent = RandomRays(500);
+    rays.insert(rays.end(), incoherent.begin(), incoherent.end());
+
+    auto batched = bvh.getClosest(rays);
+    ASSERT_EQ(batched.size(), rays.size());
+
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        auto expected = bf.getClosest(rays[i]);
+        ExpectSameIntersection(expected, bvh.getClosest(rays[i]));
+        ExpectSameIntersection(expected, batched[i]);
+    }
+
+    for (size_t i = 0; i < incoherent.size(); ++i)
+    {
+        auto expected = bf.getAll(incoherent[i]);
+        auto actual   = bvh.getAll(incoherent[i]);
+        auto cmp      = [](auto& a, auto& b) { return a.triangleIndex < b.triangleIndex; };
+        std::sort(expected.begin(), expected.end(), cmp);
+        std::sort(actual.begin(), actual.end(), cmp);
+        ASSERT_EQ(expected.size(), actual.size());
+        for (size_t j = 0; j < expected.size(); ++j)
+        {
+            ExpectSameIntersection(expected[j], actual[j]);
+        }
+    }
+}
+
+TEST(BVH, ObjectMedian)
+{
+    CompareWithBruteForce<ObjectMedianBVH>(1000);
+}
+
+TEST(BVH, SAH)
+{
+    CompareWithBruteForce<SAHBVH>(1000);
+}
+
+TEST(BVH, SAHParallelBuild)
+{
+    // Large enough to build the subtrees in parallel
+    CompareWithBruteForce<SAHBVH>(20000);
+}
+
+TEST(BVH, SAHClosestPoint)
+{
+    Random::setSeed(3592375);
+    auto triangles = RandomTriangles(500);
+    SAHBVH bvh(triangles);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        vec3 p = Random::MatrixUniform<vec3>(-1.5, 1.5);
+
+        std::pair<float, int> expected = {std::numeric_limits<float>::infinity(), -1};
+        for (size_t j = 0; j < triangles.size(); ++j)
+        {
+            float d = triangles[j].Distance(p);
+            if (d < expected.first) expected = {d, j};
+        }
+        auto actual = bvh.ClosestPoint(p);
+        EXPECT_NEAR(expected.first, actual.first, 1e-5);
+        EXPECT_EQ(expected.second, actual.second);
+    }
+}
+
+TEST(BVH, Degenerate)
+{
+    // All triangles have the same center -> no SAH split is possible
+    std::vector<Triangle> triangles(100, Triangle(vec3(0, 0, 0), vec3(1, 0, 0), vec3(0, 1, 0)));
+    SAHBVH bvh(triangles);
+    Ray ray(vec3(0, 0, -1), vec3(0.2, 0.2, 1));
+    auto inter = bvh.getClosest(ray);
+    EXPECT_TRUE(inter.valid);
+    EXPECT_NEAR(inter.t, 1, 1e-5);
+    EXPECT_EQ(bvh.getAll(ray).size(), 100);
+
+    SAHBVH empty(std::vector<Triangle>{});
+    EXPECT_FALSE(empty.getClosest(ray).valid);
+    std::vector<Ray> rays(3, ray);
+    EXPECT_FALSE(empty.getClosest(rays)[2].valid);
+}
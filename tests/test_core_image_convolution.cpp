@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/image/ImageConvolution.h"
+#include "saiga/core/math/random.h"
+
+#include "gtest/gtest.h"
+
+namespace Saiga
+{
+static constexpr int H = 41, W = 57;
+
+static TemplatedImage<float> RandomImage(int h = H, int w = W, double holes = 0)
+{
+    TemplatedImage<float> img(h, w);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            img(y, x) = Random::sampleBool(holes) ? 0 : Random::sampleDouble(0.5, 10);
+        }
+    }
+    return img;
+}
+
+// Reads the pixel like the ImageView functions the border modes are defined by.
+static float ReferenceRead(ImageView<float> img, int y, int x, ImageBorder border)
+{
+    switch (border)
+    {
+        case ImageBorder::Clamp:
+            return img.clampedRead(y, x);
+        case ImageBorder::Mirror:
+            img.mirrorToEdge(y, x);
+            return img(y, x);
+        default:
+            return img.borderRead(y, x, 0);
+    }
+}
+
+static void ExpectNear(ImageView<const float> a, ImageView<const float> b, double eps)
+{
+    for (int y = 0; y < a.h; ++y)
+    {
+        for (int x = 0; x < a.w; ++x)
+        {
+            ASSERT_NEAR(a(y, x), b(y, x), eps) << y << " " << x;
+        }
+    }
+}
+
+static const ImageBorder borders[] = {ImageBorder::Clamp, ImageBorder::Mirror, ImageBorder::Zero};
+
+TEST(ImageConvolution, BorderIndex)
+{
+    TemplatedImage<float> img(1, 7);
+    for (int x = 0; x < 7; ++x) img(0, x) = x;
+
+    for (int x = -6; x < 13; ++x)
+    {
+        for (auto border : borders)
+        {
+            int i       = BorderIndex(x, 7, border);
+            float value = i < 0 ? 0 : img(0, i);
+            EXPECT_EQ(value, ReferenceRead(img, 0, x, border));
+        }
+    }
+
+    // Mirror for windows that are larger than the image
+    EXPECT_EQ(BorderIndex(-8, 7, ImageBorder::Mirror), 4);
+    EXPECT_EQ(BorderIndex(14, 7, ImageBorder::Mirror), 2);
+    EXPECT_EQ(BorderIndex(5, 1, ImageBorder::Mirror), 0);
+}
+
+TEST(ImageConvolution, IntegralImage)
+{
+    auto img = RandomImage();
+    IntegralImage<float> integral;
+    integral.Compute(img, 3, ImageBorder::Mirror);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        int y0 = Random::uniformInt(-3, H + 3), y1 = Random::uniformInt(-3, H + 3);
+        int x0 = Random::uniformInt(-3, W + 3), x1 = Random::uniformInt(-3, W + 3);
+        if (y0 > y1) std::swap(y0, y1);
+        if (x0 > x1) std::swap(x0, x1);
+
+        double ref = 0;
+        for (int y = y0; y < y1; ++y)
+        {
+            for (int x = x0; x < x1; ++x) ref += ReferenceRead(img, y, x, ImageBorder::Mirror);
+        }
+        EXPECT_NEAR(integral.Sum(y0, x0, y1, x1), ref, 1e-6);
+    }
+}
+
+TEST(ImageConvolution, Separable)
+{
+    auto img = RandomImage();
+    TemplatedImage<float> out(H, W), ref(H, W);
+
+    // Asymmetric kernels of different sizes to check the orientation
+    std::vector<float> kx = {0.1, -0.5, 0.2, 1.0, 0.3};
+    std::vector<float> ky = {0.7, 0.2, -0.4};
+    for (auto border : borders)
+    {
+        for (int y = 0; y < H; ++y)
+        {
+            for (int x = 0; x < W; ++x)
+            {
+                double sum = 0;
+                for (int i = 0; i < 3; ++i)
+                {
+                    for (int j = 0; j < 5; ++j)
+                    {
+                        sum += ky[i] * kx[j] * ReferenceRead(img, y + i - 1, x + j - 2, border);
+                    }
+                }
+                ref(y, x) = sum;
+            }
+        }
+
+        ImageConvolution<float> conv(border);
+        conv.Separable(img, out, kx, ky);
+        ExpectNear(out, ref, 1e-4);
+
+        // In place
+        auto inplace = img;
+        conv.Separable(inplace, inplace, kx, ky);
+        ExpectNear(inplace, ref, 1e-4);
+    }
+}
+
+TEST(ImageConvolution, Box)
+{
+    auto img = RandomImage();
+    TemplatedImage<float> out(H, W), ref(H, W);
+    for (auto border : borders)
+    {
+        // radius 30 is larger than the image
+        for (int radius : {0, 1, 5, 30})
+        {
+            int n = (2 * radius + 1) * (2 * radius + 1);
+            for (int y = 0; y < H; ++y)
+            {
+                for (int x = 0; x < W; ++x)
+                {
+                    double sum = 0;
+                    for (int i = -radius; i <= radius; ++i)
+                    {
+                        for (int j = -radius; j <= radius; ++j) sum += ReferenceRead(img, y + i, x + j, border);
+                    }
+                    ref(y, x) = sum / n;
+                }
+            }
+
+            ImageConvolution<float> conv(border);
+            conv.Box(img, out, radius);
+            ExpectNear(out, ref, 1e-4);
+
+            // Same as a separable filter with constant kernels
+            std::vector<float> k(2 * radius + 1, 1.0f / (2 * radius + 1));
+            conv.Separable(img, out, k, k);
+            ExpectNear(out, ref, 1e-4);
+
+            // In place
+            auto inplace = img;
+            conv.Box(inplace, inplace, radius);
+            ExpectNear(inplace, ref, 1e-4);
+        }
+    }
+}
+
+TEST(ImageConvolution, BoxValid)
+{
+    auto img = RandomImage(H, W, 0.3);
+    TemplatedImage<float> out(H, W), ref(H, W);
+    TemplatedImage<int> count(H, W), ref_count(H, W);
+
+    for (auto border : borders)
+    {
+        for (bool keep_holes : {false, true})
+        {
+            int radius = 2;
+            for (int y = 0; y < H; ++y)
+            {
+                for (int x = 0; x < W; ++x)
+                {
+                    double sum = 0;
+                    int n      = 0;
+                    for (int i = -radius; i <= radius; ++i)
+                    {
+                        for (int j = -radius; j <= radius; ++j)
+                        {
+                            float v = ReferenceRead(img, y + i, x + j, border);
+                            if (v == 0) continue;
+                            sum += v;
+                            n++;
+                        }
+                    }
+                    ref(y, x)       = n > 0 ? sum / n : 0;
+                    ref_count(y, x) = n;
+                    if (keep_holes && img(y, x) == 0) ref(y, x) = 0;
+                }
+            }
+
+            ImageConvolution<float> conv(border);
+            conv.BoxValid(img, out, radius, keep_holes, count);
+            ExpectNear(out, ref, 1e-4);
+            for (int y = 0; y < H; ++y)
+            {
+                for (int x = 0; x < W; ++x) ASSERT_EQ(count(y, x), ref_count(y, x));
+            }
+        }
+    }
+
+    // No valid pixel in the window
+    TemplatedImage<float> zero(10, 10);
+    zero.makeZero();
+    ImageConvolution<float> conv;
+    conv.BoxValid(zero, out.getImageView().subImageView(0, 0, 10, 10), 2);
+    for (int y = 0; y < 10; ++y)
+    {
+        for (int x = 0; x < 10; ++x) EXPECT_EQ(out(y, x), 0);
+    }
+}
+
+TEST(ImageConvolution, Gaussian)
+{
+    // A normalized filter does not change a constant image
+    TemplatedImage<double> img(20, 30), out(20, 30);
+    img.getImageView().set(3.0);
+    for (auto border : {ImageBorder::Clamp, ImageBorder::Mirror})
+    {
+        ImageConvolution<double> conv(border);
+        conv.Gaussian(img, out, 4, 2.0);
+        for (int y = 0; y < img.h; ++y)
+        {
+            for (int x = 0; x < img.w; ++x) EXPECT_NEAR(out(y, x), 3.0, 1e-10);
+        }
+    }
+
+    // Same border handling as a separable filter with gaussian kernels
+    auto random = RandomImage();
+    TemplatedImage<float> ref(H, W), outf(H, W);
+    int radius  = 3;
+    float sigma = 1.5;
+    std::vector<float> kernel(2 * radius + 1);
+    float sum = 0;
+    for (int i = -radius; i <= radius; ++i)
+    {
+        kernel[i + radius] = std::exp(-float(i * i) / (2 * sigma * sigma));
+        sum += kernel[i + radius];
+    }
+    for (auto& k : kernel) k /= sum;
+
+    for (auto border : borders)
+    {
+        ImageConvolution<float> conv(border);
+        conv.Separable(random, ref, kernel, kernel);
+        conv.Gaussian(random, outf, radius, sigma);
+        ExpectNear(outf, ref, 1e-4);
+
+        // In place
+        auto inplace = random;
+        conv.Gaussian(inplace, inplace, radius, sigma);
+        ExpectNear(inplace, ref, 1e-4);
+    }
+}
+
+}  // namespace Saiga
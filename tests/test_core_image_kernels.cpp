@@ -0,0 +1,467 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/image/ImageKernels.h"
+#include "saiga/core/image/templatedImage.h"
+#include "saiga/core/math/random.h"
+#include "saiga/core/util/Thread/omp.h"
+
+#include "gtest/gtest.h"
+
+namespace Saiga
+{
+// Odd sizes to test the remainder loops of the vectorized kernels.
+static constexpr int H = 67, W = 93;
+
+template <typename T, typename F>
+static TemplatedImage<T> RandomImage(int h, int w, F f)
+{
+    TemplatedImage<T> img(h, w);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x) img(y, x) = f();
+    }
+    return img;
+}
+
+static TemplatedImage<unsigned char> RandomGray8(int h = H, int w = W)
+{
+    return RandomImage<unsigned char>(h, w, []() { return Random::uniformInt(0, 255); });
+}
+
+static TemplatedImage<float> RandomGrayF(int h = H, int w = W)
+{
+    return RandomImage<float>(h, w, []() { return Random::sampleDouble(0, 255); });
+}
+
+static TemplatedImage<ucvec4> RandomRGBA(int h = H, int w = W)
+{
+    return RandomImage<ucvec4>(h, w, []() {
+        return ucvec4(Random::uniformInt(0, 255), Random::uniformInt(0, 255), Random::uniformInt(0, 255), 255);
+    });
+}
+
+template <typename T>
+static void ExpectEqual(ImageView<const T> a, ImageView<const T> b)
+{
+    ASSERT_EQ(a.dimensions(), b.dimensions());
+    for (int y = 0; y < a.h; ++y)
+    {
+        for (int x = 0; x < a.w; ++x)
+        {
+            ASSERT_EQ(a(y, x), b(y, x)) << y << " " << x;
+        }
+    }
+}
+
+template <typename T>
+static void ExpectNear(ImageView<const T> a, ImageView<const T> b, double eps)
+{
+    ASSERT_EQ(a.dimensions(), b.dimensions());
+    for (int y = 0; y < a.h; ++y)
+    {
+        for (int x = 0; x < a.w; ++x)
+        {
+            ASSERT_NEAR(a(y, x), b(y, x), eps) << y << " " << x;
+        }
+    }
+}
+
+static TemplatedImage<ucvec3> ToRGB(ImageView<const ucvec4> rgba)
+{
+    TemplatedImage<ucvec3> rgb(rgba.h, rgba.w);
+    for (int y = 0; y < rgba.h; ++y)
+    {
+        for (int x = 0; x < rgba.w; ++x) rgb(y, x) = rgba(y, x).head<3>();
+    }
+    return rgb;
+}
+
+static std::vector<ImageKernelBackend> Backends()
+{
+    std::vector<ImageKernelBackend> result;
+    for (auto b : {ImageKernelBackend::Generic, ImageKernelBackend::AVX2})
+    {
+        if (ImageKernelBackendSupported(b)) result.push_back(b);
+    }
+    return result;
+}
+
+static int Clamp(int i, int n)
+{
+    return std::min(std::max(i, 0), n - 1);
+}
+
+static int Reflect101(int i, int n)
+{
+    return i < 0 ? -i : (i >= n ? 2 * n - 2 - i : i);
+}
+
+// Reads a pixel with the given border mode. Only for windows that are smaller than the image.
+template <typename T>
+static double Read(TemplatedImage<T>& img, int y, int x, ImageBorder border)
+{
+    switch (border)
+    {
+        case ImageBorder::Clamp:
+            return img(Clamp(y, img.h), Clamp(x, img.w));
+        case ImageBorder::Mirror:
+            return img(Reflect101(y, img.h), Reflect101(x, img.w));
+        default:
+            return (y >= 0 && y < img.h && x >= 0 && x < img.w) ? img(y, x) : 0;
+    }
+}
+
+static const ImageBorder borders[] = {ImageBorder::Clamp, ImageBorder::Mirror, ImageBorder::Zero};
+
+// The previous per pixel implementation of ImageTransformation::RGBAToGray8/RGBAToGrayF
+static float ToGray(const ucvec4& v)
+{
+    return dot(vec3(0.299f, 0.587f, 0.114f), vec3(v[0], v[1], v[2]));
+}
+
+TEST(ImageKernels, ColorConversion)
+{
+    auto rgba = RandomRGBA();
+    auto rgb  = ToRGB(rgba);
+
+    TemplatedImage<unsigned char> ref8(H, W), out8(H, W);
+    TemplatedImage<float> reff(H, W), outf(H, W);
+    TemplatedImage<ucvec4> ref4(H, W), out4(H, W);
+    for (int y = 0; y < H; ++y)
+    {
+        for (int x = 0; x < W; ++x)
+        {
+            ref8(y, x) = ToGray(rgba(y, x));
+            reff(y, x) = ToGray(rgba(y, x)) * 0.5f;
+            ref4(y, x) = ucvec4(ref8(y, x), ref8(y, x), ref8(y, x), 255);
+        }
+    }
+
+    for (auto b : Backends())
+    {
+        ImageKernel::RGBAToGray8(rgba, out8, b);
+        ExpectEqual<unsigned char>(out8, ref8);
+        ImageKernel::RGBToGray8(rgb, out8, b);
+        ExpectEqual<unsigned char>(out8, ref8);
+        ImageKernel::RGBAToGrayF(rgba, outf, 0.5f, b);
+        ExpectNear<float>(outf, reff, 1e-4);
+        ImageKernel::Gray8ToRGBA(ref8, out4, 255, b);
+        ExpectEqual<ucvec4>(out4, ref4);
+    }
+}
+
+TEST(ImageKernels, ScaleDown2)
+{
+    auto rgba  = RandomRGBA();
+    auto gray  = RandomGray8();
+    auto grayf = RandomGrayF();
+
+    TemplatedImage<ucvec4> ref4(H / 2, W / 2), out4(H / 2, W / 2);
+    TemplatedImage<unsigned char> ref8(H / 2, W / 2), out8(H / 2, W / 2);
+    TemplatedImage<float> reff(H / 2, W / 2), outf(H / 2, W / 2);
+    for (int y = 0; y < H / 2; ++y)
+    {
+        for (int x = 0; x < W / 2; ++x)
+        {
+            ivec4 sum = rgba(2 * y, 2 * x).cast<int>() + rgba(2 * y, 2 * x + 1).cast<int>() +
+                        rgba(2 * y + 1, 2 * x).cast<int>() + rgba(2 * y + 1, 2 * x + 1).cast<int>();
+            ref4(y, x) = (sum / 4).cast<unsigned char>();
+            ref8(y, x) = (gray(2 * y, 2 * x) + gray(2 * y, 2 * x + 1) + gray(2 * y + 1, 2 * x) +
+                          gray(2 * y + 1, 2 * x + 1)) /
+                         4;
+        }
+    }
+    grayf.getImageView().copyScaleDownPow2(reff.getImageView(), 2);
+
+    for (auto b : Backends())
+    {
+        ImageKernel::ScaleDown2(rgba, out4, b);
+        ExpectEqual<ucvec4>(out4, ref4);
+        ImageKernel::ScaleDown2(gray, out8, b);
+        ExpectEqual<unsigned char>(out8, ref8);
+        ImageKernel::ScaleDown2(grayf, outf, b);
+        ExpectEqual<float>(outf, reff);
+    }
+}
+
+TEST(ImageKernels, ScaleDown2Median)
+{
+    auto grayf = RandomGrayF();
+    TemplatedImage<float> ref(H / 2, W / 2), out(H / 2, W / 2);
+    grayf.getImageView().copyToScaleDownMedian(ref.getImageView());
+    for (auto b : Backends())
+    {
+        ImageKernel::ScaleDown2Median(grayf, out, true, b);
+        ExpectEqual<float>(out, ref);
+    }
+}
+
+TEST(ImageKernels, PyramidDown)
+{
+    for (int w : {W, W + 1})
+    {
+        auto gray  = RandomGray8(H, w);
+        auto grayf = RandomGrayF(H, w);
+        int dh = (H + 1) / 2, dw = (w + 1) / 2;
+
+        int k[5] = {1, 4, 6, 4, 1};
+        TemplatedImage<unsigned char> ref8(dh, dw), out8(dh, dw);
+        TemplatedImage<float> reff(dh, dw), outf(dh, dw);
+        for (int y = 0; y < dh; ++y)
+        {
+            for (int x = 0; x < dw; ++x)
+            {
+                int sum8    = 0;
+                double sumf = 0;
+                for (int i = -2; i <= 2; ++i)
+                {
+                    for (int j = -2; j <= 2; ++j)
+                    {
+                        int sy = Reflect101(2 * y + i, H), sx = Reflect101(2 * x + j, w);
+                        sum8 += k[i + 2] * k[j + 2] * gray(sy, sx);
+                        sumf += k[i + 2] * k[j + 2] * grayf(sy, sx);
+                    }
+                }
+                ref8(y, x) = (sum8 + 128) >> 8;
+                reff(y, x) = sumf / 256;
+            }
+        }
+
+        for (auto b : Backends())
+        {
+            ImageKernel::PyramidDown(gray, out8, b);
+            ExpectEqual<unsigned char>(out8, ref8);
+            ImageKernel::PyramidDown(grayf, outf, b);
+            ExpectNear<float>(outf, reff, 1e-3);
+        }
+    }
+}
+
+TEST(ImageKernels, Gradients)
+{
+    auto grayf = RandomGrayF();
+    auto gray  = RandomGray8();
+
+    TemplatedImage<float> refx(H, W), refy(H, W), outx(H, W), outy(H, W);
+    grayf.getImageView().gx(refx);
+    grayf.getImageView().gy(refy);
+    for (auto b : Backends())
+    {
+        ImageKernel::GradientX(grayf, outx, b);
+        ExpectEqual<float>(outx, refx);
+        ImageKernel::GradientY(grayf, outy, b);
+        ExpectEqual<float>(outy, refy);
+    }
+
+    int smooth[3] = {1, 2, 1};
+    for (int y = 0; y < H; ++y)
+    {
+        for (int x = 0; x < W; ++x)
+        {
+            int dx = 0, dy = 0;
+            for (int i = -1; i <= 1; ++i)
+            {
+                dx += smooth[i + 1] * (gray(Clamp(y + i, H), Clamp(x + 1, W)) - gray(Clamp(y + i, H), Clamp(x - 1, W)));
+                dy += smooth[i + 1] * (gray(Clamp(y + 1, H), Clamp(x + i, W)) - gray(Clamp(y - 1, H), Clamp(x + i, W)));
+            }
+            refx(y, x) = dx;
+            refy(y, x) = dy;
+        }
+    }
+    for (auto b : Backends())
+    {
+        ImageKernel::Sobel(gray, outx, outy, b);
+        ExpectEqual<float>(outx, refx);
+        ExpectEqual<float>(outy, refy);
+    }
+}
+
+TEST(ImageKernels, BoxFilter)
+{
+    auto gray  = RandomGray8();
+    auto grayf = RandomGrayF();
+    TemplatedImage<unsigned char> ref8(H, W), out8(H, W);
+    TemplatedImage<float> reff(H, W), outf(H, W);
+    TemplatedImage<double> grayd(H, W), refd(H, W), outd(H, W);
+    grayf.getImageView().copyTo(grayd.getImageView());
+
+    for (auto border : borders)
+    {
+        for (int radius : {0, 1, 4, 40})
+        {
+            float inv_area = 1.0f / float((2 * radius + 1) * (2 * radius + 1));
+            for (int y = 0; y < H; ++y)
+            {
+                for (int x = 0; x < W; ++x)
+                {
+                    int sum8    = 0;
+                    double sumf = 0;
+                    for (int i = -radius; i <= radius; ++i)
+                    {
+                        for (int j = -radius; j <= radius; ++j)
+                        {
+                            sum8 += Read(gray, y + i, x + j, border);
+                            sumf += Read(grayf, y + i, x + j, border);
+                        }
+                    }
+                    ref8(y, x) = (unsigned char)(float(sum8) * inv_area + 0.5f);
+                    reff(y, x) = sumf * inv_area;
+                    refd(y, x) = sumf / ((2 * radius + 1) * (2 * radius + 1));
+                }
+            }
+
+            for (auto b : Backends())
+            {
+                ImageKernel::BoxFilter(gray, out8, radius, border, b);
+                ExpectEqual<unsigned char>(out8, ref8);
+                ImageKernel::BoxFilter(grayf, outf, radius, border, b);
+                ExpectNear<float>(outf, reff, 1e-3);
+                ImageKernel::BoxFilter(grayd, outd, radius, border, b);
+                ExpectNear<double>(outd, refd, 1e-9);
+            }
+        }
+    }
+}
+
+TEST(ImageKernels, BoxFilterBlocks)
+{
+    // Large enough for the parallel path. Each thread filters one block of rows, the result must not depend on the
+    // number of blocks.
+    int h = 301, w = 257;
+
+    auto gray  = RandomGray8(h, w);
+    auto grayf = RandomGrayF(h, w);
+    TemplatedImage<unsigned char> ref8(h, w), out8(h, w);
+    TemplatedImage<float> reff(h, w), outf(h, w);
+
+    int threads = OMP::getMaxThreads();
+    for (int radius : {1, 20, 70, 200})
+    {
+        OMP::setNumThreads(1);
+        ImageKernel::BoxFilter(gray, ref8, radius, ImageBorder::Mirror);
+        ImageKernel::BoxFilter(grayf, reff, radius, ImageBorder::Mirror);
+        OMP::setNumThreads(5);
+        ImageKernel::BoxFilter(gray, out8, radius, ImageBorder::Mirror);
+        ImageKernel::BoxFilter(grayf, outf, radius, ImageBorder::Mirror);
+        ExpectEqual<unsigned char>(out8, ref8);
+        ExpectNear<float>(outf, reff, 1e-3);
+    }
+    OMP::setNumThreads(threads);
+}
+
+TEST(ImageKernels, GaussianBlur)
+{
+    auto gray  = RandomGray8();
+    auto grayf = RandomGrayF();
+    TemplatedImage<double> grayd(H, W), ref8(H, W), refd(H, W), outd(H, W);
+    TemplatedImage<float> ref(H, W), out(H, W);
+    TemplatedImage<unsigned char> out8(H, W), first8(H, W);
+    grayf.getImageView().copyTo(grayd.getImageView());
+
+    for (auto border : borders)
+    {
+        for (int radius : {1, 3, 6})
+        {
+            float sigma = radius / 2.0f;
+            std::vector<double> kernel(2 * radius + 1);
+            double kernel_sum = 0;
+            for (int i = -radius; i <= radius; ++i)
+            {
+                kernel[i + radius] = std::exp(-(i * i) / (2.0 * sigma * sigma));
+                kernel_sum += kernel[i + radius];
+            }
+
+            for (int y = 0; y < H; ++y)
+            {
+                for (int x = 0; x < W; ++x)
+                {
+                    double sum = 0, sum8 = 0;
+                    for (int i = -radius; i <= radius; ++i)
+                    {
+                        for (int j = -radius; j <= radius; ++j)
+                        {
+                            double k = kernel[i + radius] * kernel[j + radius];
+                            sum += k * Read(grayf, y + i, x + j, border);
+                            sum8 += k * Read(gray, y + i, x + j, border);
+                        }
+                    }
+                    ref(y, x)  = sum / (kernel_sum * kernel_sum);
+                    refd(y, x) = sum / (kernel_sum * kernel_sum);
+                    ref8(y, x) = sum8 / (kernel_sum * kernel_sum);
+                }
+            }
+
+            auto backends = Backends();
+            for (auto b : backends)
+            {
+                ImageKernel::GaussianBlur(grayf, out, radius, sigma, border, b);
+                ExpectNear<float>(out, ref, 1e-3);
+                ImageKernel::GaussianBlur(grayd, outd, radius, sigma, border, b);
+                ExpectNear<double>(outd, refd, 1e-9);
+
+                // 8.8 fixed point. The weights are rounded to multiples of 1/256, on noise images this adds up to 2 to
+                // the rounding error of narrow kernels.
+                ImageKernel::GaussianBlur(gray, out8, radius, sigma, border, b);
+                for (int y = 0; y < H; ++y)
+                {
+                    for (int x = 0; x < W; ++x) ASSERT_LE(std::abs(out8(y, x) - ref8(y, x)), 3.0) << y << " " << x;
+                }
+                if (b == backends.front())
+                    out8.getImageView().copyTo(first8.getImageView());
+                else
+                    ExpectEqual<unsigned char>(out8, first8);
+            }
+        }
+    }
+}
+
+TEST(ImageKernels, Reductions)
+{
+    auto gray1 = RandomGray8();
+    auto gray2 = RandomGray8();
+    auto grayf = RandomGrayF();
+    auto rgb1  = ToRGB(RandomRGBA());
+    auto rgb2  = ToRGB(RandomRGBA());
+
+    long sum8     = 0, l1_8 = 0, l1_rgb = 0;
+    double sumf   = 0;
+    float min_ref = grayf(0, 0), max_ref = grayf(0, 0);
+    for (int y = 0; y < H; ++y)
+    {
+        for (int x = 0; x < W; ++x)
+        {
+            l1_8 += std::abs(gray1(y, x) - gray2(y, x));
+            l1_rgb += (rgb1(y, x).cast<int>() - rgb2(y, x).cast<int>()).array().abs().sum();
+            sum8 += gray1(y, x);
+            sumf += grayf(y, x);
+            min_ref = std::min(min_ref, grayf(y, x));
+            max_ref = std::max(max_ref, grayf(y, x));
+        }
+    }
+
+    std::vector<double> float_sums;
+    for (auto b : Backends())
+    {
+        EXPECT_EQ(ImageKernel::L1Difference(gray1, gray2, b), l1_8);
+        EXPECT_EQ(ImageKernel::L1Difference(rgb1, rgb2, b), l1_rgb);
+        EXPECT_EQ(ImageKernel::Sum(gray1, b), sum8);
+
+        double s = ImageKernel::Sum(grayf, b);
+        EXPECT_NEAR(s, sumf, 1e-5 * sumf);
+        float_sums.push_back(s);
+
+        float min_value, max_value;
+        ImageKernel::MinMax(grayf, min_value, max_value, b);
+        EXPECT_EQ(min_value, min_ref);
+        EXPECT_EQ(max_value, max_ref);
+    }
+
+    // The float sum is deterministic over all backends
+    for (auto s : float_sums) EXPECT_EQ(s, float_sums.front());
+}
+
+}  // namespace Saiga
@@ -120,3 +120,135 @@ TEST(kdtree, RadiusSearch)
         EXPECT_EQ(RadiusSearch(points, sp, r), tree.RadiusSearch(sp, r));
     }
 }
+
+TEST(kdtree, Empty)
+{
+    std::vector<vec3> points;
+    KDT tree(points);
+    EXPECT_EQ(tree.size(), 0);
+    EXPECT_EQ(tree.NearestNeighborSearch(vec3(0, 0, 0)), -1);
+    EXPECT_TRUE(tree.KNearestNeighborSearch(vec3(0, 0, 0), 5).empty());
+    EXPECT_TRUE(tree.RadiusSearch(vec3(0, 0, 0), 1).empty());
+}
+
+TEST(kdtree, LeafSizeAndDuplicates)
+{
+    Random::setSeed(30947643);
+    auto points = RandomPoints(500);
+    // Many identical points force splits with equal coordinates on both sides.
+    for (int i = 0; i < 200; ++i)
+    {
+        points.push_back(points[i % 3]);
+    }
+    auto search_points = RandomPoints(20);
+    search_points.push_back(points[1]);
+
+    for (int leaf_size : {1, 2, 7, 16, 64})
+    {
+        KDT tree(points, leaf_size);
+        EXPECT_EQ(tree.size(), points.size());
+        for (auto sp : search_points)
+        {
+            EXPECT_EQ(NearestNeighborBruteForce(points, sp), tree.NearestNeighborSearch(sp));
+            EXPECT_EQ(KNearestNeighborBruteForce(points, sp, 13), tree.KNearestNeighborSearch(sp, 13));
+            EXPECT_EQ(RadiusSearch(points, sp, 0.3), tree.RadiusSearch(sp, 0.3));
+        }
+    }
+}
+
+TEST(kdtree, KNearestNeighbourBuffer)
+{
+    Random::setSeed(30947643);
+    auto points        = RandomPoints(1000);
+    auto search_points = RandomPoints(10);
+    KDT tree(points);
+
+    // k larger than the number of points
+    std::vector<vec3> few(points.begin(), points.begin() + 5);
+    KDT small_tree(few);
+
+    for (auto sp : search_points)
+    {
+        int k = 10;
+        std::vector<int> indices(k);
+        std::vector<float> dist(k);
+        EXPECT_EQ(tree.KNearestNeighborSearch(sp, k, indices.data(), dist.data()), k);
+        EXPECT_EQ(KNearestNeighborBruteForce(points, sp, k), indices);
+        for (int i = 0; i < k; ++i)
+        {
+            EXPECT_FLOAT_EQ(dist[i], (points[indices[i]] - sp).squaredNorm());
+        }
+
+        EXPECT_EQ(small_tree.KNearestNeighborSearch(sp, k, indices.data(), nullptr), 5);
+        indices.resize(5);
+        EXPECT_EQ(KNearestNeighborBruteForce(few, sp, 5), indices);
+    }
+}
+
+TEST(kdtree, Batched)
+{
+    Random::setSeed(30947643);
+    auto points        = RandomPoints(5000);
+    auto search_points = RandomPoints(1000);
+    int k              = 8;
+    float r            = 0.1;
+    KDT tree(points);
+
+    std::vector<int> nn(search_points.size());
+    std::vector<float> nn_dist(search_points.size());
+    tree.NearestNeighborSearch(search_points, nn, nn_dist);
+
+    std::vector<int> knn(search_points.size() * k);
+    tree.KNearestNeighborSearch(search_points, k, knn);
+
+    auto radius = tree.RadiusSearch(search_points, r);
+
+    for (size_t i = 0; i < search_points.size(); ++i)
+    {
+        auto sp = search_points[i];
+        EXPECT_EQ(NearestNeighborBruteForce(points, sp), nn[i]);
+        EXPECT_FLOAT_EQ((points[nn[i]] - sp).squaredNorm(), nn_dist[i]);
+        EXPECT_EQ(KNearestNeighborBruteForce(points, sp, k),
+                  std::vector<int>(knn.begin() + i * k, knn.begin() + i * k + k));
+        EXPECT_EQ(RadiusSearch(points, sp, r), radius[i]);
+    }
+
+    // Padding with -1 if there are less than k points
+    std::vector<vec3> few(points.begin(), points.begin() + 3);
+    KDT small_tree(few);
+    std::vector<int> small_knn(search_points.size() * k);
+    small_tree.KNearestNeighborSearch(search_points, k, small_knn);
+    for (size_t i = 0; i < search_points.size(); ++i)
+    {
+        for (int j = 3; j < k; ++j)
+        {
+            EXPECT_EQ(small_knn[i * k + j], -1);
+        }
+    }
+
+    // k > max_leaf_size without distance output uses the per thread scratch buffer
+    int large_k = KDT::max_leaf_size + 9;
+    std::vector<int> large_knn(search_points.size() * large_k);
+    tree.KNearestNeighborSearch(search_points, large_k, large_knn);
+    for (size_t i = 0; i < search_points.size(); i += 50)
+    {
+        EXPECT_EQ(KNearestNeighborBruteForce(points, search_points[i], large_k),
+                  std::vector<int>(large_knn.begin() + i * large_k, large_knn.begin() + i * large_k + large_k));
+    }
+}
+
+TEST(kdtree, ParallelBuild)
+{
+    // Large enough to build the subtrees in parallel
+    Random::setSeed(30947643);
+    auto points        = RandomPoints(50000);
+    auto search_points = RandomPoints(20);
+    KDT tree(points);
+
+    for (auto sp : search_points)
+    {
+        EXPECT_EQ(NearestNeighborBruteForce(points, sp), tree.NearestNeighborSearch(sp));
+        EXPECT_EQ(KNearestNeighborBruteForce(points, sp, 10), tree.KNearestNeighborSearch(sp, 10));
+        EXPECT_EQ(RadiusSearch(points, sp, 0.05), tree.RadiusSearch(sp, 0.05));
+    }
+}
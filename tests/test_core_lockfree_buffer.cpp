@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/util/Thread/LockFreeBuffer.h"
+
+#include "gtest/gtest.h"
+
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace Saiga;
+
+template <typename Buffer>
+static void SingleThreadedTest()
+{
+    Buffer buffer(5);
+    EXPECT_EQ(buffer.capacity(), 8);
+    EXPECT_TRUE(buffer.empty());
+
+    // Wrap around a few times
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            EXPECT_TRUE(buffer.tryAdd(i));
+        }
+        EXPECT_FALSE(buffer.tryAdd(8));
+        EXPECT_EQ(buffer.count(), 8);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            int v;
+            EXPECT_TRUE(buffer.tryGet(v));
+            EXPECT_EQ(v, i);
+        }
+        int v;
+        EXPECT_FALSE(buffer.tryGet(v));
+        EXPECT_EQ(buffer.getTimeout(std::chrono::milliseconds(1)), 0);
+    }
+}
+
+TEST(LockFreeBuffer, SingleThreaded)
+{
+    SingleThreadedTest<SPSCBuffer<int>>();
+    SingleThreadedTest<SPMCBuffer<int>>();
+    SingleThreadedTest<MPMCBuffer<int>>();
+}
+
+TEST(LockFreeBuffer, AddOverride)
+{
+    SPMCBuffer<int> buffer(5);
+    for (int i = 0; i < 8; ++i)
+    {
+        EXPECT_TRUE(buffer.tryAdd(i));
+    }
+
+    // Drops 0 and 1
+    EXPECT_TRUE(buffer.addOverride(8));
+    EXPECT_TRUE(buffer.addOverride(9));
+
+    for (int i = 2; i < 10; ++i)
+    {
+        int v;
+        EXPECT_TRUE(buffer.tryGet(v));
+        EXPECT_EQ(v, i);
+    }
+    int v;
+    EXPECT_FALSE(buffer.tryGet(v));
+}
+
+TEST(LockFreeBuffer, SPSCOrder)
+{
+    int n = 200000;
+    SPSCBuffer<int> buffer(64);
+
+    std::thread producer([&]() {
+        for (int i = 0; i < n; ++i) buffer.add(i);
+    });
+
+    for (int i = 0; i < n; ++i)
+    {
+        EXPECT_EQ(buffer.get(), i);
+    }
+    producer.join();
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST(LockFreeBuffer, SPMC)
+{
+    int n         = 100000;
+    int consumers = 3;
+    SPMCBuffer<int> buffer(16);
+
+    std::vector<std::thread> threads;
+    std::vector<long> sums(consumers, 0);
+    threads.emplace_back([&]() {
+        for (int i = 0; i < n * consumers; ++i) buffer.add(i + 1);
+    });
+    for (int c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back([&, c]() {
+            for (int i = 0; i < n; ++i) sums[c] += buffer.get();
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    long total    = std::accumulate(sums.begin(), sums.end(), 0L);
+    long elements = long(consumers) * n;
+    EXPECT_EQ(total, elements * (elements + 1) / 2);
+}
+
+TEST(LockFreeBuffer, MPMC)
+{
+    int n         = 100000;
+    int producers = 4;
+    int consumers = 4;
+    MPMCBuffer<int> buffer(32);
+
+    std::vector<std::thread> threads;
+    std::vector<long> sums(consumers, 0);
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]() {
+            for (int i = 0; i < n; ++i) buffer.add(p * n + i + 1);
+        });
+    }
+    for (int c = 0; c < consumers; ++c)
+    {
+        threads.emplace_back([&, c]() {
+            for (int i = 0; i < n; ++i) sums[c] += buffer.get();
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    long total    = std::accumulate(sums.begin(), sums.end(), 0L);
+    long elements = long(producers) * n;
+    EXPECT_EQ(total, elements * (elements + 1) / 2);
+}
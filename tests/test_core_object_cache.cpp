@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/util/DataStructures/ObjectCache.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+
+using namespace Saiga;
+
+TEST(ObjectCache, PutGet)
+{
+    ObjectCache<std::string, int, int> cache;
+    int value = 0;
+    EXPECT_FALSE(cache.get("a", value));
+
+    cache.put("a", 1);
+    cache.put("a", 2, 5);
+    cache.put("b", 3);
+    EXPECT_TRUE(cache.exists("a"));
+    EXPECT_TRUE(cache.exists("a", 5));
+    EXPECT_FALSE(cache.exists("a", 6));
+
+    EXPECT_TRUE(cache.get("a", value));
+    EXPECT_EQ(value, 1);
+    EXPECT_TRUE(cache.get("a", value, 5));
+    EXPECT_EQ(value, 2);
+
+    // Replace
+    cache.put("a", 4, 5);
+    EXPECT_TRUE(cache.get("a", value, 5));
+    EXPECT_EQ(value, 4);
+
+    EXPECT_TRUE(cache.erase("a"));
+    EXPECT_FALSE(cache.erase("a"));
+    EXPECT_FALSE(cache.exists("a"));
+    EXPECT_TRUE(cache.exists("a", 5));
+
+    int sum = 0;
+    cache.forEach([&](auto&, auto&, auto& v) { sum += v; });
+    EXPECT_EQ(sum, 4 + 3);
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.hits, 3);
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.evictions, 0);
+    EXPECT_EQ(stats.entries, 2);
+    EXPECT_EQ(stats.bytes, 2 * sizeof(int));
+
+    cache.clear();
+    EXPECT_EQ(cache.stats().entries, 0);
+}
+
+TEST(ObjectCache, LRUEviction)
+{
+    // One shard with a budget of 100 bytes
+    ObjectCache<int, std::string> cache(100, [](const std::string& s) { return s.size(); }, 1);
+
+    for (int i = 0; i < 4; ++i) cache.put(i, std::string(30, 'x'));
+    EXPECT_EQ(cache.stats().evictions, 1);
+    EXPECT_FALSE(cache.exists(0));
+
+    // 1 is now the most recently used -> 2 is evicted next
+    std::string s;
+    EXPECT_TRUE(cache.get(1, s));
+    cache.put(4, std::string(30, 'x'));
+    EXPECT_TRUE(cache.exists(1));
+    EXPECT_FALSE(cache.exists(2));
+    EXPECT_TRUE(cache.exists(3));
+    EXPECT_TRUE(cache.exists(4));
+
+    // An object larger than the budget is kept, but everything else is evicted
+    cache.put(5, std::string(200, 'x'));
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.entries, 1);
+    EXPECT_EQ(stats.bytes, 200);
+    EXPECT_EQ(stats.evictions, 5);
+    EXPECT_TRUE(cache.exists(5));
+}
+
+TEST(ObjectCache, MultiThreaded)
+{
+    const int num_threads = 8;
+    const int n           = 10000;
+    ObjectCache<int, int> cache(1000 * sizeof(int));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&, t]() {
+            for (int i = 0; i < n; ++i)
+            {
+                int key   = (i * 7 + t) % 2000;
+                int value = 0;
+                if (cache.get(key, value))
+                {
+                    EXPECT_EQ(value, key * 3);
+                }
+                else
+                {
+                    cache.put(key, key * 3);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.hits + stats.misses, num_threads * n);
+    EXPECT_LE(stats.bytes, 1000 * sizeof(int));
+    EXPECT_EQ(stats.bytes, stats.entries * sizeof(int));
+}
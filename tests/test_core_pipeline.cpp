@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/util/pipeline.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace Saiga;
+
+// A source that produces the numbers [0, n)
+static auto CountingSource(int n)
+{
+    return [n, i = 0](int& out) mutable {
+        if (i >= n) return false;
+        out = i++;
+        return true;
+    };
+}
+
+TEST(ParallelPipeline, Unordered)
+{
+    int n = 1000;
+    std::vector<int> result;
+
+    ParallelPipeline pipeline;
+    pipeline.source<int>("source", CountingSource(n))
+        .map("double", [](int i) { return 2 * i; }, {4, 8})
+        .sink("sink", [&](int v) { result.push_back(v / 2); }, {1, 8});
+    pipeline.start();
+    pipeline.wait();
+
+    ASSERT_EQ(int(result.size()), n);
+    std::sort(result.begin(), result.end());
+    for (int i = 0; i < n; ++i) EXPECT_EQ(result[i], i);
+
+    auto st = pipeline.statistics();
+    ASSERT_EQ(st.size(), 3u);
+    for (auto& s : st) EXPECT_EQ(int(s.items), n);
+}
+
+TEST(ParallelPipeline, Ordered)
+{
+    int n = 500;
+    std::vector<int> result;
+
+    ParallelPipeline pipeline;
+    pipeline.source<int>("source", CountingSource(n))
+        .map(
+            "delay",
+            [](int i) {
+                // Random delays so the workers finish out of order
+                std::this_thread::sleep_for(std::chrono::microseconds((i * 7919) % 200));
+                return i;
+            },
+            {4, 8})
+        .sink("sink", [&](int v) { result.push_back(v); }, {1, 4, true});
+    pipeline.start();
+    pipeline.wait();
+
+    ASSERT_EQ(int(result.size()), n);
+    for (int i = 0; i < n; ++i) EXPECT_EQ(result[i], i);
+}
+
+TEST(ParallelPipeline, OrderedBackpressure)
+{
+    // The first element is very slow. The reorder buffer of the sink must not grow beyond its capacity while the
+    // other workers continue.
+    int n        = 200;
+    int capacity = 4;
+    std::vector<int> result;
+
+    ParallelPipeline pipeline;
+    pipeline.source<int>("source", CountingSource(n))
+        .map(
+            "delay",
+            [](int i) {
+                if (i == 0) std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                return i;
+            },
+            {4, 2})
+        .sink("sink", [&](int v) { result.push_back(v); }, {1, capacity, true});
+    pipeline.start();
+    pipeline.wait();
+
+    ASSERT_EQ(int(result.size()), n);
+    for (int i = 0; i < n; ++i) EXPECT_EQ(result[i], i);
+
+    // The reorder window is the capacity plus the 4 upstream workers
+    auto st = pipeline.statistics();
+    EXPECT_EQ(st.back().queue_capacity, capacity + 4);
+    EXPECT_LE(st.back().max_queue_depth, capacity + 4);
+    EXPECT_LE(st[1].max_queue_depth, 2);
+}
+
+TEST(ParallelPipeline, OrderedAfterUnorderedStages)
+{
+    // Two multi-threaded stages reorder the elements before the ordered sink. The elements behind the slow ones must
+    // not block them in the queues (this deadlocked with a reorder window of queue_size).
+    int n = 200;
+    std::vector<int> result;
+
+    ParallelPipeline pipeline;
+    pipeline.source<int>("source", CountingSource(n))
+        .map(
+            "delay",
+            [](int i) {
+                std::this_thread::sleep_for(std::chrono::microseconds(i % 10 == 0 ? 2000 : (i * 7919) % 100));
+                return i;
+            },
+            {4, 4})
+        .map(
+            "delay2",
+            [](int i) {
+                std::this_thread::sleep_for(std::chrono::microseconds((i * 104729) % 100));
+                return i;
+            },
+            {2, 4})
+        .sink("sink", [&](int v) { result.push_back(v); }, {1, 1, true});
+    pipeline.start();
+    pipeline.wait();
+
+    ASSERT_EQ(int(result.size()), n);
+    for (int i = 0; i < n; ++i) EXPECT_EQ(result[i], i);
+
+    auto st = pipeline.statistics();
+    EXPECT_LE(st.back().max_queue_depth, 1 + 6);
+}
+
+TEST(ParallelPipeline, OrderedMultipleConsumers)
+{
+    // Several workers of an ordered stage. Every element is consumed exactly once.
+    int n = 1000;
+    std::vector<std::atomic<int>> hits(n);
+    for (auto& h : hits) h = 0;
+
+    ParallelPipeline pipeline;
+    pipeline.source<int>("source", CountingSource(n))
+        .map("id", [](int i) { return i; }, {3, 8})
+        .sink("sink", [&](int v) { hits[v]++; }, {3, 4, true});
+    pipeline.start();
+    pipeline.wait();
+
+    for (int i = 0; i < n; ++i) EXPECT_EQ(hits[i].load(), 1);
+}
+
+TEST(ParallelPipeline, Stop)
+{
+    // An infinite source with a blocked, ordered consumer. stop() must return.
+    std::atomic<int> produced = {0};
+    std::atomic<int> consumed = {0};
+
+    ParallelPipeline pipeline;
+    pipeline.source<int>("source",
+                         [&](int& out) {
+                             out = produced++;
+                             return true;
+                         })
+        .map("map", [](int i) { return i; }, {2, 2})
+        .sink(
+            "sink",
+            [&](int) {
+                consumed++;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            },
+            {2, 2, true});
+    pipeline.start();
+    while (consumed.load() < 10) std::this_thread::yield();
+    pipeline.stop();
+
+    // Bounded queues: the source is at most a few elements ahead of the sink.
+    EXPECT_LE(produced.load() - consumed.load(), 16);
+
+    int c = consumed.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_EQ(consumed.load(), c);
+}
+
+TEST(ParallelPipeline, SourceEndsEarly)
+{
+    // Empty source. All stages shut down.
+    int sunk = 0;
+    ParallelPipeline pipeline;
+    pipeline.source<int>("source", [](int&) { return false; })
+        .map("map", [](int i) { return i; }, {4, 4, true})
+        .sink("sink", [&](int) { sunk++; }, {1, 4, true});
+    pipeline.start();
+    pipeline.wait();
+    EXPECT_EQ(sunk, 0);
+}
@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/util/Thread/threadPool.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <numeric>
+#include <vector>
+
+using namespace Saiga;
+
+// Counts the allocations of all threads to check the task recycling.
+static std::atomic<long> num_allocations = {0};
+
+void* operator new(std::size_t size)
+{
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+// The tasks are cache line aligned
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t a = std::size_t(align);
+    if (void* p = std::aligned_alloc(a, (size + a - 1) / a * a)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+TEST(ThreadPool, Enqueue)
+{
+    ThreadPool pool(4);
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 100; ++i)
+    {
+        results.push_back(pool.enqueue([](int a, int b) { return a * b; }, i, 2));
+    }
+    for (int i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(results[i].get(), 2 * i);
+    }
+}
+
+TEST(ThreadPool, EnqueueException)
+{
+    ThreadPool pool(2);
+    auto f = pool.enqueue([]() -> int { throw std::runtime_error("test"); });
+    EXPECT_THROW(f.get(), std::runtime_error);
+
+    // The pool is still usable
+    EXPECT_EQ(pool.enqueue([]() { return 5; }).get(), 5);
+}
+
+TEST(ThreadPool, Execute)
+{
+    ThreadPool pool(4);
+    std::atomic<int> counter = {0};
+    for (int i = 0; i < 1000; ++i) pool.execute([&]() { counter++; });
+    while (counter.load() < 1000) std::this_thread::yield();
+    EXPECT_EQ(counter.load(), 1000);
+}
+
+TEST(ThreadPool, ExecuteRecycle)
+{
+    // The tasks are submitted from a non-worker thread and freed by the workers. They must still be reused.
+    ThreadPool pool(4);
+    std::atomic<int> counter = {0};
+    int rounds = 200, n = 100;
+
+    long before = num_allocations.load();
+    for (int r = 0; r < rounds; ++r)
+    {
+        for (int i = 0; i < n; ++i) pool.execute([&]() { counter++; });
+        while (counter.load() < (r + 1) * n) std::this_thread::yield();
+    }
+    long allocations = num_allocations.load() - before;
+
+    // Only the first tasks and the blocks of the injection queue are allocated.
+    EXPECT_LT(allocations, rounds * n / 4);
+}
+
+TEST(ThreadPool, ExecuteException)
+{
+    ThreadPool pool(2);
+    std::atomic<bool> ran = {false};
+    pool.execute([&]() {
+        ran = true;
+        throw std::runtime_error("test");
+    });
+    pool.quit();
+
+    // The worker did not terminate the program and the exception is forwarded
+    EXPECT_TRUE(ran.load());
+    EXPECT_THROW(pool.rethrowException(), std::runtime_error);
+    EXPECT_NO_THROW(pool.rethrowException());
+}
+
+TEST(ThreadPool, ParallelFor)
+{
+    ThreadPool pool(4);
+    std::vector<int> data(10000, 0);
+    pool.parallel_for(0, int(data.size()), [&](int i) { data[i] += i; });
+    for (int i = 0; i < int(data.size()); ++i)
+    {
+        ASSERT_EQ(data[i], i);
+    }
+}
+
+TEST(ThreadPool, ParallelReduce)
+{
+    ThreadPool pool(4);
+    int n    = 100000;
+    long sum = pool.parallel_reduce(
+        0, n, 0L, [](int i) { return long(i); }, [](long a, long b) { return a + b; });
+    EXPECT_EQ(sum, long(n) * (n - 1) / 2);
+
+    // bool results are written by different workers to neighbouring chunks (was a data race with
+    // std::vector<bool>).
+    for (int grain : {1, 7, 64})
+    {
+        bool all_even = pool.parallel_reduce(
+            0, n, true, [](int i) { return (2 * i) % 2 == 0; }, [](bool a, bool b) { return a && b; }, grain);
+        EXPECT_TRUE(all_even);
+        bool any_large = pool.parallel_reduce(
+            0, n, false, [n](int i) { return i == n - 1; }, [](bool a, bool b) { return a || b; }, grain);
+        EXPECT_TRUE(any_large);
+    }
+}
+
+TEST(ThreadPool, NestedGroups)
+{
+    ThreadPool pool(4);
+    std::atomic<int> counter = {0};
+    pool.parallel_for(0, 16, [&](int) { pool.parallel_for(0, 100, [&](int) { counter++; }); });
+    EXPECT_EQ(counter.load(), 1600);
+}
+
+TEST(ThreadPool, GroupException)
+{
+    ThreadPool pool(4);
+    TaskGroup group(pool);
+    for (int i = 0; i < 10; ++i)
+    {
+        group.run([i]() {
+            if (i == 5) throw std::runtime_error("test");
+        });
+    }
+    EXPECT_THROW(group.wait(), std::runtime_error);
+}
+
+TEST(ThreadPool, EmptyPool)
+{
+    // Without workers all tasks are executed in the calling thread
+    ThreadPool pool(0);
+    EXPECT_EQ(pool.enqueue([]() { return 3; }).get(), 3);
+    int sum = pool.parallel_reduce(
+        0, 10, 0, [](int i) { return i; }, [](int a, int b) { return a + b; });
+    EXPECT_EQ(sum, 45);
+}
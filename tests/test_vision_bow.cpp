@@ -10,6 +10,7 @@
 #include "saiga/vision/VisionTypes.h"
 #include "saiga/vision/slam/MiniBow.h"
 #include "saiga/vision/slam/MiniBow2.h"
+#include "saiga/vision/slam/MiniBow2Database.h"
 #include "saiga/vision/util/Random.h"
 
 #include "gtest/gtest.h"
@@ -291,4 +292,99 @@ TEST(BoW, Orb)
     //    auto stat = measureObject(50, [&]() { orbVoc2.transform(features.front(), bv2, fv2, 4, 4); });
     //    std::cout << stat << std::endl;
 }
+// Random sparse bow vector. Low word ids are more likely to create long inverted lists.
+static MiniBow2::BowVector RandomBowVector(int num_words, int words_per_image)
+{
+    std::vector<std::pair<MiniBow2::WordId, MiniBow2::WordValue>> words;
+    for (int i = 0; i < words_per_image; ++i)
+    {
+        double u = Random::sampleDouble(0, 1);
+        words.emplace_back(int(num_words * u * u), Random::sampleDouble(0.1, 1));
+    }
+    MiniBow2::BowVector v;
+    v.set(words);
+    return v;
+}
+
+TEST(BoW, Database)
+{
+    const int num_words = 2000;
+    MiniBow2::BowDatabase db(true);
+
+    std::vector<MiniBow2::BowVector> bows;
+    for (int i = 0; i < 500; ++i)
+    {
+        bows.push_back(RandomBowVector(num_words, 100));
+        MiniBow2::FeatureVector fv;
+        fv.push_back({i, {i, i + 1}});
+        EXPECT_EQ(db.add(bows.back(), fv), i);
+    }
+
+    // Remove every third entry
+    for (int i = 0; i < (int)bows.size(); i += 3) db.remove(i);
+    EXPECT_EQ(db.size(), 500 - 167);
+    EXPECT_FALSE(db.contains(0));
+    EXPECT_TRUE(db.contains(1));
+
+    auto check_query = [&](const MiniBow2::BowDatabase& db, const MiniBow2::BowVector& q, int k) {
+        // Reference: linear scoring against every active entry
+        std::vector<MiniBow2::QueryResult> ref;
+        for (int i = 0; i < (int)bows.size(); ++i)
+        {
+            if (i % 3 == 0) continue;
+            auto score = MiniBow2::FeatureVector::score(q, bows[i]);
+            if (score > 0) ref.push_back({i, score});
+        }
+        std::sort(ref.begin(), ref.end(),
+                  [](auto& a, auto& b) { return a.score > b.score || (a.score == b.score && a.id < b.id); });
+
+        auto result = db.query(q, k);
+        ASSERT_EQ(result.size(), std::min<size_t>(k, ref.size()));
+        for (int i = 0; i < (int)result.size(); ++i)
+        {
+            EXPECT_EQ(result[i].id, ref[i].id);
+            EXPECT_FLOAT_EQ(result[i].score, ref[i].score);
+        }
+    };
+
+    for (int i = 0; i < 20; ++i)
+    {
+        check_query(db, RandomBowVector(num_words, 100), 10);
+    }
+
+    // The entry itself is the best match with score 1
+    auto self = db.query(bows[5], 1);
+    ASSERT_EQ(self.size(), 1);
+    EXPECT_EQ(self[0].id, 5);
+    EXPECT_NEAR(self[0].score, 1, 1e-5);
+    EXPECT_EQ(db.getFeatureVector(5).front().second, std::vector<int>({5, 6}));
+
+    // Concurrent queries
+    std::vector<MiniBow2::BowVector> queries;
+    for (int i = 0; i < 64; ++i) queries.push_back(RandomBowVector(num_words, 100));
+    std::vector<std::vector<MiniBow2::QueryResult>> results(queries.size());
+#pragma omp parallel for num_threads(4)
+    for (int i = 0; i < (int)queries.size(); ++i)
+    {
+        results[i] = db.query(queries[i], 5);
+    }
+
+    db.saveRaw("test.bowdb");
+    MiniBow2::BowDatabase db2;
+    db2.loadRaw("test.bowdb");
+    EXPECT_TRUE(db2.usingDirectIndex());
+    EXPECT_EQ(db2.size(), db.size());
+    EXPECT_EQ(db2.getFeatureVector(5), db.getFeatureVector(5));
+    for (int i = 0; i < (int)queries.size(); ++i)
+    {
+        auto r = db2.query(queries[i], 5);
+        ASSERT_EQ(r.size(), results[i].size());
+        for (int j = 0; j < (int)r.size(); ++j)
+        {
+            EXPECT_EQ(r[j].id, results[i][j].id);
+            EXPECT_EQ(r[j].score, results[i][j].score);
+        }
+        check_query(db2, queries[i], 5);
+    }
+}
 }  // namespace Saiga
@@ -12,6 +12,7 @@
 #include "saiga/vision/recursive/BAPointOnly.h"
 #include "saiga/vision/recursive/BARecursive.h"
 #include "saiga/vision/recursive/BARecursiveRel.h"
+#include "saiga/vision/scene/BinarySceneFile.h"
 #include "saiga/vision/scene/SynteticScene.h"
 //#include "saiga/vision/scene/SynteticScene.h"
 
@@ -20,6 +21,8 @@
 
 #include "compare_numbers.h"
 
+#include <fstream>
+
 namespace Saiga
 {
 class BundleAdjustmentTest
@@ -51,6 +54,18 @@ class BundleAdjustmentTest
         return cpy;
     }
 
+    Scene solveRecFloat(const BAOptions& options)
+    {
+        Scene cpy = scene;
+        BARecFloat ba;
+        ba.optimizationOptions                 = opoptions;
+        ba.optimizationOptions.refinementSteps = 1;
+        ba.baOptions                           = options;
+        ba.create(cpy);
+        ba.initAndSolve();
+        return cpy;
+    }
+
     Scene solveRecRel(const BAOptions& options)
     {
         Scene cpy = scene;
@@ -79,6 +94,19 @@ class BundleAdjustmentTest
         return cpy;
     }
 
+    // The complete optimization runs inside the parallel region of LMOptimizer::solveOMP.
+    Scene solveRecParallelRegion(const BAOptions& options)
+    {
+        Scene cpy = scene;
+        BARec ba;
+        ba.optimizationOptions = opoptions;
+        ba.baOptions           = options;
+        ba.create(cpy);
+        ba.initOMP();
+        ba.solveOMP();
+        return cpy;
+    }
+
     Scene solveCeres(const BAOptions& options)
     {
         Scene cpy = scene;
@@ -230,6 +258,175 @@ TEST(Scene, LoadStore)
     }
 }
 
+TEST(Scene, LoadStoreBinary)
+{
+    Scene scene = SynteticScene::CircleSphere(2500, 65, 250);
+    scene.images[1].constant               = true;
+    scene.images[2].stereoPoints[0].depth  = 2.5;
+    scene.images[2].stereoPoints[0].weight = 0.5;
+    scene.saveBinary("test.sceneb");
+
+    BinarySceneFileView view;
+    ASSERT_TRUE(view.open("test.sceneb"));
+    EXPECT_EQ(view.images().size(), scene.images.size());
+    EXPECT_TRUE(view.validate());
+
+    // load() detects the binary format
+    Scene scene2;
+    scene2.load("test.sceneb");
+
+    EXPECT_EQ(scene.intrinsics.size(), scene2.intrinsics.size());
+    ASSERT_EQ(scene.images.size(), scene2.images.size());
+    ASSERT_EQ(scene.worldPoints.size(), scene2.worldPoints.size());
+    EXPECT_EQ(scene.chi2(), scene2.chi2());
+
+    for (int i = 0; i < (int)scene.worldPoints.size(); ++i)
+    {
+        EXPECT_EQ(scene.worldPoints[i].p, scene2.worldPoints[i].p);
+    }
+
+    for (int i = 0; i < (int)scene.images.size(); ++i)
+    {
+        EXPECT_EQ(scene.images[i].se3.params(), scene2.images[i].se3.params());
+        EXPECT_EQ(scene.images[i].constant, scene2.images[i].constant);
+        EXPECT_EQ(scene.images[i].intr, scene2.images[i].intr);
+        ASSERT_EQ(scene.images[i].stereoPoints.size(), scene2.images[i].stereoPoints.size());
+
+        for (int j = 0; j < (int)scene.images[i].stereoPoints.size(); ++j)
+        {
+            auto& ip1 = scene.images[i].stereoPoints[j];
+            auto& ip2 = scene2.images[i].stereoPoints[j];
+            EXPECT_EQ(ip1.wp, ip2.wp);
+            EXPECT_EQ(ip1.point, ip2.point);
+            EXPECT_EQ(ip1.depth, ip2.depth);
+            EXPECT_EQ(ip1.weight, ip2.weight);
+        }
+    }
+}
+
+
+TEST(Scene, BinaryObservationCountOverflow)
+{
+    Scene scene = SynteticScene::CircleSphere(2500, 65, 250);
+    scene.saveBinary("test_overflow.sceneb");
+
+    BinarySceneHeader header;
+    std::vector<BinarySceneImage> imgs;
+    {
+        BinarySceneFileView view;
+        ASSERT_TRUE(view.open("test_overflow.sceneb"));
+        ASSERT_TRUE(view.validate());
+        header = view.header();
+        imgs.assign(view.images().begin(), view.images().end());
+    }
+    ASSERT_GE(imgs.size(), 3u);
+
+    // Craft counts that wrap around 2^64 but still sum up to the correct number of observations.
+    uint64_t n01              = imgs[0].num_observations + imgs[1].num_observations;
+    imgs[0].num_observations  = std::numeric_limits<uint64_t>::max();
+    imgs[1].first_observation = std::numeric_limits<uint64_t>::max();
+    imgs[1].num_observations  = n01 + 1;
+    {
+        std::fstream strm("test_overflow.sceneb", std::ios::in | std::ios::out | std::ios::binary);
+        strm.seekp(header.images_offset);
+        strm.write(reinterpret_cast<const char*>(imgs.data()), imgs.size() * sizeof(BinarySceneImage));
+    }
+
+    BinarySceneFileView view;
+    ASSERT_TRUE(view.open("test_overflow.sceneb"));
+    EXPECT_FALSE(view.validate());
+}
+
+
+TEST(Scene, Observations)
+{
+    Scene scene                             = SynteticScene::CircleSphere(2500, 65, 250);
+    scene.images[2].stereoPoints[0].depth   = 2.5;
+    scene.images[3].stereoPoints[1].wp      = -1;
+    scene.images[4].stereoPoints[2].outlier = true;
+    scene.addImagePointNoise(0.5);
+    scene.fixWorldPointReferences();
+
+    SceneObservations obs;
+    obs.build(scene);
+    ASSERT_EQ(obs.numImages(), (int)scene.images.size());
+
+    // The point-major index lists every observation once, grouped by world point and sorted by image
+    ASSERT_EQ(obs.point_offset.size(), scene.worldPoints.size() + 1);
+    ASSERT_EQ((int)obs.point_observations.size(), obs.size());
+    for (int j = 0; j < (int)scene.worldPoints.size(); ++j)
+    {
+        for (int k = obs.point_offset[j]; k < obs.point_offset[j + 1]; ++k)
+        {
+            int o = obs.point_observations[k];
+            EXPECT_EQ(obs.wp[o], j);
+            if (k > obs.point_offset[j]) EXPECT_LT(obs.image[obs.point_observations[k - 1]], obs.image[o]);
+        }
+    }
+
+    // Reference: per image sum over the image points
+    double ref_chi2 = 0;
+    int edges       = 0;
+    for (auto& img : scene.images)
+    {
+        double image_error = 0;
+        for (auto& ip : img.stereoPoints)
+        {
+            if (!ip) continue;
+            image_error += scene.residualNorm2(img, ip);
+            edges++;
+        }
+        ref_chi2 += image_error;
+    }
+    EXPECT_EQ(scene.chi2(obs), ref_chi2);
+    EXPECT_EQ(scene.chi2(), ref_chi2);
+    EXPECT_EQ(scene.rms(obs), scene.rms());
+    EXPECT_DOUBLE_EQ(scene.rms(), sqrt(ref_chi2 / edges));
+    EXPECT_LT(scene.chi2(obs, 1.0), ref_chi2);
+
+    // build() + apply() restores the image points
+    Scene cpy = scene;
+    for (auto& img : cpy.images)
+    {
+        for (auto& ip : img.stereoPoints)
+        {
+            if (ip.wp == -1) continue;
+            ip.point   = Vec2(-1, -1);
+            ip.depth   = -1;
+            ip.weight  = -1;
+            ip.outlier = true;
+        }
+    }
+    obs.apply(cpy);
+    EXPECT_EQ(cpy.chi2(), scene.chi2());
+    for (int i = 0; i < (int)scene.images.size(); ++i)
+    {
+        for (int j = 0; j < (int)scene.images[i].stereoPoints.size(); ++j)
+        {
+            auto& ip1 = scene.images[i].stereoPoints[j];
+            auto& ip2 = cpy.images[i].stereoPoints[j];
+            EXPECT_EQ(ip1.wp, ip2.wp);
+            if (ip1.wp == -1) continue;
+            EXPECT_EQ(ip1.point, ip2.point);
+            EXPECT_EQ(ip1.depth, ip2.depth);
+            EXPECT_EQ(ip1.weight, ip2.weight);
+            EXPECT_EQ(ip1.outlier, ip2.outlier);
+        }
+    }
+
+    // compress() renumbers the world points through the observations
+    scene.removeWorldPoint(0);
+    scene.removeWorldPoint(17);
+    double chi2_before = scene.chi2();
+    auto valid_points  = scene.validPoints();
+    Vec3 first_point   = scene.worldPoints[valid_points.front()].p;
+    EXPECT_LT(valid_points.size(), scene.worldPoints.size());
+    scene.compress();
+    EXPECT_EQ(scene.worldPoints.size(), valid_points.size());
+    EXPECT_EQ(scene.worldPoints[0].p, first_point);
+    EXPECT_TRUE(scene.valid());
+    EXPECT_EQ(scene.chi2(), chi2_before);
+}
 
 TEST(BundleAdjustment, Empty)
 {
@@ -296,6 +493,37 @@ TEST(BundleAdjustment, DefaultParallel)
     //    exit(0);
 }
 
+TEST(BundleAdjustment, ParallelRegion)
+{
+    BundleAdjustmentTest test;
+    test.buildScene(false);
+    test.opoptions.numThreads = 8;
+
+    BAOptions options;
+    auto ref1 = test.solveRec(options);
+    auto ref2 = test.solveRecParallelRegion(options);
+    ExpectClose(ref1.chi2(), ref2.chi2(), 1e-1);
+
+    // Direct solver inside the parallel region
+    test.opoptions.solverType = OptimizationOptions::SolverType::Direct;
+    auto ref3                 = test.solveRecParallelRegion(options);
+    ExpectClose(ref1.chi2(), ref3.chi2(), 1e-1);
+}
+
+
+TEST(BundleAdjustment, Float)
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        BundleAdjustmentTest test;
+        test.buildScene(false);
+        BAOptions options;
+        auto scene1 = test.solveRec(options);
+        auto scene2 = test.solveRecFloat(options);
+        std::cout << test.scene.chi2() << " -> (double) " << scene1.chi2() << " (float) " << scene2.chi2() << std::endl;
+        ExpectClose(scene1.chi2(), scene2.chi2(), 1e-1);
+    }
+}
 
 TEST(BundleAdjustment, DefaultDepth)
 {
@@ -0,0 +1,209 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/vision/camera/CameraBase.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace Saiga
+{
+// Frame i has a 1x1 image with the value i. Every load takes 'delay_ms', the frames in 'slow_frames' take 10 times
+// longer.
+class TestDataset : public DatasetCameraBase
+{
+   public:
+    TestDataset(const DatasetParameters& params, int num_frames, int delay_ms)
+        : DatasetCameraBase(params), num_frames(num_frames), delay_ms(delay_ms)
+    {
+        camera_type = CameraInputType::Mono;
+        Load();
+    }
+    ~TestDataset()
+    {
+        close();
+        EXPECT_EQ(running.load(), 0);
+        destroyed = true;
+    }
+
+    int LoadMetaData() override
+    {
+        frames.resize(num_frames);
+        for (int i = 0; i < num_frames; ++i)
+        {
+            frames[i].id        = i;
+            frames[i].timeStamp = i;
+        }
+        return num_frames;
+    }
+
+    void LoadImageData(FrameData& data) override
+    {
+        EXPECT_FALSE(destroyed);
+        running++;
+        bool slow = std::find(slow_frames.begin(), slow_frames.end(), data.id) != slow_frames.end();
+        std::this_thread::sleep_for(std::chrono::milliseconds(slow ? 10 * delay_ms : delay_ms));
+        data.image.create(1, 1);
+        data.image(0, 0) = data.id;
+        loads++;
+        running--;
+    }
+
+    int num_frames;
+    int delay_ms;
+    std::vector<int> slow_frames;
+    std::atomic<int> running    = {0};
+    std::atomic<int> loads      = {0};
+    std::atomic<bool> destroyed = {false};
+};
+
+static DatasetParameters PrefetchParams(int window, int threads)
+{
+    DatasetParameters params;
+    params.playback_fps     = 1000000;
+    params.preload          = false;
+    params.prefetch_window  = window;
+    params.prefetch_threads = threads;
+    return params;
+}
+
+// Polls 'f' for at most one second.
+template <typename F>
+static bool WaitFor(F f)
+{
+    for (int i = 0; i < 1000 && !f(); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return f();
+}
+
+TEST(DatasetPrefetch, Sequential)
+{
+    int n = 30;
+    TestDataset dataset(PrefetchParams(4, 2), n, 1);
+
+    FrameData data;
+    for (int i = 0; i < n; ++i)
+    {
+        ASSERT_TRUE(dataset.getImageSync(data));
+        EXPECT_EQ(data.id, i);
+        ASSERT_EQ(data.image.h, 1);
+        EXPECT_EQ(data.image(0, 0), i);
+        EXPECT_LE(dataset.NumPrefetchedFrames(), 4);
+    }
+    EXPECT_FALSE(dataset.getImageSync(data));
+    EXPECT_EQ(dataset.loads.load(), n);
+
+    // Random access after the end
+    ASSERT_TRUE(dataset.GetFrame(5, data));
+    EXPECT_EQ(data.image(0, 0), 5);
+}
+
+TEST(DatasetPrefetch, Seek)
+{
+    TestDataset dataset(PrefetchParams(4, 4), 30, 10);
+    dataset.slow_frames = {1, 2, 3};
+
+    // Frames 1, 2, 3 are still loading after this call
+    FrameData data;
+    ASSERT_TRUE(dataset.getImageSync(data));
+    EXPECT_EQ(data.id, 0);
+
+    dataset.Seek(10);
+    ASSERT_TRUE(dataset.getImageSync(data));
+    EXPECT_EQ(data.id, 10);
+    EXPECT_EQ(data.image(0, 0), 10);
+
+    // The late loads of 1, 2, 3 are dropped. Only 11, 12, 13 remain.
+    EXPECT_TRUE(WaitFor([&]() { return dataset.NumPrefetchedFrames() <= 3; }));
+    EXPECT_TRUE(WaitFor([&]() { return dataset.running.load() == 0; }));
+    EXPECT_EQ(dataset.NumPrefetchedFrames(), 3);
+
+    // A cancelled frame can be requested again
+    ASSERT_TRUE(dataset.GetFrame(2, data));
+    EXPECT_EQ(data.image(0, 0), 2);
+
+    ASSERT_TRUE(dataset.getImageSync(data));
+    EXPECT_EQ(data.id, 11);
+}
+
+TEST(DatasetPrefetch, SeekBack)
+{
+    // Seek away and back while the frames are loading. The pending loads are used again.
+    TestDataset dataset(PrefetchParams(4, 1), 30, 10);
+    FrameData data;
+    ASSERT_TRUE(dataset.getImageSync(data));
+    dataset.Seek(20);
+    dataset.Seek(1);
+    for (int i = 1; i < 6; ++i)
+    {
+        ASSERT_TRUE(dataset.getImageSync(data));
+        EXPECT_EQ(data.id, i);
+        EXPECT_EQ(data.image(0, 0), i);
+    }
+}
+
+TEST(DatasetPrefetch, SeekDuringGetFrame)
+{
+    // Seek cancels and evicts the frames that GetFrame is waiting for. GetFrame loads them again.
+    TestDataset dataset(PrefetchParams(4, 2), 30, 2);
+    std::atomic<bool> done = {false};
+    std::thread seeker([&]() {
+        for (int i = 0; !done; i = (i + 7) % 30)
+        {
+            dataset.Seek(i);
+        }
+    });
+
+    FrameData data;
+    for (int k = 0; k < 100; ++k)
+    {
+        int index = (k * 13) % 30;
+        ASSERT_TRUE(dataset.GetFrame(index, data));
+        EXPECT_EQ(data.id, index);
+        EXPECT_EQ(data.image(0, 0), index);
+    }
+    done = true;
+    seeker.join();
+}
+
+TEST(DatasetPrefetch, EarlyClose)
+{
+    // The consumer stops after one frame. The dataset is destroyed while the other frames are loading.
+    for (int threads : {1, 4})
+    {
+        int loads;
+        {
+            TestDataset dataset(PrefetchParams(16, threads), 30, 10);
+            FrameData data;
+            ASSERT_TRUE(dataset.getImageSync(data));
+            EXPECT_EQ(data.image(0, 0), 0);
+            dataset.close();
+            loads = dataset.loads;
+
+            // Synchronous load after close
+            ASSERT_TRUE(dataset.getImageSync(data));
+            EXPECT_EQ(data.id, 1);
+            EXPECT_EQ(data.image(0, 0), 1);
+        }
+        // Loads that have not started are cancelled
+        EXPECT_LT(loads, 16);
+    }
+
+    // Destroyed without close() by the consumer
+    for (int i = 0; i < 5; ++i)
+    {
+        TestDataset dataset(PrefetchParams(8, 4), 30, 5);
+        FrameData data;
+        ASSERT_TRUE(dataset.getImageSync(data));
+    }
+}
+
+}  // namespace Saiga
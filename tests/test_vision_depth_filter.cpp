@@ -0,0 +1,307 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/math/random.h"
+#include "saiga/vision/util/DepthmapPreprocessor.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+
+namespace Saiga
+{
+// Slanted plane with a depth step and a few holes.
+static TemplatedImage<float> TestDepth(int h, int w)
+{
+    TemplatedImage<float> img(h, w);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            float d   = 1.0f + 0.01f * x + 0.005f * y + (x > w / 2 ? 1.0f : 0.0f);
+            img(y, x) = d + Random::sampleDouble(-0.01, 0.01);
+            if (Random::sampleBool(0.05)) img(y, x) = 0;
+        }
+    }
+    return img;
+}
+
+// The original implementation: gaussian in x-direction, then in y-direction on the result.
+// Each direction stops at the first broken pixel.
+static TemplatedImage<float> ReferenceGaussian(ImageView<const float> input, int radius, float sigma)
+{
+    auto filter_dir = [&](ImageView<const float> src, ImageView<float> dst, int dx, int dy) {
+        for (int y = 0; y < src.h; ++y)
+        {
+            for (int x = 0; x < src.w; ++x)
+            {
+                if (src(y, x) == 0)
+                {
+                    dst(y, x) = 0;
+                    continue;
+                }
+                double value = src(y, x), weights = 1;
+                for (int side : {-1, 1})
+                {
+                    for (int j = 1; j <= radius; ++j)
+                    {
+                        int sx = x + side * j * dx, sy = y + side * j * dy;
+                        if (!src.inImage(sy, sx) || src(sy, sx) == 0) break;
+                        double wj = std::exp(-(j * j) / (2.0 * sigma * sigma));
+                        value += wj * src(sy, sx);
+                        weights += wj;
+                    }
+                }
+                dst(y, x) = value / weights;
+            }
+        }
+    };
+
+    TemplatedImage<float> temp(input.h, input.w), result(input.h, input.w);
+    filter_dir(input, temp, 1, 0);
+    filter_dir(temp, result, 0, 1);
+    return result;
+}
+
+TEST(DepthFilter, GaussianReference)
+{
+    auto input = TestDepth(53, 71);
+    for (int radius : {1, 3, 4})
+    {
+        DepthFilter filter;
+        filter.params.radius = radius;
+        TemplatedImage<float> output(input.h, input.w);
+        filter.Filter(input, output);
+
+        auto ref = ReferenceGaussian(input, radius, filter.params.sigma_spatial);
+        for (int y = 0; y < input.h; ++y)
+        {
+            for (int x = 0; x < input.w; ++x)
+            {
+                ASSERT_NEAR(output(y, x), ref(y, x), 1e-4);
+                // Broken pixels stay broken
+                EXPECT_EQ(input(y, x) == 0, output(y, x) == 0);
+            }
+        }
+    }
+}
+
+TEST(DepthFilter, InPlace)
+{
+    auto input = TestDepth(40, 37);
+    for (auto mode : {DepthFilterMode::Gaussian, DepthFilterMode::Bilateral})
+    {
+        DepthFilter filter;
+        filter.params.mode = mode;
+        TemplatedImage<float> output(input.h, input.w);
+        filter.Filter(input, output);
+
+        auto inplace = input;
+        filter.Filter(inplace, inplace);
+        for (int y = 0; y < input.h; ++y)
+        {
+            for (int x = 0; x < input.w; ++x)
+            {
+                EXPECT_EQ(output(y, x), inplace(y, x));
+            }
+        }
+    }
+}
+
+TEST(DepthFilter, Constant)
+{
+    TemplatedImage<float> input(20, 30), output(20, 30), guide(20, 30);
+    input.getImageView().set(2.5f);
+    for (int y = 0; y < guide.h; ++y)
+    {
+        for (int x = 0; x < guide.w; ++x) guide(y, x) = x * 10;
+    }
+
+    for (auto mode : {DepthFilterMode::Gaussian, DepthFilterMode::Bilateral, DepthFilterMode::JointBilateral})
+    {
+        DepthFilter filter;
+        filter.params.mode = mode;
+        filter.Filter(input, output, guide);
+        for (int y = 0; y < input.h; ++y)
+        {
+            for (int x = 0; x < input.w; ++x)
+            {
+                EXPECT_NEAR(output(y, x), 2.5f, 1e-5);
+            }
+        }
+    }
+}
+
+TEST(DepthFilter, EdgePreserving)
+{
+    // Depth step of 0.5m. The gaussian filter smooths the edge, the bilateral filters keep it.
+    int h = 16, w = 32;
+    TemplatedImage<float> input(h, w), output(h, w), guide(h, w);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            input(y, x) = x < w / 2 ? 1.0f : 1.5f;
+            guide(y, x) = x < w / 2 ? 50.0f : 200.0f;
+        }
+    }
+
+    auto edge_error = [&]() { return std::abs(output(h / 2, w / 2 - 1) - 1.0f); };
+
+    DepthFilter filter;
+    filter.Filter(input, output);
+    EXPECT_GT(edge_error(), 0.05);
+
+    filter.params.mode = DepthFilterMode::Bilateral;
+    filter.Filter(input, output);
+    EXPECT_LT(edge_error(), 1e-3);
+
+    filter.params.mode = DepthFilterMode::JointBilateral;
+    filter.Filter(input, output, guide);
+    EXPECT_LT(edge_error(), 1e-3);
+}
+
+// The original occlusion edge removal of DepthProcessor2: median disparity by a full sort and the hysteresis by
+// repeated sweeps over the image until nothing changes. The aspect ratios are computed as in the current code.
+static void ReferenceOcclusionEdges(ImageView<float> depth, const DepthProcessor2::Settings& settings)
+{
+    int height   = depth.h;
+    int width    = depth.w;
+    float broken = settings.broken_values;
+
+    TemplatedImage<vec3> image(height, width);
+    TemplatedImage<float> disparity(height, width), p(height, width), quad_p(height - 1, width - 1);
+    std::vector<float> disparities;
+    for (int h = 0; h < height; ++h)
+    {
+        for (int w = 0; w < width; ++w)
+        {
+            image(h, w)     = settings.cameraParameters.unproject(vec2(w + 0.5f, h + 0.5f), depth(h, w));
+            disparity(h, w) = depth(h, w) == broken ? 0 : settings.cameraParameters.bf / depth(h, w);
+            if (depth(h, w) != broken) disparities.push_back(disparity(h, w));
+        }
+    }
+    std::sort(disparities.begin(), disparities.end());
+    int n        = disparities.size();
+    float median = n % 2 == 0 ? (disparities[n / 2 - 1] + disparities[n / 2]) / 2 : disparities[n / 2];
+
+    auto aspect = [](float a, float b, float c) { return std::max({a, b, c}) / std::min({a, b, c}); };
+    for (int h = 0; h < height - 1; ++h)
+    {
+        for (int w = 0; w < width - 1; ++w)
+        {
+            vec3 lu = image(h, w), ru = image(h, w + 1), ld = image(h + 1, w), rd = image(h + 1, w + 1);
+            if (lu[2] == broken || ru[2] == broken || ld[2] == broken || rd[2] == broken)
+            {
+                quad_p(h, w) = broken;
+                continue;
+            }
+            float up = (lu - ru).norm(), right = (ru - rd).norm(), down = (rd - ld).norm(), left = (ld - lu).norm();
+            float d0 = (lu - rd).norm(), d1 = (ru - ld).norm();
+            quad_p(h, w) = std::min(std::max(aspect(left, down, d0), aspect(right, up, d0)),
+                                    std::max(aspect(left, up, d1), aspect(right, down, d1)));
+        }
+    }
+    for (int h = 1; h < height - 1; ++h)
+    {
+        for (int w = 1; w < width - 1; ++w)
+        {
+            float q[4] = {quad_p(h - 1, w - 1), quad_p(h, w - 1), quad_p(h - 1, w), quad_p(h, w)};
+            if (std::find(q, q + 4, broken) != q + 4)
+            {
+                p(h, w) = broken;
+                continue;
+            }
+            p(h, w) = std::max({q[0], q[1], q[2], q[3]}) * std::min(2.0f, std::max(0.5f, disparity(h, w) / median));
+        }
+    }
+
+    std::vector<bool> sure(height * width, false);
+    for (int h = 1; h < height - 1; ++h)
+    {
+        for (int w = 1; w < width - 1; ++w)
+        {
+            if (p(h, w) >= settings.hyst_max || p(h, w) == broken)
+            {
+                depth(h, w)         = broken;
+                sure[h * width + w] = true;
+            }
+        }
+    }
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int h = 1; h < height - 1; ++h)
+        {
+            for (int w = 1; w < width - 1; ++w)
+            {
+                if (sure[h * width + w] || !(p(h, w) > settings.hyst_min && p(h, w) < settings.hyst_max)) continue;
+                bool neighbour = false;
+                for (int y = h - 1; y <= h + 1; ++y)
+                {
+                    for (int x = w - 1; x <= w + 1; ++x) neighbour = neighbour || sure[y * width + x];
+                }
+                if (neighbour)
+                {
+                    depth(h, w)         = broken;
+                    sure[h * width + w] = true;
+                    changed             = true;
+                }
+            }
+        }
+    }
+}
+
+TEST(DepthProcessor, OcclusionEdgesReference)
+{
+    // Overlapping boxes at different depths on a slanted background. Odd and even numbers of valid pixels test both
+    // cases of the median.
+    for (auto [h, w] : {std::pair<int, int>{60, 81}, std::pair<int, int>{61, 80}})
+    {
+        TemplatedImage<float> input(h, w);
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+            {
+                float d = 3.0f + 0.01f * x;
+                if (x > 10 && x < 40 && y > 5 && y < 35) d = 1.5f + 0.02f * y;
+                if (x > 30 && x < 70 && y > 25 && y < 55) d = 0.8f;
+                input(y, x) = d + Random::sampleDouble(-0.005, 0.005);
+                if (Random::sampleBool(0.02)) input(y, x) = 0;
+            }
+        }
+
+        DepthProcessor2::Settings settings;
+        settings.cameraParameters = StereoCamera4Base<float>(500, 500, w / 2, h / 2, 0, 40);
+        // Low thresholds, so that many pixels are unsure and the hysteresis propagates over long chains
+        for (auto [hyst_min, hyst_max] : {std::pair<float, float>{12, 23}, {1.5, 6}, {1.05, 3}})
+        {
+            settings.hyst_min = hyst_min;
+            settings.hyst_max = hyst_max;
+
+            auto output = input;
+            DepthProcessor2 processor(settings);
+            processor.remove_occlusion_edges(output);
+
+            auto ref = input;
+            ReferenceOcclusionEdges(ref, settings);
+
+            int removed = 0;
+            for (int y = 0; y < h; ++y)
+            {
+                for (int x = 0; x < w; ++x)
+                {
+                    ASSERT_EQ(output(y, x), ref(y, x)) << y << " " << x;
+                    removed += input(y, x) != 0 && output(y, x) == 0;
+                }
+            }
+            EXPECT_GT(removed, 0);
+        }
+    }
+}
+
+}  // namespace Saiga
@@ -232,6 +232,68 @@ TEST(EpipolarGeometry, FivePointAlgorithm)
     std::cout << "failed " << failed << std::endl;
 }
 
+TEST(EpipolarGeometry, RansacRequiredIterations)
+{
+    EXPECT_EQ(RansacRequiredIterations(1, 5, 0.99, 1000), 1);
+    EXPECT_EQ(RansacRequiredIterations(0, 5, 0.99, 1000), 1000);
+    EXPECT_EQ(RansacRequiredIterations(0.5, 5, 0.99, 1000), 146);
+    EXPECT_EQ(RansacRequiredIterations(0.5, 5, 0.99, 100), 100);
+}
+
+TEST(EpipolarGeometry, FivePointRansacAdaptive)
+{
+    FiveEightPointTest test;
+
+    // 20% outliers
+    int outliers = 0;
+    for (int i = 0; i < test.N; i += 5, ++outliers)
+    {
+        test.normalized_points2[i] = Random::MatrixUniform<Vec2>(-0.5, 0.5);
+    }
+
+    RansacParameters params;
+    params.maxIterations     = 500;
+    double epipolarTheshold  = 1.5 / test.K1.fx;
+    params.residualThreshold = epipolarTheshold * epipolarTheshold;
+    params.reserveN          = test.N;
+    params.threads           = 4;
+
+    auto run = [&](FivePointRansac& ransac, SE3& T) {
+        Mat3 E;
+        std::vector<int> inlierMatches;
+        std::vector<char> inlierMask;
+        int num = 0;
+#pragma omp parallel num_threads(params.threads)
+        {
+            int n = ransac.solve(test.normalized_points1, test.normalized_points2, E, T, inlierMatches, inlierMask);
+#pragma omp single
+            num = n;
+        }
+        EXPECT_EQ(num, inlierMatches.size());
+        return num;
+    };
+
+    SE3 T_full, T_adaptive;
+    FivePointRansac full(params);
+    int num_full = run(full, T_full);
+    EXPECT_EQ(full.Iterations(), params.maxIterations);
+
+    params.confidence    = 0.999;
+    params.preTestPoints = 1;
+    FivePointRansac adaptive(params);
+    int num_adaptive = run(adaptive, T_adaptive);
+    EXPECT_LT(adaptive.Iterations(), params.maxIterations / 5);
+
+    EXPECT_GE(num_full, test.N - outliers - 5);
+    EXPECT_GE(num_adaptive, test.N - outliers - 5);
+
+    Vec3 t     = T_adaptive.translation().normalized();
+    Vec3 ref_t = test.reference_T.translation().normalized();
+    if (t(2) < 0) t *= -1;
+    if (ref_t(2) < 0) ref_t *= -1;
+    ExpectCloseRelative(t, ref_t, 1e-2, false);
+}
+
 TEST(EpipolarGeometry, Benchmark)
 {
     int its = 50;
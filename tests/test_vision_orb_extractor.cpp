@@ -0,0 +1,258 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/image/imageTransformations.h"
+#include "saiga/core/math/random.h"
+#include "saiga/vision/features/FastDetector.h"
+#include "saiga/vision/features/ORBExtractor.h"
+
+#include "gtest/gtest.h"
+
+namespace Saiga
+{
+// Smooth random blobs + noise. Produces corners with a wide range of scores.
+static TemplatedImage<unsigned char> TestImage(int h, int w)
+{
+    TemplatedImage<unsigned char> img(h, w);
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            int v     = ((x / 7) * 37 + (y / 5) * 91) % 200 + Random::uniformInt(0, 55);
+            img(y, x) = v;
+        }
+    }
+    return img;
+}
+
+// Direct implementation of the definition (without early rejection and without SIMD).
+static std::vector<KeyPoint<float>> ReferenceFAST(ImageView<const unsigned char> img, int threshold, bool nonmax)
+{
+    const int circle[16][2] = {{0, 3},  {1, 3},   {2, 2},   {3, 1},   {3, 0},  {3, -1}, {2, -2}, {1, -3},
+                               {0, -3}, {-1, -3}, {-2, -2}, {-3, -1}, {-3, 0}, {-3, 1}, {-2, 2}, {-1, 3}};
+
+    auto is_corner = [&](int y, int x, int t) {
+        int v = img(y, x);
+        for (int start = 0; start < 16; ++start)
+        {
+            bool bright = true, dark = true;
+            for (int i = 0; i < 9; ++i)
+            {
+                int p = img(y + circle[(start + i) % 16][1], x + circle[(start + i) % 16][0]);
+                bright &= p > v + t;
+                dark &= p < v - t;
+            }
+            if (bright || dark) return true;
+        }
+        return false;
+    };
+
+    TemplatedImage<int> score(img.dimensions());
+    score.getImageView().set(0);
+    for (int y = 3; y < img.h - 3; ++y)
+    {
+        for (int x = 3; x < img.w - 3; ++x)
+        {
+            if (!is_corner(y, x, threshold)) continue;
+            int t = threshold;
+            while (is_corner(y, x, t + 1)) t++;
+            score(y, x) = t;
+        }
+    }
+
+    std::vector<KeyPoint<float>> result;
+    for (int y = 3; y < img.h - 3; ++y)
+    {
+        for (int x = 3; x < img.w - 3; ++x)
+        {
+            int s = score(y, x);
+            if (s == 0 && !is_corner(y, x, threshold)) continue;
+            bool is_max = true;
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    if (dx == 0 && dy == 0) continue;
+                    is_max &= s > score(y + dy, x + dx);
+                }
+            }
+            if (!nonmax || is_max) result.emplace_back(float(x), float(y), 7.f, -1.f, float(s));
+        }
+    }
+    return result;
+}
+
+TEST(ORBExtractor, FAST)
+{
+    auto img = TestImage(97, 203);
+    for (auto backend : {FastBackend::Scalar, FastBackend::AVX2})
+    {
+        if (!FastBackendSupported(backend)) continue;
+        for (int threshold : {5, 20, 60, 130})
+        {
+            for (bool nonmax : {false, true})
+            {
+                auto ref = ReferenceFAST(img, threshold, nonmax);
+                std::vector<KeyPoint<float>> kps;
+                DetectFAST(img, kps, threshold, nonmax, backend);
+                EXPECT_EQ(kps, ref) << FastBackendName(backend) << " threshold " << threshold;
+                if (threshold == 20)
+                {
+                    EXPECT_GT(kps.size(), 0);
+                }
+            }
+        }
+    }
+}
+
+TEST(ORBExtractor, FillBorder)
+{
+    int b = 4;
+    TemplatedImage<unsigned char> img(10 + 2 * b, 13 + 2 * b);
+    auto inner = img.getImageView().subImageView(b, b, 10, 13);
+    for (int y = 0; y < 10; ++y)
+        for (int x = 0; x < 13; ++x) inner(y, x) = y * 13 + x;
+
+    ImageTransformation::FillBorderReflect101(img, b);
+    for (int y = 0; y < img.h; ++y)
+    {
+        for (int x = 0; x < img.w; ++x)
+        {
+            int ry = std::abs(y - b);
+            int rx = std::abs(x - b);
+            if (ry >= 10) ry = 2 * 9 - ry;
+            if (rx >= 13) rx = 2 * 12 - rx;
+            EXPECT_EQ(img(y, x), ry * 13 + rx);
+        }
+    }
+}
+
+TEST(ORBExtractor, GaussianBlur)
+{
+    auto img = TestImage(40, 53);
+    TemplatedImage<unsigned char> blurred(img.dimensions());
+    ImageTransformation::GaussianBlur(img, blurred, 3, 2);
+
+    std::vector<double> kernel(7);
+    double sum = 0;
+    for (int k = 0; k < 7; ++k)
+    {
+        kernel[k] = std::exp(-(k - 3) * (k - 3) / 8.0);
+        sum += kernel[k];
+    }
+    for (auto& k : kernel) k /= sum;
+
+    auto reflect = [](int i, int n) { return i < 0 ? -i : (i >= n ? 2 * n - 2 - i : i); };
+    for (int y = 0; y < img.h; ++y)
+    {
+        for (int x = 0; x < img.w; ++x)
+        {
+            double v = 0;
+            for (int i = 0; i < 7; ++i)
+                for (int j = 0; j < 7; ++j)
+                    v += kernel[i] * kernel[j] * img(reflect(y + i - 3, img.h), reflect(x + j - 3, img.w));
+            EXPECT_LE(std::abs(blurred(y, x) - v), 1.0);
+        }
+    }
+}
+
+TEST(ORBExtractor, ResizeLinear)
+{
+    auto img = TestImage(30, 46);
+
+    TemplatedImage<unsigned char> same(img.dimensions());
+    ImageTransformation::ResizeLinear(img, same);
+    EXPECT_EQ(ImageTransformation::L1Difference(img, same), 0);
+
+    // Downscaling by 2 is the average of 2x2 pixels
+    TemplatedImage<unsigned char> small(15, 23);
+    ImageTransformation::ResizeLinear(img, small);
+    for (int y = 0; y < small.h; ++y)
+    {
+        for (int x = 0; x < small.w; ++x)
+        {
+            double avg = (img(2 * y, 2 * x) + img(2 * y + 1, 2 * x) + img(2 * y, 2 * x + 1) +
+                          img(2 * y + 1, 2 * x + 1)) /
+                         4.0;
+            EXPECT_LE(std::abs(small(y, x) - avg), 0.5 + 1e-5);
+        }
+    }
+}
+
+TEST(ORBExtractor, BatchDescriptors)
+{
+    auto img = TestImage(120, 160);
+    ORB orb;
+
+    std::vector<KeyPoint<float>> kps;
+    for (int y = 19; y < img.h - 19; y += 3)
+    {
+        for (int x = 19; x < img.w - 19; x += 5)
+        {
+            kps.emplace_back(float(x), float(y));
+        }
+    }
+
+    // Integer moments -> identical angles
+    orb.ComputeAngles(img, kps, 4);
+    for (auto& kp : kps)
+    {
+        EXPECT_EQ(kp.angle, orb.ComputeAngle(img, kp.point));
+    }
+
+    std::vector<DescriptorORB> descriptors(kps.size()), descriptors_single(kps.size());
+    orb.ComputeDescriptors(img, kps, descriptors, 4);
+    orb.ComputeDescriptors(img, kps, descriptors_single, 1);
+    EXPECT_EQ(descriptors, descriptors_single);
+
+    // The rotated pattern is rounded without the keypoint position. This changes a few bits for pattern points
+    // exactly between two pixels.
+    int total_distance = 0;
+    for (size_t i = 0; i < kps.size(); ++i)
+    {
+        auto reference = orb.ComputeDescriptor(img, kps[i].point, ORB::BinAngle(kps[i].angle));
+        int d          = distance(descriptors[i], reference);
+        EXPECT_LE(d, 8);
+        total_distance += d;
+    }
+    EXPECT_LE(total_distance, kps.size() / 2);
+}
+
+TEST(ORBExtractor, Detect)
+{
+    auto img = TestImage(480, 640);
+    ORBExtractor extractor(1000, 1.2, 8, 20, 7, 1);
+
+    std::vector<KeyPoint<float>> kps;
+    std::vector<DescriptorORB> descriptors;
+    extractor.Detect(img, kps, descriptors);
+
+    EXPECT_EQ(kps.size(), descriptors.size());
+    EXPECT_GE(kps.size(), 900);
+    EXPECT_LE(kps.size(), 1100);
+    for (auto& kp : kps)
+    {
+        EXPECT_GE(kp.point.x(), 0);
+        EXPECT_GE(kp.point.y(), 0);
+        EXPECT_LT(kp.point.x(), img.w);
+        EXPECT_LT(kp.point.y(), img.h);
+        EXPECT_GE(kp.octave, 0);
+        EXPECT_LT(kp.octave, 8);
+    }
+
+    // Same result for a different image size in between (the pyramid is reallocated)
+    auto img2 = TestImage(240, 320);
+    extractor.Detect(img2, kps, descriptors);
+    std::vector<KeyPoint<float>> kps2;
+    std::vector<DescriptorORB> descriptors2;
+    extractor.Detect(img, kps, descriptors);
+    ORBExtractor extractor2(1000, 1.2, 8, 20, 7, 1);
+    extractor2.Detect(img, kps2, descriptors2);
+    EXPECT_EQ(kps, kps2);
+    EXPECT_EQ(descriptors, descriptors2);
+}
+
+}  // namespace Saiga
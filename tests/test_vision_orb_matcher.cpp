@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2021 Darius Rückert
+ * Licensed under the MIT License.
+ * See LICENSE file for more information.
+ */
+
+#include "saiga/core/math/random.h"
+#include "saiga/vision/features/OrbMatcher.h"
+
+#include "gtest/gtest.h"
+
+namespace Saiga
+{
+static std::vector<DescriptorORB> RandomDescriptors(int n)
+{
+    std::vector<DescriptorORB> result(n);
+    for (auto& d : result)
+    {
+        for (auto& v : d) v = Random::urand64();
+    }
+    return result;
+}
+
+// Flips 'bits' random bits of d.
+static DescriptorORB Perturb(DescriptorORB d, int bits)
+{
+    for (int i = 0; i < bits; ++i)
+    {
+        int b = Random::uniformInt(0, 255);
+        d[b / 64] ^= uint64_t(1) << (b % 64);
+    }
+    return d;
+}
+
+static std::vector<HammingBackend> SupportedBackends()
+{
+    std::vector<HammingBackend> result;
+    for (auto b : {HammingBackend::Scalar, HammingBackend::AVX2, HammingBackend::AVX512})
+    {
+        if (HammingBackendSupported(b)) result.push_back(b);
+    }
+    return result;
+}
+
+TEST(OrbMatcher, OneToMany)
+{
+    auto query = RandomDescriptors(3);
+    // Sizes which are not a multiple of the SIMD width
+    for (int n : {0, 1, 3, 4, 7, 8, 9, 31, 1001})
+    {
+        auto train = RandomDescriptors(n);
+        for (auto b : SupportedBackends())
+        {
+            for (auto& q : query)
+            {
+                std::vector<int> dis(n, -1);
+                DistanceOneToMany(q, train, dis.data(), b);
+                for (int j = 0; j < n; ++j)
+                {
+                    EXPECT_EQ(dis[j], distance(q, train[j])) << HammingBackendName(b) << " n=" << n << " j=" << j;
+                }
+            }
+        }
+    }
+
+    // Extreme values
+    DescriptorORB zero, ones;
+    zero.fill(0);
+    ones.fill(~uint64_t(0));
+    std::vector<DescriptorORB> train = {zero, ones, zero, ones, ones, zero, ones, ones, zero};
+    for (auto b : SupportedBackends())
+    {
+        std::vector<int> dis(train.size());
+        DistanceOneToMany(zero, train, dis.data(), b);
+        for (int j = 0; j < (int)train.size(); ++j)
+        {
+            EXPECT_EQ(dis[j], train[j][0] ? 256 : 0);
+        }
+    }
+}
+
+TEST(OrbMatcher, ManyToMany)
+{
+    auto query = RandomDescriptors(77);
+    auto train = RandomDescriptors(1500);
+
+    std::vector<int> dis(query.size() * train.size());
+    DistanceManyToMany(query, train, dis.data());
+    for (int i = 0; i < (int)query.size(); ++i)
+    {
+        for (int j = 0; j < (int)train.size(); ++j)
+        {
+            ASSERT_EQ(dis[i * train.size() + j], distance(query[i], train[j]));
+        }
+    }
+}
+
+TEST(OrbMatcher, Knn)
+{
+    auto train = RandomDescriptors(1234);
+    std::vector<DescriptorORB> query;
+    for (int i = 0; i < 100; ++i)
+    {
+        query.push_back(Perturb(train[Random::uniformInt(0, train.size() - 1)], 20));
+    }
+    // Duplicates in train to check the tie breaking
+    train[1000] = train[10];
+    query.push_back(train[10]);
+
+    for (int k : {1, 2, 5})
+    {
+        std::vector<DescriptorMatch> knn(query.size() * k);
+        MatchKnnORB(query, train, k, knn);
+
+        for (int i = 0; i < (int)query.size(); ++i)
+        {
+            std::vector<std::pair<int, int>> ref;
+            for (int j = 0; j < (int)train.size(); ++j) ref.emplace_back(distance(query[i], train[j]), j);
+            std::sort(ref.begin(), ref.end());
+
+            for (int l = 0; l < k; ++l)
+            {
+                auto& m = knn[i * k + l];
+                EXPECT_EQ(m.query, i);
+                EXPECT_EQ(m.distance, ref[l].first);
+                EXPECT_EQ(m.train, ref[l].second);
+            }
+        }
+    }
+
+    // Less train descriptors than k
+    auto small = RandomDescriptors(2);
+    std::vector<DescriptorMatch> knn(query.size() * 4);
+    MatchKnnORB(query, small, 4, knn);
+    for (int i = 0; i < (int)query.size(); ++i)
+    {
+        EXPECT_LE(knn[i * 4].distance, knn[i * 4 + 1].distance);
+        EXPECT_GE(knn[i * 4 + 1].train, 0);
+        EXPECT_EQ(knn[i * 4 + 2].train, -1);
+        EXPECT_EQ(knn[i * 4 + 3].train, -1);
+    }
+}
+
+TEST(OrbMatcher, Filter)
+{
+    auto train = RandomDescriptors(500);
+    // Ambiguous: two equally good candidates for query 0 and 1
+    train[1] = train[0];
+
+    std::vector<DescriptorORB> query;
+    for (int i = 0; i < 200; ++i)
+    {
+        query.push_back(Perturb(train[i], 10));
+    }
+
+    ORBMatchParams params;
+    auto matches = MatchORB(query, train, params);
+
+    // Random descriptors have a distance of ~128 -> Every query, except 0 and 1, has a unique match.
+    std::vector<int> found(query.size(), -1);
+    for (auto& m : matches)
+    {
+        EXPECT_LE(m.distance, params.max_distance);
+        EXPECT_EQ(m.distance, distance(query[m.query], train[m.train]));
+        found[m.query] = m.train;
+    }
+    EXPECT_EQ(found[0], -1);
+    EXPECT_EQ(found[1], -1);
+    for (int i = 2; i < (int)query.size(); ++i) EXPECT_EQ(found[i], i);
+
+    // Without ratio test, the ambiguous queries are matched to the lower train index
+    params.ratio = 1;
+    matches      = MatchORB(query, train, params);
+    EXPECT_EQ(matches.size(), query.size());
+    EXPECT_EQ(matches[0].train, 0);
+    EXPECT_EQ(matches[1].train, 0);
+
+    // The cross check keeps only one of them
+    params.cross_check = true;
+    matches            = MatchORB(query, train, params);
+    EXPECT_EQ(matches.size(), query.size() - 1);
+    EXPECT_EQ(matches[0].train, 0);
+    EXPECT_EQ(matches[1].train, 2);
+
+    params.max_distance = 5;
+    EXPECT_TRUE(MatchORB(query, train, params).empty());
+}
+
+}  // namespace Saiga
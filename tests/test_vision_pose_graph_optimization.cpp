@@ -50,6 +50,17 @@ class PoseGraphOptimizationTest
         return cpy;
     }
 
+    PoseGraph solveRecFloat()
+    {
+        PoseGraph cpy = scene;
+        PGORecFloat ba;
+        ba.optimizationOptions                 = opoptions;
+        ba.optimizationOptions.refinementSteps = 1;
+        ba.create(cpy);
+        ba.initAndSolve();
+        return cpy;
+    }
+
     PoseGraph solveCeres()
     {
         PoseGraph cpy = scene;
@@ -71,6 +82,16 @@ class PoseGraphOptimizationTest
         ExpectClose(scene1.chi2(), scene2.chi2(), 1e-5);
     }
 
+    void testFloat()
+    {
+        auto scene1 = solveRec();
+        auto scene2 = solveRecFloat();
+
+        std::cout << scene.chi2() << " -> (double) " << scene1.chi2() << " (float) " << scene2.chi2() << std::endl;
+
+        ExpectClose(scene1.chi2(), scene2.chi2(), 1e-5);
+    }
+
     void buildScene(bool with_scale_drift)
     {
         if (with_scale_drift)
@@ -149,6 +170,16 @@ TEST(PoseGraphOptimization, LoopClosingSE3)
         test.test();
     }
 }
+TEST(PoseGraphOptimization, LoopClosingSE3Float)
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        PoseGraphOptimizationTest test;
+        test.buildScene(false);
+        test.testFloat();
+    }
+}
+
 TEST(PoseGraphOptimization, LoopClosingSim3)
 {
     for (int i = 0; i < 5; ++i)
@@ -123,6 +123,70 @@ TEST(RecursiveLinearSolver, SparseBlock)
     }
 }
 
+TEST(RecursiveLinearSolver, SupernodalLLT)
+{
+    Random::setSeed(2357);
+    srand(5783);
+
+    using T              = double;
+    const int block_size = 6;
+    int n                = 300;
+
+    using Block  = Eigen::Matrix<T, block_size, block_size>;
+    using Vector = Eigen::Matrix<T, block_size, 1>;
+    using AType  = Eigen::SparseMatrix<Eigen::Recursive::MatrixScalar<Block>, Eigen::RowMajor>;
+    using BType  = Eigen::Matrix<Eigen::Recursive::MatrixScalar<Vector>, -1, 1>;
+
+    // PGO like structure: a chain with a few random loop closures. Only the upper triangle is set.
+    auto build = [&](double diag_weight) {
+        std::vector<Eigen::Triplet<Block>> tripletList;
+        for (int i = 0; i < n; ++i)
+        {
+            Block diag = Block::Random();
+            diag       = diag * diag.transpose() + Block::Identity() * diag_weight;
+            tripletList.emplace_back(i, i, diag);
+            if (i + 1 < n) tripletList.emplace_back(i, i + 1, Block::Random());
+        }
+        for (int k = 0; k < n / 2; ++k)
+        {
+            int i = Random::uniformInt(0, n - 1);
+            int j = Random::uniformInt(0, n - 1);
+            if (std::abs(i - j) > 1) tripletList.emplace_back(std::min(i, j), std::max(i, j), Block::Random());
+        }
+        AType A(n, n);
+        A.setFromTriplets(tripletList.begin(), tripletList.end());
+        return A;
+    };
+
+    AType A = build(20);
+    BType b(n);
+    for (int i = 0; i < n; ++i) b(i) = Vector::Random();
+
+    Eigen::Matrix<double, -1, -1> A_ex = expand(A);
+    A_ex                               = A_ex.selfadjointView<Eigen::Upper>();
+    Eigen::Matrix<double, -1, 1> b_ex  = expand(b);
+    Eigen::Matrix<double, -1, 1> ref_x = A_ex.llt().solve(b_ex);
+
+    Eigen::Recursive::RecursiveSupernodalLLT<AType> llt;
+    llt.compute(A);
+    ASSERT_EQ(llt.info(), Eigen::Success);
+    EXPECT_LT(llt.numSupernodes(), n);
+    BType x = llt.solve(b);
+    ExpectCloseRelative(ref_x, expand(x), 1e-10, false);
+
+    // Same pattern, new values -> only factorize
+    for (int k = 0; k < A.nonZeros(); ++k) A.valuePtr()[k].get() *= 2;
+    llt.factorize(A);
+    ASSERT_EQ(llt.info(), Eigen::Success);
+    x = llt.solve(b);
+    ExpectCloseRelative(ref_x * 0.5, expand(x), 1e-10, false);
+
+    // Indefinite matrix
+    for (int k = 0; k < A.nonZeros(); ++k) A.valuePtr()[k].get() *= -1;
+    llt.factorize(A);
+    EXPECT_EQ(llt.info(), Eigen::NumericalIssue);
+}
+
 TEST(RecursiveLinearSolver, BA)
 {
     // Symmetric positive BA like matrix.
@@ -271,6 +271,62 @@ TEST(TSDF, BasicFunctions)
     EXPECT_TRUE(block);
 }
 
+TEST(TSDF, GrowAndRehash)
+{
+    SparseTSDF tsdf(1, 1, 1);
+    auto first = tsdf.InsertBlock({0, 0, 0});
+    first->data[1][2][3].distance = 5;
+
+    for (int z = 0; z < 20; ++z)
+        for (int y = 0; y < 20; ++y)
+            for (int x = 0; x < 20; ++x) tsdf.InsertBlock({x, y, z});
+
+    EXPECT_EQ(tsdf.current_blocks, 20 * 20 * 20);
+    EXPECT_LE(tsdf.current_blocks, tsdf.hash_size * tsdf.max_load_factor);
+
+    // Blocks are never moved
+    EXPECT_EQ(tsdf.GetBlock({0, 0, 0}), first);
+    EXPECT_EQ(first->data[1][2][3].distance, 5);
+
+    for (int z = 0; z < 20; ++z)
+        for (int y = 0; y < 20; ++y)
+            for (int x = 0; x < 20; ++x)
+            {
+                auto b = tsdf.GetBlock({x, y, z});
+                ASSERT_TRUE(b);
+                EXPECT_EQ(b->index, ivec3(x, y, z));
+            }
+}
+
+TEST(TSDF, ParallelInsert)
+{
+    int n = 50000;
+    std::vector<ivec3> ids(n);
+    for (auto& id : ids)
+    {
+        id = ivec3(Random::uniformInt(-30, 30), Random::uniformInt(-30, 30), Random::uniformInt(-30, 30));
+    }
+
+    SparseTSDF reference(1, 1000, 1000);
+    for (auto& id : ids) reference.InsertBlock(id);
+
+    // Small initial sizes -> the storage grows and the table is rehashed during the parallel insertion.
+    SparseTSDF tsdf(1, 1, 1);
+    std::vector<SparseTSDF::VoxelBlock*> ptrs(n);
+#pragma omp parallel for num_threads(8)
+    for (int i = 0; i < n; ++i)
+    {
+        ptrs[i] = tsdf.InsertBlockLock(ids[i]);
+    }
+
+    EXPECT_EQ(tsdf.current_blocks, reference.current_blocks);
+    for (int i = 0; i < n; ++i)
+    {
+        EXPECT_EQ(ptrs[i], tsdf.GetBlock(ids[i]));
+        EXPECT_EQ(ptrs[i]->index, ids[i]);
+    }
+}
+
 TEST(TSDF, Trace)
 {
     int w = 50;
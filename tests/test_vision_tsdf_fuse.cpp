@@ -7,6 +7,8 @@
 #include "saiga/core/Core.h"
 #include "saiga/vision/reconstruction/MarchingCubes.h"
 #include "saiga/vision/reconstruction/SparseTSDF.h"
+#include "saiga/vision/reconstruction/SparseTSDFRaycast.h"
+#include "saiga/vision/reconstruction/StreamingFusion.h"
 #include "saiga/vision/reconstruction/VoxelFusion.h"
 
 #include "gtest/gtest.h"
@@ -106,7 +108,7 @@ TEST(TSDF, IncrementalFuse)
     scene2 = test->scene;
     scene2.images.clear();
     scene2.params.out_file = "tsdf_incr.off";
-    for (int i = 0; i < test->scene.images.size(); ++i)
+    for (int i = 0; i < int(test->scene.images.size()); ++i)
     {
         scene2.FuseIncrement(test->scene.images[i], i == 0);
     }
@@ -117,6 +119,163 @@ TEST(TSDF, IncrementalFuse)
 }
 
 
+TEST(TSDF, StreamingFuse)
+{
+    // The camera moves away and comes back to the first position, so the first region is swapped out and in.
+    std::vector<SE3> poses;
+    for (double x : {0.0, 20.0, 40.0, 0.0, 0.2})
+    {
+        poses.push_back(SE3(Quat::Identity(), Vec3(x, 0, 0)));
+    }
+
+    FusionScene scene2;
+    scene2 = test->scene;
+    scene2.images.clear();
+    scene2.params.verbose  = false;
+    scene2.params.out_file = "";
+    for (int i = 0; i < int(poses.size()); ++i)
+    {
+        FusionImage fi;
+        fi.depthMap = test->depth_image.getImageView();
+        fi.V        = poses[i];
+        scene2.FuseIncrement(fi, i == 0);
+    }
+
+    StreamingFusionParams stream_params;
+    stream_params.working_radius = 1;
+    stream_params.swap_directory = "tsdf_swap_test";
+    StreamingFusion fusion(scene2.K, scene2.dis, scene2.params, stream_params);
+    for (auto& V : poses)
+    {
+        fusion.Add(test->depth_image.getImageView(), V);
+    }
+    fusion.Finish();
+
+    // A second instance with the same swap directory must not touch the swapped regions of the first one
+    {
+        StreamingFusion other(scene2.K, scene2.dis, scene2.params, stream_params);
+        for (auto& V : poses)
+        {
+            other.Add(test->depth_image.getImageView(), V);
+        }
+    }
+
+    auto st = fusion.Statistics();
+    EXPECT_EQ(st.frames, poses.size());
+    EXPECT_GT(st.regions_swapped_in, 0);
+    EXPECT_LT(st.max_resident_blocks, scene2.tsdf->current_blocks);
+
+    fusion.LoadAll();
+    auto& tsdf = *fusion.Scene().tsdf;
+    EXPECT_EQ(tsdf.current_blocks, scene2.tsdf->current_blocks);
+    for (int i = 0; i < scene2.tsdf->current_blocks; ++i)
+    {
+        auto& b1 = scene2.tsdf->blocks[i];
+        auto* b2 = tsdf.GetBlock(b1.index);
+        ASSERT_TRUE(b2);
+        EXPECT_EQ(std::memcmp(b1.data.data(), b2->data.data(), sizeof(b1.data)), 0);
+    }
+
+    auto mesh = fusion.ExtractMesh();
+    scene2.ExtractMesh();
+    EXPECT_EQ(mesh.NumFaces(), scene2.mesh.NumFaces());
+}
+
+TEST(TSDF, IncrementalSurface)
+{
+    FusionScene scene2;
+    scene2 = test->scene;
+    scene2.images.clear();
+    scene2.params.verbose  = false;
+    scene2.params.out_file = "";
+
+    FusionImage fi;
+    fi.depthMap = test->depth_image.getImageView();
+    fi.V        = SE3();
+    scene2.FuseIncrement(fi, true);
+
+    auto mesh     = scene2.ExtractMeshIncremental();
+    auto soup     = scene2.tsdf->ExtractSurface(scene2.params.extract_iso, scene2.params.extract_outlier_factor, 0,
+                                            OMP::getMaxThreads(), false);
+    int soup_size = 0;
+    for (auto& s : soup) soup_size += s.size();
+    EXPECT_GT(mesh.NumFaces(), 0);
+    EXPECT_EQ(mesh.NumFaces(), soup_size);
+    // Shared vertices. The triangle soup has 3 vertices per face.
+    EXPECT_LT(mesh.NumVertices(), mesh.NumFaces());
+
+    // Only the modified blocks and their neighbours are updated
+    fi.V = SE3(Quat::Identity(), Vec3(0.3, 0, 0));
+    scene2.FuseIncrement(fi, false);
+    int updated = scene2.surface.Update(*scene2.tsdf, scene2.params.extract_iso,
+                                        scene2.params.extract_outlier_factor, 0);
+    EXPECT_GT(updated, 0);
+    EXPECT_LT(updated, scene2.tsdf->current_blocks);
+    auto mesh_incremental = scene2.surface.CreateMesh();
+
+    SparseTSDFSurface full;
+    full.Update(*scene2.tsdf, scene2.params.extract_iso, scene2.params.extract_outlier_factor, 0);
+    auto mesh_full = full.CreateMesh();
+
+    ASSERT_EQ(mesh_incremental.NumFaces(), mesh_full.NumFaces());
+    ASSERT_EQ(mesh_incremental.NumVertices(), mesh_full.NumVertices());
+    EXPECT_EQ(mesh_incremental.triangles, mesh_full.triangles);
+    EXPECT_EQ(mesh_incremental.position, mesh_full.position);
+}
+
+TEST(TSDF, Raycast)
+{
+    auto& scene = test->scene;
+    auto& tsdf  = *scene.tsdf;
+    auto& input = test->depth_image;
+    SE3 V       = scene.images[0].V;
+
+    SparseTSDFRaycast raycast(tsdf);
+    raycast.params.max_depth = scene.params.maxIntegrationDistance;
+
+    TSDFRaycastImages model;
+    auto stats = raycast.Raycast(scene.K, V, input.h, input.w, model);
+    EXPECT_GT(stats.hits, input.w * input.h / 4);
+    EXPECT_GT(stats.skipped_blocks, 0);
+    EXPECT_LT(stats.block_lookups, stats.samples / 4);
+
+    // The rendered depth is close to the fused depth map and the normals point to the camera
+    std::vector<float> errors;
+    int facing = 0;
+    for (int y = 0; y < input.h; ++y)
+    {
+        for (int x = 0; x < input.w; ++x)
+        {
+            float d = model.depth(y, x);
+            if (d <= 0) continue;
+            EXPECT_GT(model.confidence(y, x), 0);
+            vec2 np = scene.K.cast<float>().unproject2(vec2(x, y));
+            facing += model.normal(y, x).dot(vec3(np(0), np(1), 1)) < 0;
+            if (input(y, x) > 0) errors.push_back(std::abs(d - input(y, x)));
+        }
+    }
+    ASSERT_GT(errors.size(), 0);
+    std::nth_element(errors.begin(), errors.begin() + errors.size() / 2, errors.end());
+    EXPECT_LT(errors[errors.size() / 2], tsdf.voxel_size);
+    EXPECT_GT(facing, stats.hits * 0.95);
+
+    // Same intersections as the single ray reference with a small step size
+    vec3 origin = V.inverse().translation().cast<float>();
+    int tested = 0, same = 0;
+    for (int y = 0; y < input.h; y += 7)
+    {
+        for (int x = 0; x < input.w; x += 7)
+        {
+            vec2 np   = scene.K.cast<float>().unproject2(vec2(x, y));
+            vec3 dir  = (V.so3().inverse() * Vec3(np(0), np(1), 1)).cast<float>().normalized();
+            float ref = tsdf.RaySurfaceIntersection<2>(origin, dir, 0.1, 5, tsdf.voxel_size * 0.25);
+            float t   = raycast.TraceRay(origin, dir, 0.1, 5);
+            tested++;
+            same += (ref >= 5 && t >= 5) || std::abs(ref - t) < tsdf.voxel_size;
+        }
+    }
+    EXPECT_GT(same, tested * 0.95);
+}
 
 TEST(TSDF, LoadStore)
 {